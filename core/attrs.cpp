@@ -1,9 +1,26 @@
 #include "attrs.hpp"
 
+#include <limits>
+#include <stdexcept>
+
 namespace os2cx {
 
 AttrBitIndex attr_bit_solid() {
     return 0;
 }
 
+AttrSetId AttrSetTable::intern(AttrBitset attrs) {
+    auto it = ids.find(attrs);
+    if (it != ids.end()) {
+        return it->second;
+    }
+    if (static_cast<int>(sets.size()) > std::numeric_limits<AttrSetId>::max()) {
+        throw std::runtime_error("too many distinct combinations of attrs");
+    }
+    AttrSetId id = sets.size();
+    sets.push_back(attrs);
+    ids.insert(std::make_pair(attrs, id));
+    return id;
+}
+
 } /* namespace os2cx */
@@ -1,8 +1,11 @@
 #ifndef OS2CX_ATTRS_HPP_
 #define OS2CX_ATTRS_HPP_
 
+#include <stdint.h>
+
 #include <bitset>
 #include <cassert>
+#include <unordered_map>
 #include <vector>
 
 namespace os2cx {
@@ -13,6 +16,28 @@ typedef std::bitset<num_attr_bits> AttrBitset;
 
 AttrBitIndex attr_bit_solid();
 
+/* A mesh only has a handful of distinct combinations of attrs, so instead of
+storing an AttrBitset for every element and face, it stores an AttrSetId that
+refers to an AttrBitset in an AttrSetTable. */
+typedef uint16_t AttrSetId;
+
+class AttrSetTable {
+public:
+    /* Returns the ID of 'attrs', adding it to the table if it's new */
+    AttrSetId intern(AttrBitset attrs);
+
+    const AttrBitset &operator[](AttrSetId id) const {
+        assert(id < static_cast<int>(sets.size()));
+        return sets[id];
+    }
+
+    int size() const { return sets.size(); }
+
+private:
+    std::vector<AttrBitset> sets;
+    std::unordered_map<AttrBitset, AttrSetId> ids;
+};
+
 template<class T>
 class AttrOverrides {
 public:
@@ -23,6 +48,9 @@ public:
     }
 
     T lookup(AttrBitset attrs, T default_value) const {
+        if ((attrs & overridden_attrs).none()) {
+            return default_value;
+        }
         for (AttrBitIndex i = num_attr_bits - 1; i >= 0; --i) {
             if (attrs[i] && overridden_attrs[i]) {
                 return values[i];
@@ -31,6 +59,20 @@ public:
         return default_value;
     }
 
+    /* Looks up every set in 'table' at once, so that the result for an
+    element is just an index into the returned vector by its AttrSetId */
+    std::vector<T> lookup_table(
+        const AttrSetTable &table,
+        T default_value
+    ) const {
+        std::vector<T> results;
+        results.reserve(table.size());
+        for (int id = 0; id < table.size(); ++id) {
+            results.push_back(lookup(table[id], default_value));
+        }
+        return results;
+    }
+
     AttrBitset overridden_attrs;
     T values[num_attr_bits];
 };
@@ -2,6 +2,8 @@
 
 #include <assert.h>
 
+#include <algorithm>
+
 namespace os2cx {
 
 std::ostream &operator<<(std::ostream &stream, Dimension dimension) {
@@ -34,6 +36,48 @@ Vector triangle_normal(Point p1, Point p2, Point p3) {
     return c / c.magnitude();
 }
 
+/* This is the algorithm from "Real-Time Collision Detection" by Christer
+Ericson, section 5.1.5. */
+Point closest_point_on_triangle(Point p, Point a, Point b, Point c) {
+    LengthVector ab = b - a, ac = c - a, ap = p - a;
+    double d1 = ab.dot(ap), d2 = ac.dot(ap);
+    if (d1 <= 0 && d2 <= 0) return a;
+
+    LengthVector bp = p - b;
+    double d3 = ab.dot(bp), d4 = ac.dot(bp);
+    if (d3 >= 0 && d4 <= d3) return b;
+
+    double vc = d1 * d4 - d3 * d2;
+    if (vc <= 0 && d1 >= 0 && d3 <= 0) {
+        return a + ab * (d1 / (d1 - d3));
+    }
+
+    LengthVector cp = p - c;
+    double d5 = ab.dot(cp), d6 = ac.dot(cp);
+    if (d6 >= 0 && d5 <= d6) return c;
+
+    double vb = d5 * d2 - d1 * d6;
+    if (vb <= 0 && d2 >= 0 && d6 <= 0) {
+        return a + ac * (d2 / (d2 - d6));
+    }
+
+    double va = d3 * d6 - d5 * d4;
+    if (va <= 0 && (d4 - d3) >= 0 && (d5 - d6) >= 0) {
+        return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+    }
+
+    double denom = 1 / (va + vb + vc);
+    return a + ab * (vb * denom) + ac * (vc * denom);
+}
+
+Point closest_point_on_segment(Point p, Point a, Point b) {
+    LengthVector ab = b - a;
+    double len2 = ab.dot(ab);
+    if (len2 == 0) return a;
+    double t = (p - a).dot(ab) / len2;
+    return a + ab * std::max(0.0, std::min(1.0, t));
+}
+
 std::ostream &operator<<(std::ostream &stream, Point point) {
     return stream << '('
         << point.x << ' '
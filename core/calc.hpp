@@ -168,6 +168,12 @@ inline Point operator+(LengthVector a, Point b) {
 
 Vector triangle_normal(Point p1, Point p2, Point p3);
 
+/* Returns the point on the triangle (a, b, c) that is closest to 'p' */
+Point closest_point_on_triangle(Point p, Point a, Point b, Point c);
+
+/* Returns the point on the line segment (a, b) that is closest to 'p' */
+Point closest_point_on_segment(Point p, Point a, Point b);
+
 std::ostream &operator<<(std::ostream &stream, Point point);
 
 class ComplexVector {
@@ -1,6 +1,9 @@
 #include "calculix_inp_write.hpp"
 
 #include <fstream>
+#include <math.h>
+
+#include "mesher_axisymmetric.hpp"
 
 namespace os2cx {
 
@@ -25,11 +28,21 @@ void write_calculix_nodes_and_elements(
     NodeId node_begin,
     NodeId node_end,
     ElementId element_begin,
-    ElementId element_end
+    ElementId element_end,
+    const ContiguousMap<NodeId, NodeId> *meridian_nodes
 ) {
     stream << "*NODE, NSET=N" << name << '\n';
     for (NodeId nid = node_begin; nid != node_end; ++nid) {
         const Node3 &node = mesh.nodes[nid];
+        if (meridian_nodes) {
+            /* Only the nodes of the CAX elements, in the R-Z plane */
+            if ((*meridian_nodes)[nid] != nid) continue;
+            stream << nid.to_int()
+                << ", " << node.point.x
+                << ", " << node.point.z
+                << ", 0\n";
+            continue;
+        }
         stream << nid.to_int()
             << ", " << node.point.x
             << ", " << node.point.y
@@ -44,13 +57,34 @@ void write_calculix_nodes_and_elements(
 
     for (ElementType type : types_present) {
         const ElementTypeShape &shape = element_type_shape(type);
-        stream << "*ELEMENT, TYPE=" << shape.name
+        /* The revolved elements of an axisymmetric mesh are written as CAX
+        elements, using the corner nodes on the meridian and then the nodes in
+        the middles of their edges; see mesher_axisymmetric() */
+        std::vector<int> vertex_indices;
+        if (meridian_nodes) {
+            int n = (shape.category == ElementTypeShape::Category::Brick)
+                ? 4 : 3;
+            for (int i = 0; i < n; ++i) {
+                vertex_indices.push_back(i);
+            }
+            if (shape.order == 2) {
+                for (int i = 0; i < n; ++i) {
+                    vertex_indices.push_back(2 * n + i);
+                }
+            }
+        } else {
+            for (int i = 0; i < static_cast<int>(shape.vertices.size()); ++i) {
+                vertex_indices.push_back(i);
+            }
+        }
+        stream << "*ELEMENT, TYPE="
+            << (meridian_nodes ? axisymmetric_element_name(type) : shape.name)
             << ", ELSET=E" << name << '\n';
         for (ElementId eid = element_begin; eid != element_end; ++eid) {
-            const Element3 *element = &mesh.elements[eid];
-            if (element->type != type) continue;
+            ConstElement3Ref element = mesh.elements[eid];
+            if (element.type != type) continue;
             stream << eid.to_int();
-            for (size_t i = 0; i < shape.vertices.size(); ++i) {
+            for (size_t i = 0; i < vertex_indices.size(); ++i) {
                 if (i == 15) {
                     /* If there would be more than 16 entries on a single line,
                     CalculiX expects it to be split into two lines */
@@ -58,7 +92,7 @@ void write_calculix_nodes_and_elements(
                 } else {
                     stream << ", ";
                 }
-                stream << element->nodes[i].to_int();
+                stream << element.nodes[vertex_indices[i]].to_int();
             }
             stream << '\n';
         }
@@ -133,12 +167,15 @@ void write_calculix_material_and_solid_section(
         << project.unit_system.unit_to_system(material.density) << '\n';
 
     bool any_element = false;
+    const Element3Store &elements = project.mesh->elements;
     for (const auto &pair : project.mesh_objects) {
+        std::vector<MaterialId> set_materials =
+            project.material_overrides.lookup_table(
+                elements.attr_sets(), pair.second.material);
         for (ElementId eid = pair.second.element_begin;
                 eid != pair.second.element_end; ++eid) {
-            MaterialId element_material = project.material_overrides.lookup(
-                project.mesh->elements[eid].attrs,
-                pair.second.material);
+            MaterialId element_material =
+                set_materials[elements.attr_set_id(eid)];
             if (element_material != material.id) {
                 continue;
             }
@@ -205,55 +242,159 @@ void write_calculix_equation(
     variables_used->insert(dependent_variable);
 }
 
+static std::string symmetry_plane_name(const Project::SymmetryPlane &plane) {
+    switch (plane.axis) {
+    case Dimension::X: return "symmetry_yz";
+    case Dimension::Y: return "symmetry_xz";
+    case Dimension::Z: return "symmetry_xy";
+    default: assert(false);
+    }
+}
+
+/* For an axisymmetric mesh, CalculiX only knows the nodes on the meridian, and
+numbers the faces of each CAX element from its first edge; faces 0 and 1 of
+the revolved elements are the sides of the wedge, which aren't real surfaces */
+static NodeSet axisymmetric_node_set(
+    const NodeSet &node_set,
+    const ContiguousMap<NodeId, NodeId> &meridian_nodes
+) {
+    NodeSet result;
+    for (NodeId node_id : node_set.nodes) {
+        result.nodes.insert(meridian_nodes[node_id]);
+    }
+    return result;
+}
+
+static FaceSet axisymmetric_face_set(const FaceSet &face_set) {
+    FaceSet result;
+    for (FaceId face_id : face_set.faces) {
+        if (face_id.face >= 2) {
+            result.faces.insert(FaceId(face_id.element_id, face_id.face - 2));
+        }
+    }
+    return result;
+}
+
+/* Sums the loads onto the meridian nodes, as radial and axial components.
+CalculiX expects the loads on a 2 degree wedge, which is exactly what the mesh
+is, so they don't need to be scaled. */
+static ConcentratedLoad axisymmetric_load(
+    const Mesh3 &mesh,
+    const ConcentratedLoad &load,
+    const ContiguousMap<NodeId, NodeId> &meridian_nodes
+) {
+    ConcentratedLoad result;
+    for (const auto &pair : load.loads) {
+        Point point = mesh.nodes[pair.first].point;
+        double angle = atan2(point.y, point.x);
+        const Vector &force = pair.second.force;
+        Vector &sum = result.loads[meridian_nodes[pair.first]].force;
+        sum.x += force.x * cos(angle) + force.y * sin(angle);
+        sum.y += force.z;
+    }
+    return result;
+}
+
 void write_calculix_job(
     const FilePath &dir_path,
     const std::string &main_file_name,
     const Project &project
 ) {
+    bool axisymmetric = project.is_axisymmetric();
+    ContiguousMap<NodeId, NodeId> meridian_nodes;
+    if (axisymmetric) {
+        meridian_nodes = compute_axisymmetric_meridian_nodes(*project.mesh);
+    }
+
     {
         FilePath geometry_file_path = dir_path + "/objects.inp";
         std::ofstream geometry_stream(geometry_file_path);
 
         for (const auto &pair : project.create_node_objects) {
+            Point point = pair.second.point;
+            if (axisymmetric) {
+                point = Point(hypot(point.x, point.y), point.z, 0);
+            }
             write_calculix_create_node(
-                geometry_stream, pair.first,
-                pair.second.node_id, pair.second.point);
+                geometry_stream, pair.first, pair.second.node_id, point);
         }
 
         for (const auto &pair : project.mesh_objects) {
             write_calculix_nodes_and_elements(
                 geometry_stream, pair.first, *project.mesh,
                 pair.second.node_begin, pair.second.node_end,
-                pair.second.element_begin, pair.second.element_end);
+                pair.second.element_begin, pair.second.element_end,
+                axisymmetric ? &meridian_nodes : nullptr);
+        }
+
+        /* The nodes on the symmetry planes are fixed perpendicular to them.
+        CalculiX doesn't allow a fixed variable to be the dependent variable
+        of an equation, and an equation among only fixed variables holds
+        trivially, so leave it out. */
+        std::set<LinearEquation::Variable> variables_fixed;
+        for (const Project::SymmetryPlane &plane : project.symmetry_planes) {
+            std::string name = symmetry_plane_name(plane);
+            write_calculix_nset(geometry_stream, name, *plane.node_set);
+            int dimension = dimension_to_int(plane.axis);
+            geometry_stream << "*BOUNDARY\n" << 'N' << name << ','
+                << dimension << ',' << dimension << '\n';
+            for (NodeId node_id : plane.node_set->nodes) {
+                variables_fixed.insert(
+                    LinearEquation::Variable(node_id, plane.axis));
+            }
         }
+        auto is_fixed = [&](const LinearEquation &equation) {
+            for (const auto &term : equation.terms) {
+                if (term.second != 0 && !variables_fixed.count(term.first)) {
+                    return false;
+                }
+            }
+            return true;
+        };
 
-        std::set<LinearEquation::Variable> variables_used;
+        std::set<LinearEquation::Variable> variables_used = variables_fixed;
+        for (const auto &pair : project.mesh_objects) {
+            if (!pair.second.equations) continue;
+            for (const LinearEquation &equation : *pair.second.equations) {
+                if (is_fixed(equation)) continue;
+                write_calculix_equation(
+                    geometry_stream, equation, &variables_used);
+            }
+        }
         for (const auto &pair : project.slice_objects) {
             for (const LinearEquation &equation : *pair.second.equations) {
+                if (is_fixed(equation)) continue;
                 write_calculix_equation(
                     geometry_stream, equation, &variables_used);
             }
         }
 
         for (const auto &pair : project.select_volume_objects) {
-            write_calculix_nset(
-                geometry_stream, pair.first, *pair.second.node_set);
+            write_calculix_nset(geometry_stream, pair.first, axisymmetric
+                ? axisymmetric_node_set(*pair.second.node_set, meridian_nodes)
+                : *pair.second.node_set);
             write_calculix_elset(
                 geometry_stream, pair.first, *pair.second.element_set);
         }
 
         for (const auto &pair : project.select_surface_objects) {
-            write_calculix_nset(
-                geometry_stream, pair.first, *pair.second.node_set);
-            write_calculix_surface(
-                geometry_stream, pair.first, *pair.second.face_set);
+            write_calculix_nset(geometry_stream, pair.first, axisymmetric
+                ? axisymmetric_node_set(*pair.second.node_set, meridian_nodes)
+                : *pair.second.node_set);
+            write_calculix_surface(geometry_stream, pair.first, axisymmetric
+                ? axisymmetric_face_set(*pair.second.face_set)
+                : *pair.second.face_set);
         }
 
         for (const auto &pair : project.select_node_objects) {
+            NodeId node_id = pair.second.node_id;
+            if (axisymmetric) {
+                node_id = meridian_nodes[node_id];
+            }
             write_calculix_nset(
                 geometry_stream,
                 pair.first,
-                compute_node_set_singleton(pair.second.node_id)
+                compute_node_set_singleton(node_id)
                 );
         }
 
@@ -266,13 +407,19 @@ void write_calculix_job(
     for (const auto &pair : project.load_volume_objects) {
         FilePath load_file_path = dir_path + "/" + pair.first + ".clo";
         std::ofstream load_stream(load_file_path);
-        write_calculix_cload(load_stream, *pair.second.load);
+        write_calculix_cload(load_stream, axisymmetric
+            ? axisymmetric_load(*project.mesh, *pair.second.load,
+                meridian_nodes)
+            : *pair.second.load);
     }
 
     for (const auto &pair : project.load_surface_objects) {
         FilePath load_file_path = dir_path + "/" + pair.first + ".clo";
         std::ofstream load_stream(load_file_path);
-        write_calculix_cload(load_stream, *pair.second.load);
+        write_calculix_cload(load_stream, axisymmetric
+            ? axisymmetric_load(*project.mesh, *pair.second.load,
+                meridian_nodes)
+            : *pair.second.load);
     }
 
     FilePath main_file_path = dir_path + "/" + main_file_name + ".inp";
@@ -14,6 +14,8 @@ void write_calculix_create_node(
     NodeId node_id,
     Point point);
 
+/* If 'meridian_nodes' isn't null, the mesh came from mesher_axisymmetric()
+and is written as CAX elements; see compute_axisymmetric_meridian_nodes() */
 void write_calculix_nodes_and_elements(
     std::ostream &stream,
     const std::string &name,
@@ -21,7 +23,8 @@ void write_calculix_nodes_and_elements(
     NodeId node_begin,
     NodeId node_end,
     ElementId element_begin,
-    ElementId element_end);
+    ElementId element_end,
+    const ContiguousMap<NodeId, NodeId> *meridian_nodes);
 
 void write_calculix_nset(
     std::ostream &stream,
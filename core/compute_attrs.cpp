@@ -1,5 +1,7 @@
 #include "compute_attrs.hpp"
 
+#include "mesh_batch.hpp"
+
 namespace os2cx {
 
 static const double direction_angle_epsilon = 1e-6;
@@ -177,6 +179,74 @@ void compute_plc_nef_select_node(
     });
 }
 
+void compute_plc_nef_symmetry_cut(
+    PlcNef3 *solid_nef,
+    const Box &solid_bounds,
+    Dimension axis,
+    double position,
+    AttrBitIndex attr_bit_plane
+) {
+    /* Set the plane bit on every solid volume and face of solid_nef. Only the
+    faces that end up on the plane will keep it. */
+    assert(attr_bit_plane != attr_bit_solid());
+    solid_nef->map_everywhere([&](AttrBitset bs, PlcNef3::FeatureType ft) {
+        if (bs[attr_bit_solid()] && (ft == PlcNef3::FeatureType::Volume ||
+                ft == PlcNef3::FeatureType::Face)) {
+            bs.set(attr_bit_plane);
+        }
+        return bs;
+    });
+
+    /* For the half-space nef: A box that covers the solid on the positive side
+    of the plane. Inside it, set all bits except 'attr_bit_plane', except on
+    the face that lies on the plane, where all bits are set. Outside it, clear
+    all bits. So AND-ing this with solid_nef will cut away the negative side,
+    and leave the plane bit only on the faces where the plane cut the solid. */
+    double margin = 1 + std::max(solid_bounds.xh - solid_bounds.xl,
+        std::max(solid_bounds.yh - solid_bounds.yl,
+            solid_bounds.zh - solid_bounds.zl));
+    Box half(solid_bounds.xl - margin, solid_bounds.yl - margin,
+        solid_bounds.zl - margin, solid_bounds.xh + margin,
+        solid_bounds.yh + margin, solid_bounds.zh + margin);
+    switch (axis) {
+    case Dimension::X: half.xl = position; break;
+    case Dimension::Y: half.yl = position; break;
+    case Dimension::Z: half.zl = position; break;
+    }
+    if (half.xl >= half.xh || half.yl >= half.yh || half.zl >= half.zh) {
+        /* The plane is beyond the solid, so nothing is left */
+        *solid_nef = PlcNef3::empty();
+        return;
+    }
+    Vector axis_vector = Vector::zero();
+    axis_vector.set_at(axis, 1);
+
+    PlcNef3 half_nef = PlcNef3::from_poly(Poly3::from_box(half));
+    half_nef.map_everywhere([&](AttrBitset bs, PlcNef3::FeatureType) {
+        AttrBitset result;
+        if (bs != AttrBitset()) {
+            result.set();
+            result.reset(attr_bit_plane);
+        }
+        return result;
+    });
+    half_nef.map_faces([&](
+        AttrBitset face_attrs,
+        AttrBitset vol1_attrs,
+        AttrBitset,
+        Vector normal_towards_vol1
+    ) {
+        Vector normal_inwards = (vol1_attrs != AttrBitset())
+            ? normal_towards_vol1 : -normal_towards_vol1;
+        if (normal_inwards.dot(axis_vector) > 0.5) {
+            face_attrs.set();
+        }
+        return face_attrs;
+    });
+
+    *solid_nef = solid_nef->binary_and(half_nef);
+}
+
 MaxElementSize suggest_max_element_size(const Plc3 &plc) {
     Volume approx_volume = pow(2 * plc.compute_approx_scale(), 3);
 
@@ -211,7 +281,7 @@ ElementSet compute_element_set_from_attr_bit(
     assert(attr_bit != attr_bit_solid());
     ElementSet set;
     for (ElementId eid = element_begin; eid != element_end; ++eid) {
-        const Element3 &element = mesh.elements[eid];
+        ConstElement3Ref element = mesh.elements[eid];
         if (element.attrs[attr_bit]) {
             set.elements.insert(eid);
         }
@@ -230,32 +300,35 @@ FaceSet compute_face_set_from_attr_bit(
     double cos_threshold = cos(direction_angle_tolerance / 180 * M_PI)
         - direction_angle_epsilon;
     assert(attr_bit != attr_bit_solid());
-    FaceSet set;
+    std::vector<FaceId> candidates;
     FaceId fid;
     for (fid.element_id = element_begin; fid.element_id != element_end;
             ++fid.element_id) {
-        const Element3 &element = mesh.elements[fid.element_id];
+        ConstElement3Ref element = mesh.elements[fid.element_id];
         const ElementTypeShape *shape = &element_type_shape(element.type);
         for (fid.face = 0; fid.face < static_cast<int>(shape->faces.size());
                 ++fid.face) {
             AttrBitset attrs = element.face_attrs[fid.face];
             if (attrs[attr_bit]) {
-                /* This direction_vector check is _almost_ redundant, because
-                compute_plc_nef3_select_surface_*() wouldn't have set the attr
-                bit if it didn't pass the direction_vector check. The problem is
-                that PlcNef3 doesn't keep track of the "orientation" of the
-                surface, so for an internal surface selection, we'd end up
-                selecting the faces on both sides of the surface. The easiest
-                workaround is to re-check direction_vector to disambiguate. */
-                Vector face_normal = mesh.oriented_area(element, fid.face);
-                face_normal /= face_normal.magnitude();
-                double dot = direction_vector.dot(face_normal);
-                if (dot > cos_threshold) {
-                    set.faces.insert(fid);
-                }
+                candidates.push_back(fid);
             }
         }
     }
+
+    /* This direction_vector check is _almost_ redundant, because
+    compute_plc_nef3_select_surface_*() wouldn't have set the attr bit if it
+    didn't pass the direction_vector check. The problem is that PlcNef3 doesn't
+    keep track of the "orientation" of the surface, so for an internal surface
+    selection, we'd end up selecting the faces on both sides of the surface. The
+    easiest workaround is to re-check direction_vector to disambiguate. */
+    FaceAreaBatch areas = compute_face_area_batch(mesh, candidates);
+    FaceSet set;
+    for (int i = 0; i < static_cast<int>(candidates.size()); ++i) {
+        double dot = direction_vector.dot(areas.normal(i));
+        if (dot > cos_threshold) {
+            set.faces.insert(set.faces.end(), candidates[i]);
+        }
+    }
     return set;
 }
 
@@ -273,35 +346,44 @@ NodeSet compute_node_set_from_range(NodeId begin, NodeId end) {
     return set;
 }
 
+/* Neighboring elements share most of their nodes, so collecting the nodes in a
+vector and deduplicating them once is much cheaper than inserting each one into
+the set. A sorted range is inserted into a std::set in linear time. */
+static NodeSet node_set_from_vector(std::vector<NodeId> *nodes) {
+    std::sort(nodes->begin(), nodes->end());
+    nodes->erase(std::unique(nodes->begin(), nodes->end()), nodes->end());
+    NodeSet set;
+    set.nodes.insert(nodes->begin(), nodes->end());
+    return set;
+}
+
 NodeSet compute_node_set_from_element_set(
     const Mesh3 &mesh,
     const ElementSet &element_set
 ) {
-    NodeSet set;
+    std::vector<NodeId> nodes;
     for (ElementId element_id : element_set.elements) {
-        const Element3 &element = mesh.elements[element_id];
-        int num_nodes = element.num_nodes();
-        for (int i = 0; i < num_nodes; ++i) {
-            set.nodes.insert(element.nodes[i]);
-        }
+        ConstElement3Ref element = mesh.elements[element_id];
+        nodes.insert(nodes.end(),
+            element.nodes, element.nodes + element.num_nodes());
     }
-    return set;
+    return node_set_from_vector(&nodes);
 }
 
 NodeSet compute_node_set_from_face_set(
     const Mesh3 &mesh,
     const FaceSet &face_set
 ) {
-    NodeSet set;
+    std::vector<NodeId> nodes;
     for (FaceId face_id : face_set.faces) {
-        const Element3 &element = mesh.elements[face_id.element_id];
+        ConstElement3Ref element = mesh.elements[face_id.element_id];
         const ElementTypeShape *shape = &element_type_shape(element.type);
 
         for (int vertex_index : shape->faces[face_id.face].vertices) {
-            set.nodes.insert(element.nodes[vertex_index]);
+            nodes.push_back(element.nodes[vertex_index]);
         }
     }
-    return set;
+    return node_set_from_vector(&nodes);
 }
 
 NodeId compute_node_id_from_attr_bit(
@@ -322,24 +404,51 @@ NodeId compute_node_id_from_attr_bit(
     return node_id;
 }
 
+/* Sums the forces on each node into a ConcentratedLoad. The forces are sorted
+by node first, so that the map is built in order rather than searched once per
+force; the forces on each node are still summed in their original order. */
+static ConcentratedLoad sum_node_forces(
+    std::vector<std::pair<NodeId, Vector> > *forces
+) {
+    std::stable_sort(forces->begin(), forces->end(),
+        [](const std::pair<NodeId, Vector> &a,
+                const std::pair<NodeId, Vector> &b) {
+            return a.first < b.first;
+        });
+    ConcentratedLoad load;
+    for (const auto &force : *forces) {
+        if (load.loads.empty() || load.loads.rbegin()->first != force.first) {
+            load.loads.emplace_hint(
+                load.loads.end(), force.first, ConcentratedLoad::Load());
+        }
+        load.loads.rbegin()->second.force += force.second;
+    }
+    return load;
+}
+
 ConcentratedLoad compute_load_from_element_set(const Mesh3 &mesh,
     const ElementSet &element_set,
     Vector force_total_or_per_volume,
     bool force_is_per_volume
 ) {
-    ConcentratedLoad load;
+    std::vector<ElementId> element_ids(
+        element_set.elements.begin(), element_set.elements.end());
+    ElementVolumeBatch volumes =
+        compute_element_volume_batch(mesh, element_ids);
+    std::vector<std::pair<NodeId, Vector> > forces;
+    forces.reserve(volumes.node_volumes.size());
     double total_volume = 0;
-    for (ElementId element_id : element_set.elements) {
-        const Element3 &element = mesh.elements[element_id];
+    for (int i = 0; i < static_cast<int>(element_ids.size()); ++i) {
+        ConstElement3Ref element = mesh.elements[element_ids[i]];
         int num_nodes = element.num_nodes();
-        Volume volumes_for_nodes[ElementTypeShape::max_vertices_per_element];
-        mesh.volumes_for_nodes(element, volumes_for_nodes);
-        for (int i = 0; i < num_nodes; ++i) {
-            total_volume += volumes_for_nodes[i];
-            load.loads[element.nodes[i]].force +=
-                volumes_for_nodes[i] * force_total_or_per_volume;
+        for (int j = 0; j < num_nodes; ++j) {
+            double volume = volumes.node_volumes[volumes.node_offsets[i] + j];
+            total_volume += volume;
+            forces.push_back(std::make_pair(
+                element.nodes[j], volume * force_total_or_per_volume));
         }
     }
+    ConcentratedLoad load = sum_node_forces(&forces);
     if (!force_is_per_volume && total_volume != 0) {
         for (auto &pair : load.loads) {
             pair.second.force /= total_volume;
@@ -354,27 +463,28 @@ ConcentratedLoad compute_load_from_face_set(
     Vector force_total_or_per_area,
     bool force_is_per_area
 ) {
-    ConcentratedLoad load;
+    std::vector<FaceId> face_ids(face_set.faces.begin(), face_set.faces.end());
+    FaceAreaBatch areas = compute_face_area_batch(mesh, face_ids);
+    std::vector<std::pair<NodeId, Vector> > forces;
+    forces.reserve(areas.node_area_x.size());
     double total_area = 0;
-    for (FaceId face_id : face_set.faces) {
-        const Element3 &element = mesh.elements[face_id.element_id];
-        int num_nodes = element.num_nodes();
-        /* Note: For second-order rectangular faces, some oriented areas may
-        point in the opposite direction of the overall face! */
-        Vector areas_for_nodes[ElementTypeShape::max_vertices_per_element];
-        mesh.oriented_areas_for_nodes(element, face_id.face, areas_for_nodes);
-        Vector face_oriented_area = Vector::zero();
-        for (int i = 0; i < num_nodes; ++i) {
-            face_oriented_area += areas_for_nodes[i];
-        }
+    for (int i = 0; i < static_cast<int>(face_ids.size()); ++i) {
+        ConstElement3Ref element = mesh.elements[face_ids[i].element_id];
+        const std::vector<int> &face_vertices =
+            element_type_shape(element.type).faces[face_ids[i].face].vertices;
+        Vector face_oriented_area = areas.area(i);
         double face_area = face_oriented_area.magnitude();
         total_area += face_area;
-        for (int i = 0; i < num_nodes; ++i) {
-            load.loads[element.nodes[i]].force +=
-                areas_for_nodes[i].dot(face_oriented_area) / face_area
-                    * force_total_or_per_area;
+        /* Note: For second-order rectangular faces, some oriented areas may
+        point in the opposite direction of the overall face! */
+        for (int k = 0; k < static_cast<int>(face_vertices.size()); ++k) {
+            forces.push_back(std::make_pair(
+                element.nodes[face_vertices[k]],
+                areas.node_area(i, k).dot(face_oriented_area) / face_area
+                    * force_total_or_per_area));
         }
     }
+    ConcentratedLoad load = sum_node_forces(&forces);
     if (!force_is_per_area && total_area != 0) {
         for (auto &pair : load.loads) {
             pair.second.force /= total_area;
@@ -411,7 +521,7 @@ Slice compute_slice(
     /* Identify all nodes that might be participating in the slice */
     std::set<NodeId> nodes;
     for (const FaceId &face : face_set.faces) {
-        const Element3 &element = mesh->elements[face.element_id];
+        ConstElement3Ref element = mesh->elements[face.element_id];
         for (int vertex :
                 element_type_shape(element.type).faces[face.face].vertices) {
             nodes.insert(element.nodes[vertex]);
@@ -419,7 +529,9 @@ Slice compute_slice(
     }
 
     /* For each eligible node, build a data structure tracking all the elements
-    it participates in and which faces they share with each other. */
+    it participates in and which faces they share with each other. The faces
+    around each node come from the index, so only the elements near the slice
+    are visited. */
     struct NodeElementData {
         NodeElementData() {
             for (int face = 0; face < ElementTypeShape::max_faces_per_element;
@@ -446,32 +558,46 @@ Slice compute_slice(
         PartitionedNodeId partitioned_node_id;
     };
     std::map<NodeId, std::map<ElementId, NodeElementData> > node_element_data;
-    for (ElementId element_id = mesh->elements.key_begin();
-            element_id != mesh->elements.key_end(); ++element_id) {
-        const Element3 &element = mesh->elements[element_id];
-        const ElementTypeShape &shape = element_type_shape(element.type);
-        for (int face = 0; face < static_cast<int>(shape.faces.size());
-                ++face) {
-            FaceId face_id_1(element_id, face);
+    std::vector<FaceId> sliced_faces;
+    for (NodeId node : nodes) {
+        std::map<ElementId, NodeElementData> *element_data =
+            &node_element_data.emplace_hint(node_element_data.end(),
+                node, std::map<ElementId, NodeElementData>())->second;
+        for (FaceId face_id_1 : mesh_index.node_faces(node)) {
             FaceId face_id_2 = mesh_index.matching_face(face_id_1);
             if (face_id_2 == FaceId::invalid()) {
                 continue;
             }
-            for (int vertex : shape.faces[face].vertices) {
-                NodeId node = element.nodes[vertex];
-                if (!nodes.count(node)) {
-                    continue;
+            ConstElement3Ref element = mesh->elements[face_id_1.element_id];
+            const ElementTypeShape &shape = element_type_shape(element.type);
+            NodeElementData *data = &(*element_data)[face_id_1.element_id];
+            for (int vertex : shape.faces[face_id_1.face].vertices) {
+                if (element.nodes[vertex] == node) {
+                    data->vertex = vertex;
                 }
-                NodeElementData *data = &node_element_data[node][element_id];
-                data->vertex = vertex;
-                data->adjacent[face] = face_id_2.element_id;
-                data->adjacent_sliced[face] =
-                    face_set.faces.count(face_id_1) ||
-                    face_set.faces.count(face_id_2);
             }
+            data->adjacent[face_id_1.face] = face_id_2.element_id;
+            data->adjacent_sliced[face_id_1.face] =
+                face_set.faces.count(face_id_1) ||
+                face_set.faces.count(face_id_2);
+            if (data->adjacent_sliced[face_id_1.face]) {
+                sliced_faces.push_back(face_id_1);
+            }
+        }
+        if (element_data->empty()) {
+            node_element_data.erase(node);
         }
     }
 
+    /* The normals of the sliced faces are computed up front, in one batch.
+    Partitioning only adds copies of existing nodes, so it doesn't change
+    them. */
+    std::sort(sliced_faces.begin(), sliced_faces.end());
+    sliced_faces.erase(std::unique(sliced_faces.begin(), sliced_faces.end()),
+        sliced_faces.end());
+    FaceAreaBatch sliced_face_areas =
+        compute_face_area_batch(*mesh, sliced_faces);
+
     Slice slice;
 
     /* Visit each node and consider partitioning it */
@@ -533,7 +659,7 @@ Slice compute_slice(
         /* Update the actual element records to point at the partitioned nodes
         */
         for (const auto &data_pair : element_data) {
-            Element3 &element = mesh->elements[data_pair.first];
+            Element3Ref element = mesh->elements[data_pair.first];
             assert(element.nodes[data_pair.second.vertex] == node_id);
             element.nodes[data_pair.second.vertex] =
                 data_pair.second.partitioned_node_id;
@@ -571,10 +697,12 @@ Slice compute_slice(
                 }
                 std::pair<PartitionedNodeId, PartitionedNodeId> key(
                     partition1, partition2);
-                Vector oriented_area =
-                    mesh->oriented_area(mesh->elements[data_pair.first], face);
-                Vector normal = oriented_area / oriented_area.magnitude();
-                partition_pair_areas[key].push_back(normal);
+                auto it = std::lower_bound(sliced_faces.begin(),
+                    sliced_faces.end(), FaceId(data_pair.first, face));
+                assert(it != sliced_faces.end() &&
+                    *it == FaceId(data_pair.first, face));
+                partition_pair_areas[key].push_back(
+                    sliced_face_areas.normal(it - sliced_faces.begin()));
             }
         }
 
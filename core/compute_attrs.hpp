@@ -37,6 +37,16 @@ void compute_plc_nef_select_node(
     Point point,
     AttrBitIndex attr_bit_mask);
 
+/* Cuts away the part of solid_nef on the negative side of the plane
+perpendicular to 'axis' at 'position', and sets 'attr_bit_plane' on the faces
+that the cut leaves on the plane. 'solid_bounds' must contain the solid. */
+void compute_plc_nef_symmetry_cut(
+    PlcNef3 *solid_nef,
+    const Box &solid_bounds,
+    Dimension axis,
+    double position,
+    AttrBitIndex attr_bit_plane);
+
 MaxElementSize suggest_max_element_size(const Plc3 &plc);
 
 class ElementSet {
@@ -5,6 +5,7 @@ CONFIG -= app_bundle
 
 LIBS += -lgmp -lmpfr
 LIBS += -ltet
+LIBS += -lpthread
 
 # The following define makes your compiler emit warnings if you use
 # any feature of Qt which as been marked deprecated (the exact warnings
@@ -29,6 +30,7 @@ SOURCES += \
     calculix_inp_write.cpp \
     calculix_run.cpp \
     mesh.cpp \
+    mesh_batch.cpp \
     mesher_tetgen.cpp \
     mesh_index.cpp \
     mesh_type_info.cpp \
@@ -48,7 +50,20 @@ SOURCES += \
     project_run.cpp \
     mesher_naive_bricks.cpp \
     compute_attrs.cpp \
-    attrs.cpp
+    plc_facets.cpp \
+    plc_simplify.cpp \
+    sizing_field.cpp \
+    error_estimate.cpp \
+    resource_estimate.cpp \
+    mesh_quality.cpp \
+    mesh_optimize.cpp \
+    mesh_renumber.cpp \
+    parallel.cpp \
+    simd.cpp \
+    attrs.cpp \
+    mesher_octree_bricks.cpp \
+    mesher_sweep.cpp \
+    mesher_axisymmetric.cpp
 
 HEADERS += \
     calc.hpp \
@@ -57,9 +72,12 @@ HEADERS += \
     calculix_inp_write.hpp \
     calculix_run.hpp \
     mesh.hpp \
+    mesh_batch.hpp \
+    mesh_batch.internal.hpp \
     mesher_tetgen.hpp \
     mesh_index.hpp \
     mesh_type_info.hpp \
+    mesh_type_info.internal.hpp \
     openscad_extract.hpp \
     openscad_run.hpp \
     openscad_value.hpp \
@@ -78,7 +96,21 @@ HEADERS += \
     project_run.hpp \
     mesher_naive_bricks.hpp \
     compute_attrs.hpp \
-    attrs.hpp
+    plc_facets.hpp \
+    plc_simplify.hpp \
+    sizing_field.hpp \
+    error_estimate.hpp \
+    resource_estimate.hpp \
+    mesh_quality.hpp \
+    mesh_optimize.hpp \
+    mesh_renumber.hpp \
+    parallel.hpp \
+    simd.hpp \
+    attrs.hpp \
+    mesher_octree_bricks.hpp \
+    mesher_sweep.hpp \
+    mesher_sweep.internal.hpp \
+    mesher_axisymmetric.hpp
 
 # The "gui" and "test" projects include all the same headers and sources as
 # "core", minus "main.cpp". Prepare variables for them to use from this file.
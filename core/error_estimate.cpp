@@ -0,0 +1,142 @@
+#include "error_estimate.hpp"
+
+#include <math.h>
+
+#include "parallel.hpp"
+
+namespace os2cx {
+
+static double squared_norm(const Matrix &m) {
+    double sum = 0;
+    for (int i = 0; i < 3; ++i) {
+        sum += m.cols[i].dot(m.cols[i]);
+    }
+    return sum;
+}
+
+/* Returns the stress in the given element at the given shape point, computed
+from the nodal displacements by Hooke's law, and stores the volume weight of
+the point (the determinant of the Jacobian) in 'det_out'. */
+static Matrix raw_stress_at(
+    const Mesh3 &mesh,
+    ConstElement3Ref element,
+    const ContiguousMap<NodeId, Vector> &displacements,
+    const ElasticMaterial &material,
+    ElementTypeShape::ShapePoint uvw,
+    double *det_out
+) {
+    const ElementTypeShape &shape = element_type_shape(element.type);
+    int num_nodes = shape.vertices.size();
+    ElementTypeShape::ShapeVector sf_d_uvw[
+        ElementTypeShape::max_vertices_per_element];
+    shape.shape_function_derivatives(uvw, sf_d_uvw);
+
+    Matrix jacobian = Matrix::zero();
+    for (int i = 0; i < num_nodes; ++i) {
+        Vector point = mesh.nodes[element.nodes[i]].point - Point::origin();
+        jacobian.cols[0] += point * sf_d_uvw[i].x;
+        jacobian.cols[1] += point * sf_d_uvw[i].y;
+        jacobian.cols[2] += point * sf_d_uvw[i].z;
+    }
+    double det = jacobian.determinant();
+    *det_out = det;
+
+    /* The columns of the cofactor matrix are the rows of the inverse
+    Jacobian, scaled by the determinant, so applying it to a gradient with
+    respect to (u, v, w) gives the gradient with respect to (x, y, z). */
+    Matrix cofactor = jacobian.cofactor_matrix();
+
+    /* grad.cols[j] is the derivative of the displacement along axis j */
+    Matrix grad = Matrix::zero();
+    for (int i = 0; i < num_nodes; ++i) {
+        Vector sf_d_xyz = cofactor.apply(sf_d_uvw[i]) / det;
+        Vector u = displacements[element.nodes[i]];
+        grad.cols[0] += u * sf_d_xyz.x;
+        grad.cols[1] += u * sf_d_xyz.y;
+        grad.cols[2] += u * sf_d_xyz.z;
+    }
+
+    double e = material.youngs_modulus, nu = material.poissons_ratio;
+    double lambda = e * nu / ((1 + nu) * (1 - 2 * nu));
+    double mu = e / (2 * (1 + nu));
+    double trace = grad.cols[0].x + grad.cols[1].y + grad.cols[2].z;
+    Matrix stress;
+    for (int j = 0; j < 3; ++j) {
+        /* stress = lambda * trace(strain) * I + 2 * mu * strain, where
+        strain = (grad + grad^T) / 2 */
+        Vector transposed(
+            grad.cols[0].at(static_cast<Dimension>(j)),
+            grad.cols[1].at(static_cast<Dimension>(j)),
+            grad.cols[2].at(static_cast<Dimension>(j)));
+        stress.cols[j] = (grad.cols[j] + transposed) * mu;
+    }
+    stress.cols[0].x += lambda * trace;
+    stress.cols[1].y += lambda * trace;
+    stress.cols[2].z += lambda * trace;
+    return stress;
+}
+
+StressErrorEstimate estimate_stress_error(
+    const Mesh3 &mesh,
+    const ContiguousMap<NodeId, Vector> &displacements,
+    const ContiguousMap<NodeId, Matrix> &nodal_stresses,
+    const std::function<ElasticMaterial(ElementId)> &material
+) {
+    StressErrorEstimate estimate;
+    estimate.element_errors = ContiguousMap<ElementId, double>(
+        mesh.elements.key_begin(), mesh.elements.key_end(), 0.0);
+    ContiguousMap<ElementId, double> element_stresses(
+        mesh.elements.key_begin(), mesh.elements.key_end(), 0.0);
+
+    static const int chunk_size = 1024;
+    int begin_index = mesh.elements.key_begin().to_int();
+    parallel_for(mesh.elements.size(), chunk_size, [&](int begin, int end) {
+        for (int index = begin; index < end; ++index) {
+            ElementId element_id = ElementId::from_int(begin_index + index);
+            ConstElement3Ref element = mesh.elements[element_id];
+            const ElementTypeShape &shape = element_type_shape(element.type);
+            ElasticMaterial element_material = material(element_id);
+
+            double error_sq = 0, stress_sq = 0;
+            for (const ElementTypeShape::IntegrationPoint &ip :
+                    shape.volume_integration_points) {
+                double det;
+                Matrix raw = raw_stress_at(mesh, element, displacements,
+                    element_material, ip.uvw, &det);
+
+                double sf[ElementTypeShape::max_vertices_per_element];
+                shape.shape_functions(ip.uvw, sf);
+                Matrix recovered = Matrix::zero();
+                for (int i = 0; i < static_cast<int>(shape.vertices.size());
+                        ++i) {
+                    const Matrix &nodal = nodal_stresses[element.nodes[i]];
+                    for (int j = 0; j < 3; ++j) {
+                        recovered.cols[j] += nodal.cols[j] * sf[i];
+                    }
+                }
+
+                Matrix difference;
+                for (int j = 0; j < 3; ++j) {
+                    difference.cols[j] = recovered.cols[j] - raw.cols[j];
+                }
+                double weight = ip.weight * fabs(det);
+                error_sq += weight * squared_norm(difference);
+                stress_sq += weight * squared_norm(recovered);
+            }
+            estimate.element_errors[element_id] = sqrt(error_sq);
+            element_stresses[element_id] = stress_sq;
+        }
+    });
+
+    double total_error_sq = 0, total_stress_sq = 0;
+    for (ElementId element_id = mesh.elements.key_begin();
+            element_id != mesh.elements.key_end(); ++element_id) {
+        total_error_sq += pow(estimate.element_errors[element_id], 2);
+        total_stress_sq += element_stresses[element_id];
+    }
+    estimate.total_error = sqrt(total_error_sq);
+    estimate.total_stress = sqrt(total_stress_sq);
+    return estimate;
+}
+
+} /* namespace os2cx */
@@ -0,0 +1,48 @@
+#ifndef OS2CX_ERROR_ESTIMATE_HPP_
+#define OS2CX_ERROR_ESTIMATE_HPP_
+
+#include <functional>
+
+#include "mesh.hpp"
+
+namespace os2cx {
+
+class ElasticMaterial {
+public:
+    double youngs_modulus;
+    double poissons_ratio;
+};
+
+class StressErrorEstimate {
+public:
+    /* The error indicator of each element: the L2 norm, over the element, of
+    the difference between the recovered and the raw stress */
+    ContiguousMap<ElementId, double> element_errors;
+
+    /* The L2 norms over the whole mesh of the error and of the recovered
+    stress */
+    double total_error;
+    double total_stress;
+
+    double relative_error() const {
+        return (total_stress > 0) ? total_error / total_stress : 0;
+    }
+};
+
+/* estimate_stress_error() computes a recovery-based (Zienkiewicz-Zhu) error
+indicator for a linear elastic solution. The raw stress is computed inside each
+element from the nodal displacements and the element's shape functions; it is
+discontinuous from one element to the next. The recovered stress is the nodal
+stress that CalculiX writes to the FRD file, which it has already averaged
+across the elements sharing each node, interpolated with the same shape
+functions. Where the two disagree, the mesh is too coarse to resolve the
+stress field. 'material' returns the elastic properties of each element. */
+StressErrorEstimate estimate_stress_error(
+    const Mesh3 &mesh,
+    const ContiguousMap<NodeId, Vector> &displacements,
+    const ContiguousMap<NodeId, Matrix> &nodal_stresses,
+    const std::function<ElasticMaterial(ElementId)> &material);
+
+} /* namespace os2cx */
+
+#endif /* OS2CX_ERROR_ESTIMATE_HPP_ */
@@ -1,7 +1,113 @@
 #include "mesh.hpp"
 
+#include <map>
+
+#include "mesh_type_info.internal.hpp"
+#include "parallel.hpp"
+
 namespace os2cx {
 
+int Element3Store::bytes_per_element(ElementType type) {
+    const ElementTypeShape &shape = element_type_shape(type);
+    return sizeof(ElementType) + 2 * sizeof(int) + sizeof(AttrSetId)
+        + shape.vertices.size() * sizeof(NodeId)
+        + shape.faces.size() * sizeof(AttrSetId);
+}
+
+void Element3Store::reserve(int capacity) {
+    types.reserve(capacity);
+    node_offsets.reserve(capacity);
+    face_offsets.reserve(capacity);
+    attrs.reserve(capacity);
+}
+
+void Element3Store::reserve_for_append(
+    const std::vector<const Element3Store *> &others
+) {
+    int num_elements = types.size();
+    int num_node_ids = node_ids.size();
+    int num_face_attrs = face_attrs.size();
+    for (const Element3Store *other : others) {
+        num_elements += other->types.size();
+        num_node_ids += other->node_ids.size();
+        num_face_attrs += other->face_attrs.size();
+    }
+    reserve(num_elements);
+    node_ids.reserve(num_node_ids);
+    face_attrs.reserve(num_face_attrs);
+}
+
+ElementId Element3Store::push_back(const ConstElement3Ref &element) {
+    const ElementTypeShape &shape = element_type_shape(element.type);
+    types.push_back(element.type);
+    node_offsets.push_back(node_ids.size());
+    face_offsets.push_back(face_attrs.size());
+    attrs.push_back(attr_set_table.intern(element.attrs));
+    node_ids.insert(node_ids.end(),
+        element.nodes, element.nodes + shape.vertices.size());
+    for (int f = 0; f < static_cast<int>(shape.faces.size()); ++f) {
+        face_attrs.push_back(attr_set_table.intern(element.face_attrs[f]));
+    }
+    return ElementId::from_int(offset + types.size() - 1);
+}
+
+void Element3Store::append(Element3Store &&other, int node_id_offset) {
+    static const int chunk_size = 4096;
+
+    /* The other store has its own AttrSetTable, so its attr set IDs have to
+    be converted to IDs in ours */
+    std::vector<AttrSetId> attr_set_ids(other.attr_set_table.size());
+    for (int i = 0; i < other.attr_set_table.size(); ++i) {
+        attr_set_ids[i] = attr_set_table.intern(other.attr_set_table[i]);
+    }
+
+    int first_element = types.size();
+    int first_node_id = node_ids.size();
+    int first_face_attr = face_attrs.size();
+    int num_elements = other.types.size();
+
+    types.insert(types.end(), other.types.begin(), other.types.end());
+    std::vector<ElementType>().swap(other.types);
+
+    node_offsets.resize(first_element + num_elements);
+    face_offsets.resize(first_element + num_elements);
+    attrs.resize(first_element + num_elements);
+    parallel_for(num_elements, chunk_size, [&](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            node_offsets[first_element + i] =
+                other.node_offsets[i] + first_node_id;
+            face_offsets[first_element + i] =
+                other.face_offsets[i] + first_face_attr;
+            attrs[first_element + i] = attr_set_ids[other.attrs[i]];
+        }
+    });
+    std::vector<int>().swap(other.node_offsets);
+    std::vector<int>().swap(other.face_offsets);
+    std::vector<AttrSetId>().swap(other.attrs);
+
+    int num_node_ids = other.node_ids.size();
+    node_ids.resize(first_node_id + num_node_ids);
+    parallel_for(num_node_ids, chunk_size, [&](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            node_ids[first_node_id + i] = NodeId::from_int(
+                other.node_ids[i].to_int() + node_id_offset);
+        }
+    });
+    std::vector<NodeId>().swap(other.node_ids);
+
+    int num_face_attrs = other.face_attrs.size();
+    face_attrs.resize(first_face_attr + num_face_attrs);
+    parallel_for(num_face_attrs, chunk_size, [&](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            face_attrs[first_face_attr + i] =
+                attr_set_ids[other.face_attrs[i]];
+        }
+    });
+    std::vector<AttrSetId>().swap(other.face_attrs);
+
+    other.attr_set_table = AttrSetTable();
+}
+
 void Mesh3::append_mesh(
     const Mesh3 &other,
     MeshIdMapping *id_mapping_out
@@ -16,8 +122,8 @@ void Mesh3::append_mesh(
     }
 
     elements.reserve(elements.size() + other.elements.size());
-    for (const Element3 &element : other.elements) {
-        Element3 copy = element;
+    for (ConstElement3Ref element : other.elements) {
+        Element3 copy = element.to_element();
         for (int i = 0; i < copy.num_nodes(); ++i) {
             copy.nodes[i] = id_mapping_out->convert_node_id(copy.nodes[i]);
         }
@@ -25,135 +131,384 @@ void Mesh3::append_mesh(
     }
 }
 
-Volume Mesh3::volume(const Element3 &element) const {
-    const ElementTypeShape &shape = element_type_shape(element.type);
-    double total_volume = 0;
-    for (const auto &ip : shape.volume_integration_points) {
-        total_volume += integrate_volume(element, ip);
+void Mesh3::append_mesh(
+    Mesh3 &&other,
+    MeshIdMapping *id_mapping_out
+) {
+    int node_id_offset =
+        nodes.key_end().to_int() - other.nodes.key_begin().to_int();
+    *id_mapping_out = MeshIdMapping(
+        node_id_offset,
+        elements.key_end().to_int() - other.elements.key_begin().to_int());
+    nodes.append(std::move(other.nodes));
+    elements.append(std::move(other.elements), node_id_offset);
+}
+
+void Mesh3::reserve_for_append(const std::vector<const Mesh3 *> &others) {
+    int num_nodes = nodes.size();
+    std::vector<const Element3Store *> other_elements;
+    for (const Mesh3 *other : others) {
+        num_nodes += other->nodes.size();
+        other_elements.push_back(&other->elements);
     }
-    return Volume(total_volume);
+    nodes.reserve(num_nodes);
+    elements.reserve_for_append(other_elements);
 }
 
-void Mesh3::volumes_for_nodes(
-    const Element3 &element,
+/* Returns the permutation of the vertices and faces of 'shape' that swaps its
+U and V axes. Every shape is symmetric under that swap, and it reverses the
+orientation, so it's how a mirrored element is put right side out. */
+static void compute_mirror_permutation(
+    const ElementTypeShape &shape,
+    std::vector<int> *vertices_out,
+    std::vector<int> *faces_out
+) {
+    int num_vertices = shape.vertices.size();
+    for (int i = 0; i < num_vertices; ++i) {
+        const ElementTypeShape::ShapePoint &uvw = shape.vertices[i].uvw;
+        int j = 0;
+        while (j < num_vertices && !(
+                shape.vertices[j].uvw.x == uvw.y &&
+                shape.vertices[j].uvw.y == uvw.x &&
+                shape.vertices[j].uvw.z == uvw.z)) {
+            ++j;
+        }
+        assert(j < num_vertices);
+        vertices_out->push_back(j);
+    }
+    for (const ElementTypeShape::Face &face : shape.faces) {
+        std::set<int> image;
+        for (int v : face.vertices) {
+            image.insert((*vertices_out)[v]);
+        }
+        int j = 0;
+        while (std::set<int>(shape.faces[j].vertices.begin(),
+                shape.faces[j].vertices.end()) != image) {
+            ++j;
+        }
+        faces_out->push_back(j);
+    }
+}
+
+ContiguousMap<NodeId, NodeId> Mesh3::append_mirror_image(
+    Dimension axis,
+    double position,
+    const std::set<NodeId> &plane_nodes
+) {
+    NodeId original_end = nodes.key_end();
+    ContiguousMap<NodeId, NodeId> images(
+        nodes.key_begin(), original_end, NodeId::invalid());
+    ContiguousMap<NodeId, NodeId> sources(
+        nodes.key_begin(), original_end, NodeId::invalid());
+    for (NodeId node_id = nodes.key_begin(); node_id != original_end;
+            ++node_id) {
+        sources[node_id] = node_id;
+        if (plane_nodes.count(node_id)) {
+            images[node_id] = node_id;
+            continue;
+        }
+        Node3 image = nodes[node_id];
+        image.point.set_at(axis, 2 * position - image.point.at(axis));
+        images[node_id] = nodes.push_back(image);
+        sources.push_back(node_id);
+    }
+
+    std::map<ElementType, std::pair<std::vector<int>, std::vector<int> > >
+        permutations;
+    ElementId original_elements_end = elements.key_end();
+    for (ElementId element_id = elements.key_begin();
+            element_id != original_elements_end; ++element_id) {
+        ConstElement3Ref element = elements[element_id];
+        auto it = permutations.find(element.type);
+        if (it == permutations.end()) {
+            it = permutations.insert(std::make_pair(element.type,
+                std::make_pair(std::vector<int>(), std::vector<int>()))).first;
+            compute_mirror_permutation(element_type_shape(element.type),
+                &it->second.first, &it->second.second);
+        }
+        Element3 image = element.to_element();
+        for (int i = 0; i < element.num_nodes(); ++i) {
+            image.nodes[it->second.first[i]] = images[element.nodes[i]];
+        }
+        for (int i = 0; i < static_cast<int>(it->second.second.size()); ++i) {
+            image.face_attrs[it->second.second[i]] = element.face_attrs[i];
+        }
+        elements.push_back(image);
+    }
+
+    return sources;
+}
+
+/* The integration routines behind Mesh3::volume() and friends, specialized for
+each element type */
+template<ElementType type>
+class ElementKernel {
+public:
+    typedef ShapeTables<type> Tables;
+    static const int num_vertices = Tables::num_vertices;
+
+    /* Sets '*volume_out' to the volume of 'element' and, if 'volumes_out'
+    isn't null, sets 'volumes_out[i]' to the volume influenced by vertex 'i' */
+    static void volumes(
+        const ContiguousMap<NodeId, Node3> &nodes,
+        ConstElement3Ref element,
+        Volume *volume_out,
+        Volume *volumes_out);
+
+    /* Likewise for the oriented area of face 'face_index' */
+    static void areas(
+        const ContiguousMap<NodeId, Node3> &nodes,
+        ConstElement3Ref element,
+        int face_index,
+        Vector *area_out,
+        Vector *areas_out);
+
+private:
+    static void gather(
+        const ContiguousMap<NodeId, Node3> &nodes,
+        ConstElement3Ref element,
+        Vector *points_out
+    ) {
+        for (int i = 0; i < num_vertices; ++i) {
+            points_out[i] = nodes[element.nodes[i]].point - Point::origin();
+        }
+    }
+
+    static Matrix jacobian(
+        const Vector *points,
+        const typename Tables::Sample &sample
+    ) {
+        Matrix jacobian = Matrix::zero();
+        for (int i = 0; i < num_vertices; ++i) {
+            jacobian.cols[0] += points[i] * sample.sf_d_uvw[i].x;
+            jacobian.cols[1] += points[i] * sample.sf_d_uvw[i].y;
+            jacobian.cols[2] += points[i] * sample.sf_d_uvw[i].z;
+        }
+        return jacobian;
+    }
+};
+
+template<ElementType type>
+void ElementKernel<type>::volumes(
+    const ContiguousMap<NodeId, Node3> &nodes,
+    ConstElement3Ref element,
+    Volume *volume_out,
     Volume *volumes_out
-) const {
-    const ElementTypeShape &shape = element_type_shape(element.type);
-    for (int i = 0; i < static_cast<int>(shape.vertices.size()); ++i) {
-        volumes_out[i] = 0;
+) {
+    const Tables &tables = Tables::get();
+    Vector points[num_vertices];
+    gather(nodes, element, points);
+    if (volumes_out != nullptr) {
+        for (int i = 0; i < num_vertices; ++i) {
+            volumes_out[i] = 0;
+        }
     }
-    for (const auto &ip : shape.volume_integration_points) {
-        double d_volume = integrate_volume(element, ip);
-        double sf[ElementTypeShape::max_vertices_per_element];
-        shape.shape_functions(ip.uvw, sf);
-        for (int i = 0; i < static_cast<int>(shape.vertices.size()); ++i) {
-            volumes_out[i] += sf[i] * d_volume;
+    double total_volume = 0;
+    for (const typename Tables::Sample &sample : tables.volume_samples) {
+        double d_volume =
+            sample.weight * jacobian(points, sample).determinant();
+        total_volume += d_volume;
+        if (volumes_out != nullptr) {
+            for (int i = 0; i < num_vertices; ++i) {
+                volumes_out[i] += sample.sf[i] * d_volume;
+            }
         }
     }
+    *volume_out = Volume(total_volume);
 }
 
-Vector Mesh3::oriented_area(const Element3 &element, int face_index) const {
-    const ElementTypeShape &shape = element_type_shape(element.type);
-    const ElementTypeShape::Face &face_shape = shape.faces[face_index];
-    Vector total_oriented_area = Vector::zero();
-    for (const auto &ip : face_shape.integration_points) {
-        total_oriented_area += integrate_area(element, face_index, ip);
+/* A linear tetrahedron has a constant Jacobian, so its volume has a closed
+form, and each vertex influences exactly a quarter of it */
+template<>
+void ElementKernel<ElementType::C3D4>::volumes(
+    const ContiguousMap<NodeId, Node3> &nodes,
+    ConstElement3Ref element,
+    Volume *volume_out,
+    Volume *volumes_out
+) {
+    Vector points[num_vertices];
+    gather(nodes, element, points);
+    Vector a = points[1] - points[0];
+    Vector b = points[2] - points[0];
+    Vector c = points[3] - points[0];
+    double volume = a.dot(b.cross(c)) / 6;
+    if (volumes_out != nullptr) {
+        for (int i = 0; i < num_vertices; ++i) {
+            volumes_out[i] = Volume(volume / 4);
+        }
     }
-    return total_oriented_area;
+    *volume_out = Volume(volume);
 }
 
-void Mesh3::oriented_areas_for_nodes(
-    const Element3 &element,
+template<ElementType type>
+void ElementKernel<type>::areas(
+    const ContiguousMap<NodeId, Node3> &nodes,
+    ConstElement3Ref element,
     int face_index,
+    Vector *area_out,
     Vector *areas_out
-) const {
-    const ElementTypeShape &shape = element_type_shape(element.type);
-    const ElementTypeShape::Face &face_shape = shape.faces[face_index];
-    for (int i = 0; i < static_cast<int>(shape.vertices.size()); ++i) {
-        areas_out[i] = Vector::zero();
+) {
+    const Tables &tables = Tables::get();
+    const ElementTypeShape::Face &face_shape =
+        element_type_shape(type).faces[face_index];
+    Vector points[num_vertices];
+    gather(nodes, element, points);
+    if (areas_out != nullptr) {
+        for (int i = 0; i < num_vertices; ++i) {
+            areas_out[i] = Vector::zero();
+        }
     }
-    for (const auto &ip : face_shape.integration_points) {
-        Vector d_area = integrate_area(element, face_index, ip);
-        double sf[ElementTypeShape::max_vertices_per_element];
-        shape.shape_functions(ip.uvw, sf);
-        for (int node_ix : face_shape.vertices) {
-            areas_out[node_ix] += sf[node_ix] * d_area;
+    Vector total_area = Vector::zero();
+    for (const typename Tables::Sample &sample :
+            tables.face_samples[face_index]) {
+        Vector d_area = sample.weight * jacobian(points, sample)
+            .cofactor_matrix().apply(face_shape.normal);
+        total_area += d_area;
+        if (areas_out != nullptr) {
+            for (int node_ix : face_shape.vertices) {
+                areas_out[node_ix] += sample.sf[node_ix] * d_area;
+            }
         }
     }
+    *area_out = total_area;
 }
 
-/* Computes the center of mass and volume of the given element. */
-void Mesh3::center_of_mass(
-    const Element3 &element,
-    Point *center_of_mass_out,
-    Volume *volume_out
-) const {
-    Vector center_of_mass = Vector::zero();
-    double volume = 0;
-    const ElementTypeShape &shape = element_type_shape(element.type);
-    for (const auto &ip : shape.volume_integration_points) {
-        Point ip_center_of_mass = point_for_shape_point(element, ip.uvw);
-        double ip_volume = integrate_volume(element, ip);
-        center_of_mass += (ip_center_of_mass - Point::origin()) * ip_volume;
-        volume += ip_volume;
-    }
-    *center_of_mass_out = Point::origin() + center_of_mass / volume;
-    if (volume_out != nullptr) {
-        *volume_out = Volume(volume);
+static void element_volumes(
+    const ContiguousMap<NodeId, Node3> &nodes,
+    ConstElement3Ref element,
+    Volume *volume_out,
+    Volume *volumes_out
+) {
+    switch (element.type) {
+    case ElementType::C3D8:
+        ElementKernel<ElementType::C3D8>::volumes(
+            nodes, element, volume_out, volumes_out);
+        break;
+    case ElementType::C3D20:
+        ElementKernel<ElementType::C3D20>::volumes(
+            nodes, element, volume_out, volumes_out);
+        break;
+    case ElementType::C3D20R:
+        ElementKernel<ElementType::C3D20R>::volumes(
+            nodes, element, volume_out, volumes_out);
+        break;
+    case ElementType::C3D20RI:
+        ElementKernel<ElementType::C3D20RI>::volumes(
+            nodes, element, volume_out, volumes_out);
+        break;
+    case ElementType::C3D4:
+        ElementKernel<ElementType::C3D4>::volumes(
+            nodes, element, volume_out, volumes_out);
+        break;
+    case ElementType::C3D10:
+        ElementKernel<ElementType::C3D10>::volumes(
+            nodes, element, volume_out, volumes_out);
+        break;
+    case ElementType::C3D6:
+        ElementKernel<ElementType::C3D6>::volumes(
+            nodes, element, volume_out, volumes_out);
+        break;
+    case ElementType::C3D15:
+        ElementKernel<ElementType::C3D15>::volumes(
+            nodes, element, volume_out, volumes_out);
+        break;
+    default: assert(false);
     }
 }
 
-Point Mesh3::point_for_shape_point(
-    const Element3 &element,
-    ElementTypeShape::ShapePoint uvw
-) const {
-    const ElementTypeShape &shape = element_type_shape(element.type);
-    double sf[ElementTypeShape::max_vertices_per_element];
-    shape.shape_functions(uvw, sf);
-    Vector point = Vector::zero();
-    for (int vertex = 0; vertex < static_cast<int>(shape.vertices.size());
-            ++vertex) {
-        Point vertex_point = nodes[element.nodes[vertex]].point;
-        point += sf[vertex] * (vertex_point - Point::origin());
+static void element_areas(
+    const ContiguousMap<NodeId, Node3> &nodes,
+    ConstElement3Ref element,
+    int face_index,
+    Vector *area_out,
+    Vector *areas_out
+) {
+    switch (element.type) {
+    case ElementType::C3D8:
+        ElementKernel<ElementType::C3D8>::areas(
+            nodes, element, face_index, area_out, areas_out);
+        break;
+    case ElementType::C3D20:
+        ElementKernel<ElementType::C3D20>::areas(
+            nodes, element, face_index, area_out, areas_out);
+        break;
+    case ElementType::C3D20R:
+        ElementKernel<ElementType::C3D20R>::areas(
+            nodes, element, face_index, area_out, areas_out);
+        break;
+    case ElementType::C3D20RI:
+        ElementKernel<ElementType::C3D20RI>::areas(
+            nodes, element, face_index, area_out, areas_out);
+        break;
+    case ElementType::C3D4:
+        ElementKernel<ElementType::C3D4>::areas(
+            nodes, element, face_index, area_out, areas_out);
+        break;
+    case ElementType::C3D10:
+        ElementKernel<ElementType::C3D10>::areas(
+            nodes, element, face_index, area_out, areas_out);
+        break;
+    case ElementType::C3D6:
+        ElementKernel<ElementType::C3D6>::areas(
+            nodes, element, face_index, area_out, areas_out);
+        break;
+    case ElementType::C3D15:
+        ElementKernel<ElementType::C3D15>::areas(
+            nodes, element, face_index, area_out, areas_out);
+        break;
+    default: assert(false);
     }
-    return Point::origin() + point;
 }
 
-Matrix Mesh3::jacobian(
-    const Element3 &element,
-    ElementTypeShape::ShapePoint uvw
-) const {
-    const ElementTypeShape &shape = element_type_shape(element.type);
-    ElementTypeShape::ShapeVector sf_d_uvw[
-        ElementTypeShape::max_vertices_per_element];
-    shape.shape_function_derivatives(uvw, sf_d_uvw);
-    Matrix jacobian = Matrix::zero();
-    for (int i = 0; i < static_cast<int>(shape.vertices.size()); ++i) {
-        Vector point = nodes[element.nodes[i]].point - Point::origin();
-        jacobian.cols[0] += point * sf_d_uvw[i].x;
-        jacobian.cols[1] += point * sf_d_uvw[i].y;
-        jacobian.cols[2] += point * sf_d_uvw[i].z;
-    }
-    return jacobian;
-}
-
-double Mesh3::integrate_volume(
-    const Element3 &element,
-    const ElementTypeShape::IntegrationPoint &ip
+Volume Mesh3::volume(ConstElement3Ref element) const {
+    Volume volume;
+    element_volumes(nodes, element, &volume, nullptr);
+    return volume;
+}
+
+void Mesh3::volumes_for_nodes(
+    ConstElement3Ref element,
+    Volume *volumes_out
 ) const {
-    return ip.weight * jacobian(element, ip.uvw).determinant();
+    Volume volume;
+    element_volumes(nodes, element, &volume, volumes_out);
+}
+
+Vector Mesh3::oriented_area(ConstElement3Ref element, int face_index) const {
+    Vector area;
+    element_areas(nodes, element, face_index, &area, nullptr);
+    return area;
 }
 
-Vector Mesh3::integrate_area(
-    const Element3 &element,
+void Mesh3::oriented_areas_for_nodes(
+    ConstElement3Ref element,
     int face_index,
-    const ElementTypeShape::IntegrationPoint &ip
+    Vector *areas_out
 ) const {
-    Matrix j = jacobian(element, ip.uvw);
-    ElementTypeShape::ShapeVector shape_normal =
-        element_type_shape(element.type).faces[face_index].normal;
-    return ip.weight * j.cofactor_matrix().apply(shape_normal);
+    Vector area;
+    element_areas(nodes, element, face_index, &area, areas_out);
 }
 
-} /* namespace os2cx */
+/* Computes the center of mass and volume of the given element. Integrating the
+position over the element is the same as weighting each vertex by the volume
+that it influences, because the shape functions sum to one everywhere. */
+void Mesh3::center_of_mass(
+    ConstElement3Ref element,
+    Point *center_of_mass_out,
+    Volume *volume_out
+) const {
+    Volume volumes[ElementTypeShape::max_vertices_per_element];
+    Volume volume;
+    element_volumes(nodes, element, &volume, volumes);
+    Vector center_of_mass = Vector::zero();
+    for (int i = 0; i < element.num_nodes(); ++i) {
+        center_of_mass +=
+            (nodes[element.nodes[i]].point - Point::origin()) * volumes[i];
+    }
+    *center_of_mass_out = Point::origin() + center_of_mass / volume;
+    if (volume_out != nullptr) {
+        *volume_out = volume;
+    }
+}
 
+} /* namespace os2cx */
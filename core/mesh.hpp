@@ -3,6 +3,7 @@
 
 #include <assert.h>
 
+#include <algorithm>
 #include <set>
 #include <string>
 #include <vector>
@@ -33,6 +34,23 @@ private:
     int id;
 };
 
+class ElementId {
+public:
+    static ElementId from_int(int id) { ElementId ei; ei.id = id; return ei; }
+    static ElementId invalid() { return ElementId::from_int(-1); }
+    int to_int() const { return id; }
+    bool operator==(ElementId other) const { return id == other.id; }
+    bool operator!=(ElementId other) const { return id != other.id; }
+    bool operator<(ElementId other) const { return id < other.id; }
+    void operator++() { ++id; }
+private:
+    int id;
+};
+
+/* Element3 holds a single element while it's being built or modified. The
+elements of a Mesh3 aren't stored as Element3s, because most of an Element3 is
+wasted space for anything but a C3D20; instead, they're stored compactly in an
+Element3Store, and accessed through ConstElement3Ref and Element3Ref. */
 class Element3 {
 public:
     int num_nodes() const {
@@ -45,17 +63,198 @@ public:
     AttrBitset face_attrs[ElementTypeShape::max_faces_per_element];
 };
 
-class ElementId {
+/* ConstElement3Ref refers to an element in an Element3Store, or to an
+Element3. It has the same members as Element3, but 'nodes' and 'face_attrs'
+only extend as far as the element's number of vertices and faces. It's only
+valid until the store is next modified. */
+class ConstElement3Ref {
 public:
-    static ElementId from_int(int id) { ElementId ei; ei.id = id; return ei; }
-    static ElementId invalid() { return ElementId::from_int(-1); }
-    int to_int() const { return id; }
-    bool operator==(ElementId other) const { return id == other.id; }
-    bool operator!=(ElementId other) const { return id != other.id; }
-    bool operator<(ElementId other) const { return id < other.id; }
-    void operator++() { ++id; }
+    /* The face attrs of an Element3Store element are AttrSetIds, whereas
+    those of an Element3 are AttrBitsets; FaceAttrs looks up either one. */
+    class FaceAttrs {
+    public:
+        FaceAttrs(const AttrBitset *bs) :
+            bitsets(bs), ids(nullptr), table(nullptr) { }
+        FaceAttrs(const AttrSetId *is, const AttrSetTable *t) :
+            bitsets(nullptr), ids(is), table(t) { }
+        const AttrBitset &operator[](int face) const {
+            return table ? (*table)[ids[face]] : bitsets[face];
+        }
+    private:
+        const AttrBitset *bitsets;
+        const AttrSetId *ids;
+        const AttrSetTable *table;
+    };
+
+    ConstElement3Ref(
+        ElementType t,
+        const NodeId *ns,
+        const AttrBitset &as,
+        FaceAttrs fas
+    ) : type(t), nodes(ns), attrs(as), face_attrs(fas) { }
+    ConstElement3Ref(const Element3 &element) :
+        type(element.type),
+        nodes(element.nodes),
+        attrs(element.attrs),
+        face_attrs(element.face_attrs)
+        { }
+
+    int num_nodes() const {
+        return element_type_shape(type).vertices.size();
+    }
+
+    /* Copies the element out, e.g. to modify it and push it onto a store */
+    Element3 to_element() const {
+        const ElementTypeShape &shape = element_type_shape(type);
+        Element3 element;
+        element.type = type;
+        std::copy(nodes, nodes + shape.vertices.size(), element.nodes);
+        element.attrs = attrs;
+        for (int f = 0; f < static_cast<int>(shape.faces.size()); ++f) {
+            element.face_attrs[f] = face_attrs[f];
+        }
+        return element;
+    }
+
+    ElementType type;
+    const NodeId *nodes;
+    const AttrBitset &attrs;
+    FaceAttrs face_attrs;
+};
+
+/* Element3Ref is like ConstElement3Ref, but allows the nodes of the element to
+be modified in place. The attrs are changed with Element3Store::set_attrs() and
+set_face_attrs() instead, since they're shared with other elements. The type
+can't be changed, because that would change how much space the element takes
+up. */
+class Element3Ref {
+public:
+    Element3Ref(
+        ElementType t,
+        NodeId *ns,
+        const AttrBitset &as,
+        ConstElement3Ref::FaceAttrs fas
+    ) : type(t), nodes(ns), attrs(as), face_attrs(fas) { }
+
+    operator ConstElement3Ref() const {
+        return ConstElement3Ref(type, nodes, attrs, face_attrs);
+    }
+
+    int num_nodes() const {
+        return element_type_shape(type).vertices.size();
+    }
+
+    ElementType type;
+    NodeId *nodes;
+    const AttrBitset &attrs;
+    ConstElement3Ref::FaceAttrs face_attrs;
+};
+
+/* Element3Store is the collection of elements of a Mesh3. It's used like a
+ContiguousMap<ElementId, Element3>, but the nodes and face attrs of all the
+elements are packed into two flat arrays, with each element taking only as many
+entries as it has vertices and faces. Attrs are interned in an AttrSetTable, so
+each element and face only stores an AttrSetId. A C3D4 takes up about a quarter
+of the space it would as an Element3, which matters for meshes with millions of
+elements. */
+class Element3Store {
+public:
+    template<class Store, class Ref>
+    class Iterator {
+    public:
+        Iterator(Store *s, ElementId i) : store(s), id(i) { }
+        Ref operator*() const { return (*store)[id]; }
+        void operator++() { ++id; }
+        bool operator==(const Iterator &other) const { return id == other.id; }
+        bool operator!=(const Iterator &other) const { return id != other.id; }
+    private:
+        Store *store;
+        ElementId id;
+    };
+    typedef Iterator<Element3Store, Element3Ref> iterator;
+    typedef Iterator<const Element3Store, ConstElement3Ref> const_iterator;
+
+    /* The number of bytes that an element of the given type takes up */
+    static int bytes_per_element(ElementType type);
+
+    Element3Store() : offset(0) { }
+    explicit Element3Store(ElementId off) : offset(off.to_int()) { }
+
+    ConstElement3Ref operator[](ElementId k) const {
+        int index = to_index(k);
+        return ConstElement3Ref(
+            types[index],
+            node_ids.data() + node_offsets[index],
+            attr_set_table[attrs[index]],
+            ConstElement3Ref::FaceAttrs(
+                face_attrs.data() + face_offsets[index], &attr_set_table));
+    }
+    Element3Ref operator[](ElementId k) {
+        int index = to_index(k);
+        return Element3Ref(
+            types[index],
+            node_ids.data() + node_offsets[index],
+            attr_set_table[attrs[index]],
+            ConstElement3Ref::FaceAttrs(
+                face_attrs.data() + face_offsets[index], &attr_set_table));
+    }
+
+    /* The attrs of every element and face are in attr_sets(), so anything
+    that only depends on them can be computed once per AttrSetId */
+    const AttrSetTable &attr_sets() const { return attr_set_table; }
+    AttrSetId attr_set_id(ElementId k) const { return attrs[to_index(k)]; }
+    AttrSetId face_attr_set_id(ElementId k, int face) const {
+        return face_attrs[face_offsets[to_index(k)] + face];
+    }
+
+    void set_attrs(ElementId k, AttrBitset new_attrs) {
+        attrs[to_index(k)] = attr_set_table.intern(new_attrs);
+    }
+    void set_face_attrs(ElementId k, int face, AttrBitset new_attrs) {
+        face_attrs[face_offsets[to_index(k)] + face] =
+            attr_set_table.intern(new_attrs);
+    }
+
+    int size() const { return types.size(); }
+    ElementId key_begin() const { return ElementId::from_int(offset); }
+    ElementId key_end() const {
+        return ElementId::from_int(offset + types.size());
+    }
+    iterator begin() { return iterator(this, key_begin()); }
+    iterator end() { return iterator(this, key_end()); }
+    const_iterator begin() const { return const_iterator(this, key_begin()); }
+    const_iterator end() const { return const_iterator(this, key_end()); }
+
+    void reserve(int capacity);
+
+    /* Reserves space for all of 'others' to be append()ed to this store */
+    void reserve_for_append(const std::vector<const Element3Store *> &others);
+
+    /* 'element' must not refer to an element of this store */
+    ElementId push_back(const ConstElement3Ref &element);
+
+    /* Moves the elements of 'other' onto the end of this store, adding
+    'node_id_offset' to their node IDs, and leaves 'other' empty. Each array of
+    'other' is freed as soon as it has been copied, and the node IDs and attr
+    set IDs are converted in parallel. */
+    void append(Element3Store &&other, int node_id_offset);
+
 private:
-    int id;
+    int to_index(ElementId k) const {
+        int index = k.to_int() - offset;
+        assert(index >= 0);
+        assert(index < static_cast<int>(types.size()));
+        return index;
+    }
+
+    int offset;
+    std::vector<ElementType> types;
+    std::vector<int> node_offsets;
+    std::vector<int> face_offsets;
+    std::vector<AttrSetId> attrs;
+    std::vector<NodeId> node_ids;
+    std::vector<AttrSetId> face_attrs;
+    AttrSetTable attr_set_table;
 };
 
 class FaceId {
@@ -131,63 +330,63 @@ public:
         const Mesh3 &other,
         MeshIdMapping *id_mapping_out);
 
+    /* Like append_mesh(), but moves the contents out of 'other' instead of
+    copying them, leaving it empty. If reserve_for_append() was called first
+    with all the meshes that will be appended, the combined mesh is allocated
+    once and each part is freed as soon as it has been moved, so the peak
+    memory is the combined mesh plus the largest part rather than twice the
+    combined mesh. */
+    void append_mesh(
+        Mesh3 &&other,
+        MeshIdMapping *id_mapping_out);
+    void reserve_for_append(const std::vector<const Mesh3 *> &others);
+
+    /* Appends the mirror image of this mesh in the plane perpendicular to
+    'axis' at 'position'. The nodes in 'plane_nodes' lie on the plane, so the
+    mirror image shares them instead of copying them. The vertices of the
+    mirrored elements are reordered so they aren't turned inside out. Returns a
+    map from every node of the resulting mesh to the node that it's an image of;
+    the original nodes map to themselves. */
+    ContiguousMap<NodeId, NodeId> append_mirror_image(
+        Dimension axis,
+        double position,
+        const std::set<NodeId> &plane_nodes);
+
     /* Computes the volume of the given element. */
-    Volume volume(const Element3 &element) const;
+    Volume volume(ConstElement3Ref element) const;
 
     /* Computes the weighted "volume" influenced by each node of the given
     element. This is useful for e.g. converting a force distributed uniformly
     over the volume of the element into an equivalent set of forces on the nodes
     of the element. */
-    void volumes_for_nodes(const Element3 &element, Volume *volumes_out) const;
+    void volumes_for_nodes(ConstElement3Ref element, Volume *volumes_out) const;
 
     /* Computes the oriented area of the given face of the given element. (For
     linear elements, this can be thought of as a vector pointing perpendicularly
     out from the face with magnitude equal to the face's area; although this
     description isn't quite right for a quadratic element with a curved face.)
     */
-    Vector oriented_area(const Element3 &element, int face_index) const;
+    Vector oriented_area(ConstElement3Ref element, int face_index) const;
 
     /* Computes the weighted "oriented areas" influenced by each node of the
     given element. This is useful for e.g. converting a force distributed
     uniformly over the area of the face into an equivalent set of forces on the
     nodes. Nodes that aren't part of the face will have values set to zero. */
     void oriented_areas_for_nodes(
-        const Element3 &element,
+        ConstElement3Ref element,
         int face_index,
         Vector *areas_out
     ) const;
 
     /* Computes the center of mass and volume of the given element. */
     void center_of_mass(
-        const Element3 &element,
+        ConstElement3Ref element,
         Point *center_of_mass_out,
         Volume *volume_out
     ) const;
 
     ContiguousMap<NodeId, Node3> nodes;
-    ContiguousMap<ElementId, Element3> elements;
-
-private:
-    Point point_for_shape_point(
-        const Element3 &element,
-        ElementTypeShape::ShapePoint uvw
-    ) const;
-
-    Matrix jacobian(
-        const Element3 &element,
-        ElementTypeShape::ShapePoint uvw
-    ) const;
-
-    double integrate_volume(
-        const Element3 &element,
-        const ElementTypeShape::IntegrationPoint &ip
-    ) const;
-
-    Vector integrate_area(
-        const Element3 &element,
-        int face_index,
-        const ElementTypeShape::IntegrationPoint &ip
-    ) const;
+    Element3Store elements;
 };
 
 } /* namespace os2cx */
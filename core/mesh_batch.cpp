@@ -0,0 +1,247 @@
+#include "mesh_batch.hpp"
+
+#include "mesh_type_info.internal.hpp"
+#include "parallel.hpp"
+#include "simd.hpp"
+
+#ifdef OS2CX_X86_SIMD
+#include <immintrin.h>
+#endif
+
+namespace os2cx {
+
+/* The kernels in mesh_batch.internal.hpp are written against a class Lanes,
+which holds one double per element being evaluated together. They're compiled
+twice: once with a portable Lanes that's an array, whose loops are left for the
+compiler to vectorize however the baseline target allows; and, on x86, once
+with AVX2 enabled for just that code and a Lanes that's a single AVX2
+register. simd_level() chooses between them at runtime. Both versions round the
+same way, because neither uses fused multiply-add. */
+
+static const int lane_width = 4;
+
+typedef void (*VolumeKernel)(
+    const Mesh3 &, const std::vector<ElementId> &, const int *, int,
+    ElementVolumeBatch *);
+typedef void (*AreaKernel)(
+    const Mesh3 &, const std::vector<FaceId> &, const int *, int,
+    FaceAreaBatch *);
+
+namespace mesh_batch_scalar {
+
+class Lanes {
+public:
+    static const int width = lane_width;
+
+    Lanes() { }
+    static Lanes broadcast(double x) {
+        Lanes l;
+        for (int i = 0; i < width; ++i) l.value[i] = x;
+        return l;
+    }
+    static Lanes load(const double *values) {
+        Lanes l;
+        for (int i = 0; i < width; ++i) l.value[i] = values[i];
+        return l;
+    }
+    void store(double *values) const {
+        for (int i = 0; i < width; ++i) values[i] = value[i];
+    }
+    Lanes operator+(Lanes other) const {
+        Lanes l;
+        for (int i = 0; i < width; ++i) l.value[i] = value[i] + other.value[i];
+        return l;
+    }
+    Lanes operator-(Lanes other) const {
+        Lanes l;
+        for (int i = 0; i < width; ++i) l.value[i] = value[i] - other.value[i];
+        return l;
+    }
+    Lanes operator*(Lanes other) const {
+        Lanes l;
+        for (int i = 0; i < width; ++i) l.value[i] = value[i] * other.value[i];
+        return l;
+    }
+private:
+    double value[width];
+};
+
+#include "mesh_batch.internal.hpp"
+
+} /* namespace mesh_batch_scalar */
+
+#ifdef OS2CX_X86_SIMD
+
+#ifdef __clang__
+#pragma clang attribute push (__attribute__((target("avx2"))), \
+    apply_to = function)
+#else
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#endif
+
+namespace mesh_batch_avx2 {
+
+class Lanes {
+public:
+    static const int width = lane_width;
+
+    Lanes() { }
+    explicit Lanes(__m256d v) : value(v) { }
+    static Lanes broadcast(double x) { return Lanes(_mm256_set1_pd(x)); }
+    static Lanes load(const double *values) {
+        return Lanes(_mm256_loadu_pd(values));
+    }
+    void store(double *values) const { _mm256_storeu_pd(values, value); }
+    Lanes operator+(Lanes other) const {
+        return Lanes(_mm256_add_pd(value, other.value));
+    }
+    Lanes operator-(Lanes other) const {
+        return Lanes(_mm256_sub_pd(value, other.value));
+    }
+    Lanes operator*(Lanes other) const {
+        return Lanes(_mm256_mul_pd(value, other.value));
+    }
+private:
+    __m256d value;
+};
+
+#include "mesh_batch.internal.hpp"
+
+} /* namespace mesh_batch_avx2 */
+
+#ifdef __clang__
+#pragma clang attribute pop
+#else
+#pragma GCC pop_options
+#endif
+
+#endif /* OS2CX_X86_SIMD */
+
+static VolumeKernel volume_kernel_for(SimdLevel level, ElementType type) {
+#ifdef OS2CX_X86_SIMD
+    if (level >= SimdLevel::Avx2) {
+        return mesh_batch_avx2::volume_kernel_for(type);
+    }
+#endif
+    return mesh_batch_scalar::volume_kernel_for(type);
+}
+
+static AreaKernel area_kernel_for(SimdLevel level, ElementType type) {
+#ifdef OS2CX_X86_SIMD
+    if (level >= SimdLevel::Avx2) {
+        return mesh_batch_avx2::area_kernel_for(type);
+    }
+#endif
+    return mesh_batch_scalar::area_kernel_for(type);
+}
+
+static const int num_element_types =
+    static_cast<int>(ElementType::C3D15) + 1;
+
+/* Splits the indices in [begin, end) into groups of up to lane_width that
+have the same key(index), which must be in [0, num_keys), and calls
+flush(indices, count) for each group. Indices are grouped in the order they
+appear, so nearby elements end up in the same lanes. */
+template<class Key, class Flush>
+static void for_each_lane_group(
+    int begin,
+    int end,
+    int num_keys,
+    const Key &key,
+    const Flush &flush
+) {
+    std::vector<int> pending(num_keys * lane_width);
+    std::vector<int> num_pending(num_keys, 0);
+    for (int index = begin; index < end; ++index) {
+        int k = key(index);
+        int *group = &pending[k * lane_width];
+        group[num_pending[k]++] = index;
+        if (num_pending[k] == lane_width) {
+            flush(group, lane_width);
+            num_pending[k] = 0;
+        }
+    }
+    for (int k = 0; k < num_keys; ++k) {
+        if (num_pending[k] != 0) {
+            flush(&pending[k * lane_width], num_pending[k]);
+        }
+    }
+}
+
+ElementVolumeBatch compute_element_volume_batch(
+    const Mesh3 &mesh,
+    const std::vector<ElementId> &element_ids
+) {
+    int count = element_ids.size();
+    ElementVolumeBatch batch;
+    batch.volumes.resize(count);
+    batch.node_offsets.resize(count);
+    int num_node_volumes = 0;
+    for (int i = 0; i < count; ++i) {
+        batch.node_offsets[i] = num_node_volumes;
+        num_node_volumes += mesh.elements[element_ids[i]].num_nodes();
+    }
+    batch.node_volumes.resize(num_node_volumes);
+
+    SimdLevel level = simd_level();
+    static const int chunk_size = 1024;
+    parallel_for(count, chunk_size, [&](int begin, int end) {
+        for_each_lane_group(begin, end, num_element_types,
+            [&](int index) {
+                return static_cast<int>(
+                    mesh.elements[element_ids[index]].type);
+            },
+            [&](const int *indices, int num_indices) {
+                ElementType type = mesh.elements[element_ids[indices[0]]].type;
+                volume_kernel_for(level, type)(
+                    mesh, element_ids, indices, num_indices, &batch);
+            });
+    });
+    return batch;
+}
+
+FaceAreaBatch compute_face_area_batch(
+    const Mesh3 &mesh,
+    const std::vector<FaceId> &face_ids
+) {
+    int count = face_ids.size();
+    FaceAreaBatch batch;
+    batch.area_x.resize(count);
+    batch.area_y.resize(count);
+    batch.area_z.resize(count);
+    batch.node_offsets.resize(count);
+    int num_node_areas = 0;
+    for (int i = 0; i < count; ++i) {
+        batch.node_offsets[i] = num_node_areas;
+        ElementType type = mesh.elements[face_ids[i].element_id].type;
+        num_node_areas +=
+            element_type_shape(type).faces[face_ids[i].face].vertices.size();
+    }
+    batch.node_area_x.resize(num_node_areas);
+    batch.node_area_y.resize(num_node_areas);
+    batch.node_area_z.resize(num_node_areas);
+
+    SimdLevel level = simd_level();
+    static const int chunk_size = 1024;
+    parallel_for(count, chunk_size, [&](int begin, int end) {
+        for_each_lane_group(begin, end,
+            num_element_types * ElementTypeShape::max_faces_per_element,
+            [&](int index) {
+                ElementType type =
+                    mesh.elements[face_ids[index].element_id].type;
+                return static_cast<int>(type)
+                    * ElementTypeShape::max_faces_per_element
+                    + face_ids[index].face;
+            },
+            [&](const int *indices, int num_indices) {
+                ElementType type =
+                    mesh.elements[face_ids[indices[0]].element_id].type;
+                area_kernel_for(level, type)(
+                    mesh, face_ids, indices, num_indices, &batch);
+            });
+    });
+    return batch;
+}
+
+} /* namespace os2cx */
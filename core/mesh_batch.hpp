@@ -0,0 +1,63 @@
+#ifndef OS2CX_MESH_BATCH_HPP_
+#define OS2CX_MESH_BATCH_HPP_
+
+#include <vector>
+
+#include "mesh.hpp"
+
+namespace os2cx {
+
+/* The batched counterparts of Mesh3::volumes_for_nodes() and
+Mesh3::oriented_areas_for_nodes(), for passes that visit many elements or
+faces. Elements of the same type are evaluated several at a time, one per SIMD
+lane (four lanes of AVX2 if the CPU supports it, or portable code otherwise),
+and the results are stored as structure-of-arrays. */
+
+class ElementVolumeBatch {
+public:
+    /* volumes[i] is the volume of the i'th element of the batch */
+    std::vector<double> volumes;
+
+    /* The volume influenced by vertex 'j' of the i'th element is
+    node_volumes[node_offsets[i] + j] */
+    std::vector<int> node_offsets;
+    std::vector<double> node_volumes;
+};
+
+ElementVolumeBatch compute_element_volume_batch(
+    const Mesh3 &mesh,
+    const std::vector<ElementId> &element_ids);
+
+class FaceAreaBatch {
+public:
+    /* The oriented area of the i'th face of the batch */
+    Vector area(int i) const {
+        return Vector(area_x[i], area_y[i], area_z[i]);
+    }
+
+    /* The i'th face's oriented area, normalized */
+    Vector normal(int i) const {
+        Vector a = area(i);
+        return a / a.magnitude();
+    }
+
+    /* The oriented area influenced by the k'th vertex of the i'th face, in the
+    order of ElementTypeShape::Face::vertices */
+    Vector node_area(int i, int k) const {
+        int index = node_offsets[i] + k;
+        return Vector(
+            node_area_x[index], node_area_y[index], node_area_z[index]);
+    }
+
+    std::vector<double> area_x, area_y, area_z;
+    std::vector<int> node_offsets;
+    std::vector<double> node_area_x, node_area_y, node_area_z;
+};
+
+FaceAreaBatch compute_face_area_batch(
+    const Mesh3 &mesh,
+    const std::vector<FaceId> &face_ids);
+
+} /* namespace os2cx */
+
+#endif /* OS2CX_MESH_BATCH_HPP_ */
@@ -0,0 +1,230 @@
+/* The SIMD kernels behind compute_element_volume_batch() and
+compute_face_area_batch(). mesh_batch.cpp includes this file once per
+instruction set, each time inside its own namespace that defines a class
+Lanes; so unlike the other headers, it has no include guard and doesn't
+include anything itself. */
+
+/* A Vector per lane */
+class LaneVector {
+public:
+    LaneVector() { }
+    LaneVector(Lanes x_, Lanes y_, Lanes z_) : x(x_), y(y_), z(z_) { }
+    static LaneVector zero() {
+        Lanes z = Lanes::broadcast(0);
+        return LaneVector(z, z, z);
+    }
+    LaneVector operator+(const LaneVector &other) const {
+        return LaneVector(x + other.x, y + other.y, z + other.z);
+    }
+    LaneVector operator*(Lanes scale) const {
+        return LaneVector(x * scale, y * scale, z * scale);
+    }
+    Lanes dot(const LaneVector &other) const {
+        return x * other.x + y * other.y + z * other.z;
+    }
+    LaneVector cross(const LaneVector &other) const {
+        return LaneVector(
+            y * other.z - z * other.y,
+            z * other.x - x * other.z,
+            x * other.y - y * other.x);
+    }
+    Lanes x, y, z;
+};
+
+/* Loads the positions of the vertices of up to Lanes::width elements of the
+same type, one element per lane. Lanes past 'count' repeat the first element, so
+that they compute something harmless. */
+template<int num_vertices>
+static void gather_points(
+    const Mesh3 &mesh,
+    const ElementId *element_ids,
+    int count,
+    LaneVector *points_out
+) {
+    const NodeId *lane_nodes[Lanes::width];
+    for (int lane = 0; lane < Lanes::width; ++lane) {
+        ElementId element_id = element_ids[lane < count ? lane : 0];
+        lane_nodes[lane] = mesh.elements[element_id].nodes;
+    }
+    for (int i = 0; i < num_vertices; ++i) {
+        double x[Lanes::width], y[Lanes::width], z[Lanes::width];
+        for (int lane = 0; lane < Lanes::width; ++lane) {
+            const Point &point = mesh.nodes[lane_nodes[lane][i]].point;
+            x[lane] = point.x;
+            y[lane] = point.y;
+            z[lane] = point.z;
+        }
+        points_out[i] =
+            LaneVector(Lanes::load(x), Lanes::load(y), Lanes::load(z));
+    }
+}
+
+/* Computes the columns of the Jacobian at 'sample' */
+template<class Sample, int num_vertices>
+static void jacobian(
+    const LaneVector *points,
+    const Sample &sample,
+    LaneVector *cols_out
+) {
+    cols_out[0] = cols_out[1] = cols_out[2] = LaneVector::zero();
+    for (int i = 0; i < num_vertices; ++i) {
+        cols_out[0] = cols_out[0] +
+            points[i] * Lanes::broadcast(sample.sf_d_uvw[i].x);
+        cols_out[1] = cols_out[1] +
+            points[i] * Lanes::broadcast(sample.sf_d_uvw[i].y);
+        cols_out[2] = cols_out[2] +
+            points[i] * Lanes::broadcast(sample.sf_d_uvw[i].z);
+    }
+}
+
+/* Evaluates the elements element_ids[indices[0...count]], which must all be of
+type 'type', and stores the results in 'batch' */
+template<ElementType type>
+static void volume_kernel(
+    const Mesh3 &mesh,
+    const std::vector<ElementId> &element_ids,
+    const int *indices,
+    int count,
+    ElementVolumeBatch *batch
+) {
+    typedef ShapeTables<type> Tables;
+    static const int num_vertices = Tables::num_vertices;
+    const Tables &tables = Tables::get();
+
+    ElementId lane_element_ids[Lanes::width];
+    for (int lane = 0; lane < count; ++lane) {
+        lane_element_ids[lane] = element_ids[indices[lane]];
+    }
+    LaneVector points[num_vertices];
+    gather_points<num_vertices>(mesh, lane_element_ids, count, points);
+
+    Lanes volume = Lanes::broadcast(0);
+    Lanes node_volumes[num_vertices];
+    for (int i = 0; i < num_vertices; ++i) {
+        node_volumes[i] = Lanes::broadcast(0);
+    }
+    for (const typename Tables::Sample &sample : tables.volume_samples) {
+        LaneVector cols[3];
+        jacobian<typename Tables::Sample, num_vertices>(points, sample, cols);
+        Lanes d_volume = cols[0].dot(cols[1].cross(cols[2]))
+            * Lanes::broadcast(sample.weight);
+        volume = volume + d_volume;
+        for (int i = 0; i < num_vertices; ++i) {
+            node_volumes[i] = node_volumes[i]
+                + d_volume * Lanes::broadcast(sample.sf[i]);
+        }
+    }
+
+    double values[Lanes::width];
+    volume.store(values);
+    for (int lane = 0; lane < count; ++lane) {
+        batch->volumes[indices[lane]] = values[lane];
+    }
+    for (int i = 0; i < num_vertices; ++i) {
+        node_volumes[i].store(values);
+        for (int lane = 0; lane < count; ++lane) {
+            batch->node_volumes[batch->node_offsets[indices[lane]] + i] =
+                values[lane];
+        }
+    }
+}
+
+/* Like volume_kernel(), but for faces, which must all have the same face
+index as well as the same element type */
+template<ElementType type>
+static void area_kernel(
+    const Mesh3 &mesh,
+    const std::vector<FaceId> &face_ids,
+    const int *indices,
+    int count,
+    FaceAreaBatch *batch
+) {
+    typedef ShapeTables<type> Tables;
+    static const int num_vertices = Tables::num_vertices;
+    const Tables &tables = Tables::get();
+    int face_index = face_ids[indices[0]].face;
+    const ElementTypeShape::Face &face_shape =
+        element_type_shape(type).faces[face_index];
+    int num_face_vertices = face_shape.vertices.size();
+
+    ElementId lane_element_ids[Lanes::width];
+    for (int lane = 0; lane < count; ++lane) {
+        lane_element_ids[lane] = face_ids[indices[lane]].element_id;
+    }
+    LaneVector points[num_vertices];
+    gather_points<num_vertices>(mesh, lane_element_ids, count, points);
+
+    Lanes normal_u = Lanes::broadcast(face_shape.normal.x);
+    Lanes normal_v = Lanes::broadcast(face_shape.normal.y);
+    Lanes normal_w = Lanes::broadcast(face_shape.normal.z);
+    LaneVector area = LaneVector::zero();
+    LaneVector node_areas[ElementTypeShape::max_vertices_per_face];
+    for (int k = 0; k < num_face_vertices; ++k) {
+        node_areas[k] = LaneVector::zero();
+    }
+    for (const typename Tables::Sample &sample :
+            tables.face_samples[face_index]) {
+        LaneVector cols[3];
+        jacobian<typename Tables::Sample, num_vertices>(points, sample, cols);
+        /* The cofactor matrix of the Jacobian, applied to the face normal */
+        LaneVector d_area =
+            (cols[1].cross(cols[2]) * normal_u
+                + cols[2].cross(cols[0]) * normal_v
+                + cols[0].cross(cols[1]) * normal_w)
+            * Lanes::broadcast(sample.weight);
+        area = area + d_area;
+        for (int k = 0; k < num_face_vertices; ++k) {
+            node_areas[k] = node_areas[k]
+                + d_area * Lanes::broadcast(sample.sf[face_shape.vertices[k]]);
+        }
+    }
+
+    double x[Lanes::width], y[Lanes::width], z[Lanes::width];
+    area.x.store(x);
+    area.y.store(y);
+    area.z.store(z);
+    for (int lane = 0; lane < count; ++lane) {
+        batch->area_x[indices[lane]] = x[lane];
+        batch->area_y[indices[lane]] = y[lane];
+        batch->area_z[indices[lane]] = z[lane];
+    }
+    for (int k = 0; k < num_face_vertices; ++k) {
+        node_areas[k].x.store(x);
+        node_areas[k].y.store(y);
+        node_areas[k].z.store(z);
+        for (int lane = 0; lane < count; ++lane) {
+            int index = batch->node_offsets[indices[lane]] + k;
+            batch->node_area_x[index] = x[lane];
+            batch->node_area_y[index] = y[lane];
+            batch->node_area_z[index] = z[lane];
+        }
+    }
+}
+
+static VolumeKernel volume_kernel_for(ElementType type) {
+    switch (type) {
+    case ElementType::C3D8:    return &volume_kernel<ElementType::C3D8>;
+    case ElementType::C3D20:   return &volume_kernel<ElementType::C3D20>;
+    case ElementType::C3D20R:  return &volume_kernel<ElementType::C3D20R>;
+    case ElementType::C3D20RI: return &volume_kernel<ElementType::C3D20RI>;
+    case ElementType::C3D4:    return &volume_kernel<ElementType::C3D4>;
+    case ElementType::C3D10:   return &volume_kernel<ElementType::C3D10>;
+    case ElementType::C3D6:    return &volume_kernel<ElementType::C3D6>;
+    case ElementType::C3D15:   return &volume_kernel<ElementType::C3D15>;
+    default: assert(false);
+    }
+}
+
+static AreaKernel area_kernel_for(ElementType type) {
+    switch (type) {
+    case ElementType::C3D8:    return &area_kernel<ElementType::C3D8>;
+    case ElementType::C3D20:   return &area_kernel<ElementType::C3D20>;
+    case ElementType::C3D20R:  return &area_kernel<ElementType::C3D20R>;
+    case ElementType::C3D20RI: return &area_kernel<ElementType::C3D20RI>;
+    case ElementType::C3D4:    return &area_kernel<ElementType::C3D4>;
+    case ElementType::C3D10:   return &area_kernel<ElementType::C3D10>;
+    case ElementType::C3D6:    return &area_kernel<ElementType::C3D6>;
+    case ElementType::C3D15:   return &area_kernel<ElementType::C3D15>;
+    default: assert(false);
+    }
+}
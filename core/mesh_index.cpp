@@ -1,12 +1,15 @@
 #include "mesh_index.hpp"
 
-#include <boost/container/flat_map.hpp>
+#include <atomic>
+#include <memory>
+
+#include "parallel.hpp"
 
 namespace os2cx {
 
 class FaceNodes {
 public:
-    static FaceNodes make(const Element3 &element, int face) {
+    static FaceNodes make(ConstElement3Ref element, int face) {
         FaceNodes out;
 
         const ElementTypeShape &shape = element_type_shape(element.type);
@@ -44,51 +47,78 @@ public:
         }
     }
 
-    /* This is just an arbitrary ordering so we can use FaceNodes as a sorting
-    key */
-    bool operator<(const FaceNodes &o) const {
-        if (num_nodes < o.num_nodes) return true;
-        if (o.num_nodes < num_nodes) return false;
+    bool operator==(const FaceNodes &o) const {
+        if (num_nodes != o.num_nodes) return false;
         for (int i = 0; i < num_nodes; ++i) {
-            if (nodes[i].to_int() < o.nodes[i].to_int()) return true;
-            if (o.nodes[i].to_int() < nodes[i].to_int()) return false;
+            if (nodes[i] != o.nodes[i]) return false;
         }
-        return false;
+        return true;
     }
 
     int num_nodes;
     NodeId nodes[ElementTypeShape::max_vertices_per_face];
 };
 
-Mesh3Index::Mesh3Index(const Mesh3 &mesh) {
-    /* We want to build a map from FaceNodes to FaceId so that we can match
-    faces. We use 'boost::container::flat_map' instead of 'std::map' in order to
-    reduce memory allocations and improve memory locality. The FaceNodes
-    ordering function should put matching faces close together in the map, which
-    will further improve locality. */
-    typedef boost::container::flat_map<FaceNodes, FaceId> MapType;
-    MapType::sequence_type sequence;
-    for (ElementId element_id = mesh.elements.key_begin();
-            element_id != mesh.elements.key_end();
-            ++element_id) {
-        const Element3 &element = mesh.elements[element_id];
-        const ElementTypeShape &shape = element_type_shape(element.type);
-        for (int face = 0;
-                face < static_cast<int>(shape.faces.size()); ++face) {
-            sequence.push_back(std::make_pair(
-                FaceNodes::make(element, face),
-                FaceId { element_id, face }
-            ));
-        }
-    }
+Mesh3Index::Mesh3Index(const Mesh3 &mesh) : indexed_mesh(&mesh) {
+    /* Two faces can only match if they have the same nodes, so in particular
+    the same lowest node ID. We bucket the faces by their lowest node ID with a
+    counting sort, then look for matches within each bucket. Each bucket only
+    holds a few faces, so the buckets are searched exhaustively, in parallel.
 
-    int num_faces = sequence.size();
-    MapType map;
-    map.adopt_sequence(std::move(sequence));
+    Faces are numbered by their slot in 'matching_faces', i.e. their FaceId
+    relative to the first element; slots past the last face of an element are
+    unused. */
+    static const int slots_per_element =
+        ElementTypeShape::max_faces_per_element;
+    int element_begin = mesh.elements.key_begin().to_int();
+    int num_slots = mesh.elements.size() * slots_per_element;
+    auto slot_face_id = [&](int slot) {
+        return FaceId(
+            ElementId::from_int(element_begin + slot / slots_per_element),
+            slot % slots_per_element);
+    };
 
-    /* This would fail if some faces were non-unique, i.e. if two elements
-    shared a certain face *from the same side*. */
-    assert(num_faces == static_cast<int>(map.size()));
+    static const int chunk_size = 1024;
+    int node_begin = mesh.nodes.key_begin().to_int();
+    std::vector<int> lowest_nodes(num_slots, -1);
+    parallel_for(mesh.elements.size(), chunk_size, [&](int begin, int end) {
+        for (int index = begin; index < end; ++index) {
+            ConstElement3Ref element =
+                mesh.elements[ElementId::from_int(element_begin + index)];
+            const ElementTypeShape &shape = element_type_shape(element.type);
+            for (int face = 0; face < static_cast<int>(shape.faces.size());
+                    ++face) {
+                int lowest = -1;
+                for (int vertex : shape.faces[face].vertices) {
+                    int node = element.nodes[vertex].to_int() - node_begin;
+                    if (lowest == -1 || node < lowest) {
+                        lowest = node;
+                    }
+                }
+                lowest_nodes[index * slots_per_element + face] = lowest;
+            }
+        }
+    });
+
+    std::vector<int> bucket_begins(mesh.nodes.size() + 1, 0);
+    for (int lowest : lowest_nodes) {
+        if (lowest != -1) {
+            ++bucket_begins[lowest + 1];
+        }
+    }
+    for (int node = 0; node < mesh.nodes.size(); ++node) {
+        bucket_begins[node + 1] += bucket_begins[node];
+    }
+    std::vector<int> bucket_slots(bucket_begins.back());
+    {
+        std::vector<int> next(bucket_begins.begin(), bucket_begins.end() - 1);
+        for (int slot = 0; slot < num_slots; ++slot) {
+            if (lowest_nodes[slot] != -1) {
+                bucket_slots[next[lowest_nodes[slot]]++] = slot;
+            }
+        }
+    }
+    std::vector<int>().swap(lowest_nodes);
 
     matching_faces = ContiguousMap<FaceId, FaceId>(
         FaceId { mesh.elements.key_begin(), 0 },
@@ -96,19 +126,153 @@ Mesh3Index::Mesh3Index(const Mesh3 &mesh) {
         FaceId::invalid()
     );
 
-    for (auto it = map.begin(); it != map.end(); ++it) {
-        FaceId *result = &matching_faces[it->second];
-        FaceNodes key = it->first;
-        key.reverse();
-        auto jt = map.find(key);
-        if (jt == map.end()) {
-            *result = FaceId::invalid();
-            unmatched_faces.push_back(it->second);
-        } else {
-            *result = jt->second;
+    parallel_for(mesh.nodes.size(), chunk_size, [&](int begin, int end) {
+        std::vector<FaceNodes> keys, reversed_keys;
+        for (int node = begin; node < end; ++node) {
+            const int *slots = &bucket_slots[bucket_begins[node]];
+            int bucket_size = bucket_begins[node + 1] - bucket_begins[node];
+            keys.clear();
+            reversed_keys.clear();
+            for (int i = 0; i < bucket_size; ++i) {
+                FaceId face_id = slot_face_id(slots[i]);
+                keys.push_back(FaceNodes::make(
+                    mesh.elements[face_id.element_id], face_id.face));
+                reversed_keys.push_back(keys.back());
+                reversed_keys.back().reverse();
+            }
+            for (int i = 0; i < bucket_size; ++i) {
+                for (int j = 0; j < bucket_size; ++j) {
+                    if (j == i) continue;
+                    /* This would fail if some faces were non-unique, i.e. if
+                    two elements shared a certain face *from the same side*. */
+                    assert(!(keys[i] == keys[j]));
+                    if (keys[i] == reversed_keys[j]) {
+                        matching_faces[slot_face_id(slots[i])] =
+                            slot_face_id(slots[j]);
+                    }
+                }
+            }
+        }
+    });
+
+    for (ElementId element_id = mesh.elements.key_begin();
+            element_id != mesh.elements.key_end(); ++element_id) {
+        const ElementTypeShape &shape =
+            element_type_shape(mesh.elements[element_id].type);
+        for (int face = 0; face < static_cast<int>(shape.faces.size());
+                ++face) {
+            if (matching_faces[FaceId(element_id, face)] == FaceId::invalid()) {
+                unmatched_faces.push_back(FaceId(element_id, face));
+            }
         }
     }
 }
 
-} /* namespace os2cx */
+/* Fills in a node-to-ID adjacency table for 'num_nodes' nodes, in parallel.
+'visit(element_index, emit)' must call 'emit(node_index, id)' for every node
+index and ID that element number 'element_index' contributes. */
+template<class Id, class Visit>
+static void build_adjacency(
+    int num_nodes,
+    int num_elements,
+    const Visit &visit,
+    std::vector<int> *begins_out,
+    std::vector<Id> *ids_out
+) {
+    static const int chunk_size = 1024;
+    std::unique_ptr<std::atomic<int>[]> counts(
+        new std::atomic<int>[num_nodes]());
+    parallel_for(num_elements, chunk_size, [&](int begin, int end) {
+        for (int index = begin; index < end; ++index) {
+            visit(index, [&](int node, Id) {
+                counts[node].fetch_add(1, std::memory_order_relaxed);
+            });
+        }
+    });
+
+    /* Turn the counts into the start of each node's row, and then reuse them
+    as the next free position in the row */
+    begins_out->resize(num_nodes + 1);
+    (*begins_out)[0] = 0;
+    for (int node = 0; node < num_nodes; ++node) {
+        int count = counts[node].load(std::memory_order_relaxed);
+        (*begins_out)[node + 1] = (*begins_out)[node] + count;
+        counts[node].store((*begins_out)[node], std::memory_order_relaxed);
+    }
+
+    ids_out->resize(begins_out->back());
+    parallel_for(num_elements, chunk_size, [&](int begin, int end) {
+        for (int index = begin; index < end; ++index) {
+            visit(index, [&](int node, Id id) {
+                int position =
+                    counts[node].fetch_add(1, std::memory_order_relaxed);
+                (*ids_out)[position] = id;
+            });
+        }
+    });
 
+    /* The order within each row depends on how the threads were scheduled, so
+    sort the rows to make it deterministic */
+    parallel_for(num_nodes, chunk_size, [&](int begin, int end) {
+        for (int node = begin; node < end; ++node) {
+            std::sort(ids_out->begin() + (*begins_out)[node],
+                ids_out->begin() + (*begins_out)[node + 1]);
+        }
+    });
+}
+
+Mesh3Index::Range<ElementId> Mesh3Index::node_elements(NodeId node) const {
+    const Mesh3 &mesh = *indexed_mesh;
+    int node_begin = mesh.nodes.key_begin().to_int();
+    std::call_once(node_elements_once, [&]() {
+        int element_begin = mesh.elements.key_begin().to_int();
+        build_adjacency<ElementId>(
+            mesh.nodes.size(),
+            mesh.elements.size(),
+            [&](int index, const auto &emit) {
+                ElementId element_id =
+                    ElementId::from_int(element_begin + index);
+                ConstElement3Ref element = mesh.elements[element_id];
+                for (int i = 0; i < element.num_nodes(); ++i) {
+                    emit(element.nodes[i].to_int() - node_begin, element_id);
+                }
+            },
+            &node_elements_adjacency.begins,
+            &node_elements_adjacency.ids);
+    });
+    assert(node.to_int() - node_begin <
+        static_cast<int>(node_elements_adjacency.begins.size()) - 1);
+    return node_elements_adjacency[node.to_int() - node_begin];
+}
+
+Mesh3Index::Range<FaceId> Mesh3Index::node_faces(NodeId node) const {
+    const Mesh3 &mesh = *indexed_mesh;
+    int node_begin = mesh.nodes.key_begin().to_int();
+    std::call_once(node_faces_once, [&]() {
+        int element_begin = mesh.elements.key_begin().to_int();
+        build_adjacency<FaceId>(
+            mesh.nodes.size(),
+            mesh.elements.size(),
+            [&](int index, const auto &emit) {
+                ElementId element_id =
+                    ElementId::from_int(element_begin + index);
+                ConstElement3Ref element = mesh.elements[element_id];
+                const ElementTypeShape &shape =
+                    element_type_shape(element.type);
+                for (int face = 0;
+                        face < static_cast<int>(shape.faces.size()); ++face) {
+                    for (int vertex : shape.faces[face].vertices) {
+                        emit(element.nodes[vertex].to_int() - node_begin,
+                            FaceId(element_id, face));
+                    }
+                }
+            },
+            &node_faces_adjacency.begins,
+            &node_faces_adjacency.ids);
+    });
+    assert(node.to_int() - node_begin <
+        static_cast<int>(node_faces_adjacency.begins.size()) - 1);
+    return node_faces_adjacency[node.to_int() - node_begin];
+}
+
+} /* namespace os2cx */
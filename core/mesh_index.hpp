@@ -1,6 +1,8 @@
 #ifndef OS2CX_MESH_INDEX_HPP_
 #define OS2CX_MESH_INDEX_HPP_
 
+#include <mutex>
+
 #include "mesh.hpp"
 #include "mesh_type_info.hpp"
 
@@ -8,6 +10,8 @@ namespace os2cx {
 
 class Mesh3Index {
 public:
+    /* 'mesh' must outlive the index and must not be modified while the index
+    is in use, since node_elements() and node_faces() read it lazily */
     Mesh3Index(const Mesh3 &mesh);
 
     /* If face 'face' of element 'el' is directly face-to-face with some face of
@@ -17,10 +21,50 @@ public:
         return matching_faces[face];
     }
 
+    template<class Id>
+    class Range {
+    public:
+        Range(const Id *b, const Id *e) : first(b), last(e) { }
+        const Id *begin() const { return first; }
+        const Id *end() const { return last; }
+        int size() const { return last - first; }
+    private:
+        const Id *first, *last;
+    };
+
+    /* Returns the elements that have 'node' as a vertex, in increasing order.
+    The node-to-element adjacency is built in parallel the first time this is
+    called, and then reused. */
+    Range<ElementId> node_elements(NodeId node) const;
+
+    /* Returns the faces that have 'node' as a vertex, in increasing order. The
+    node-to-face adjacency is built separately from the node-to-element
+    adjacency, the first time this is called. */
+    Range<FaceId> node_faces(NodeId node) const;
+
     std::vector<FaceId> unmatched_faces;
 
 private:
+    /* A compressed sparse row table: the IDs for node 'n' are
+    ids[begins[n - node_begin]] through ids[begins[n - node_begin + 1]] */
+    template<class Id>
+    class Adjacency {
+    public:
+        Range<Id> operator[](int index) const {
+            return Range<Id>(
+                ids.data() + begins[index], ids.data() + begins[index + 1]);
+        }
+        std::vector<int> begins;
+        std::vector<Id> ids;
+    };
+
+    const Mesh3 *indexed_mesh;
     ContiguousMap<FaceId, FaceId> matching_faces;
+
+    mutable std::once_flag node_elements_once;
+    mutable Adjacency<ElementId> node_elements_adjacency;
+    mutable std::once_flag node_faces_once;
+    mutable Adjacency<FaceId> node_faces_adjacency;
 };
 
 } /* namespace os2cx */
@@ -0,0 +1,553 @@
+#include "mesh_optimize.hpp"
+
+#include <algorithm>
+#include <array>
+#include <map>
+
+#include "mesh_quality.hpp"
+#include "parallel.hpp"
+
+namespace os2cx {
+
+/* The corners of each face of a C3D4 element, counterclockwise from outside;
+the corner opposite each face; and the corners at the ends of each edge. Edge
+'i' of a C3D10 element has its midside node at vertex 4+i. */
+static const int tet_faces[4][3] = {{0, 2, 1}, {0, 1, 3}, {1, 2, 3}, {0, 3, 2}};
+static const int tet_face_opposite[4] = {3, 2, 0, 1};
+static const int tet_edges[6][2] = {
+    {0, 1}, {1, 2}, {2, 0}, {0, 3}, {1, 3}, {2, 3}};
+
+/* Flips are only attempted around elements with a worse radius ratio than
+this; better elements aren't worth the search. */
+static const double flip_radius_ratio_threshold = 0.4;
+
+/* A flip or a move must improve the worst affected element by at least this
+much, so that the passes can't cycle. */
+static const double min_improvement = 1e-6;
+
+class OptimizerTet {
+public:
+    int corners[4];
+    AttrBitset attrs;
+    AttrBitset face_attrs[4];
+    bool alive;
+};
+
+/* transfer_attrs() gives every face that isn't on a surface of the Plc3 the
+attrs of its element, so that's what a plain interior face looks like */
+static bool is_interior_face(const OptimizerTet &tet, int face) {
+    return tet.face_attrs[face] == tet.attrs;
+}
+
+/* Identifies a face together with its orientation, by rotating its corners so
+the smallest comes first. The two elements sharing a face see it with opposite
+orientations, so this tells them apart. */
+typedef std::array<int, 3> OrientedFace;
+static OrientedFace make_oriented_face(int a, int b, int c) {
+    if (a < b && a < c) return {{a, b, c}};
+    if (b < c) return {{b, c, a}};
+    return {{c, a, b}};
+}
+
+/* Returns true if the corners of a tetrahedron, listed in the order
+(c[i[0]], c[i[1]], c[i[2]], c[i[3]]), are an even permutation of c. */
+static bool is_even_permutation(const int i[4]) {
+    int inversions = 0;
+    for (int j = 0; j < 4; ++j) {
+        for (int k = j + 1; k < 4; ++k) {
+            if (i[j] > i[k]) ++inversions;
+        }
+    }
+    return inversions % 2 == 0;
+}
+
+class TetMeshOptimizer {
+public:
+    std::vector<Point> points;
+    std::vector<bool> movable;
+    std::vector<OptimizerTet> tets;
+
+    /* The indices of the live tets that each point is a corner of */
+    std::vector<std::vector<int> > point_tets;
+
+    void init(const std::vector<AttrBitset> &point_attrs) {
+        point_tets.assign(points.size(), std::vector<int>());
+        for (int t = 0; t < static_cast<int>(tets.size()); ++t) {
+            for (int corner : tets[t].corners) {
+                point_tets[corner].push_back(t);
+            }
+        }
+        compute_movable(point_attrs);
+    }
+
+    /* Tries every flip around every sliver once. Returns how many flips were
+    made. */
+    int flip_pass() {
+        int num_flips = 0;
+        for (int t = 0; t < static_cast<int>(tets.size()); ++t) {
+            if (!tets[t].alive ||
+                    quality(tets[t].corners) >= flip_radius_ratio_threshold) {
+                continue;
+            }
+            bool flipped = false;
+            for (int f = 0; f < 4 && !flipped; ++f) {
+                flipped = try_flip_23(t, f);
+            }
+            for (int e = 0; e < 6 && !flipped; ++e) {
+                flipped = try_flip_32(t, e);
+            }
+            if (flipped) ++num_flips;
+        }
+        return num_flips;
+    }
+
+    /* Moves every movable point once. Returns how many points moved. */
+    int smooth_pass() {
+        /* Points that share an element can't move at the same time, because
+        each one's move depends on the other's position. So color the points
+        such that no two neighbors have the same color, and move one color
+        at a time. */
+        std::vector<std::vector<int> > color_groups;
+        std::vector<int> colors(points.size(), -1);
+        std::vector<bool> neighbor_colors;
+        for (int p = 0; p < static_cast<int>(points.size()); ++p) {
+            if (!movable[p]) continue;
+            neighbor_colors.assign(color_groups.size() + 1, false);
+            for (int t : point_tets[p]) {
+                for (int corner : tets[t].corners) {
+                    if (colors[corner] != -1) {
+                        neighbor_colors[colors[corner]] = true;
+                    }
+                }
+            }
+            int color = 0;
+            while (neighbor_colors[color]) ++color;
+            if (color == static_cast<int>(color_groups.size())) {
+                color_groups.push_back(std::vector<int>());
+            }
+            color_groups[color].push_back(p);
+            colors[p] = color;
+        }
+
+        static const int chunk_size = 256;
+        std::vector<char> moved(points.size(), false);
+        for (const std::vector<int> &group : color_groups) {
+            parallel_for(group.size(), chunk_size, [&](int begin, int end) {
+                for (int i = begin; i < end; ++i) {
+                    moved[group[i]] = smooth_point(group[i]);
+                }
+            });
+        }
+        return std::count(moved.begin(), moved.end(), true);
+    }
+
+private:
+    double quality(const int corners[4]) const {
+        return tetrahedron_radius_ratio(
+            points[corners[0]], points[corners[1]],
+            points[corners[2]], points[corners[3]]);
+    }
+
+    /* Returns the quality of tet 't' if point 'p' were moved to 'moved_to' */
+    double quality_with(int t, int p, Point moved_to) const {
+        Point corners[4];
+        for (int i = 0; i < 4; ++i) {
+            int corner = tets[t].corners[i];
+            corners[i] = (corner == p) ? moved_to : points[corner];
+        }
+        return tetrahedron_radius_ratio(
+            corners[0], corners[1], corners[2], corners[3]);
+    }
+
+    /* A point may move unless it has attrs of its own, or it's on a face that
+    isn't shared by two elements with the same attrs whose face attrs are just
+    the element attrs. */
+    void compute_movable(const std::vector<AttrBitset> &point_attrs) {
+        class FaceRecord {
+        public:
+            std::array<int, 3> sorted_corners;
+            int tet, face;
+        };
+        std::vector<FaceRecord> records;
+        records.reserve(4 * tets.size());
+        for (int t = 0; t < static_cast<int>(tets.size()); ++t) {
+            for (int f = 0; f < 4; ++f) {
+                FaceRecord record;
+                for (int i = 0; i < 3; ++i) {
+                    record.sorted_corners[i] =
+                        tets[t].corners[tet_faces[f][i]];
+                }
+                std::sort(record.sorted_corners.begin(),
+                    record.sorted_corners.end());
+                record.tet = t;
+                record.face = f;
+                records.push_back(record);
+            }
+        }
+        std::sort(records.begin(), records.end(),
+            [](const FaceRecord &a, const FaceRecord &b) {
+                return a.sorted_corners < b.sorted_corners;
+            });
+
+        movable.assign(points.size(), false);
+        for (int p = 0; p < static_cast<int>(points.size()); ++p) {
+            movable[p] = !point_tets[p].empty() && point_attrs[p].none();
+        }
+        for (int i = 0; i < static_cast<int>(records.size()); ) {
+            int j = i + 1;
+            while (j < static_cast<int>(records.size()) &&
+                    records[j].sorted_corners == records[i].sorted_corners) {
+                ++j;
+            }
+            bool interior = (j - i == 2);
+            for (int k = i; k < j && interior; ++k) {
+                const OptimizerTet &tet = tets[records[k].tet];
+                interior = tet.attrs == tets[records[i].tet].attrs &&
+                    is_interior_face(tet, records[k].face);
+            }
+            if (!interior) {
+                for (int corner : records[i].sorted_corners) {
+                    movable[corner] = false;
+                }
+            }
+            i = j;
+        }
+    }
+
+    /* Moves point 'p' towards the centroid of its neighbors, as far as that
+    improves its worst element. Returns true if it moved. */
+    bool smooth_point(int p) {
+        double worst = HUGE_VAL;
+        LengthVector sum = LengthVector::zero();
+        int count = 0;
+        for (int t : point_tets[p]) {
+            worst = std::min(worst, quality(tets[t].corners));
+            for (int corner : tets[t].corners) {
+                if (corner != p) {
+                    sum += points[corner] - Point::origin();
+                    ++count;
+                }
+            }
+        }
+        Point centroid = Point::origin() + sum / count;
+
+        /* Try the full Laplacian step first, then shorter ones */
+        static const double step_fractions[3] = {1, 0.5, 0.25};
+        for (double step : step_fractions) {
+            Point candidate = points[p] + (centroid - points[p]) * step;
+            double candidate_worst = HUGE_VAL;
+            for (int t : point_tets[p]) {
+                candidate_worst = std::min(candidate_worst,
+                    quality_with(t, p, candidate));
+            }
+            if (candidate_worst > worst + min_improvement) {
+                points[p] = candidate;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void add_tet(int slot, const int corners[4], AttrBitset attrs,
+            const std::map<OrientedFace, AttrBitset> &face_attrs) {
+        OptimizerTet tet;
+        std::copy(corners, corners + 4, tet.corners);
+        tet.attrs = attrs;
+        tet.alive = true;
+        for (int f = 0; f < 4; ++f) {
+            auto it = face_attrs.find(make_oriented_face(
+                corners[tet_faces[f][0]],
+                corners[tet_faces[f][1]],
+                corners[tet_faces[f][2]]));
+            /* Faces that the flip created are interior faces */
+            tet.face_attrs[f] = (it != face_attrs.end()) ? it->second : attrs;
+        }
+        if (slot == -1) {
+            slot = tets.size();
+            tets.push_back(tet);
+        } else {
+            tets[slot] = tet;
+        }
+        for (int i = 0; i < 4; ++i) {
+            point_tets[corners[i]].push_back(slot);
+        }
+    }
+
+    /* Removes the given tets, and returns the attrs of all of their faces so
+    that add_tet() can carry them over to the faces that still exist */
+    std::map<OrientedFace, AttrBitset> remove_tets(
+            const std::vector<int> &to_remove) {
+        std::map<OrientedFace, AttrBitset> face_attrs;
+        for (int t : to_remove) {
+            OptimizerTet *tet = &tets[t];
+            for (int f = 0; f < 4; ++f) {
+                face_attrs[make_oriented_face(
+                    tet->corners[tet_faces[f][0]],
+                    tet->corners[tet_faces[f][1]],
+                    tet->corners[tet_faces[f][2]])] = tet->face_attrs[f];
+            }
+            for (int corner : tet->corners) {
+                std::vector<int> *list = &point_tets[corner];
+                list->erase(std::find(list->begin(), list->end(), t));
+            }
+            tet->alive = false;
+        }
+        return face_attrs;
+    }
+
+    bool has_corner(int t, int p) const {
+        const int *c = tets[t].corners;
+        return c[0] == p || c[1] == p || c[2] == p || c[3] == p;
+    }
+
+    std::vector<int> tets_with_edge(int a, int b) const {
+        std::vector<int> result;
+        for (int t : point_tets[a]) {
+            if (has_corner(t, b)) result.push_back(t);
+        }
+        return result;
+    }
+
+    bool face_exists(int a, int b, int c) const {
+        for (int t : point_tets[a]) {
+            if (has_corner(t, b) && has_corner(t, c)) return true;
+        }
+        return false;
+    }
+
+    /* Replaces tet 't' and its neighbor across face 'f' by three tets around
+    the edge between their apexes */
+    bool try_flip_23(int t, int f) {
+        OptimizerTet tet = tets[t];
+        if (!is_interior_face(tet, f)) return false;
+        int a = tet.corners[tet_faces[f][0]];
+        int b = tet.corners[tet_faces[f][1]];
+        int c = tet.corners[tet_faces[f][2]];
+        int d = tet.corners[tet_face_opposite[f]];
+
+        int u = -1;
+        for (int other : point_tets[a]) {
+            if (other != t && has_corner(other, b) && has_corner(other, c)) {
+                u = other;
+            }
+        }
+        if (u == -1 || tets[u].attrs != tet.attrs) return false;
+        int e = -1;
+        for (int uf = 0; uf < 4; ++uf) {
+            int opposite = tets[u].corners[tet_face_opposite[uf]];
+            if (opposite != a && opposite != b && opposite != c) {
+                if (!is_interior_face(tets[u], uf)) return false;
+                e = opposite;
+            }
+        }
+        if (!tets_with_edge(d, e).empty()) return false;
+
+        /* The shared face is counterclockwise seen from 'e', so these are all
+        positively oriented if the two tets form a convex pair */
+        int new_tets[3][4] = {{a, b, d, e}, {b, c, d, e}, {c, a, d, e}};
+        double old_worst = std::min(quality(tet.corners),
+            quality(tets[u].corners));
+        double new_worst = HUGE_VAL;
+        for (const auto &corners : new_tets) {
+            new_worst = std::min(new_worst, quality(corners));
+        }
+        if (new_worst <= old_worst + min_improvement) return false;
+
+        std::map<OrientedFace, AttrBitset> face_attrs = remove_tets({t, u});
+        add_tet(t, new_tets[0], tet.attrs, face_attrs);
+        add_tet(u, new_tets[1], tet.attrs, face_attrs);
+        add_tet(-1, new_tets[2], tet.attrs, face_attrs);
+        return true;
+    }
+
+    /* If edge 'edge' of tet 't' is shared by exactly three tets, replaces them
+    by two tets on either side of the triangle around the edge */
+    bool try_flip_32(int t, int edge) {
+        int d = tets[t].corners[tet_edges[edge][0]];
+        int e = tets[t].corners[tet_edges[edge][1]];
+        std::vector<int> around = tets_with_edge(d, e);
+        if (around.size() != 3) return false;
+
+        /* Write each tet as (x, y, d, e) with positive orientation; then the
+        (x, y) pairs must chain into a ring a -> b -> c -> a */
+        int ring[3][2];
+        for (int i = 0; i < 3; ++i) {
+            const OptimizerTet &other = tets[around[i]];
+            if (other.attrs != tets[t].attrs) return false;
+            int order[4], num_others = 0;
+            for (int j = 0; j < 4; ++j) {
+                if (other.corners[j] == d) {
+                    order[2] = j;
+                } else if (other.corners[j] == e) {
+                    order[3] = j;
+                } else {
+                    order[num_others++] = j;
+                }
+            }
+            if (!is_even_permutation(order)) std::swap(order[0], order[1]);
+            ring[i][0] = other.corners[order[0]];
+            ring[i][1] = other.corners[order[1]];
+            /* The faces around the edge must be plain interior faces */
+            for (int f = 0; f < 4; ++f) {
+                int opposite = other.corners[tet_face_opposite[f]];
+                if (opposite != d && opposite != e &&
+                        !is_interior_face(other, f)) {
+                    return false;
+                }
+            }
+        }
+        int a = ring[0][0], b = ring[0][1], c;
+        if (ring[1][0] == b && ring[2][0] == ring[1][1] && ring[2][1] == a) {
+            c = ring[1][1];
+        } else if (ring[2][0] == b && ring[1][0] == ring[2][1] &&
+                ring[1][1] == a) {
+            c = ring[2][1];
+        } else {
+            return false;
+        }
+        if (face_exists(a, b, c)) return false;
+
+        int new_tets[2][4] = {{a, b, c, e}, {a, c, b, d}};
+        double old_worst = HUGE_VAL;
+        for (int other : around) {
+            old_worst = std::min(old_worst, quality(tets[other].corners));
+        }
+        double new_worst = std::min(
+            quality(new_tets[0]), quality(new_tets[1]));
+        if (new_worst <= old_worst + min_improvement) return false;
+
+        AttrBitset attrs = tets[t].attrs;
+        std::map<OrientedFace, AttrBitset> face_attrs = remove_tets(around);
+        add_tet(around[0], new_tets[0], attrs, face_attrs);
+        add_tet(around[1], new_tets[1], attrs, face_attrs);
+        return true;
+    }
+};
+
+void mesh_optimize(Mesh3 *mesh, int num_passes) {
+    if (mesh->elements.size() == 0) return;
+    ElementType type = mesh->elements[mesh->elements.key_begin()].type;
+    if (type != ElementType::C3D4 && type != ElementType::C3D10) return;
+    for (ConstElement3Ref element : mesh->elements) {
+        if (element.type != type) return;
+    }
+    bool second_order = (type == ElementType::C3D10);
+
+    int node_begin = mesh->nodes.key_begin().to_int();
+    TetMeshOptimizer optimizer;
+    std::vector<AttrBitset> point_attrs;
+    for (const Node3 &node : mesh->nodes) {
+        optimizer.points.push_back(node.point);
+        point_attrs.push_back(node.attrs);
+    }
+
+    /* Remember the midside node of each edge, so that edges that survive keep
+    their node */
+    std::map<std::pair<int, int>, int> edge_nodes;
+    std::vector<bool> used_before(mesh->nodes.size(), false);
+    for (ConstElement3Ref element : mesh->elements) {
+        OptimizerTet tet;
+        for (int i = 0; i < 4; ++i) {
+            tet.corners[i] = element.nodes[i].to_int() - node_begin;
+        }
+        tet.attrs = element.attrs;
+        for (int f = 0; f < 4; ++f) {
+            tet.face_attrs[f] = element.face_attrs[f];
+        }
+        tet.alive = true;
+        optimizer.tets.push_back(tet);
+
+        for (int i = 0; i < element.num_nodes(); ++i) {
+            used_before[element.nodes[i].to_int() - node_begin] = true;
+        }
+        if (second_order) {
+            for (int k = 0; k < 6; ++k) {
+                int p = tet.corners[tet_edges[k][0]];
+                int q = tet.corners[tet_edges[k][1]];
+                edge_nodes[std::make_pair(std::min(p, q), std::max(p, q))] =
+                    element.nodes[4 + k].to_int() - node_begin;
+            }
+        }
+    }
+    optimizer.init(point_attrs);
+
+    for (int pass = 0; pass < num_passes; ++pass) {
+        int num_flips = optimizer.flip_pass();
+        int num_moves = optimizer.smooth_pass();
+        if (num_flips == 0 && num_moves == 0) break;
+    }
+
+    /* Rebuild the elements, creating midside nodes for new edges and moving
+    the midside nodes of edges whose corners moved */
+    std::vector<Node3> nodes(mesh->nodes.begin(), mesh->nodes.end());
+    std::vector<bool> point_moved(nodes.size());
+    for (int i = 0; i < static_cast<int>(nodes.size()); ++i) {
+        point_moved[i] = (optimizer.points[i] != nodes[i].point);
+        nodes[i].point = optimizer.points[i];
+    }
+    std::vector<Element3> elements;
+    for (const OptimizerTet &tet : optimizer.tets) {
+        if (!tet.alive) continue;
+        Element3 element;
+        element.type = type;
+        element.attrs = tet.attrs;
+        for (int f = 0; f < 4; ++f) {
+            element.face_attrs[f] = tet.face_attrs[f];
+        }
+        for (int i = 0; i < 4; ++i) {
+            element.nodes[i] = NodeId::from_int(tet.corners[i]);
+        }
+        if (second_order) {
+            for (int k = 0; k < 6; ++k) {
+                int p = tet.corners[tet_edges[k][0]];
+                int q = tet.corners[tet_edges[k][1]];
+                auto key = std::make_pair(std::min(p, q), std::max(p, q));
+                auto it = edge_nodes.find(key);
+                int edge_node;
+                if (it != edge_nodes.end()) {
+                    edge_node = it->second;
+                } else {
+                    edge_node = nodes.size();
+                    nodes.push_back(Node3());
+                    edge_nodes[key] = edge_node;
+                }
+                if (edge_node >= static_cast<int>(point_moved.size()) ||
+                        point_moved[p] || point_moved[q]) {
+                    nodes[edge_node].point = nodes[p].point +
+                        (nodes[q].point - nodes[p].point) / 2;
+                }
+                element.nodes[4 + k] = NodeId::from_int(edge_node);
+            }
+        }
+        elements.push_back(element);
+    }
+    std::vector<bool> used_after(nodes.size(), false);
+    for (const Element3 &element : elements) {
+        for (int i = 0; i < element.num_nodes(); ++i) {
+            used_after[element.nodes[i].to_int()] = true;
+        }
+    }
+
+    /* Drop the midside nodes of edges that the flips removed, keeping the
+    relative order of the rest */
+    ContiguousMap<NodeId, Node3> new_nodes(mesh->nodes.key_begin());
+    std::vector<NodeId> new_ids(nodes.size(), NodeId::invalid());
+    for (int i = 0; i < static_cast<int>(nodes.size()); ++i) {
+        bool was_used =
+            i < static_cast<int>(used_before.size()) && used_before[i];
+        if (used_after[i] || !was_used) {
+            new_ids[i] = new_nodes.push_back(nodes[i]);
+        }
+    }
+    Element3Store new_elements(mesh->elements.key_begin());
+    for (Element3 &element : elements) {
+        for (int i = 0; i < element.num_nodes(); ++i) {
+            element.nodes[i] = new_ids[element.nodes[i].to_int()];
+        }
+        new_elements.push_back(element);
+    }
+    mesh->nodes = std::move(new_nodes);
+    mesh->elements = std::move(new_elements);
+}
+
+} /* namespace os2cx */
@@ -0,0 +1,26 @@
+#ifndef OS2CX_MESH_OPTIMIZE_HPP_
+#define OS2CX_MESH_OPTIMIZE_HPP_
+
+#include "mesh.hpp"
+
+namespace os2cx {
+
+/* Improves the shape of the elements of a tetrahedral (C3D4 or C3D10) mesh.
+Each pass first tries to remove slivers by 2-3 and 3-2 flips, and then moves
+every interior node to where it most improves its worst neighboring element
+(smart Laplacian smoothing); no move or flip is made that would invert an
+element or make the worst affected element worse.
+
+Following transfer_attrs(), a face counts as interior if its face attrs are
+the same as its element's attrs. Nodes that lie on the boundary of the mesh, on
+an internal surface between elements with different attrs or with other face
+attrs, or that have attrs of their own, are never moved, and no flip ever
+crosses such a surface, so the attrs of the mesh are unaffected. Faces created
+by flips get their element's attrs. Midside nodes of C3D10 elements are kept at
+the midpoints of their edges; flips create and remove midside nodes as needed,
+so the node IDs may change. Meshes with other element types are left alone. */
+void mesh_optimize(Mesh3 *mesh, int num_passes);
+
+} /* namespace os2cx */
+
+#endif /* OS2CX_MESH_OPTIMIZE_HPP_ */
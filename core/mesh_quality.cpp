@@ -0,0 +1,235 @@
+#include "mesh_quality.hpp"
+
+#include <math.h>
+
+#include <algorithm>
+#include <sstream>
+
+#include "parallel.hpp"
+
+namespace os2cx {
+
+/* For each corner of a tetrahedron or brick, the three corners that share an
+edge with it, in the CalculiX vertex numbering */
+static const int tetrahedron_corner_neighbors[4][3] = {
+    {1, 2, 3}, {0, 2, 3}, {0, 1, 3}, {0, 1, 2}
+};
+static const int brick_corner_neighbors[8][3] = {
+    {1, 3, 4}, {0, 2, 5}, {1, 3, 6}, {0, 2, 7},
+    {5, 7, 0}, {4, 6, 1}, {5, 7, 2}, {4, 6, 3}
+};
+static const int wedge_corner_neighbors[6][3] = {
+    {1, 2, 3}, {2, 0, 4}, {0, 1, 5}, {4, 5, 0}, {5, 3, 1}, {3, 4, 2}
+};
+
+static const int num_histogram_bins = 10;
+static const int num_worst_elements = 5;
+
+/* Returns the interior dihedral angle along the edge from the origin to 'e',
+between the faces that also contain 'f' and 'g' respectively. */
+static double dihedral_angle(Vector e, Vector f, Vector g) {
+    double e_sq = e.dot(e);
+    Vector f_perp = f - e * (f.dot(e) / e_sq);
+    Vector g_perp = g - e * (g.dot(e) / e_sq);
+    double cos_angle = f_perp.dot(g_perp) /
+        sqrt(f_perp.dot(f_perp) * g_perp.dot(g_perp));
+    return acos(std::max(-1.0, std::min(1.0, cos_angle)));
+}
+
+double tetrahedron_radius_ratio(
+    Point a, Point b_point, Point c_point, Point d_point
+) {
+    Vector b = b_point - a, c = c_point - a, d = d_point - a;
+    double triple = b.dot(c.cross(d));
+    if (triple == 0) {
+        return 0;
+    }
+    double area = (b.cross(c).magnitude() + c.cross(d).magnitude()
+        + d.cross(b).magnitude() + (c - b).cross(d - b).magnitude()) / 2;
+    double inradius = triple / 2 / area;
+    Vector circumcenter = (c.cross(d) * b.dot(b) + d.cross(b) * c.dot(c)
+        + b.cross(c) * d.dot(d)) / (2 * triple);
+    return 3 * inradius / circumcenter.magnitude();
+}
+
+static ElementQuality compute_element_quality(
+    const Mesh3 &mesh,
+    ConstElement3Ref element
+) {
+    const ElementTypeShape &shape = element_type_shape(element.type);
+    ElementQuality quality;
+
+    int num_corners;
+    const int (*neighbors)[3];
+    if (shape.category == ElementTypeShape::Category::Tetrahedron) {
+        num_corners = 4;
+        neighbors = tetrahedron_corner_neighbors;
+        quality.radius_ratio = tetrahedron_radius_ratio(
+            mesh.nodes[element.nodes[0]].point,
+            mesh.nodes[element.nodes[1]].point,
+            mesh.nodes[element.nodes[2]].point,
+            mesh.nodes[element.nodes[3]].point);
+    } else if (shape.category == ElementTypeShape::Category::Wedge) {
+        num_corners = 6;
+        neighbors = wedge_corner_neighbors;
+        quality.radius_ratio = NAN;
+    } else {
+        num_corners = 8;
+        neighbors = brick_corner_neighbors;
+        quality.radius_ratio = NAN;
+    }
+
+    quality.min_dihedral_angle = M_PI;
+    for (int i = 0; i < num_corners; ++i) {
+        Point corner = mesh.nodes[element.nodes[i]].point;
+        Vector edges[3];
+        for (int j = 0; j < 3; ++j) {
+            edges[j] = mesh.nodes[element.nodes[neighbors[i][j]]].point
+                - corner;
+        }
+        for (int j = 0; j < 3; ++j) {
+            quality.min_dihedral_angle = std::min(
+                quality.min_dihedral_angle,
+                dihedral_angle(edges[j], edges[(j+1)%3], edges[(j+2)%3]));
+        }
+    }
+
+    int num_nodes = shape.vertices.size();
+    ElementTypeShape::ShapeVector sf_d_uvw[
+        ElementTypeShape::max_vertices_per_element];
+    double min_det = HUGE_VAL, max_det = -HUGE_VAL;
+    for (const ElementTypeShape::IntegrationPoint &ip :
+            shape.volume_integration_points) {
+        shape.shape_function_derivatives(ip.uvw, sf_d_uvw);
+        Matrix jacobian = Matrix::zero();
+        for (int i = 0; i < num_nodes; ++i) {
+            Vector point = mesh.nodes[element.nodes[i]].point
+                - Point::origin();
+            jacobian.cols[0] += point * sf_d_uvw[i].x;
+            jacobian.cols[1] += point * sf_d_uvw[i].y;
+            jacobian.cols[2] += point * sf_d_uvw[i].z;
+        }
+        double det = jacobian.determinant();
+        min_det = std::min(min_det, det);
+        max_det = std::max(max_det, det);
+    }
+    if (max_det > 0) {
+        quality.jacobian_ratio = min_det / max_det;
+    } else {
+        /* Every integration point is inverted */
+        quality.jacobian_ratio = -1;
+    }
+
+    return quality;
+}
+
+static MeshQualityMetric summarize_metric(
+    const ContiguousMap<ElementId, ElementQuality> &elements,
+    double ElementQuality::*member,
+    double range_min,
+    double range_max
+) {
+    MeshQualityMetric metric;
+    metric.range_min = range_min;
+    metric.range_max = range_max;
+    metric.histogram.assign(num_histogram_bins, 0);
+    metric.count = 0;
+    metric.min_value = NAN;
+    metric.mean_value = NAN;
+
+    std::vector<std::pair<double, ElementId> > values;
+    double sum = 0;
+    for (ElementId eid = elements.key_begin();
+            eid != elements.key_end(); ++eid) {
+        double value = elements[eid].*member;
+        if (std::isnan(value)) continue;
+        values.push_back(std::make_pair(value, eid));
+        sum += value;
+        int bin = static_cast<int>(floor(num_histogram_bins *
+            (value - range_min) / (range_max - range_min)));
+        bin = std::max(0, std::min(num_histogram_bins - 1, bin));
+        ++metric.histogram[bin];
+    }
+    metric.count = values.size();
+    if (values.empty()) {
+        return metric;
+    }
+    metric.mean_value = sum / metric.count;
+
+    int num_worst = std::min(num_worst_elements, metric.count);
+    std::partial_sort(values.begin(), values.begin() + num_worst, values.end(),
+        [](const std::pair<double, ElementId> &a,
+                const std::pair<double, ElementId> &b) {
+            return a.first < b.first;
+        });
+    metric.min_value = values[0].first;
+    for (int i = 0; i < num_worst; ++i) {
+        metric.worst_elements.push_back(values[i].second);
+    }
+    return metric;
+}
+
+static void describe_metric(
+    const std::string &name,
+    const MeshQualityMetric &metric,
+    double display_scale,
+    std::vector<std::string> *lines_out
+) {
+    if (metric.count == 0) {
+        return;
+    }
+    std::stringstream summary;
+    summary << name << ": min " << metric.min_value * display_scale
+        << ", mean " << metric.mean_value * display_scale
+        << "; worst elements";
+    for (ElementId eid : metric.worst_elements) {
+        summary << " " << eid.to_int();
+    }
+    lines_out->push_back(summary.str());
+
+    std::stringstream histogram;
+    histogram << "  ";
+    int num_bins = metric.histogram.size();
+    for (int i = 0; i < num_bins; ++i) {
+        double bin_min = metric.range_min +
+            (metric.range_max - metric.range_min) * i / num_bins;
+        histogram << (i == 0 ? "" : " | ") << bin_min * display_scale
+            << "+: " << metric.histogram[i];
+    }
+    lines_out->push_back(histogram.str());
+}
+
+std::vector<std::string> MeshQuality::describe() const {
+    std::vector<std::string> lines;
+    describe_metric("Radius ratio", radius_ratio, 1, &lines);
+    describe_metric("Min dihedral angle (degrees)", min_dihedral_angle,
+        180 / M_PI, &lines);
+    describe_metric("Jacobian ratio", jacobian_ratio, 1, &lines);
+    return lines;
+}
+
+MeshQuality compute_mesh_quality(const Mesh3 &mesh) {
+    MeshQuality quality;
+    quality.elements = ContiguousMap<ElementId, ElementQuality>(
+        mesh.elements.key_begin(), mesh.elements.key_end(), ElementQuality());
+
+    static const int chunk_size = 1024;
+    int begin_index = mesh.elements.key_begin().to_int();
+    parallel_for(mesh.elements.size(), chunk_size, [&](int begin, int end) {
+        for (int index = begin; index < end; ++index) {
+            ElementId element_id = ElementId::from_int(begin_index + index);
+            quality.elements[element_id] =
+                compute_element_quality(mesh, mesh.elements[element_id]);
+        }
+    });
+
+    quality.radius_ratio = summarize_metric(
+        quality.elements, &ElementQuality::radius_ratio, 0, 1);
+    quality.min_dihedral_angle = summarize_metric(
+        quality.elements, &ElementQuality::min_dihedral_angle, 0, M_PI / 2);
+    quality.jacobian_ratio = summarize_metric(
+        quality.elements, &ElementQuality::jacobian_ratio, 0, 1);
+    return quality;
+}
+
+} /* namespace os2cx */
@@ -0,0 +1,72 @@
+#ifndef OS2CX_MESH_QUALITY_HPP_
+#define OS2CX_MESH_QUALITY_HPP_
+
+#include <string>
+#include <vector>
+
+#include "mesh.hpp"
+
+namespace os2cx {
+
+class ElementQuality {
+public:
+    /* Three times the inradius divided by the circumradius of the element's
+    corners: 1 for a regular tetrahedron, approaching 0 as it flattens into a
+    sliver, and negative if it's inverted. It's only defined for tetrahedra;
+    for bricks it's NAN. */
+    double radius_ratio;
+
+    /* The smallest interior angle, in radians, between two faces that meet at
+    an edge, measured at the corners. A cube has 90 degrees everywhere and a
+    regular tetrahedron about 70.5 degrees. */
+    double min_dihedral_angle;
+
+    /* The smallest Jacobian determinant over the element's volume integration
+    points, divided by the largest. 1 for an undistorted element; zero or
+    negative if the element is folded over itself. */
+    double jacobian_ratio;
+};
+
+/* Summarizes one ElementQuality metric over the whole mesh. For all three
+metrics, larger values are better. */
+class MeshQualityMetric {
+public:
+    /* histogram[i] counts the elements whose value lies in the i'th of
+    histogram.size() equal bins spanning [range_min, range_max]. Values outside
+    of the range are counted in the first or last bin. */
+    double range_min, range_max;
+    std::vector<int> histogram;
+
+    /* Number of elements for which the metric is defined */
+    int count;
+
+    double min_value;
+    double mean_value;
+
+    /* The elements with the smallest values, worst first */
+    std::vector<ElementId> worst_elements;
+};
+
+class MeshQuality {
+public:
+    ContiguousMap<ElementId, ElementQuality> elements;
+
+    MeshQualityMetric radius_ratio;
+    MeshQualityMetric min_dihedral_angle;
+    MeshQualityMetric jacobian_ratio;
+
+    /* Returns a human-readable summary, one line per entry */
+    std::vector<std::string> describe() const;
+};
+
+/* Returns the radius ratio (see ElementQuality) of the tetrahedron with the
+given corners, in the same order as a C3D4 element's vertices. */
+double tetrahedron_radius_ratio(Point a, Point b, Point c, Point d);
+
+/* Computes the quality metrics of every element in the mesh. This is cheap
+compared to meshing, so it's done for every mesh. */
+MeshQuality compute_mesh_quality(const Mesh3 &mesh);
+
+} /* namespace os2cx */
+
+#endif /* OS2CX_MESH_QUALITY_HPP_ */
@@ -0,0 +1,435 @@
+#include "mesh_renumber.hpp"
+
+#include <math.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace os2cx {
+
+/* Hilbert keys are computed on a grid of this many bits per axis, so that a
+key fits in 64 bits */
+static const int hilbert_bits = 21;
+
+/* The search for a peripheral node to start the Cuthill-McKee ordering from
+usually converges after two or three steps; this bounds it */
+static const int max_peripheral_node_steps = 5;
+
+RenumberMethod renumber_method_from_string(const std::string &str) {
+    if (str == "none") return RenumberMethod::None;
+    if (str == "rcm") return RenumberMethod::ReverseCuthillMcKee;
+    if (str == "hilbert") return RenumberMethod::Hilbert;
+    throw std::domain_error("no such renumbering method: " + str);
+}
+
+MeshRenumbering MeshRenumbering::identity(const Mesh3 &mesh) {
+    MeshRenumbering renumbering;
+    renumbering.nodes = ContiguousMap<NodeId, NodeId>(
+        mesh.nodes.key_begin(), mesh.nodes.key_end(), NodeId::invalid());
+    for (NodeId nid = mesh.nodes.key_begin(); nid != mesh.nodes.key_end();
+            ++nid) {
+        renumbering.nodes[nid] = nid;
+    }
+    renumbering.elements = ContiguousMap<ElementId, ElementId>(
+        mesh.elements.key_begin(), mesh.elements.key_end(),
+        ElementId::invalid());
+    for (ElementId eid = mesh.elements.key_begin();
+            eid != mesh.elements.key_end(); ++eid) {
+        renumbering.elements[eid] = eid;
+    }
+    return renumbering;
+}
+
+/* The nodes in the range, indexed from zero, and the elements that each one
+belongs to. Two nodes are neighbors if they share an element. */
+class NodeGraph {
+public:
+    NodeGraph(
+        const Mesh3 &m,
+        NodeId nb,
+        NodeId ne,
+        ElementId eb,
+        ElementId ee
+    ) : mesh(m), node_begin(nb), element_begin(eb) {
+        int num_nodes = ne.to_int() - nb.to_int();
+        offsets.assign(num_nodes + 1, 0);
+        for (ElementId eid = eb; eid != ee; ++eid) {
+            ConstElement3Ref element = mesh.elements[eid];
+            for (int i = 0; i < element.num_nodes(); ++i) {
+                ++offsets[node_index(element.nodes[i]) + 1];
+            }
+        }
+        for (int i = 0; i < num_nodes; ++i) {
+            offsets[i + 1] += offsets[i];
+        }
+        incidence.resize(offsets[num_nodes]);
+        std::vector<int> fill(offsets.begin(), offsets.end() - 1);
+        for (ElementId eid = eb; eid != ee; ++eid) {
+            ConstElement3Ref element = mesh.elements[eid];
+            for (int i = 0; i < element.num_nodes(); ++i) {
+                int index = node_index(element.nodes[i]);
+                incidence[fill[index]++] = eid.to_int() - eb.to_int();
+            }
+        }
+    }
+
+    int num_nodes() const { return offsets.size() - 1; }
+
+    int node_index(NodeId node_id) const {
+        int index = node_id.to_int() - node_begin.to_int();
+        assert(index >= 0 && index < num_nodes());
+        return index;
+    }
+
+    /* The number of elements that the node belongs to; this stands in for
+    the number of neighbors, which is more expensive to count */
+    int degree(int node) const {
+        return offsets[node + 1] - offsets[node];
+    }
+
+    template<class Callback>
+    void for_each_neighbor(int node, const Callback &callback) const {
+        for (int k = offsets[node]; k < offsets[node + 1]; ++k) {
+            ConstElement3Ref element = mesh.elements[
+                ElementId::from_int(element_begin.to_int() + incidence[k])];
+            for (int i = 0; i < element.num_nodes(); ++i) {
+                int neighbor = node_index(element.nodes[i]);
+                if (neighbor != node) {
+                    callback(neighbor);
+                }
+            }
+        }
+    }
+
+private:
+    const Mesh3 &mesh;
+    NodeId node_begin;
+    ElementId element_begin;
+    std::vector<int> offsets;
+    std::vector<int> incidence;
+};
+
+/* Visits the nodes connected to 'start' in breadth-first order, marking each
+with 'stamp' and appending it to 'order_out'. If 'by_degree' is set, the new
+neighbors of each node are visited in order of increasing degree, as
+Cuthill-McKee requires. Returns the number of levels, and sets
+'last_level_begin_out' to the index in 'order_out' where the last one begins.
+*/
+static int breadth_first(
+    const NodeGraph &graph,
+    int start,
+    bool by_degree,
+    int stamp,
+    std::vector<int> *stamps,
+    std::vector<int> *order_out,
+    int *last_level_begin_out
+) {
+    (*stamps)[start] = stamp;
+    order_out->push_back(start);
+    int level_begin = order_out->size() - 1, level_end = order_out->size();
+    int num_levels = 0;
+    std::vector<int> discovered;
+    while (level_begin != level_end) {
+        *last_level_begin_out = level_begin;
+        ++num_levels;
+        for (int i = level_begin; i < level_end; ++i) {
+            discovered.clear();
+            graph.for_each_neighbor((*order_out)[i], [&](int neighbor) {
+                if ((*stamps)[neighbor] != stamp) {
+                    (*stamps)[neighbor] = stamp;
+                    discovered.push_back(neighbor);
+                }
+            });
+            if (by_degree) {
+                std::stable_sort(discovered.begin(), discovered.end(),
+                    [&](int a, int b) {
+                        return graph.degree(a) < graph.degree(b);
+                    });
+            }
+            order_out->insert(
+                order_out->end(), discovered.begin(), discovered.end());
+        }
+        level_begin = level_end;
+        level_end = order_out->size();
+    }
+    return num_levels;
+}
+
+static std::vector<int> order_nodes_reverse_cuthill_mckee(
+    const NodeGraph &graph
+) {
+    int num_nodes = graph.num_nodes();
+    std::vector<int> stamps(num_nodes, 0);
+    std::vector<bool> placed(num_nodes, false);
+    int next_stamp = 1;
+    std::vector<int> order;
+    order.reserve(num_nodes);
+    std::vector<int> levels;
+    for (int seed = 0; seed < num_nodes; ++seed) {
+        if (placed[seed]) continue;
+
+        /* Look for a node that's as far as possible from the rest of its
+        component, by repeatedly jumping to the lowest-degree node of the last
+        level, as long as that makes the search deeper */
+        int start = seed;
+        int depth = 0;
+        int last_level_begin;
+        for (int step = 0; step < max_peripheral_node_steps; ++step) {
+            levels.clear();
+            int new_depth = breadth_first(graph, start, false, next_stamp++,
+                &stamps, &levels, &last_level_begin);
+            if (step != 0 && new_depth <= depth) break;
+            depth = new_depth;
+            int candidate = levels[last_level_begin];
+            for (int i = last_level_begin; i < static_cast<int>(levels.size());
+                    ++i) {
+                if (graph.degree(levels[i]) < graph.degree(candidate)) {
+                    candidate = levels[i];
+                }
+            }
+            if (candidate == start) break;
+            start = candidate;
+        }
+
+        int component_begin = order.size();
+        breadth_first(graph, start, true, next_stamp++, &stamps, &order,
+            &last_level_begin);
+        for (int i = component_begin; i < static_cast<int>(order.size());
+                ++i) {
+            placed[order[i]] = true;
+        }
+    }
+    std::reverse(order.begin(), order.end());
+    return order;
+}
+
+/* Returns the index of 'x' along a Hilbert curve through the grid of
+2^hilbert_bits cells per axis, using Skilling's transposition algorithm. */
+static uint64_t hilbert_key(uint32_t x[3]) {
+    uint32_t m = 1u << (hilbert_bits - 1);
+    for (uint32_t q = m; q > 1; q >>= 1) {
+        uint32_t p = q - 1;
+        for (int i = 0; i < 3; ++i) {
+            if (x[i] & q) {
+                x[0] ^= p;
+            } else {
+                uint32_t t = (x[0] ^ x[i]) & p;
+                x[0] ^= t;
+                x[i] ^= t;
+            }
+        }
+    }
+    for (int i = 1; i < 3; ++i) {
+        x[i] ^= x[i - 1];
+    }
+    uint32_t t = 0;
+    for (uint32_t q = m; q > 1; q >>= 1) {
+        if (x[2] & q) t ^= q - 1;
+    }
+    for (int i = 0; i < 3; ++i) {
+        x[i] ^= t;
+    }
+    uint64_t key = 0;
+    for (int b = hilbert_bits - 1; b >= 0; --b) {
+        for (int i = 0; i < 3; ++i) {
+            key = (key << 1) | ((x[i] >> b) & 1);
+        }
+    }
+    return key;
+}
+
+static std::vector<int> order_elements_hilbert(
+    const Mesh3 &mesh,
+    ElementId element_begin,
+    ElementId element_end
+) {
+    int num_elements = element_end.to_int() - element_begin.to_int();
+    std::vector<Point> centers;
+    centers.reserve(num_elements);
+    Point min_corner(HUGE_VAL, HUGE_VAL, HUGE_VAL);
+    Point max_corner(-HUGE_VAL, -HUGE_VAL, -HUGE_VAL);
+    for (ElementId eid = element_begin; eid != element_end; ++eid) {
+        ConstElement3Ref element = mesh.elements[eid];
+        LengthVector sum = LengthVector::zero();
+        for (int i = 0; i < element.num_nodes(); ++i) {
+            sum += mesh.nodes[element.nodes[i]].point - Point::origin();
+        }
+        Point center = Point::origin() + sum / element.num_nodes();
+        for (Dimension d : {Dimension::X, Dimension::Y, Dimension::Z}) {
+            min_corner.set_at(d, std::min(min_corner.at(d), center.at(d)));
+            max_corner.set_at(d, std::max(max_corner.at(d), center.at(d)));
+        }
+        centers.push_back(center);
+    }
+
+    double cells = (1u << hilbert_bits) - 1;
+    std::vector<uint64_t> keys;
+    keys.reserve(num_elements);
+    for (const Point &center : centers) {
+        uint32_t x[3];
+        for (int i = 0; i < 3; ++i) {
+            Dimension d = static_cast<Dimension>(i);
+            double extent = max_corner.at(d) - min_corner.at(d);
+            double fraction = (extent > 0)
+                ? (center.at(d) - min_corner.at(d)) / extent : 0;
+            x[i] = static_cast<uint32_t>(fraction * cells);
+        }
+        keys.push_back(hilbert_key(x));
+    }
+
+    std::vector<int> order(num_elements);
+    for (int i = 0; i < num_elements; ++i) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+        return keys[a] < keys[b];
+    });
+    return order;
+}
+
+void compute_mesh_renumbering(
+    const Mesh3 &mesh,
+    NodeId node_begin,
+    NodeId node_end,
+    ElementId element_begin,
+    ElementId element_end,
+    RenumberMethod method,
+    MeshRenumbering *renumbering
+) {
+    if (method == RenumberMethod::None) return;
+    int num_nodes = node_end.to_int() - node_begin.to_int();
+    int num_elements = element_end.to_int() - element_begin.to_int();
+
+    /* new_node_index[i] is the new position of the i'th node of the range,
+    or -1 if it hasn't been placed yet */
+    std::vector<int> new_node_index(num_nodes, -1);
+    std::vector<int> element_order;
+
+    if (method == RenumberMethod::ReverseCuthillMcKee) {
+        NodeGraph graph(mesh, node_begin, node_end, element_begin, element_end);
+        std::vector<int> node_order = order_nodes_reverse_cuthill_mckee(graph);
+        for (int i = 0; i < num_nodes; ++i) {
+            new_node_index[node_order[i]] = i;
+        }
+
+        /* Order the elements by their first node in the new order, so that
+        they're visited in roughly the same order as their nodes */
+        std::vector<int> first_nodes(num_elements);
+        for (int i = 0; i < num_elements; ++i) {
+            ConstElement3Ref element = mesh.elements[
+                ElementId::from_int(element_begin.to_int() + i)];
+            int first = num_nodes;
+            for (int j = 0; j < element.num_nodes(); ++j) {
+                first = std::min(first, new_node_index[
+                    element.nodes[j].to_int() - node_begin.to_int()]);
+            }
+            first_nodes[i] = first;
+            element_order.push_back(i);
+        }
+        std::stable_sort(element_order.begin(), element_order.end(),
+            [&](int a, int b) { return first_nodes[a] < first_nodes[b]; });
+
+    } else if (method == RenumberMethod::Hilbert) {
+        element_order =
+            order_elements_hilbert(mesh, element_begin, element_end);
+
+        /* Number the nodes in the order that the elements first use them;
+        nodes that no element uses go last */
+        int next = 0;
+        for (int i : element_order) {
+            ConstElement3Ref element = mesh.elements[
+                ElementId::from_int(element_begin.to_int() + i)];
+            for (int j = 0; j < element.num_nodes(); ++j) {
+                int index = element.nodes[j].to_int() - node_begin.to_int();
+                if (new_node_index[index] == -1) {
+                    new_node_index[index] = next++;
+                }
+            }
+        }
+        for (int i = 0; i < num_nodes; ++i) {
+            if (new_node_index[i] == -1) {
+                new_node_index[i] = next++;
+            }
+        }
+
+    } else {
+        assert(false);
+    }
+
+    for (int i = 0; i < num_nodes; ++i) {
+        renumbering->nodes[NodeId::from_int(node_begin.to_int() + i)] =
+            NodeId::from_int(node_begin.to_int() + new_node_index[i]);
+    }
+    for (int i = 0; i < num_elements; ++i) {
+        renumbering->elements[ElementId::from_int(
+            element_begin.to_int() + element_order[i])] =
+            ElementId::from_int(element_begin.to_int() + i);
+    }
+}
+
+void apply_mesh_renumbering(
+    const MeshRenumbering &renumbering,
+    Mesh3 *mesh
+) {
+    ContiguousMap<NodeId, Node3> nodes(
+        mesh->nodes.key_begin(), mesh->nodes.key_end(), Node3());
+    for (NodeId nid = mesh->nodes.key_begin(); nid != mesh->nodes.key_end();
+            ++nid) {
+        nodes[renumbering.nodes[nid]] = mesh->nodes[nid];
+    }
+
+    ContiguousMap<ElementId, ElementId> old_element_ids(
+        mesh->elements.key_begin(), mesh->elements.key_end(),
+        ElementId::invalid());
+    for (ElementId eid = mesh->elements.key_begin();
+            eid != mesh->elements.key_end(); ++eid) {
+        old_element_ids[renumbering.elements[eid]] = eid;
+    }
+    const Element3Store &old_elements = mesh->elements;
+    Element3Store elements(old_elements.key_begin());
+    elements.reserve(old_elements.size());
+    for (ElementId eid = old_elements.key_begin();
+            eid != old_elements.key_end(); ++eid) {
+        Element3 element = old_elements[old_element_ids[eid]].to_element();
+        for (int i = 0; i < element.num_nodes(); ++i) {
+            element.nodes[i] = renumbering.nodes[element.nodes[i]];
+        }
+        elements.push_back(element);
+    }
+
+    mesh->nodes = std::move(nodes);
+    mesh->elements = std::move(elements);
+}
+
+MeshProfile compute_mesh_profile(const Mesh3 &mesh) {
+    MeshProfile result;
+    result.bandwidth = 0;
+    result.profile = 0;
+    ContiguousMap<NodeId, NodeId> first_neighbors(
+        mesh.nodes.key_begin(), mesh.nodes.key_end(), NodeId::invalid());
+    for (NodeId nid = mesh.nodes.key_begin(); nid != mesh.nodes.key_end();
+            ++nid) {
+        first_neighbors[nid] = nid;
+    }
+    for (ConstElement3Ref element : mesh.elements) {
+        NodeId min_id = element.nodes[0], max_id = element.nodes[0];
+        for (int i = 1; i < element.num_nodes(); ++i) {
+            min_id = std::min(min_id, element.nodes[i]);
+            max_id = std::max(max_id, element.nodes[i]);
+        }
+        result.bandwidth = std::max(result.bandwidth,
+            static_cast<long long>(max_id.to_int() - min_id.to_int()));
+        for (int i = 0; i < element.num_nodes(); ++i) {
+            NodeId &first = first_neighbors[element.nodes[i]];
+            first = std::min(first, min_id);
+        }
+    }
+    for (NodeId nid = mesh.nodes.key_begin(); nid != mesh.nodes.key_end();
+            ++nid) {
+        result.profile += nid.to_int() - first_neighbors[nid].to_int();
+    }
+    return result;
+}
+
+} /* namespace os2cx */
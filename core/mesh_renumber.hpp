@@ -0,0 +1,62 @@
+#ifndef OS2CX_MESH_RENUMBER_HPP_
+#define OS2CX_MESH_RENUMBER_HPP_
+
+#include <string>
+
+#include "mesh.hpp"
+
+namespace os2cx {
+
+/* How the nodes and elements of a mesh are reordered for locality.
+ReverseCuthillMcKee orders the nodes by breadth-first search from a peripheral
+node, which minimizes the profile of the stiffness matrix. Hilbert orders the
+elements along a Hilbert curve through their centers, which keeps elements
+that are close in space close in memory. */
+enum class RenumberMethod { None, ReverseCuthillMcKee, Hilbert };
+
+RenumberMethod renumber_method_from_string(const std::string &str);
+
+/* Maps the old node and element IDs of a mesh to their new IDs. */
+class MeshRenumbering {
+public:
+    /* Returns a renumbering that leaves every ID of 'mesh' unchanged */
+    static MeshRenumbering identity(const Mesh3 &mesh);
+
+    ContiguousMap<NodeId, NodeId> nodes;
+    ContiguousMap<ElementId, ElementId> elements;
+};
+
+/* Reorders the nodes in [node_begin, node_end) and the elements in
+[element_begin, element_end) of 'mesh' according to 'method', and records the
+result in 'renumbering'. The elements in the range must only refer to nodes in
+the range, so that the ranges of the other mesh objects aren't disturbed. */
+void compute_mesh_renumbering(
+    const Mesh3 &mesh,
+    NodeId node_begin,
+    NodeId node_end,
+    ElementId element_begin,
+    ElementId element_end,
+    RenumberMethod method,
+    MeshRenumbering *renumbering);
+
+/* Moves the nodes and elements of 'mesh' to their new IDs. */
+void apply_mesh_renumbering(
+    const MeshRenumbering &renumbering,
+    Mesh3 *mesh);
+
+/* The bandwidth and profile of the matrix whose nonzeros are the pairs of
+nodes that share an element, such as the stiffness matrix; smaller is better.
+The bandwidth is the largest difference between the IDs of two such nodes. The
+profile is the sum, over every node, of the difference between its ID and the
+smallest ID that it shares an element with. */
+class MeshProfile {
+public:
+    long long bandwidth;
+    long long profile;
+};
+
+MeshProfile compute_mesh_profile(const Mesh3 &mesh);
+
+} /* namespace os2cx */
+
+#endif /* OS2CX_MESH_RENUMBER_HPP_ */
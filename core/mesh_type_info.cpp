@@ -27,6 +27,8 @@ ElementType element_type_from_string(const std::string &str) {
     if (str == "C3D20RI") return ElementType::C3D20RI;
     if (str == "C3D4") return ElementType::C3D4;
     if (str == "C3D10") return ElementType::C3D10;
+    if (str == "C3D6") return ElementType::C3D6;
+    if (str == "C3D15") return ElementType::C3D15;
 
     if (all_element_types_including_unsupported.count(str)) {
         throw std::domain_error("OS2CX does not support element type: " + str);
@@ -463,6 +465,188 @@ public:
     }
 };
 
+/* A wedge is a triangle in (U, V) swept along W from -1 to +1, as in CalculiX.
+wedge_triangle_coords() computes the triangle's three barycentric coordinates
+and their derivatives with respect to U and V. */
+static void wedge_triangle_coords(
+    ElementTypeShape::ShapePoint uvw,
+    double *xi_out,
+    double *xi_d_u_out,
+    double *xi_d_v_out
+) {
+    xi_out[0] = 1.0 - uvw.x - uvw.y;
+    xi_out[1] = uvw.x;
+    xi_out[2] = uvw.y;
+    xi_d_u_out[0] = -1;
+    xi_d_u_out[1] = 1;
+    xi_d_u_out[2] = 0;
+    xi_d_v_out[0] = -1;
+    xi_d_v_out[1] = 0;
+    xi_d_v_out[2] = 1;
+}
+
+class ElementTypeShapeC3D6 : public ElementTypeShape {
+public:
+    ElementTypeShapeC3D6() {
+        name = "C3D6";
+        category = Category::Wedge;
+        order = 1;
+
+        vertices.resize(6);
+        static const Vertex::Type c = Vertex::Type::Corner;
+        vertices[0] = Vertex(c, 0, 0, -1);
+        vertices[1] = Vertex(c, 1, 0, -1);
+        vertices[2] = Vertex(c, 0, 1, -1);
+        vertices[3] = Vertex(c, 0, 0, +1);
+        vertices[4] = Vertex(c, 1, 0, +1);
+        vertices[5] = Vertex(c, 0, 1, +1);
+
+        faces.resize(5);
+        faces[0].vertices = { 0, 2, 1 };
+        faces[1].vertices = { 3, 4, 5 };
+        faces[2].vertices = { 0, 1, 4, 3 };
+        faces[3].vertices = { 1, 2, 5, 4 };
+        faces[4].vertices = { 2, 0, 3, 5 };
+        precalculate_face_info();
+
+        volume_integration_points.resize(2);
+        volume_integration_points[0] =
+            IntegrationPoint(1/3.0, 1/3.0, -1/sqrt(3), 0.5);
+        volume_integration_points[1] =
+            IntegrationPoint(1/3.0, 1/3.0, +1/sqrt(3), 0.5);
+    }
+
+    void shape_functions(ShapePoint uvw, double *sf_out) const {
+        double xi[3], xi_d_u[3], xi_d_v[3];
+        wedge_triangle_coords(uvw, xi, xi_d_u, xi_d_v);
+        for (int i = 0; i < 3; ++i) {
+            sf_out[i] = 0.5 * xi[i] * (1 - uvw.z);
+            sf_out[i + 3] = 0.5 * xi[i] * (1 + uvw.z);
+        }
+    }
+
+    void shape_function_derivatives(
+        ShapePoint uvw,
+        ShapeVector *sf_d_uvw_out
+    ) const {
+        double xi[3], xi_d_u[3], xi_d_v[3];
+        wedge_triangle_coords(uvw, xi, xi_d_u, xi_d_v);
+        for (int i = 0; i < 3; ++i) {
+            sf_d_uvw_out[i] = ShapeVector(
+                0.5 * xi_d_u[i] * (1 - uvw.z),
+                0.5 * xi_d_v[i] * (1 - uvw.z),
+                -0.5 * xi[i]);
+            sf_d_uvw_out[i + 3] = ShapeVector(
+                0.5 * xi_d_u[i] * (1 + uvw.z),
+                0.5 * xi_d_v[i] * (1 + uvw.z),
+                0.5 * xi[i]);
+        }
+    }
+};
+
+class ElementTypeShapeC3D15 : public ElementTypeShape {
+public:
+    ElementTypeShapeC3D15() {
+        name = "C3D15";
+        category = Category::Wedge;
+        order = 2;
+
+        vertices.resize(15);
+        static const Vertex::Type c = Vertex::Type::Corner;
+        static const Vertex::Type e = Vertex::Type::Edge;
+        vertices[ 0] = Vertex(c, 0.0, 0.0, -1);
+        vertices[ 1] = Vertex(c, 1.0, 0.0, -1);
+        vertices[ 2] = Vertex(c, 0.0, 1.0, -1);
+        vertices[ 3] = Vertex(c, 0.0, 0.0, +1);
+        vertices[ 4] = Vertex(c, 1.0, 0.0, +1);
+        vertices[ 5] = Vertex(c, 0.0, 1.0, +1);
+        vertices[ 6] = Vertex(e, 0.5, 0.0, -1);
+        vertices[ 7] = Vertex(e, 0.5, 0.5, -1);
+        vertices[ 8] = Vertex(e, 0.0, 0.5, -1);
+        vertices[ 9] = Vertex(e, 0.5, 0.0, +1);
+        vertices[10] = Vertex(e, 0.5, 0.5, +1);
+        vertices[11] = Vertex(e, 0.0, 0.5, +1);
+        vertices[12] = Vertex(e, 0.0, 0.0,  0);
+        vertices[13] = Vertex(e, 1.0, 0.0,  0);
+        vertices[14] = Vertex(e, 0.0, 1.0,  0);
+
+        faces.resize(5);
+        faces[0].vertices = {  0,  8,  2,  7,  1,  6 };
+        faces[1].vertices = {  3,  9,  4, 10,  5, 11 };
+        faces[2].vertices = {  0,  6,  1, 13,  4,  9,  3, 12 };
+        faces[3].vertices = {  1,  7,  2, 14,  5, 10,  4, 13 };
+        faces[4].vertices = {  2,  8,  0, 12,  3, 11,  5, 14 };
+        precalculate_face_info();
+
+        /* Three points on the triangle times three Gauss points along W */
+        volume_integration_points.resize(9);
+        double tri_locs[3][2] = {
+            {1/6.0, 1/6.0}, {2/3.0, 1/6.0}, {1/6.0, 2/3.0}};
+        double weights[3] = {5/9.0, 8/9.0, 5/9.0};
+        double locs[3] = {-sqrt(0.6), 0, +sqrt(0.6)};
+        for (int i = 0; i < 9; ++i) {
+            int t = i % 3, w = i / 3;
+            volume_integration_points[i] = IntegrationPoint(
+                tri_locs[t][0], tri_locs[t][1], locs[w], weights[w] / 6);
+        }
+    }
+
+    void shape_functions(ShapePoint uvw, double *sf_out) const {
+        double xi[3], xi_d_u[3], xi_d_v[3];
+        wedge_triangle_coords(uvw, xi, xi_d_u, xi_d_v);
+        double w = uvw.z;
+        for (int i = 0; i < 3; ++i) {
+            int j = (i + 1) % 3;
+            sf_out[i] = 0.5 * xi[i] * ((2 * xi[i] - 1) * (1 - w) - (1 - w * w));
+            sf_out[i + 3] =
+                0.5 * xi[i] * ((2 * xi[i] - 1) * (1 + w) - (1 - w * w));
+            sf_out[i + 6] = 2 * xi[i] * xi[j] * (1 - w);
+            sf_out[i + 9] = 2 * xi[i] * xi[j] * (1 + w);
+            sf_out[i + 12] = xi[i] * (1 - w * w);
+        }
+    }
+
+    void shape_function_derivatives(
+        ShapePoint uvw,
+        ShapeVector *sf_d_uvw_out
+    ) const {
+        double xi[3], xi_d_u[3], xi_d_v[3];
+        wedge_triangle_coords(uvw, xi, xi_d_u, xi_d_v);
+        double w = uvw.z;
+        for (int i = 0; i < 3; ++i) {
+            int j = (i + 1) % 3;
+            /* d/d(xi[i]) and d/dw of the corner functions */
+            double lower_d_xi =
+                0.5 * ((4 * xi[i] - 1) * (1 - w) - (1 - w * w));
+            double upper_d_xi =
+                0.5 * ((4 * xi[i] - 1) * (1 + w) - (1 - w * w));
+            sf_d_uvw_out[i] = ShapeVector(
+                lower_d_xi * xi_d_u[i],
+                lower_d_xi * xi_d_v[i],
+                0.5 * xi[i] * (-(2 * xi[i] - 1) + 2 * w));
+            sf_d_uvw_out[i + 3] = ShapeVector(
+                upper_d_xi * xi_d_u[i],
+                upper_d_xi * xi_d_v[i],
+                0.5 * xi[i] * ((2 * xi[i] - 1) + 2 * w));
+
+            double edge_d_u = xi_d_u[i] * xi[j] + xi[i] * xi_d_u[j];
+            double edge_d_v = xi_d_v[i] * xi[j] + xi[i] * xi_d_v[j];
+            sf_d_uvw_out[i + 6] = ShapeVector(
+                2 * edge_d_u * (1 - w),
+                2 * edge_d_v * (1 - w),
+                -2 * xi[i] * xi[j]);
+            sf_d_uvw_out[i + 9] = ShapeVector(
+                2 * edge_d_u * (1 + w),
+                2 * edge_d_v * (1 + w),
+                2 * xi[i] * xi[j]);
+            sf_d_uvw_out[i + 12] = ShapeVector(
+                xi_d_u[i] * (1 - w * w),
+                xi_d_v[i] * (1 - w * w),
+                -2 * xi[i] * w);
+        }
+    }
+};
+
 const ElementTypeShape &element_type_shape(ElementType type) {
     static const ElementTypeShapeC3D8    c3d8;
     static const ElementTypeShapeC3D20   c3d20;
@@ -470,6 +654,8 @@ const ElementTypeShape &element_type_shape(ElementType type) {
     static const ElementTypeShapeC3D20RI c3d20ri;
     static const ElementTypeShapeC3D4    c3d4;
     static const ElementTypeShapeC3D10   c3d10;
+    static const ElementTypeShapeC3D6    c3d6;
+    static const ElementTypeShapeC3D15   c3d15;
 
     switch (type) {
     case ElementType::C3D8:    return c3d8;
@@ -478,6 +664,8 @@ const ElementTypeShape &element_type_shape(ElementType type) {
     case ElementType::C3D20RI: return c3d20ri;
     case ElementType::C3D4:    return c3d4;
     case ElementType::C3D10:   return c3d10;
+    case ElementType::C3D6:    return c3d6;
+    case ElementType::C3D15:   return c3d15;
     default: assert(false);
     }
 }
@@ -15,6 +15,8 @@ enum class ElementType {
     C3D20RI, /* twenty-node brick (reduced integration, incompressibility) */
     C3D4,    /* four-node tetrahedron */
     C3D10,   /* ten-node tetrahedron */
+    C3D6,    /* six-node wedge */
+    C3D15,   /* fifteen-node wedge */
 };
 
 ElementType element_type_from_string(const std::string &str);
@@ -23,7 +25,8 @@ class ElementTypeShape {
 public:
     enum class Category {
         Brick,
-        Tetrahedron
+        Tetrahedron,
+        Wedge
     };
 
     static const int max_faces_per_element = 6;
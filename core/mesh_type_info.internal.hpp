@@ -0,0 +1,131 @@
+#ifndef OS2CX_MESH_TYPE_INFO_INTERNAL_HPP_
+#define OS2CX_MESH_TYPE_INFO_INTERNAL_HPP_
+
+#include "mesh_type_info.hpp"
+
+#include <assert.h>
+
+namespace os2cx {
+
+/* The number of vertices and volume integration points of each element type,
+as compile-time constants so that integration loops over them have fixed
+bounds. They must agree with element_type_shape(). */
+template<ElementType type>
+class ElementTypeTraits;
+
+template<>
+class ElementTypeTraits<ElementType::C3D8> {
+public:
+    static const int num_vertices = 8;
+    static const int num_volume_points = 8;
+};
+
+template<>
+class ElementTypeTraits<ElementType::C3D20> {
+public:
+    static const int num_vertices = 20;
+    static const int num_volume_points = 27;
+};
+
+template<>
+class ElementTypeTraits<ElementType::C3D20R> {
+public:
+    static const int num_vertices = 20;
+    static const int num_volume_points = 8;
+};
+
+template<>
+class ElementTypeTraits<ElementType::C3D20RI> {
+public:
+    static const int num_vertices = 20;
+    static const int num_volume_points = 8;
+};
+
+template<>
+class ElementTypeTraits<ElementType::C3D4> {
+public:
+    static const int num_vertices = 4;
+    static const int num_volume_points = 1;
+};
+
+template<>
+class ElementTypeTraits<ElementType::C3D10> {
+public:
+    static const int num_vertices = 10;
+    static const int num_volume_points = 4;
+};
+
+template<>
+class ElementTypeTraits<ElementType::C3D6> {
+public:
+    static const int num_vertices = 6;
+    static const int num_volume_points = 2;
+};
+
+template<>
+class ElementTypeTraits<ElementType::C3D15> {
+public:
+    static const int num_vertices = 15;
+    static const int num_volume_points = 9;
+};
+
+/* The shape functions and their derivatives at the integration points of one
+element type. They're the same for every element of the type, so they're
+evaluated once here rather than at every integration point of every element. */
+template<ElementType type>
+class ShapeTables {
+public:
+    static const int num_vertices = ElementTypeTraits<type>::num_vertices;
+    static const int num_volume_points =
+        ElementTypeTraits<type>::num_volume_points;
+
+    class Sample {
+    public:
+        double weight;
+        double sf[num_vertices];
+        ElementTypeShape::ShapeVector sf_d_uvw[num_vertices];
+    };
+
+    static const ShapeTables &get() {
+        static const ShapeTables tables;
+        return tables;
+    }
+
+    Sample volume_samples[num_volume_points];
+    std::vector<Sample> face_samples[ElementTypeShape::max_faces_per_element];
+
+private:
+    ShapeTables() {
+        const ElementTypeShape &shape = element_type_shape(type);
+        assert(static_cast<int>(shape.vertices.size()) == num_vertices);
+        assert(static_cast<int>(shape.volume_integration_points.size())
+            == num_volume_points);
+        for (int i = 0; i < num_volume_points; ++i) {
+            evaluate(shape, shape.volume_integration_points[i],
+                &volume_samples[i]);
+        }
+        for (int f = 0; f < static_cast<int>(shape.faces.size()); ++f) {
+            const ElementTypeShape::Face &face = shape.faces[f];
+            face_samples[f].resize(face.integration_points.size());
+            for (int i = 0; i < static_cast<int>(face_samples[f].size());
+                    ++i) {
+                evaluate(shape, face.integration_points[i],
+                    &face_samples[f][i]);
+            }
+        }
+    }
+
+    static void evaluate(
+        const ElementTypeShape &shape,
+        const ElementTypeShape::IntegrationPoint &ip,
+        Sample *sample_out
+    ) {
+        sample_out->weight = ip.weight;
+        shape.shape_functions(ip.uvw, sample_out->sf);
+        shape.shape_function_derivatives(ip.uvw, sample_out->sf_d_uvw);
+    }
+};
+
+} /* namespace os2cx */
+
+#endif
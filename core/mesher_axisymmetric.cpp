@@ -0,0 +1,438 @@
+#include "mesher_axisymmetric.hpp"
+
+#include <math.h>
+
+#include <algorithm>
+#include <map>
+
+#include "mesher_sweep.internal.hpp"
+
+namespace os2cx {
+
+/* The angle of the wedge that mesher_axisymmetric() revolves the meridional
+section through. CalculiX expands axisymmetric elements into a 2 degree wedge
+too, and expects their concentrated loads to be given for that wedge, so loads
+computed on our mesh can be written for the CAX elements unchanged. */
+static const double axisymmetric_sector_angle = 2 * M_PI / 180;
+
+/* How many times the boundary of the meridional section may be split in half
+before giving up on making it a union of edges of the triangulation */
+static const int max_boundary_recovery_rounds = 40;
+
+/* A piece of the boundary of the meridional section. Either volume is -1 if
+it isn't known. */
+class MeridionalSegment {
+public:
+    SweepPoint a, b;
+    /* -1 for the segments along the axis */
+    Plc3::SurfaceId surface;
+    Plc3::VolumeId left_volume, right_volume;
+};
+
+static bool same_point(SweepPoint p1, SweepPoint p2) {
+    return p1.u == p2.u && p1.v == p2.v;
+}
+
+/* Where the edge from 'p1' to 'p2' crosses the plane Y=0. Both triangles that
+share an edge pass its endpoints in the same order, so that they get exactly
+the same point. */
+static SweepPoint cut_edge(const Point &p1, const Point &p2) {
+    if (p1.y == 0) return SweepPoint(p1.x, p1.z);
+    if (p2.y == 0) return SweepPoint(p2.x, p2.z);
+    double t = p1.y / (p1.y - p2.y);
+    return SweepPoint(p1.x + (p2.x - p1.x) * t, p1.z + (p2.z - p1.z) * t);
+}
+
+/* Where the segment from 'outside', which has U<0, to 'inside' crosses the
+axis */
+static SweepPoint clip_to_axis(SweepPoint outside, SweepPoint inside) {
+    if (inside.u == 0) return inside;
+    double t = outside.u / (outside.u - inside.u);
+    return SweepPoint(0, outside.v + (inside.v - outside.v) * t);
+}
+
+/* Intersects the surfaces of 'plc' with the half-plane Y=0, X>=0, taking U=X
+and V=Z. Vertices on the plane are treated as if they were slightly above it,
+so a triangle that only touches the plane contributes nothing, and an edge
+that lies in the plane is contributed once, by the triangle below it. Where
+the section reaches the axis, segments along the axis close it off. */
+static std::vector<MeridionalSegment> cut_meridional_section(const Plc3 &plc) {
+    std::vector<MeridionalSegment> segments;
+    std::vector<double> axis_vs;
+    for (Plc3::SurfaceId sid = 0;
+            sid < static_cast<int>(plc.surfaces.size()); ++sid) {
+        const Plc3::Surface &surface = plc.surfaces[sid];
+        for (const Plc3::Surface::Triangle &tri : surface.triangles) {
+            const Point *p[3];
+            for (int i = 0; i < 3; ++i) {
+                p[i] = &plc.vertices[tri.vertices[i]].point;
+            }
+            SweepPoint cuts[2];
+            int num_cuts = 0;
+            for (int i = 0; i < 3; ++i) {
+                int j = (i + 1) % 3;
+                if ((p[i]->y < 0) == (p[j]->y < 0)) continue;
+                cuts[num_cuts++] = (tri.vertices[i] < tri.vertices[j])
+                    ? cut_edge(*p[i], *p[j]) : cut_edge(*p[j], *p[i]);
+            }
+            assert(num_cuts == 0 || num_cuts == 2);
+            if (num_cuts == 0 || same_point(cuts[0], cuts[1])) continue;
+
+            MeridionalSegment segment;
+            segment.a = cuts[0];
+            segment.b = cuts[1];
+            segment.surface = sid;
+
+            /* The triangle's normal points into volumes[0] */
+            double e1x = p[1]->x - p[0]->x, e1y = p[1]->y - p[0]->y;
+            double e1z = p[1]->z - p[0]->z;
+            double e2x = p[2]->x - p[0]->x, e2y = p[2]->y - p[0]->y;
+            double e2z = p[2]->z - p[0]->z;
+            double normal_u = e1y * e2z - e1z * e2y;
+            double normal_v = e1x * e2y - e1y * e2x;
+            double left_u = segment.a.v - segment.b.v;
+            double left_v = segment.b.u - segment.a.u;
+            bool first_on_left = (left_u * normal_u + left_v * normal_v > 0);
+            segment.left_volume = surface.volumes[first_on_left ? 0 : 1];
+            segment.right_volume = surface.volumes[first_on_left ? 1 : 0];
+
+            if (segment.a.u < 0 && segment.b.u < 0) continue;
+            if (segment.a.u < 0) {
+                segment.a = clip_to_axis(segment.a, segment.b);
+            } else if (segment.b.u < 0) {
+                segment.b = clip_to_axis(segment.b, segment.a);
+            }
+            if (same_point(segment.a, segment.b)) continue;
+            for (SweepPoint end : {segment.a, segment.b}) {
+                if (end.u == 0) axis_vs.push_back(end.v);
+            }
+            segments.push_back(segment);
+        }
+    }
+
+    /* Between two consecutive points where the section meets the axis, the
+    axis is either all inside the section or all outside it, so it doesn't
+    hurt to constrain all of it */
+    std::sort(axis_vs.begin(), axis_vs.end());
+    axis_vs.erase(std::unique(axis_vs.begin(), axis_vs.end()), axis_vs.end());
+    for (int i = 0; i + 1 < static_cast<int>(axis_vs.size()); ++i) {
+        MeridionalSegment segment;
+        segment.a = SweepPoint(0, axis_vs[i]);
+        segment.b = SweepPoint(0, axis_vs[i + 1]);
+        segment.surface = -1;
+        segment.left_volume = segment.right_volume = -1;
+        segments.push_back(segment);
+    }
+    return segments;
+}
+
+/* Triangulates the meridional section of 'plc' with its boundary as
+segments, and refines it. Each volume is a region. 'input_points_out' records
+the index of each point where the surfaces of 'plc' cross the half-plane. */
+static CrossSection make_meridional_section(
+    const Plc3 &plc,
+    MaxElementSize max_element_size_default,
+    const AttrOverrides<MaxElementSize> &max_element_size_overrides,
+    std::vector<Plc3::VolumeId> *region_volumes_out,
+    std::vector<Plc3::SurfaceId> *segment_surfaces_out,
+    std::map<SweepPoint, int, LessSweepPoint> *input_points_out
+) {
+    std::vector<MeridionalSegment> segments = cut_meridional_section(plc);
+    if (segments.empty()) {
+        throw AxisymmetricError("axisymmetric mesher requires a body of "
+            "revolution about the Z axis, but it doesn't cross the half-plane "
+            "Y=0, X>0");
+    }
+
+    /* Start from a triangle far bigger than the section, and insert the
+    endpoints of the segments into it */
+    double u_min = HUGE_VAL, v_min = HUGE_VAL;
+    double u_max = -HUGE_VAL, v_max = -HUGE_VAL;
+    for (const MeridionalSegment &segment : segments) {
+        for (SweepPoint p : {segment.a, segment.b}) {
+            u_min = std::min(u_min, p.u);
+            v_min = std::min(v_min, p.v);
+            u_max = std::max(u_max, p.u);
+            v_max = std::max(v_max, p.v);
+        }
+    }
+    double u_center = (u_min + u_max) / 2, v_center = (v_min + v_max) / 2;
+    double extent = 10 * std::max(u_max - u_min, v_max - v_min);
+    CrossSection cs;
+    cs.points.push_back(SweepPoint(u_center - extent, v_center - extent));
+    cs.points.push_back(SweepPoint(u_center + extent, v_center - extent));
+    cs.points.push_back(SweepPoint(u_center, v_center + extent));
+    CrossSection::Triangle enclosing;
+    for (int i = 0; i < 3; ++i) {
+        enclosing.vertices[i] = i;
+        enclosing.neighbors[i] = -1;
+        enclosing.segments[i] = -1;
+    }
+    enclosing.region = -1;
+    cs.triangles.push_back(enclosing);
+
+    class Piece {
+    public:
+        int a, b, segment;
+    };
+    std::vector<Piece> pieces;
+    std::map<SweepPoint, int, LessSweepPoint> point_indices;
+    auto insert = [&](SweepPoint p) {
+        auto it = point_indices.find(p);
+        if (it == point_indices.end()) {
+            it = point_indices.insert(
+                std::make_pair(p, cs.insert_point(p))).first;
+        }
+        return it->second;
+    };
+    for (int s = 0; s < static_cast<int>(segments.size()); ++s) {
+        Piece piece;
+        piece.a = insert(segments[s].a);
+        piece.b = insert(segments[s].b);
+        piece.segment = s;
+        pieces.push_back(piece);
+        segment_surfaces_out->push_back(segments[s].surface);
+    }
+
+    auto edge_map = [&]() {
+        std::map<std::pair<int, int>, std::pair<int, int> > edges;
+        for (int t = 0; t < static_cast<int>(cs.triangles.size()); ++t) {
+            const CrossSection::Triangle &tri = cs.triangles[t];
+            for (int i = 0; i < 3; ++i) {
+                int a = tri.vertices[(i + 1) % 3];
+                int b = tri.vertices[(i + 2) % 3];
+                edges[std::make_pair(std::min(a, b), std::max(a, b))] =
+                    std::make_pair(t, i);
+            }
+        }
+        return edges;
+    };
+
+    /* Split the pieces of the segments that aren't edges of the
+    triangulation at their midpoints until they all are. Nothing is marked as
+    a segment until then, so a later split may flip away an edge that was
+    already recovered; it's just split again in the next round. */
+    for (int round = 0; ; ++round) {
+        auto edges = edge_map();
+        std::vector<Piece> next_pieces;
+        bool all_recovered = true;
+        for (const Piece &piece : pieces) {
+            if (edges.count(std::make_pair(
+                    std::min(piece.a, piece.b), std::max(piece.a, piece.b)))) {
+                next_pieces.push_back(piece);
+                continue;
+            }
+            all_recovered = false;
+            SweepPoint a = cs.points[piece.a], b = cs.points[piece.b];
+            int middle = cs.insert_point(
+                SweepPoint((a.u + b.u) / 2, (a.v + b.v) / 2));
+            Piece first = piece, second = piece;
+            first.b = second.a = middle;
+            next_pieces.push_back(first);
+            next_pieces.push_back(second);
+        }
+        pieces = std::move(next_pieces);
+        if (all_recovered) break;
+        if (round == max_boundary_recovery_rounds) {
+            throw AxisymmetricError("axisymmetric mesher: couldn't recover the "
+                "boundary of the meridional section");
+        }
+    }
+
+    /* Spread the volumes on either side of each segment to the triangles
+    that can be reached without crossing a segment */
+    std::vector<Plc3::VolumeId> volumes(cs.triangles.size(), -1);
+    std::vector<int> stack;
+    auto assign = [&](int t, Plc3::VolumeId volume) {
+        if (volume == -1 || volumes[t] == volume) return;
+        if (volumes[t] != -1) {
+            throw AxisymmetricError("axisymmetric mesher: the meridional "
+                "section is inconsistent; is the body self-intersecting?");
+        }
+        volumes[t] = volume;
+        stack.push_back(t);
+    };
+    auto edges = edge_map();
+    for (const Piece &piece : pieces) {
+        auto it = edges.at(std::make_pair(
+            std::min(piece.a, piece.b), std::max(piece.a, piece.b)));
+        CrossSection::Triangle &tri = cs.triangles[it.first];
+        tri.segments[it.second] = piece.segment;
+        if (tri.neighbors[it.second] != -1) {
+            CrossSection::Triangle &other =
+                cs.triangles[tri.neighbors[it.second]];
+            int j = 0;
+            while (other.neighbors[j] != it.first) ++j;
+            other.segments[j] = piece.segment;
+        }
+    }
+    for (const Piece &piece : pieces) {
+        auto it = edges.at(std::make_pair(
+            std::min(piece.a, piece.b), std::max(piece.a, piece.b)));
+        const CrossSection::Triangle &tri = cs.triangles[it.first];
+        const MeridionalSegment &segment = segments[piece.segment];
+        /* Each triangle is to the left of its own counterclockwise edges */
+        bool on_left = (tri.vertices[(it.second + 1) % 3] == piece.a);
+        assign(it.first,
+            on_left ? segment.left_volume : segment.right_volume);
+        if (tri.neighbors[it.second] != -1) {
+            assign(tri.neighbors[it.second],
+                on_left ? segment.right_volume : segment.left_volume);
+        }
+    }
+    while (!stack.empty()) {
+        int t = stack.back();
+        stack.pop_back();
+        const CrossSection::Triangle &tri = cs.triangles[t];
+        for (int i = 0; i < 3; ++i) {
+            if (tri.segments[i] == -1 && tri.neighbors[i] != -1) {
+                assign(tri.neighbors[i], volumes[t]);
+            }
+        }
+    }
+
+    std::map<Plc3::VolumeId, int> region_map;
+    for (int t = 0; t < static_cast<int>(cs.triangles.size()); ++t) {
+        Plc3::VolumeId volume = volumes[t];
+        if (volume == -1 || volume == plc.volume_outside) {
+            cs.triangles[t].region = -1;
+            continue;
+        }
+        auto it = region_map.find(volume);
+        if (it == region_map.end()) {
+            it = region_map.insert(
+                std::make_pair(volume, region_map.size())).first;
+            region_volumes_out->push_back(volume);
+            cs.region_sizes.push_back(max_element_size_overrides.lookup(
+                plc.volumes[volume].attrs, max_element_size_default));
+        }
+        cs.triangles[t].region = it->second;
+    }
+    if (region_map.empty()) {
+        throw AxisymmetricError("axisymmetric mesher: the meridional "
+            "section is empty");
+    }
+
+    std::vector<int> new_points = cs.discard_outside();
+    for (const auto &pair : point_indices) {
+        if (new_points[pair.second] != -1) {
+            (*input_points_out)[pair.first] = new_points[pair.second];
+        }
+    }
+
+    cs.legalize_all();
+    cs.refine();
+    return cs;
+}
+
+Mesh3 mesher_axisymmetric(
+    const Plc3 &plc,
+    MaxElementSize max_element_size_default,
+    const AttrOverrides<MaxElementSize> &max_element_size_overrides,
+    ElementType element_type
+) {
+    /* Throws if there's no axisymmetric element for 'element_type' */
+    axisymmetric_element_name(element_type);
+    ElementType brick_type, wedge_type;
+    choose_sweep_element_types(element_type, &brick_type, &wedge_type);
+    bool make_quads = (brick_type != wedge_type);
+    int order = element_type_shape(element_type).order;
+
+    Mesh3 mesh;
+    if (plc.vertices.empty()) {
+        return mesh;
+    }
+
+    std::vector<Plc3::VolumeId> region_volumes;
+    std::vector<Plc3::SurfaceId> segment_surfaces;
+    std::map<SweepPoint, int, LessSweepPoint> input_points;
+    CrossSection cs = make_meridional_section(plc,
+        max_element_size_default, max_element_size_overrides,
+        &region_volumes, &segment_surfaces, &input_points);
+    std::vector<SweepCell> cells = make_cells(cs, make_quads);
+
+    /* Revolving counterclockwise about the U axis and then the Z axis would
+    turn the elements inside out, so revolve clockwise, away from the
+    meridional half-plane */
+    auto place = [&](SweepPoint p, int step) {
+        if (step == 0) {
+            return Point(p.u, 0, p.v);
+        }
+        double angle = axisymmetric_sector_angle * step / 2;
+        return Point(p.u * cos(angle), -p.u * sin(angle), p.v);
+    };
+    SweepNodes nodes(cs, cells, 1, order, place, &mesh);
+    for (const Plc3::Vertex &vertex : plc.vertices) {
+        if (vertex.point.y != 0) continue;
+        auto it = input_points.find(SweepPoint(vertex.point.x, vertex.point.z));
+        if (it != input_points.end()) {
+            mesh.nodes[nodes.corner(it->second, 0)].attrs = vertex.attrs;
+        }
+    }
+
+    for (const SweepCell &cell : cells) {
+        Element3 element = make_sweep_element(
+            cell, 0, nodes, brick_type, wedge_type);
+        element.attrs = plc.volumes[region_volumes[cell.region]].attrs;
+        /* Faces 0 and 1 are the sides of the wedge, not real surfaces */
+        element.face_attrs[0] = element.face_attrs[1] = element.attrs;
+        for (int i = 0; i < cell.num_vertices; ++i) {
+            int segment = cell.segments[i];
+            element.face_attrs[2 + i] =
+                (segment == -1 || segment_surfaces[segment] == -1)
+                ? element.attrs
+                : plc.surfaces[segment_surfaces[segment]].attrs;
+        }
+        mesh.elements.push_back(element);
+    }
+
+    return mesh;
+}
+
+ContiguousMap<NodeId, NodeId> compute_axisymmetric_meridian_nodes(
+    const Mesh3 &mesh
+) {
+    ContiguousMap<NodeId, NodeId> meridian_nodes(
+        mesh.nodes.key_begin(), mesh.nodes.key_end(), NodeId::invalid());
+    for (ConstElement3Ref element : mesh.elements) {
+        const ElementTypeShape &shape = element_type_shape(element.type);
+        int n = (shape.category == ElementTypeShape::Category::Brick) ? 4 : 3;
+        for (int i = 0; i < n; ++i) {
+            NodeId corner = element.nodes[i];
+            meridian_nodes[corner] = corner;
+            meridian_nodes[element.nodes[n + i]] = corner;
+            if (shape.order == 2) {
+                NodeId middle = element.nodes[2 * n + i];
+                meridian_nodes[middle] = middle;
+                meridian_nodes[element.nodes[3 * n + i]] = middle;
+                meridian_nodes[element.nodes[4 * n + i]] = corner;
+            }
+        }
+    }
+    return meridian_nodes;
+}
+
+std::string axisymmetric_element_name(ElementType element_type) {
+    switch (element_type) {
+    case ElementType::C3D6: return "CAX3";
+    case ElementType::C3D8: return "CAX4";
+    case ElementType::C3D15: return "CAX6";
+    case ElementType::C3D20: return "CAX8";
+    case ElementType::C3D20R: return "CAX8R";
+    default:
+        throw std::domain_error("no axisymmetric element corresponds to " +
+            element_type_shape(element_type).name);
+    }
+}
+
+ElementType axisymmetric_element_type_from_string(const std::string &str) {
+    for (ElementType element_type : {ElementType::C3D6, ElementType::C3D8,
+            ElementType::C3D15, ElementType::C3D20, ElementType::C3D20R}) {
+        if (axisymmetric_element_name(element_type) == str) {
+            return element_type;
+        }
+    }
+    throw std::domain_error("no such axisymmetric element type: " + str);
+}
+
+} /* namespace os2cx */
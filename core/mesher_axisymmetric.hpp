@@ -0,0 +1,42 @@
+#ifndef OS2CX_MESHER_AXISYMMETRIC_HPP_
+#define OS2CX_MESHER_AXISYMMETRIC_HPP_
+
+#include <stdexcept>
+
+#include "attrs.hpp"
+#include "mesh.hpp"
+#include "plc.hpp"
+
+namespace os2cx {
+
+class AxisymmetricError : public std::runtime_error {
+public:
+    AxisymmetricError(const std::string &s) : std::runtime_error(s) { }
+};
+
+/* Meshes a body of revolution about the Z axis for an axisymmetric analysis.
+The section of 'plc' by the half-plane Y=0, X>=0 is triangulated and refined
+as in mesher_sweep(), and revolved by the same 2 degrees that CalculiX uses to
+expand axisymmetric elements, so the mesh is exactly the one that CalculiX
+will solve. The nodes on the half-plane are the nodes of the CAX elements.
+'element_type' is the type of the revolved elements; only types returned by
+axisymmetric_element_type_from_string() are accepted. */
+Mesh3 mesher_axisymmetric(
+    const Plc3 &plc,
+    MaxElementSize max_element_size_default,
+    const AttrOverrides<MaxElementSize> &max_element_size_overrides,
+    ElementType element_type);
+
+/* Maps each node of a mesh from mesher_axisymmetric() to the node on the
+half-plane Y=0 that it was revolved from */
+ContiguousMap<NodeId, NodeId> compute_axisymmetric_meridian_nodes(
+    const Mesh3 &mesh);
+
+/* Converts between the types of the revolved elements and the names of the
+CalculiX axisymmetric elements: CAX3, CAX4, CAX6, CAX8, and CAX8R */
+std::string axisymmetric_element_name(ElementType element_type);
+ElementType axisymmetric_element_type_from_string(const std::string &str);
+
+} /* namespace os2cx */
+
+#endif /* OS2CX_MESHER_AXISYMMETRIC_HPP_ */
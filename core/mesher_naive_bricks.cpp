@@ -6,6 +6,7 @@
 #include <map>
 
 #include "mesher_tetgen.hpp"
+#include "parallel.hpp"
 
 /* uncomment to enable debug output */
 // #define NAIVE_BRICKS_DEBUG(x) x
@@ -26,89 +27,132 @@ public:
 static const Plc3::VolumeId VOLUME_ID_UNSET = -1;
 static const Plc3::SurfaceId SURFACE_ID_UNSET = -1;
 
-/* Tracks a mapping between X/Y/Z coordinates and grid indexes. */
+/* Tracks a mapping between X/Y/Z coordinates and grid indexes, and the
+triangles that lie in each grid plane. The coordinates are kept in a sorted
+array, and the triangles in a single array ordered by plane, with
+'triangle_offsets' marking where each plane's triangles begin. */
 class GridAxis {
 public:
-    typedef std::map<double, int>::const_iterator const_iterator;
-    GridAxis(const std::map<double, std::vector<TriangleRef> > &triangles) {
-        for (const auto &pair : triangles) {
-            points[pair.first] = points.size();
-            points_by_index.push_back(pair.first);
-        }
-    }
     int num_points() const {
         return points.size();
     }
     int num_intervals() const {
         return points.size() - 1;
     }
-    const_iterator begin_points() const {
-        return points.begin();
-    }
-    const_iterator end_points() const {
-        return points.end();
+    double point_at_index(int index) const {
+        return points[index];
     }
-    const_iterator find_point_lte(double p) const {
-        auto it = points.lower_bound(p);
-        if (it != points.end() && it->first == p) return it;
+    /* Returns the index of the last point that is less than or equal to 'p' */
+    int find_point_lte(double p) const {
+        auto it = std::upper_bound(points.begin(), points.end(), p);
         assert(it != points.begin());
-        --it;
-        return it;
+        return (it - points.begin()) - 1;
     }
-    const_iterator find_point_gte(double p) const {
-        auto it = points.lower_bound(p);
+    /* Returns the index of the first point that is greater than or equal to
+    'p' */
+    int find_point_gte(double p) const {
+        auto it = std::lower_bound(points.begin(), points.end(), p);
         assert(it != points.end());
-        return it;
+        return it - points.begin();
     }
-    double point_at_index(int index) const {
-        return points_by_index.at(index);
+    const TriangleRef *triangles_begin(int index) const {
+        return triangles.data() + triangle_offsets[index];
+    }
+    const TriangleRef *triangles_end(int index) const {
+        return triangles.data() + triangle_offsets[index + 1];
     }
-    std::map<double, int> points;
-    std::vector<double> points_by_index;
+    std::vector<double> points;
+    std::vector<int> triangle_offsets;
+    std::vector<TriangleRef> triangles;
 };
 
-/* Given a grid (expressed as a map of X/Y/Z coordinates to lists of triangles)
-applies max_element_size and min_subdivision to that grid. */
-void subdivide_grid(
+/* Collects the grid planes and triangles along one axis while setup_grid() is
+scanning the Plc3. */
+class GridAxisBuilder {
+public:
+    void add_point(double p) {
+        points.push_back(p);
+    }
+    void add_triangle(double p, TriangleRef tri_ref) {
+        points.push_back(p);
+        triangles.push_back(std::make_pair(p, tri_ref));
+    }
+    std::vector<double> points;
+    std::vector<std::pair<double, TriangleRef> > triangles;
+};
+
+/* Given the grid points (not necessarily sorted or unique) applies
+max_element_size and min_subdivision to them, returning the sorted points of
+the resulting grid. */
+std::vector<double> subdivide_grid(
     MaxElementSize max_element_size,
     int min_subdivision,
-    std::map<double, std::vector<TriangleRef> > *grid
+    std::vector<double> points
 ) {
-    auto lower = grid->begin();
-    while (true) {
-        auto upper = lower;
-        ++upper;
-        if (upper == grid->end()) break;
+    std::sort(points.begin(), points.end());
+    points.erase(std::unique(points.begin(), points.end()), points.end());
+
+    std::vector<double> grid;
+    for (int i = 0; i < static_cast<int>(points.size()); ++i) {
+        grid.push_back(points[i]);
+        if (i + 1 == static_cast<int>(points.size())) break;
+        double lower = points[i], upper = points[i + 1];
 
         int num_parts = std::max(
-            static_cast<int>(ceil(
-                (upper->first - lower->first) / max_element_size)),
+            static_cast<int>(ceil((upper - lower) / max_element_size)),
             min_subdivision);
-        double part_size = (upper->first - lower->first) / num_parts;
-        for (int i = 1; i < num_parts; ++i) {
-            double split_point = lower->first + part_size * i;
-            /* This mutates 'grid', but our existing 'upper' and 'lower'
-            iterators remain valid. Because we've already calculated
-            'upper', iteration will continue after the newly added
-            points. */
-            (*grid)[split_point];
+        double part_size = (upper - lower) / num_parts;
+        for (int j = 1; j < num_parts; ++j) {
+            grid.push_back(lower + part_size * j);
         }
+    }
+    return grid;
+}
 
-        lower = upper;
+GridAxis build_grid_axis(
+    MaxElementSize max_element_size,
+    int min_subdivision,
+    GridAxisBuilder *builder
+) {
+    GridAxis axis;
+    axis.points = subdivide_grid(
+        max_element_size, min_subdivision, std::move(builder->points));
+
+    /* Bucket the triangles by plane, keeping them in the order they were
+    added within each plane */
+    std::vector<int> plane_indices;
+    plane_indices.reserve(builder->triangles.size());
+    axis.triangle_offsets.assign(axis.points.size() + 1, 0);
+    for (const auto &pair : builder->triangles) {
+        int index = axis.find_point_gte(pair.first);
+        assert(axis.points[index] == pair.first);
+        plane_indices.push_back(index);
+        ++axis.triangle_offsets[index + 1];
+    }
+    for (int i = 0; i < static_cast<int>(axis.points.size()); ++i) {
+        axis.triangle_offsets[i + 1] += axis.triangle_offsets[i];
+    }
+    axis.triangles.resize(builder->triangles.size());
+    std::vector<int> next = axis.triangle_offsets;
+    for (int i = 0; i < static_cast<int>(builder->triangles.size()); ++i) {
+        axis.triangles[next[plane_indices[i]]++] =
+            builder->triangles[i].second;
     }
+    return axis;
 }
 
 /* Confirms that all triangles and borders in the Plc3 are aligned with the
-X/Y/Z axes. Emits x/y/z_triangles_out, where keys are grid locations and values
-are the triangles in the given plane. */
+X/Y/Z axes. Emits x/y/z_grid_out, whose points are the grid locations and whose
+triangles are sorted by the plane they lie in. */
 void setup_grid(
     const Plc3 &plc,
     MaxElementSize max_element_size,
     double min_subdivision,
-    std::map<double, std::vector<TriangleRef> > *x_triangles_out,
-    std::map<double, std::vector<TriangleRef> > *y_triangles_out,
-    std::map<double, std::vector<TriangleRef> > *z_triangles_out
+    GridAxis *x_grid_out,
+    GridAxis *y_grid_out,
+    GridAxis *z_grid_out
 ) {
+    GridAxisBuilder x_builder, y_builder, z_builder;
     for (Plc3::SurfaceId sid = 0;
             sid < static_cast<int>(plc.surfaces.size()); ++sid) {
         const Plc3::Surface &surface = plc.surfaces[sid];
@@ -119,11 +163,11 @@ void setup_grid(
             Point p1 = plc.vertices[tri.vertices[1]].point;
             Point p2 = plc.vertices[tri.vertices[2]].point;
             if (p0.x == p1.x && p0.x == p2.x) {
-                (*x_triangles_out)[p0.x].push_back(TriangleRef(sid, tix));
+                x_builder.add_triangle(p0.x, TriangleRef(sid, tix));
             } else if (p0.y == p1.y && p0.y == p2.y) {
-                (*y_triangles_out)[p0.y].push_back(TriangleRef(sid, tix));
+                y_builder.add_triangle(p0.y, TriangleRef(sid, tix));
             } else if (p0.z == p1.z && p0.z == p2.z) {
-                (*z_triangles_out)[p0.z].push_back(TriangleRef(sid, tix));
+                z_builder.add_triangle(p0.z, TriangleRef(sid, tix));
             } else {
                 throw NaiveBricksAlignmentError(p0, p1, p2);
             }
@@ -135,14 +179,14 @@ void setup_grid(
             Point p0 = plc.vertices[border.vertices[i]].point;
             Point p1 = plc.vertices[border.vertices[i + 1]].point;
             if (p0.x == p1.x && p0.y == p1.y) {
-                (*x_triangles_out)[p0.x]; /* make sure entry in map exists */
-                (*y_triangles_out)[p0.y];
+                x_builder.add_point(p0.x);
+                y_builder.add_point(p0.y);
             } else if (p0.x == p1.x && p0.z == p1.z) {
-                (*x_triangles_out)[p0.x];
-                (*z_triangles_out)[p0.z];
+                x_builder.add_point(p0.x);
+                z_builder.add_point(p0.z);
             } else if (p0.y == p1.y && p0.z == p1.z) {
-                (*y_triangles_out)[p0.y];
-                (*z_triangles_out)[p0.z];
+                y_builder.add_point(p0.y);
+                z_builder.add_point(p0.z);
             } else {
                 throw NaiveBricksAlignmentError(p0, p1);
             }
@@ -153,14 +197,14 @@ void setup_grid(
     isolated in the middle of a surface or volume */
     for (const Plc3::Vertex &vertex : plc.vertices) {
         Point p = vertex.point;
-        (*x_triangles_out)[p.x]; /* make sure entry in map exists */
-        (*y_triangles_out)[p.y];
-        (*z_triangles_out)[p.z];
+        x_builder.add_point(p.x);
+        y_builder.add_point(p.y);
+        z_builder.add_point(p.z);
     }
 
-    subdivide_grid(max_element_size, min_subdivision, x_triangles_out);
-    subdivide_grid(max_element_size, min_subdivision, y_triangles_out);
-    subdivide_grid(max_element_size, min_subdivision, z_triangles_out);
+    *x_grid_out = build_grid_axis(max_element_size, min_subdivision, &x_builder);
+    *y_grid_out = build_grid_axis(max_element_size, min_subdivision, &y_builder);
+    *z_grid_out = build_grid_axis(max_element_size, min_subdivision, &z_builder);
 }
 
 /* Helper class for tracking the minimum and maximum of a set of numbers */
@@ -228,7 +272,8 @@ void apply_triangles(
     Dimension dim_w,
     const GridAxis &u_grid,
     const GridAxis &v_grid,
-    const std::vector<TriangleRef> &triangles,
+    const TriangleRef *triangles_begin,
+    const TriangleRef *triangles_end,
     const std::function<void(
         /* The index of the U-interval that the triangle overlaps with */
         int u_index,
@@ -242,7 +287,9 @@ void apply_triangles(
         Plc3::VolumeId volume_after
     )> &callback
 ) {
-    for (const TriangleRef &tri_ref : triangles) {
+    for (const TriangleRef *tri_it = triangles_begin;
+            tri_it != triangles_end; ++tri_it) {
+        const TriangleRef &tri_ref = *tri_it;
         const Plc3::Surface &surface =
             plc.surfaces[tri_ref.surface_id];
         const Plc3::Surface::Triangle &triangle =
@@ -274,46 +321,37 @@ void apply_triangles(
         /* Shrink the area by epsilon to prevent rounding errors wherein a
         triangle overlaps the wrong area by a tiny amount */
         double u_epsilon = (u_minmax.max() - u_minmax.min()) * 1e-10;
-        GridAxis::const_iterator u_min =
-            u_grid.find_point_lte(u_minmax.min() + u_epsilon);
-        GridAxis::const_iterator u_max =
-            u_grid.find_point_gte(u_minmax.max() - u_epsilon);
+        int u_min = u_grid.find_point_lte(u_minmax.min() + u_epsilon);
+        int u_max = u_grid.find_point_gte(u_minmax.max() - u_epsilon);
 
-        for (auto u_lower = u_min; u_lower != u_max; ++u_lower) {
-            auto u_upper = u_lower;
-            ++u_upper;
+        for (int u_index = u_min; u_index != u_max; ++u_index) {
+            double u_lower = u_grid.point_at_index(u_index);
+            double u_upper = u_grid.point_at_index(u_index + 1);
 
             MinMaxSet v_minmax;
             interpolate_v_from_u(dim_u, dim_v,
-                p0, p1, u_lower->first, u_upper->first, &v_minmax);
+                p0, p1, u_lower, u_upper, &v_minmax);
             interpolate_v_from_u(dim_u, dim_v,
-                p1, p2, u_lower->first, u_upper->first, &v_minmax);
+                p1, p2, u_lower, u_upper, &v_minmax);
             interpolate_v_from_u(dim_u, dim_v,
-                p2, p0, u_lower->first, u_upper->first, &v_minmax);
+                p2, p0, u_lower, u_upper, &v_minmax);
 
             NAIVE_BRICKS_DEBUG(std::cerr << "considering strip "
-                << "u = (" << u_lower->first << ", " << u_upper->first << "), "
+                << "u = (" << u_lower << ", " << u_upper << "), "
                 << "v = (" << v_minmax.min() << ", " << v_minmax.max() << ")"
                 << std::endl);
 
             double v_epsilon = (v_minmax.max() - v_minmax.min()) * 1e-10;
-            GridAxis::const_iterator v_min =
-                v_grid.find_point_lte(v_minmax.min() + v_epsilon);
-            GridAxis::const_iterator v_max =
-                v_grid.find_point_gte(v_minmax.max() - v_epsilon);
-
-            for (auto v_lower = v_min; v_lower != v_max; ++v_lower) {
-                auto v_upper = v_lower;
-                ++v_upper;
+            int v_min = v_grid.find_point_lte(v_minmax.min() + v_epsilon);
+            int v_max = v_grid.find_point_gte(v_minmax.max() - v_epsilon);
+
+            for (int v_index = v_min; v_index != v_max; ++v_index) {
                 NAIVE_BRICKS_DEBUG(std::cerr << "applying at cell "
-                    << "u = (" << u_lower->first
-                    << ", " << u_upper->first << "), "
-                    << "v = (" << v_lower->first
-                    << ", " << v_upper->first << ")"
+                    << "u = (" << u_lower << ", " << u_upper << "), "
+                    << "v = (" << v_grid.point_at_index(v_index)
+                    << ", " << v_grid.point_at_index(v_index + 1) << ")"
                     << std::endl);
 
-                int u_index = u_lower->second;
-                int v_index = v_lower->second;
                 callback(
                     u_index,
                     v_index,
@@ -325,44 +363,69 @@ void apply_triangles(
     }
 }
 
-/* Given a set of triangles that all lie in the same Z-plane, computes the
-volume IDs for the grid cells immediately in the positive-Z direction of that
-Z-plane. */
+/* Given the volume IDs for the grid cells immediately in the negative-Z
+direction of the z_index'th Z-plane, updates them in place to the volume IDs for
+the grid cells immediately in the positive-Z direction. Only the cells covered
+by the triangles in that plane are touched, so this is cheap even for a large
+grid. */
 void apply_triangles_to_update_volume_ids(
     const Plc3 &plc,
     const GridAxis &x_grid,
     const GridAxis &y_grid,
-    const std::vector<TriangleRef> &triangles,
-    /* Volume IDs for the grid cells in the negative-Z direction of the Z-plane,
-    used for sanity checking. */
-    const Array2D<Plc3::VolumeId> &volume_ids_before,
-    Array2D<Plc3::VolumeId> *volume_ids_after
+    const GridAxis &z_grid,
+    int z_index,
+    Array2D<Plc3::VolumeId> *volume_ids
 ) {
     apply_triangles(
         plc,
         Dimension::X, Dimension::Y, Dimension::Z,
         x_grid, y_grid,
-        triangles,
+        z_grid.triangles_begin(z_index), z_grid.triangles_end(z_index),
         [&](int x_index, int y_index,
             Plc3::SurfaceId,
             Plc3::VolumeId volume_before,
             Plc3::VolumeId volume_after
         ) {
-            assert(volume_ids_before(x_index, y_index) == volume_before);
-            if ((*volume_ids_after)(x_index, y_index) == VOLUME_ID_UNSET) {
-                (*volume_ids_after)(x_index, y_index) = volume_after;
-            } else {
-                assert(
-                    (*volume_ids_after)(x_index, y_index) == volume_after);
-            }
+            /* Sanity check; if several triangles cover the same cell, an
+            earlier one may have already updated it. */
+            assert((*volume_ids)(x_index, y_index) == volume_before ||
+                (*volume_ids)(x_index, y_index) == volume_after);
+            (void)volume_before;
+            (*volume_ids)(x_index, y_index) = volume_after;
         }
     );
-    for (int x = 0; x < x_grid.num_intervals(); ++x) {
-        for (int y = 0; y < y_grid.num_intervals(); ++y) {
-            if ((*volume_ids_after)(x, y) == VOLUME_ID_UNSET) {
-                (*volume_ids_after)(x, y) = volume_ids_before(x, y);
+}
+
+/* Records, for each grid cell, the volume ID that the triangles in the Z-planes
+[slab_begin, slab_end) leave immediately above them, or VOLUME_ID_UNSET if none
+of those triangles cover the cell. This doesn't need to know the volume IDs
+below slab_begin, so every chunk can compute it at once; overlaying the results
+in order then gives the volume IDs at the bottom of each chunk. */
+void compute_volume_id_changes(
+    const Plc3 &plc,
+    const GridAxis &x_grid,
+    const GridAxis &y_grid,
+    const GridAxis &z_grid,
+    int slab_begin,
+    int slab_end,
+    Array2D<Plc3::VolumeId> *changes_out
+) {
+    *changes_out = Array2D<Plc3::VolumeId>(
+        x_grid.num_intervals(), y_grid.num_intervals(), VOLUME_ID_UNSET);
+    for (int slab = slab_begin; slab < slab_end; ++slab) {
+        apply_triangles(
+            plc,
+            Dimension::X, Dimension::Y, Dimension::Z,
+            x_grid, y_grid,
+            z_grid.triangles_begin(slab), z_grid.triangles_end(slab),
+            [&](int x_index, int y_index,
+                Plc3::SurfaceId,
+                Plc3::VolumeId,
+                Plc3::VolumeId volume_after
+            ) {
+                (*changes_out)(x_index, y_index) = volume_after;
             }
-        }
+        );
     }
 }
 
@@ -389,10 +452,11 @@ NodeId create_node(
 void create_brick(
     ElementType element_type,
     int order,
-    const GridAxis::const_iterator &x_lower,
-    const GridAxis::const_iterator &x_upper,
-    const GridAxis::const_iterator &y_lower,
-    const GridAxis::const_iterator &y_upper,
+    const GridAxis &x_grid,
+    const GridAxis &y_grid,
+    /* The indices of the brick's X-interval and Y-interval */
+    int x_index,
+    int y_index,
     double z_lower,
     double z_upper,
     Array2D<NodeId> *z_lower_node_ids,
@@ -404,10 +468,14 @@ void create_brick(
     Element3 element;
     element.type = element_type;
 
-    std::pair<double, int> xp_lower(x_lower->first, x_lower->second * 2);
-    std::pair<double, int> xp_upper(x_upper->first, x_upper->second * 2);
-    std::pair<double, int> yp_lower(y_lower->first, y_lower->second * 2);
-    std::pair<double, int> yp_upper(y_upper->first, y_upper->second * 2);
+    double x_lower = x_grid.point_at_index(x_index);
+    double x_upper = x_grid.point_at_index(x_index + 1);
+    double y_lower = y_grid.point_at_index(y_index);
+    double y_upper = y_grid.point_at_index(y_index + 1);
+    std::pair<double, int> xp_lower(x_lower, x_index * 2);
+    std::pair<double, int> xp_upper(x_upper, (x_index + 1) * 2);
+    std::pair<double, int> yp_lower(y_lower, y_index * 2);
+    std::pair<double, int> yp_upper(y_upper, (y_index + 1) * 2);
     std::pair<double, Array2D<NodeId> *> zp_lower(z_lower, z_lower_node_ids);
     std::pair<double, Array2D<NodeId> *> zp_upper(z_upper, z_upper_node_ids);
 
@@ -422,9 +490,9 @@ void create_brick(
 
     if (order == 2) {
         std::pair<double, int> xp_middle(
-            (x_lower->first + x_upper->first) / 2, x_lower->second * 2 + 1);
+            (x_lower + x_upper) / 2, x_index * 2 + 1);
         std::pair<double, int> yp_middle(
-            (y_lower->first + y_upper->first) / 2, y_lower->second * 2 + 1);
+            (y_lower + y_upper) / 2, y_index * 2 + 1);
         std::pair<double, Array2D<NodeId> *> zp_middle(
             (z_lower + z_upper) / 2, z_middle_node_ids);
 
@@ -479,23 +547,15 @@ void create_bricks(
             NodeId::invalid());
     }
 
-    auto x_lower = x_grid.begin_points();
-    while (true) {
-        auto x_upper = x_lower;
-        ++x_upper;
-        if (x_upper == x_grid.end_points()) break;
-
-        auto y_lower = y_grid.begin_points();
-        while (true) {
-            auto y_upper = y_lower;
-            ++y_upper;
-            if (y_upper == y_grid.end_points()) break;
-
-            Plc3::VolumeId vid = volume_ids(x_lower->second, y_lower->second);
+    for (int x_index = 0; x_index < x_grid.num_intervals(); ++x_index) {
+        for (int y_index = 0; y_index < y_grid.num_intervals(); ++y_index) {
+            Plc3::VolumeId vid = volume_ids(x_index, y_index);
 
             NAIVE_BRICKS_DEBUG(std::cerr
-                << "x = (" << x_lower->first << ", " << x_upper->first << "), "
-                << "y = (" << y_lower->first << ", " << y_upper->first << "), "
+                << "x = (" << x_grid.point_at_index(x_index)
+                << ", " << x_grid.point_at_index(x_index + 1) << "), "
+                << "y = (" << y_grid.point_at_index(y_index)
+                << ", " << y_grid.point_at_index(y_index + 1) << "), "
                 << "z = (" << z_lower << ", " << z_upper << "), "
                 << "vid = " << vid
                 << std::endl);
@@ -503,59 +563,172 @@ void create_bricks(
             if (vid != plc.volume_outside) {
                 create_brick(
                     element_type, order,
-                    x_lower, x_upper, y_lower, y_upper, z_lower, z_upper,
+                    x_grid, y_grid, x_index, y_index, z_lower, z_upper,
                     z_lower_node_ids, &z_middle_node_ids, z_upper_node_ids,
                     plc.volumes[vid].attrs,
                     mesh);
             }
-
-            y_lower = y_upper;
         }
+    }
+}
+
+/* The bricks for a run of consecutive Z-intervals, meshed independently of the
+rest of the grid. Node IDs are local to 'mesh'. */
+class NaiveBricksChunk {
+public:
+    Mesh3 mesh;
+    /* The local node IDs on the bottom and top Z-planes of the chunk */
+    Array2D<NodeId> bottom_node_ids, top_node_ids;
+};
+
+/* Meshes the Z-intervals [slab_begin, slab_end) into 'chunk_out', given the
+volume IDs just below the Z-plane at slab_begin. */
+void create_chunk_bricks(
+    const Plc3 &plc,
+    ElementType element_type,
+    const GridAxis &x_grid,
+    const GridAxis &y_grid,
+    const GridAxis &z_grid,
+    int slab_begin,
+    int slab_end,
+    Array2D<Plc3::VolumeId> volume_ids,
+    NaiveBricksChunk *chunk_out
+) {
+    int node_xs = x_grid.num_points() + x_grid.num_intervals();
+    int node_ys = y_grid.num_points() + y_grid.num_intervals();
+    chunk_out->bottom_node_ids =
+        Array2D<NodeId>(node_xs, node_ys, NodeId::invalid());
+    Array2D<NodeId> *node_ids = &chunk_out->bottom_node_ids;
+    Array2D<NodeId> node_ids_2;
+
+    for (int slab = slab_begin; slab < slab_end; ++slab) {
+        NAIVE_BRICKS_DEBUG(std::cerr
+            << "apply_triangles at z = " << z_grid.point_at_index(slab)
+            << std::endl);
+        apply_triangles_to_update_volume_ids(
+            plc, x_grid, y_grid, z_grid, slab, &volume_ids);
 
-        x_lower = x_upper;
+        NAIVE_BRICKS_DEBUG(std::cerr
+            << "create bricks at z = (" << z_grid.point_at_index(slab)
+            << ", " << z_grid.point_at_index(slab + 1) << ")" << std::endl);
+        Array2D<NodeId> node_ids_3(node_xs, node_ys, NodeId::invalid());
+        create_bricks(
+            plc,
+            element_type,
+            x_grid, y_grid,
+            z_grid.point_at_index(slab), z_grid.point_at_index(slab + 1),
+            volume_ids,
+            node_ids, &node_ids_3,
+            &chunk_out->mesh);
+        node_ids_2 = std::move(node_ids_3);
+        node_ids = &node_ids_2;
     }
+    chunk_out->top_node_ids = std::move(node_ids_2);
 }
 
-/* Finds the element ID of the brick whose 0-th node is at 'point'. This is
-efficient by taking advantage of the fact that the bricks are always created in
-lexicographical order on [z, x, y]. */
-ElementId find_brick(const Mesh3 &mesh, Point point) {
-    Element3 dummy_element;
-    dummy_element.nodes[0] = NodeId::invalid();
-    auto iterator_pair = std::equal_range(
-        mesh.elements.begin(),
-        mesh.elements.end(),
-        dummy_element,
-        [&](const Element3 &element_a, const Element3 &element_b) {
-            Point point_a = (element_a.nodes[0] == NodeId::invalid())
-                ? point
-                : mesh.nodes[element_a.nodes[0]].point;
-            Point point_b = (element_b.nodes[0] == NodeId::invalid())
-                ? point
-                : mesh.nodes[element_b.nodes[0]].point;
-            if (point_a.z < point_b.z) return true;
-            if (point_a.z > point_b.z) return false;
-            if (point_a.x < point_b.x) return true;
-            if (point_a.x > point_b.x) return false;
-            return (point_a.y < point_b.y);
+/* Appends the chunk's nodes and elements to 'mesh'. Nodes on the chunk's
+bottom Z-plane are merged with the nodes in 'node_ids', which holds the global
+node IDs on the top Z-plane of the previous chunk; on return, it holds the
+global node IDs on the top Z-plane of this chunk. All other nodes are appended
+in the order the chunk created them. */
+void stitch_chunk(
+    const GridAxis &x_grid,
+    const GridAxis &y_grid,
+    NaiveBricksChunk *chunk,
+    Array2D<NodeId> *node_ids,
+    Mesh3 *mesh
+) {
+    int node_xs = x_grid.num_points() + x_grid.num_intervals();
+    int node_ys = y_grid.num_points() + y_grid.num_intervals();
+    const Mesh3 &local = chunk->mesh;
+
+    ContiguousMap<NodeId, NodeId> node_map(
+        local.nodes.key_begin(), local.nodes.key_end(), NodeId::invalid());
+    for (int x = 0; x < node_xs; ++x) {
+        for (int y = 0; y < node_ys; ++y) {
+            NodeId local_id = chunk->bottom_node_ids(x, y);
+            if (local_id != NodeId::invalid()) {
+                node_map[local_id] = (*node_ids)(x, y);
+            }
         }
-    );
+    }
+    for (NodeId local_id = local.nodes.key_begin();
+            local_id != local.nodes.key_end(); ++local_id) {
+        if (node_map[local_id] == NodeId::invalid()) {
+            node_map[local_id] = mesh->nodes.push_back(local.nodes[local_id]);
+        }
+    }
 
-    if (iterator_pair.first == iterator_pair.second) {
-        return ElementId::invalid();
+    for (ConstElement3Ref local_element : local.elements) {
+        Element3 element = local_element.to_element();
+        int num_nodes = element_type_shape(element.type).vertices.size();
+        for (int i = 0; i < num_nodes; ++i) {
+            element.nodes[i] = node_map[element.nodes[i]];
+        }
+        mesh->elements.push_back(element);
+    }
 
-    } else {
-        int offset = iterator_pair.first - mesh.elements.begin();
-        ElementId eid = ElementId::from_int(
-            mesh.elements.key_begin().to_int() + offset);
+    for (int x = 0; x < node_xs; ++x) {
+        for (int y = 0; y < node_ys; ++y) {
+            NodeId local_id = chunk->top_node_ids(x, y);
+            (*node_ids)(x, y) = (local_id == NodeId::invalid())
+                ? NodeId::invalid() : node_map[local_id];
+        }
+    }
 
-        /* Sanity check that we actually found the right element */
-        const Element3 &element = mesh.elements[eid];
-        assert(mesh.nodes[element.nodes[0]].point == point);
+    /* Free the chunk's memory as soon as it's been copied */
+    *chunk = NaiveBricksChunk();
+}
 
-        return eid;
+/* Maps each cell of the grid to the ID of the brick that fills it, or
+ElementId::invalid() if the cell is empty. */
+class BrickGrid {
+public:
+    BrickGrid(
+        const GridAxis &x_grid,
+        const GridAxis &y_grid,
+        const GridAxis &z_grid,
+        const Mesh3 &mesh
+    ) :
+        xs(x_grid.num_intervals()),
+        ys(y_grid.num_intervals()),
+        zs(z_grid.num_intervals()),
+        element_ids(xs * ys * zs, ElementId::invalid())
+    {
+        for (ElementId eid = mesh.elements.key_begin();
+                eid != mesh.elements.key_end(); ++eid) {
+            Point point = mesh.nodes[mesh.elements[eid].nodes[0]].point;
+            int cell[3] = {
+                x_grid.find_point_gte(point.x),
+                y_grid.find_point_gte(point.y),
+                z_grid.find_point_gte(point.z)};
+            assert(x_grid.point_at_index(cell[0]) == point.x);
+            assert(y_grid.point_at_index(cell[1]) == point.y);
+            assert(z_grid.point_at_index(cell[2]) == point.z);
+            element_ids[offset(cell)] = eid;
+        }
+    }
+
+    /* 'cell' holds the X, Y, and Z interval indices. An index one past the
+    last interval is allowed, and is always empty. */
+    ElementId at(const int cell[3]) const {
+        if (cell[0] == xs || cell[1] == ys || cell[2] == zs) {
+            return ElementId::invalid();
+        }
+        return element_ids[offset(cell)];
+    }
+
+private:
+    int offset(const int cell[3]) const {
+        assert(cell[0] >= 0 && cell[0] < xs);
+        assert(cell[1] >= 0 && cell[1] < ys);
+        assert(cell[2] >= 0 && cell[2] < zs);
+        return cell[0] + xs * (cell[1] + ys * cell[2]);
     }
-}
+
+    int xs, ys, zs;
+    std::vector<ElementId> element_ids;
+};
 
 /* Sweeps through the entire grid in order of increasing W-dimension. For each
 face of a brick in 'mesh' for which that face lies in the W-plane, and is part
@@ -569,8 +742,10 @@ void update_face_attrs(
     int face_before,
     /* The face index of the face on the positive-W side of the brick */
     int face_after,
-    GridAxis u_grid, GridAxis v_grid,
-    std::map<double, std::vector<TriangleRef> > w_triangles,
+    const GridAxis &u_grid,
+    const GridAxis &v_grid,
+    const GridAxis &w_grid,
+    const BrickGrid &bricks,
     Mesh3 *mesh
 ) {
     NAIVE_BRICKS_DEBUG(std::cerr
@@ -583,12 +758,13 @@ void update_face_attrs(
         v_grid.num_intervals(),
         ElementId::invalid());
 
-    for (const auto &w_triangles_pair : w_triangles) {
-        Point point;
-        point.set_at(dim_w, w_triangles_pair.first);
+    for (int w_index = 0; w_index < w_grid.num_points(); ++w_index) {
+        int cell[3];
+        cell[static_cast<int>(dim_w)] = w_index;
 
         NAIVE_BRICKS_DEBUG(std::cerr
-            << "update_face_attrs w=" << w_triangles_pair.first << std::endl);
+            << "update_face_attrs w=" << w_grid.point_at_index(w_index)
+            << std::endl);
 
         /* Compute surface ID for each grid cell in this W-plane */
         Array2D<Plc3::SurfaceId> surface_ids(
@@ -598,7 +774,8 @@ void update_face_attrs(
         apply_triangles(
             plc,
             dim_u, dim_v, dim_w,
-            u_grid, v_grid, w_triangles_pair.second,
+            u_grid, v_grid,
+            w_grid.triangles_begin(w_index), w_grid.triangles_end(w_index),
             [&](int u_index, int v_index,
                 Plc3::SurfaceId surface_id, Plc3::VolumeId, Plc3::VolumeId
             ) {
@@ -624,9 +801,9 @@ void update_face_attrs(
             for (int v_index = 0; v_index < v_grid.num_intervals(); ++v_index) {
                 /* Update element_ids */
                 ElementId prev_eid = element_ids(u_index, v_index);
-                point.set_at(dim_u, u_grid.point_at_index(u_index));
-                point.set_at(dim_v, v_grid.point_at_index(v_index));
-                ElementId next_eid = find_brick(*mesh, point);
+                cell[static_cast<int>(dim_u)] = u_index;
+                cell[static_cast<int>(dim_v)] = v_index;
+                ElementId next_eid = bricks.at(cell);
                 element_ids(u_index, v_index) = next_eid;
 
                 Plc3::SurfaceId surface_id = surface_ids(u_index, v_index);
@@ -635,18 +812,17 @@ void update_face_attrs(
                     << " u_index=" << u_index
                     << " v_index=" << v_index
                     << " prev_eid=" << prev_eid.to_int()
-                    << " point=" << point
                     << " next_eid=" << next_eid.to_int()
                     << " surface_id=" << surface_id << std::endl);
                 if (surface_id != SURFACE_ID_UNSET) {
                     AttrBitset attrs = plc.surfaces[surface_id].attrs;
                     if (prev_eid != ElementId::invalid()) {
-                        mesh->elements[prev_eid].face_attrs[face_after] =
-                            attrs;
+                        mesh->elements.set_face_attrs(
+                            prev_eid, face_after, attrs);
                     }
                     if (next_eid != ElementId::invalid()) {
-                        mesh->elements[next_eid].face_attrs[face_before] =
-                            attrs;
+                        mesh->elements.set_face_attrs(
+                            next_eid, face_before, attrs);
                     }
                 }
             }
@@ -692,86 +868,101 @@ Mesh3 mesher_naive_bricks(
             "element_type C3D8, C3D20, C3D20R, or C3D20RI");
     }
 
-    std::map<double, std::vector<TriangleRef> >
-        x_triangles, y_triangles, z_triangles;
+    GridAxis x_grid, y_grid, z_grid;
     setup_grid(
         plc, max_element_size, min_subdivision,
-        &x_triangles, &y_triangles, &z_triangles);
+        &x_grid, &y_grid, &z_grid);
 
     Mesh3 mesh;
-    if (z_triangles.empty()) {
+    if (z_grid.points.empty()) {
         return mesh;
     }
 
-    GridAxis x_grid(x_triangles), y_grid(y_triangles), z_grid(z_triangles);
-
     NAIVE_BRICKS_DEBUG(std::cerr
         << "volume_outside = " << plc.volume_outside << std::endl);
 
+    /* Each chunk is a run of consecutive Z-intervals that is meshed on its
+    own. The result doesn't depend on the chunk size, so it's fine to base it on
+    the number of threads. */
+    int num_slabs = z_grid.num_intervals();
+    int slabs_per_chunk = std::max(1, static_cast<int>(ceil(
+        static_cast<double>(num_slabs) / (4 * parallel_num_threads()))));
+    int num_chunks = (num_slabs + slabs_per_chunk - 1) / slabs_per_chunk;
+
+    /* Each chunk needs the volume IDs at its bottom before it can classify
+    its own cells. Find which cells each chunk's triangles change, in parallel;
+    then overlay those changes in order, which only takes one pass over the
+    cells per chunk. */
+    std::vector<Array2D<Plc3::VolumeId> > chunk_changes(num_chunks);
+    parallel_for(num_chunks, 1, [&](int begin, int end) {
+        for (int chunk = begin; chunk < end; ++chunk) {
+            int slab_begin = chunk * slabs_per_chunk;
+            int slab_end = std::min(slab_begin + slabs_per_chunk, num_slabs);
+            compute_volume_id_changes(
+                plc, x_grid, y_grid, z_grid, slab_begin, slab_end,
+                &chunk_changes[chunk]);
+        }
+    });
+    std::vector<Array2D<Plc3::VolumeId> > chunk_volume_ids;
     Array2D<Plc3::VolumeId> volume_ids(
         x_grid.num_intervals(),
         y_grid.num_intervals(),
         plc.volume_outside);
+    for (int chunk = 0; chunk < num_chunks; ++chunk) {
+        chunk_volume_ids.push_back(volume_ids);
+        for (int x = 0; x < x_grid.num_intervals(); ++x) {
+            for (int y = 0; y < y_grid.num_intervals(); ++y) {
+                Plc3::VolumeId change = chunk_changes[chunk](x, y);
+                if (change != VOLUME_ID_UNSET) {
+                    volume_ids(x, y) = change;
+                }
+            }
+        }
+        chunk_changes[chunk] = Array2D<Plc3::VolumeId>();
+    }
+
+    std::vector<NaiveBricksChunk> chunks(num_chunks);
+    parallel_for(num_chunks, 1, [&](int begin, int end) {
+        for (int chunk = begin; chunk < end; ++chunk) {
+            int slab_begin = chunk * slabs_per_chunk;
+            int slab_end = std::min(slab_begin + slabs_per_chunk, num_slabs);
+            create_chunk_bricks(
+                plc, element_type, x_grid, y_grid, z_grid,
+                slab_begin, slab_end,
+                std::move(chunk_volume_ids[chunk]),
+                &chunks[chunk]);
+        }
+    });
+
+    /* Stitching is sequential so that the node and element IDs come out the
+    same as if the whole grid were meshed in one sweep */
     Array2D<NodeId> node_ids(
         /* num_points + num_intervals for second order bricks */
         x_grid.num_points() + x_grid.num_intervals(),
         y_grid.num_points() + y_grid.num_intervals(),
         NodeId::invalid());
-
-    auto z_lower = z_triangles.begin();
-    while (true) {
-        auto z_upper = z_lower;
-        ++z_upper;
-        if (z_upper == z_triangles.end()) break;
-
-        NAIVE_BRICKS_DEBUG(std::cerr
-            << "apply_triangles at z = " << z_lower->first << std::endl);
-        Array2D<Plc3::VolumeId> volume_ids_2(
-            x_grid.num_intervals(), y_grid.num_intervals(), VOLUME_ID_UNSET);
-        apply_triangles_to_update_volume_ids(
-            plc,
-            x_grid, y_grid, z_lower->second,
-            volume_ids, &volume_ids_2
-        );
-        volume_ids = std::move(volume_ids_2);
-
-        NAIVE_BRICKS_DEBUG(std::cerr
-            << "create bricks at z = (" << z_lower->first
-            << ", " << z_upper->first << ")" << std::endl);
-        Array2D<NodeId> node_ids_2(
-            x_grid.num_points() + x_grid.num_intervals(),
-            y_grid.num_points() + y_grid.num_intervals(),
-            NodeId::invalid());
-        create_bricks(
-            plc,
-            element_type,
-            x_grid, y_grid,
-            z_lower->first, z_upper->first,
-            volume_ids,
-            &node_ids, &node_ids_2,
-            &mesh);
-        node_ids = std::move(node_ids_2);
-
-        z_lower = z_upper;
+    for (NaiveBricksChunk &chunk : chunks) {
+        stitch_chunk(x_grid, y_grid, &chunk, &node_ids, &mesh);
     }
 
+    BrickGrid bricks(x_grid, y_grid, z_grid, mesh);
     update_face_attrs(
         plc,
         Dimension::X, Dimension::Y, Dimension::Z,
         0, 1,
-        x_triangles, y_grid, z_triangles,
+        x_grid, y_grid, z_grid, bricks,
         &mesh);
     update_face_attrs(
         plc,
         Dimension::Y, Dimension::Z, Dimension::X,
         5, 3,
-        y_grid, z_grid, x_triangles,
+        y_grid, z_grid, x_grid, bricks,
         &mesh);
     update_face_attrs(
         plc,
         Dimension::Z, Dimension::X, Dimension::Y,
         2, 4,
-        z_grid, x_grid, y_triangles,
+        z_grid, x_grid, y_grid, bricks,
         &mesh);
 
     update_node_attrs(plc, &mesh);
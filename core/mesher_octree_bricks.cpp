@@ -0,0 +1,701 @@
+#include "mesher_octree_bricks.hpp"
+
+#include <math.h>
+
+#include <algorithm>
+#include <map>
+
+#include "mesher_naive_bricks.hpp"
+#include "parallel.hpp"
+
+namespace os2cx {
+
+static const Plc3::SurfaceId SURFACE_ID_UNSET = -1;
+
+/* How fast the element size may grow with distance from a vertex of the Plc3;
+the same as compute_sizing_field() uses along the edges of the Plc3. */
+static const double grading = 0.5;
+
+/* A safety net in case a size target is unreasonably small */
+static const int max_refinement_level = 24;
+
+/* Shape function weights smaller than this are dropped from the equations */
+static const double min_equation_weight = 1e-12;
+
+/* Face indices of a brick, by axis and by side, matching the numbering that
+mesher_naive_bricks() uses */
+static const int brick_faces[3][2] = {{5, 3}, {2, 4}, {0, 1}};
+
+class LessPoint {
+public:
+    bool operator()(Point p1, Point p2) const {
+        return
+            (p1.x < p2.x) ||
+            (p1.x == p2.x && p1.y < p2.y) ||
+            (p1.x == p2.x && p1.y == p2.y && p1.z < p2.z);
+    }
+};
+
+/* The coarsest grid that conforms to the Plc3: the planes through all of its
+vertices, along each axis. */
+class BaseGrid {
+public:
+    int num_intervals(int axis) const {
+        return points[axis].size() - 1;
+    }
+
+    /* Returns the index of the grid point along 'axis' that is exactly 'p' */
+    int find_point(int axis, double p) const {
+        auto it = std::lower_bound(points[axis].begin(), points[axis].end(), p);
+        assert(it != points[axis].end() && *it == p);
+        return it - points[axis].begin();
+    }
+
+    /* Index into face_surfaces[w]: the cell face on the w_index'th plane along
+    axis 'w', in the given intervals along the other two axes. */
+    int face_offset(int w, int w_index, int u_index, int v_index) const {
+        int u = (w + 1) % 3;
+        return w_index + points[w].size() * (
+            u_index + num_intervals(u) * v_index);
+    }
+
+    int cell_offset(const int cell[3]) const {
+        return cell[0] + num_intervals(0) * (
+            cell[1] + num_intervals(1) * cell[2]);
+    }
+
+    std::vector<double> points[3];
+
+    /* The surface that each cell face lies on, or SURFACE_ID_UNSET */
+    std::vector<Plc3::SurfaceId> face_surfaces[3];
+
+    /* The volume that each cell lies in */
+    std::vector<Plc3::VolumeId> cell_volumes;
+};
+
+/* Returns true if (pu, pv) lies in the triangle, or on its edges */
+static bool triangle_contains(
+    double pu, double pv,
+    const double tu[3], const double tv[3]
+) {
+    double area = (tu[1] - tu[0]) * (tv[2] - tv[0])
+        - (tu[2] - tu[0]) * (tv[1] - tv[0]);
+    double epsilon = fabs(area) * 1e-10;
+    for (int i = 0; i < 3; ++i) {
+        int j = (i + 1) % 3;
+        double side = (tu[j] - tu[i]) * (pv - tv[i])
+            - (tv[j] - tv[i]) * (pu - tu[i]);
+        if (area > 0 ? side < -epsilon : side > epsilon) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Builds the base grid, records which cell faces each triangle of the Plc3
+covers, and sweeps along Z to find the volume of every cell. */
+static BaseGrid setup_base_grid(const Plc3 &plc) {
+    BaseGrid grid;
+    for (const Plc3::Vertex &vertex : plc.vertices) {
+        grid.points[0].push_back(vertex.point.x);
+        grid.points[1].push_back(vertex.point.y);
+        grid.points[2].push_back(vertex.point.z);
+    }
+    for (int axis = 0; axis < 3; ++axis) {
+        std::vector<double> *points = &grid.points[axis];
+        std::sort(points->begin(), points->end());
+        points->erase(std::unique(points->begin(), points->end()),
+            points->end());
+    }
+
+    for (const Plc3::Border &border : plc.borders) {
+        for (int i = 0; i < static_cast<int>(border.vertices.size() - 1); ++i) {
+            Point p0 = plc.vertices[border.vertices[i]].point;
+            Point p1 = plc.vertices[border.vertices[i + 1]].point;
+            int num_equal = (p0.x == p1.x) + (p0.y == p1.y) + (p0.z == p1.z);
+            if (num_equal < 2) {
+                throw NaiveBricksAlignmentError(p0, p1);
+            }
+        }
+    }
+
+    for (int w = 0; w < 3; ++w) {
+        int u = (w + 1) % 3, v = (w + 2) % 3;
+        grid.face_surfaces[w].assign(
+            grid.points[w].size() * grid.num_intervals(u) *
+                grid.num_intervals(v),
+            SURFACE_ID_UNSET);
+    }
+    /* For the faces along Z, the volume on the positive-Z side */
+    std::vector<Plc3::VolumeId> z_face_volumes(
+        grid.face_surfaces[2].size(), plc.volume_outside);
+
+    for (Plc3::SurfaceId sid = 0;
+            sid < static_cast<int>(plc.surfaces.size()); ++sid) {
+        const Plc3::Surface &surface = plc.surfaces[sid];
+        for (const Plc3::Surface::Triangle &tri : surface.triangles) {
+            Point p[3];
+            for (int i = 0; i < 3; ++i) {
+                p[i] = plc.vertices[tri.vertices[i]].point;
+            }
+            int w = -1;
+            for (int axis = 0; axis < 3; ++axis) {
+                Dimension dim = static_cast<Dimension>(axis);
+                if (p[0].at(dim) == p[1].at(dim) &&
+                        p[0].at(dim) == p[2].at(dim)) {
+                    w = axis;
+                    break;
+                }
+            }
+            if (w == -1) {
+                throw NaiveBricksAlignmentError(p[0], p[1], p[2]);
+            }
+            int u = (w + 1) % 3, v = (w + 2) % 3;
+            Dimension dim_u = static_cast<Dimension>(u);
+            Dimension dim_v = static_cast<Dimension>(v);
+            Dimension dim_w = static_cast<Dimension>(w);
+
+            Plc3::VolumeId volume_after =
+                ((p[1] - p[0]).cross(p[2] - p[0]).at(dim_w) < 0)
+                ? surface.volumes[1] : surface.volumes[0];
+
+            double tu[3], tv[3];
+            for (int i = 0; i < 3; ++i) {
+                tu[i] = p[i].at(dim_u);
+                tv[i] = p[i].at(dim_v);
+            }
+            int w_index = grid.find_point(w, p[0].at(dim_w));
+            int u_begin = grid.find_point(u, *std::min_element(tu, tu + 3));
+            int u_end = grid.find_point(u, *std::max_element(tu, tu + 3));
+            int v_begin = grid.find_point(v, *std::min_element(tv, tv + 3));
+            int v_end = grid.find_point(v, *std::max_element(tv, tv + 3));
+            for (int u_index = u_begin; u_index < u_end; ++u_index) {
+                double uc = (grid.points[u][u_index]
+                    + grid.points[u][u_index + 1]) / 2;
+                for (int v_index = v_begin; v_index < v_end; ++v_index) {
+                    double vc = (grid.points[v][v_index]
+                        + grid.points[v][v_index + 1]) / 2;
+                    if (!triangle_contains(uc, vc, tu, tv)) {
+                        continue;
+                    }
+                    int offset = grid.face_offset(w, w_index, u_index, v_index);
+                    grid.face_surfaces[w][offset] = sid;
+                    if (w == 2) {
+                        z_face_volumes[offset] = volume_after;
+                    }
+                }
+            }
+        }
+    }
+
+    int nx = grid.num_intervals(0), ny = grid.num_intervals(1);
+    int nz = grid.num_intervals(2);
+    grid.cell_volumes.assign(nx * ny * nz, plc.volume_outside);
+    for (int x = 0; x < nx; ++x) {
+        for (int y = 0; y < ny; ++y) {
+            Plc3::VolumeId volume = plc.volume_outside;
+            for (int z = 0; z < nz; ++z) {
+                int offset = grid.face_offset(2, z, x, y);
+                if (grid.face_surfaces[2][offset] != SURFACE_ID_UNSET) {
+                    volume = z_face_volumes[offset];
+                }
+                int cell[3] = {x, y, z};
+                grid.cell_volumes[grid.cell_offset(cell)] = volume;
+            }
+        }
+    }
+
+    return grid;
+}
+
+/* A box in the octree of one base cell. The cell is subdivided in levels; at
+level 'n', 'h' is the base cell's longest side divided by 2^n, and the cell is
+split along every axis where the base cell's side would otherwise be longer
+than 'h'. Because the number of splits along an axis only depends on the length
+of that side of the base cell and on 'h', two cells that share a face always
+subdivide it into nested rectangles, even if they're in different base cells. */
+class OctreeCell {
+public:
+    double lower[3], upper[3];
+    int level;
+    /* The cells created by splitting this one, or none for a leaf */
+    int children_begin, children_end;
+    ElementId element_id;
+};
+
+/* The octree for one base cell */
+class OctreeRoot {
+public:
+    int base_cell[3];
+    Plc3::VolumeId volume;
+    int cell_index;
+};
+
+/* Returns how many times the side 'length' must be halved until it's no longer
+than 'h' */
+static int num_splits(double length, double h) {
+    int splits = 0;
+    while (length > h) {
+        length /= 2;
+        ++splits;
+    }
+    return splits;
+}
+
+class OctreeMesher {
+public:
+    OctreeMesher(
+        const Plc3 &plc_,
+        const BaseGrid &grid_,
+        MaxElementSize max_element_size_default_,
+        const AttrOverrides<MaxElementSize> &max_element_size_overrides_,
+        const std::vector<Length> *vertex_sizes,
+        ElementType element_type_
+    ) :
+        plc(plc_),
+        grid(grid_),
+        max_element_size_default(max_element_size_default_),
+        max_element_size_overrides(max_element_size_overrides_),
+        element_type(element_type_)
+    {
+        if (vertex_sizes != nullptr) {
+            assert(vertex_sizes->size() == plc.vertices.size());
+            for (Plc3::VertexId vid = 0;
+                    vid < static_cast<int>(plc.vertices.size()); ++vid) {
+                sized_vertices.push_back(
+                    std::make_pair((*vertex_sizes)[vid], vid));
+            }
+            std::sort(sized_vertices.begin(), sized_vertices.end());
+        }
+    }
+
+    void build_octrees() {
+        int cell[3];
+        for (cell[2] = 0; cell[2] < grid.num_intervals(2); ++cell[2]) {
+            for (cell[1] = 0; cell[1] < grid.num_intervals(1); ++cell[1]) {
+                for (cell[0] = 0; cell[0] < grid.num_intervals(0); ++cell[0]) {
+                    Plc3::VolumeId volume =
+                        grid.cell_volumes[grid.cell_offset(cell)];
+                    if (volume == plc.volume_outside) {
+                        continue;
+                    }
+                    OctreeRoot root;
+                    std::copy(cell, cell + 3, root.base_cell);
+                    root.volume = volume;
+                    root.cell_index = cells.size();
+                    OctreeCell root_cell;
+                    for (int axis = 0; axis < 3; ++axis) {
+                        root_cell.lower[axis] = grid.points[axis][cell[axis]];
+                        root_cell.upper[axis] =
+                            grid.points[axis][cell[axis] + 1];
+                    }
+                    root_cell.level = 0;
+                    cells.push_back(root_cell);
+                    roots.push_back(root);
+                    subdivide(root, root.cell_index);
+                }
+            }
+        }
+    }
+
+    void create_elements(Mesh3 *mesh) {
+        for (const OctreeRoot &root : roots) {
+            create_elements(root, root.cell_index, mesh);
+        }
+        for (const Plc3::Vertex &vertex : plc.vertices) {
+            auto it = nodes_by_point.find(vertex.point);
+            if (it != nodes_by_point.end()) {
+                mesh->nodes[it->second].attrs = vertex.attrs;
+            }
+        }
+    }
+
+    void create_equations(
+        const Mesh3 &mesh,
+        std::vector<LinearEquation> *equations_out
+    );
+
+private:
+    typedef std::vector<std::pair<NodeId, double> > Weights;
+
+    /* The element size that the volume and the nearby vertices ask for,
+    anywhere in the box */
+    double target_size(const OctreeRoot &root, const OctreeCell &cell) const {
+        double size = max_element_size_overrides.lookup(
+            plc.volumes[root.volume].attrs, max_element_size_default);
+        for (const auto &pair : sized_vertices) {
+            if (pair.first >= size) {
+                break;
+            }
+            Point point = plc.vertices[pair.second].point;
+            double distance_sq = 0;
+            for (int axis = 0; axis < 3; ++axis) {
+                double p = point.at(static_cast<Dimension>(axis));
+                double d = std::max(0.0, std::max(
+                    cell.lower[axis] - p, p - cell.upper[axis]));
+                distance_sq += d * d;
+            }
+            size = std::min(size, pair.first + grading * sqrt(distance_sq));
+        }
+        return size;
+    }
+
+    void subdivide(const OctreeRoot &root, int cell_index) {
+        double base_lengths[3], base_max = 0;
+        for (int axis = 0; axis < 3; ++axis) {
+            base_lengths[axis] =
+                grid.points[axis][root.base_cell[axis] + 1] -
+                grid.points[axis][root.base_cell[axis]];
+            base_max = std::max(base_max, base_lengths[axis]);
+        }
+
+        double target = target_size(root, cells[cell_index]);
+        int level = cells[cell_index].level;
+        double h = ldexp(base_max, -level);
+        bool split[3] = {false, false, false};
+        while (h > target && level < max_refinement_level) {
+            ++level;
+            double next_h = h / 2;
+            for (int axis = 0; axis < 3; ++axis) {
+                split[axis] = num_splits(base_lengths[axis], next_h) >
+                    num_splits(base_lengths[axis], h);
+            }
+            h = next_h;
+            if (split[0] || split[1] || split[2]) {
+                break;
+            }
+        }
+        cells[cell_index].level = level;
+        cells[cell_index].children_begin = cells.size();
+        if (!split[0] && !split[1] && !split[2]) {
+            cells[cell_index].children_end = cells.size();
+            return;
+        }
+
+        OctreeCell parent = cells[cell_index];
+        for (int octant = 0; octant < 8; ++octant) {
+            OctreeCell child = parent;
+            bool skip = false;
+            for (int axis = 0; axis < 3; ++axis) {
+                bool upper_half = (octant >> axis) & 1;
+                if (!split[axis]) {
+                    skip = skip || upper_half;
+                    continue;
+                }
+                double middle = (parent.lower[axis] + parent.upper[axis]) / 2;
+                if (upper_half) {
+                    child.lower[axis] = middle;
+                } else {
+                    child.upper[axis] = middle;
+                }
+            }
+            if (!skip) {
+                cells.push_back(child);
+            }
+        }
+        int children_begin = cells[cell_index].children_begin;
+        int children_end = cells.size();
+        cells[cell_index].children_end = children_end;
+        for (int child = children_begin; child < children_end; ++child) {
+            subdivide(root, child);
+        }
+    }
+
+    NodeId create_node(Point point, Mesh3 *mesh) {
+        auto it = nodes_by_point.find(point);
+        if (it != nodes_by_point.end()) {
+            return it->second;
+        }
+        Node3 node;
+        node.point = point;
+        NodeId node_id = mesh->nodes.push_back(node);
+        nodes_by_point[point] = node_id;
+        return node_id;
+    }
+
+    void create_elements(const OctreeRoot &root, int cell_index, Mesh3 *mesh) {
+        OctreeCell &cell = cells[cell_index];
+        if (cell.children_begin != cell.children_end) {
+            for (int child = cell.children_begin; child < cell.children_end;
+                    ++child) {
+                create_elements(root, child, mesh);
+            }
+            return;
+        }
+
+        const ElementTypeShape &shape = element_type_shape(element_type);
+        Element3 element;
+        element.type = element_type;
+        for (int i = 0; i < static_cast<int>(shape.vertices.size()); ++i) {
+            /* Map the vertex's (U, V, W) coordinates in [-1, 1] onto the
+            cell */
+            ElementTypeShape::ShapePoint uvw = shape.vertices[i].uvw;
+            double coords[3] = {uvw.x, uvw.y, uvw.z};
+            for (int axis = 0; axis < 3; ++axis) {
+                if (coords[axis] < 0) {
+                    coords[axis] = cell.lower[axis];
+                } else if (coords[axis] > 0) {
+                    coords[axis] = cell.upper[axis];
+                } else {
+                    coords[axis] = (cell.lower[axis] + cell.upper[axis]) / 2;
+                }
+            }
+            element.nodes[i] = create_node(
+                Point(coords[0], coords[1], coords[2]), mesh);
+        }
+
+        element.attrs = plc.volumes[root.volume].attrs;
+        for (int w = 0; w < 3; ++w) {
+            int u = (w + 1) % 3, v = (w + 2) % 3;
+            for (int side = 0; side < 2; ++side) {
+                int face = brick_faces[w][side];
+                element.face_attrs[face] = element.attrs;
+                double coord = side ? cell.upper[w] : cell.lower[w];
+                int w_index = root.base_cell[w] + side;
+                if (coord != grid.points[w][w_index]) {
+                    /* The face is inside the base cell */
+                    continue;
+                }
+                Plc3::SurfaceId sid = grid.face_surfaces[w][grid.face_offset(
+                    w, w_index, root.base_cell[u], root.base_cell[v])];
+                if (sid != SURFACE_ID_UNSET) {
+                    element.face_attrs[face] = plc.surfaces[sid].attrs;
+                }
+            }
+        }
+
+        cell.element_id = mesh->elements.push_back(element);
+    }
+
+    /* Finds a leaf whose closed box contains 'point' but whose element doesn't
+    have 'node_id' as a node, and returns the weights of that element's
+    shape functions at 'point'. Returns false if there isn't one, i.e. the node
+    isn't hanging. */
+    bool find_hanging_weights(
+        const Mesh3 &mesh,
+        NodeId node_id,
+        Weights *weights_out
+    ) const;
+
+    bool find_hanging_weights_in_cell(
+        const Mesh3 &mesh,
+        NodeId node_id,
+        int cell_index,
+        Weights *weights_out
+    ) const;
+
+    /* Expands the weights of 'node_id' in terms of nodes that aren't hanging,
+    substituting hanging masters by their own weights. */
+    const Weights &resolve_weights(NodeId node_id);
+
+    const Plc3 &plc;
+    const BaseGrid &grid;
+    MaxElementSize max_element_size_default;
+    const AttrOverrides<MaxElementSize> &max_element_size_overrides;
+    ElementType element_type;
+
+    /* The vertices of the Plc3 that have a size target, smallest first */
+    std::vector<std::pair<Length, Plc3::VertexId> > sized_vertices;
+
+    std::vector<OctreeCell> cells;
+    std::vector<OctreeRoot> roots;
+    std::map<Point, NodeId, LessPoint> nodes_by_point;
+
+    /* Indices into 'roots' by base cell, or -1 if the base cell is outside */
+    std::vector<int> root_indices;
+
+    /* For each node, the weights of the nodes that it's tied to; empty if the
+    node isn't hanging */
+    ContiguousMap<NodeId, Weights> direct_weights;
+    ContiguousMap<NodeId, Weights> resolved_weights;
+    ContiguousMap<NodeId, int> resolve_state;
+};
+
+bool OctreeMesher::find_hanging_weights_in_cell(
+    const Mesh3 &mesh,
+    NodeId node_id,
+    int cell_index,
+    Weights *weights_out
+) const {
+    const OctreeCell &cell = cells[cell_index];
+    Point point = mesh.nodes[node_id].point;
+    for (int axis = 0; axis < 3; ++axis) {
+        double p = point.at(static_cast<Dimension>(axis));
+        if (p < cell.lower[axis] || p > cell.upper[axis]) {
+            return false;
+        }
+    }
+    if (cell.children_begin != cell.children_end) {
+        for (int child = cell.children_begin; child < cell.children_end;
+                ++child) {
+            if (find_hanging_weights_in_cell(
+                    mesh, node_id, child, weights_out)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    ConstElement3Ref element = mesh.elements[cell.element_id];
+    const ElementTypeShape &shape = element_type_shape(element.type);
+    int num_vertices = shape.vertices.size();
+    for (int i = 0; i < num_vertices; ++i) {
+        if (element.nodes[i] == node_id) {
+            return false;
+        }
+    }
+
+    /* The brick's (U, V, W) coordinates run from -1 to 1 along X, Y, Z */
+    double coords[3];
+    for (int axis = 0; axis < 3; ++axis) {
+        double p = point.at(static_cast<Dimension>(axis));
+        coords[axis] = 2 * (p - cell.lower[axis])
+            / (cell.upper[axis] - cell.lower[axis]) - 1;
+    }
+    double sf[ElementTypeShape::max_vertices_per_element];
+    shape.shape_functions(
+        ElementTypeShape::ShapePoint(coords[0], coords[1], coords[2]), sf);
+    weights_out->clear();
+    for (int i = 0; i < num_vertices; ++i) {
+        if (fabs(sf[i]) > min_equation_weight) {
+            weights_out->push_back(std::make_pair(element.nodes[i], sf[i]));
+        }
+    }
+    return true;
+}
+
+bool OctreeMesher::find_hanging_weights(
+    const Mesh3 &mesh,
+    NodeId node_id,
+    Weights *weights_out
+) const {
+    /* The node may lie on the boundary between up to eight base cells */
+    Point point = mesh.nodes[node_id].point;
+    int begin[3], end[3];
+    for (int axis = 0; axis < 3; ++axis) {
+        const std::vector<double> &points = grid.points[axis];
+        double p = point.at(static_cast<Dimension>(axis));
+        int index = std::upper_bound(points.begin(), points.end(), p)
+            - points.begin() - 1;
+        begin[axis] = std::max(0, (points[index] == p) ? index - 1 : index);
+        end[axis] = std::min(index + 1, grid.num_intervals(axis));
+    }
+    int cell[3];
+    for (cell[2] = begin[2]; cell[2] < end[2]; ++cell[2]) {
+        for (cell[1] = begin[1]; cell[1] < end[1]; ++cell[1]) {
+            for (cell[0] = begin[0]; cell[0] < end[0]; ++cell[0]) {
+                int root_index = root_indices[grid.cell_offset(cell)];
+                if (root_index == -1) continue;
+                if (find_hanging_weights_in_cell(mesh, node_id,
+                        roots[root_index].cell_index, weights_out)) {
+                    return true;
+                }
+            }
+        }
+    }
+    return false;
+}
+
+const OctreeMesher::Weights &OctreeMesher::resolve_weights(NodeId node_id) {
+    enum { Unvisited = 0, InProgress = 1, Done = 2 };
+    if (resolve_state[node_id] == Done) {
+        return resolved_weights[node_id];
+    }
+    /* A hanging node's masters belong to a larger element than the one it's a
+    corner of, so following them always leads to larger elements */
+    assert(resolve_state[node_id] == Unvisited);
+    resolve_state[node_id] = InProgress;
+
+    std::map<NodeId, double> weights;
+    for (const auto &pair : direct_weights[node_id]) {
+        if (direct_weights[pair.first].empty()) {
+            weights[pair.first] += pair.second;
+        } else {
+            for (const auto &sub_pair : resolve_weights(pair.first)) {
+                weights[sub_pair.first] += pair.second * sub_pair.second;
+            }
+        }
+    }
+    Weights *resolved = &resolved_weights[node_id];
+    for (const auto &pair : weights) {
+        if (fabs(pair.second) > min_equation_weight) {
+            resolved->push_back(pair);
+        }
+    }
+    resolve_state[node_id] = Done;
+    return *resolved;
+}
+
+void OctreeMesher::create_equations(
+    const Mesh3 &mesh,
+    std::vector<LinearEquation> *equations_out
+) {
+    root_indices.assign(grid.cell_volumes.size(), -1);
+    for (int i = 0; i < static_cast<int>(roots.size()); ++i) {
+        root_indices[grid.cell_offset(roots[i].base_cell)] = i;
+    }
+
+    direct_weights = ContiguousMap<NodeId, Weights>(
+        mesh.nodes.key_begin(), mesh.nodes.key_end(), Weights());
+    static const int chunk_size = 1024;
+    int begin_index = mesh.nodes.key_begin().to_int();
+    parallel_for(mesh.nodes.size(), chunk_size, [&](int begin, int end) {
+        for (int index = begin; index < end; ++index) {
+            NodeId node_id = NodeId::from_int(begin_index + index);
+            find_hanging_weights(mesh, node_id, &direct_weights[node_id]);
+        }
+    });
+
+    resolved_weights = ContiguousMap<NodeId, Weights>(
+        mesh.nodes.key_begin(), mesh.nodes.key_end(), Weights());
+    resolve_state = ContiguousMap<NodeId, int>(
+        mesh.nodes.key_begin(), mesh.nodes.key_end(), 0);
+    for (NodeId node_id = mesh.nodes.key_begin();
+            node_id != mesh.nodes.key_end(); ++node_id) {
+        if (direct_weights[node_id].empty()) continue;
+        const Weights &weights = resolve_weights(node_id);
+        for (int axis = 0; axis < 3; ++axis) {
+            Dimension dim = static_cast<Dimension>(axis);
+            LinearEquation equation;
+            equation.terms[LinearEquation::Variable(node_id, dim)] = 1;
+            for (const auto &pair : weights) {
+                equation.terms[LinearEquation::Variable(pair.first, dim)] =
+                    -pair.second;
+            }
+            equations_out->push_back(equation);
+        }
+    }
+}
+
+Mesh3 mesher_octree_bricks(
+    const Plc3 &plc,
+    MaxElementSize max_element_size_default,
+    const AttrOverrides<MaxElementSize> &max_element_size_overrides,
+    const std::vector<Length> *vertex_sizes,
+    ElementType element_type,
+    std::vector<LinearEquation> *equations_out
+) {
+    if (element_type != ElementType::C3D8 &&
+            element_type != ElementType::C3D20 &&
+            element_type != ElementType::C3D20R &&
+            element_type != ElementType::C3D20RI
+    ) {
+        throw std::domain_error("octree_bricks mesher only supports "
+            "element_type C3D8, C3D20, C3D20R, or C3D20RI");
+    }
+
+    Mesh3 mesh;
+    if (plc.vertices.empty()) {
+        return mesh;
+    }
+
+    BaseGrid grid = setup_base_grid(plc);
+    OctreeMesher mesher(plc, grid, max_element_size_default,
+        max_element_size_overrides, vertex_sizes, element_type);
+    mesher.build_octrees();
+    mesher.create_elements(&mesh);
+    mesher.create_equations(mesh, equations_out);
+    return mesh;
+}
+
+} /* namespace os2cx */
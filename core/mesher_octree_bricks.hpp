@@ -0,0 +1,39 @@
+#ifndef OS2CX_MESHER_OCTREE_BRICKS_HPP_
+#define OS2CX_MESHER_OCTREE_BRICKS_HPP_
+
+#include <vector>
+
+#include "compute_attrs.hpp"
+#include "mesh.hpp"
+#include "plc.hpp"
+
+namespace os2cx {
+
+/* Meshes 'plc' with bricks that are refined only where they need to be. Like
+mesher_naive_bricks(), every surface of 'plc' must be aligned with the X/Y/Z
+axes, or NaiveBricksAlignmentError is thrown.
+
+The planes through the vertices of 'plc' cut its bounding box into a coarse
+grid of base cells, each of which lies within a single volume. Each base cell
+is then split octree-style, halving its longest sides, until it's no larger
+than the element size that applies there: the max_element_size for its volume,
+or, if 'vertex_sizes' is not null, the sizes at the nearby vertices of 'plc',
+growing with distance as in compute_sizing_field().
+
+Where a small brick meets a larger one, the small brick's nodes on the shared
+face are "hanging" nodes that the larger brick doesn't have. For each hanging
+node, three linear equations that tie its displacement to the shape functions
+of the larger brick are appended to 'equations_out'; the mesh is only conforming
+once they are applied. The equations always refer to nodes that aren't hanging
+themselves. */
+Mesh3 mesher_octree_bricks(
+    const Plc3 &plc,
+    MaxElementSize max_element_size_default,
+    const AttrOverrides<MaxElementSize> &max_element_size_overrides,
+    const std::vector<Length> *vertex_sizes,
+    ElementType element_type,
+    std::vector<LinearEquation> *equations_out);
+
+} /* namespace os2cx */
+
+#endif /* OS2CX_MESHER_OCTREE_BRICKS_HPP_ */
@@ -0,0 +1,1002 @@
+#include "mesher_sweep.internal.hpp"
+
+#include <math.h>
+
+#include <algorithm>
+#include <array>
+#include <deque>
+#include <functional>
+#include <map>
+
+namespace os2cx {
+
+/* Twice the signed area of the triangle (a, b, c); positive if it's
+counterclockwise */
+static double orientation(SweepPoint a, SweepPoint b, SweepPoint c) {
+    return (b.u - a.u) * (c.v - a.v) - (b.v - a.v) * (c.u - a.u);
+}
+
+/* Positive if 'd' lies inside the circumcircle of the counterclockwise
+triangle (a, b, c). Returns zero if the four points are so close to cocircular
+that rounding errors could change the sign; otherwise, the many cocircular
+points on round parts could make edges flip back and forth forever. */
+static double in_circle(
+    SweepPoint a, SweepPoint b, SweepPoint c, SweepPoint d
+) {
+    double adu = a.u - d.u, adv = a.v - d.v;
+    double bdu = b.u - d.u, bdv = b.v - d.v;
+    double cdu = c.u - d.u, cdv = c.v - d.v;
+    double a_sq = adu * adu + adv * adv;
+    double b_sq = bdu * bdu + bdv * bdv;
+    double c_sq = cdu * cdu + cdv * cdv;
+    double det = a_sq * (bdu * cdv - cdu * bdv)
+        + b_sq * (cdu * adv - adu * cdv)
+        + c_sq * (adu * bdv - bdu * adv);
+    double permanent = a_sq * (fabs(bdu * cdv) + fabs(cdu * bdv))
+        + b_sq * (fabs(cdu * adv) + fabs(adu * cdv))
+        + c_sq * (fabs(adu * bdv) + fabs(bdu * adv));
+    return (fabs(det) <= 1e-12 * permanent) ? 0 : det;
+}
+
+static double distance(SweepPoint a, SweepPoint b) {
+    return hypot(b.u - a.u, b.v - a.v);
+}
+
+static SweepPoint circumcenter(SweepPoint a, SweepPoint b, SweepPoint c) {
+    double bu = b.u - a.u, bv = b.v - a.v;
+    double cu = c.u - a.u, cv = c.v - a.v;
+    double d = 2 * (bu * cv - bv * cu);
+    double b_sq = bu * bu + bv * bv, c_sq = cu * cu + cv * cv;
+    return SweepPoint(
+        a.u + (cv * b_sq - bv * c_sq) / d,
+        a.v + (bu * c_sq - cu * b_sq) / d);
+}
+
+/* The limit on the ratio of a triangle's circumradius to its shortest edge;
+sqrt(2) guarantees that no angle is smaller than about 20.7 degrees. */
+static const double max_radius_edge_ratio = sqrt(2.0);
+
+/* Triangles aren't refined for quality, nor segments split because they're
+encroached, below this fraction of the element size. This guarantees that the
+refinement terminates even where the input has small angles. */
+static const double min_edge_fraction = 1e-3;
+
+/* A safety net in case the refinement runs away anyway */
+static const int max_refinement_points = 10000000;
+
+/* Two triangles are only merged into a quadrilateral if all of its angles are
+within this many radians of a right angle. */
+static const double max_quad_angle_deviation = M_PI / 4;
+
+void CrossSection::fix_neighbor(int tri_index, int a, int b, int new_neighbor) {
+    if (tri_index == -1) return;
+    Triangle *tri = &triangles[tri_index];
+    for (int i = 0; i < 3; ++i) {
+        int ea = tri->vertices[(i + 1) % 3], eb = tri->vertices[(i + 2) % 3];
+        if ((ea == a && eb == b) || (ea == b && eb == a)) {
+            tri->neighbors[i] = new_neighbor;
+            return;
+        }
+    }
+    assert(false);
+}
+
+void CrossSection::set_triangle(
+    int tri_index,
+    int a, int b, int c,
+    int na, int nb, int nc,
+    int sa, int sb, int sc,
+    int region
+) {
+    if (tri_index == static_cast<int>(triangles.size())) {
+        triangles.push_back(Triangle());
+    }
+    Triangle *tri = &triangles[tri_index];
+    tri->vertices[0] = a;
+    tri->vertices[1] = b;
+    tri->vertices[2] = c;
+    tri->neighbors[0] = na;
+    tri->neighbors[1] = nb;
+    tri->neighbors[2] = nc;
+    tri->segments[0] = sa;
+    tri->segments[1] = sb;
+    tri->segments[2] = sc;
+    tri->region = region;
+    touched.push_back(tri_index);
+}
+
+/* Replaces the triangles (p, a, b) and (q, b, a) on either side of the edge
+opposite vertex 'edge' of 'tri_index' by (p, a, q) and (q, b, p) */
+void CrossSection::flip(int tri_index, int edge) {
+    Triangle t = triangles[tri_index];
+    int n_index = t.neighbors[edge];
+    Triangle n = triangles[n_index];
+    int j = 0;
+    while (n.neighbors[j] != tri_index) ++j;
+    int p = t.vertices[edge];
+    int a = t.vertices[(edge + 1) % 3];
+    int b = t.vertices[(edge + 2) % 3];
+    int q = n.vertices[j];
+    assert(n.vertices[(j + 1) % 3] == b && n.vertices[(j + 2) % 3] == a);
+
+    set_triangle(tri_index, p, a, q,
+        n.neighbors[(j + 1) % 3], n_index, t.neighbors[(edge + 2) % 3],
+        n.segments[(j + 1) % 3], -1, t.segments[(edge + 2) % 3],
+        t.region);
+    set_triangle(n_index, q, b, p,
+        t.neighbors[(edge + 1) % 3], tri_index, n.neighbors[(j + 2) % 3],
+        t.segments[(edge + 1) % 3], -1, n.segments[(j + 2) % 3],
+        n.region);
+    fix_neighbor(n.neighbors[(j + 1) % 3], a, q, tri_index);
+    fix_neighbor(t.neighbors[(edge + 1) % 3], b, p, n_index);
+}
+
+/* Restores the Delaunay property around the newly inserted 'vertex', which is
+a vertex of 'tri_index', by flipping edges away from it */
+void CrossSection::legalize(int tri_index, int vertex) {
+    std::vector<int> stack;
+    stack.push_back(tri_index);
+    while (!stack.empty()) {
+        int t_index = stack.back();
+        stack.pop_back();
+        const Triangle &t = triangles[t_index];
+        int i = 0;
+        while (t.vertices[i] != vertex) ++i;
+        int n_index = t.neighbors[i];
+        if (n_index == -1 || t.segments[i] != -1) continue;
+        const Triangle &n = triangles[n_index];
+        int j = 0;
+        while (n.neighbors[j] != t_index) ++j;
+        if (in_circle(point(t, 0), point(t, 1), point(t, 2), point(n, j))
+                <= 0) {
+            continue;
+        }
+        flip(t_index, i);
+        stack.push_back(t_index);
+        stack.push_back(n_index);
+    }
+}
+
+void CrossSection::legalize_all() {
+    std::deque<std::pair<int, int> > queue;
+    for (int t = 0; t < static_cast<int>(triangles.size()); ++t) {
+        for (int i = 0; i < 3; ++i) {
+            queue.push_back(std::make_pair(t, i));
+        }
+    }
+    while (!queue.empty()) {
+        int t_index = queue.front().first, i = queue.front().second;
+        queue.pop_front();
+        const Triangle &t = triangles[t_index];
+        int n_index = t.neighbors[i];
+        if (n_index == -1 || t.segments[i] != -1) continue;
+        const Triangle &n = triangles[n_index];
+        int j = 0;
+        while (n.neighbors[j] != t_index) ++j;
+        if (in_circle(point(t, 0), point(t, 1), point(t, 2), point(n, j))
+                <= 0) {
+            continue;
+        }
+        flip(t_index, i);
+        for (int k = 0; k < 3; ++k) {
+            queue.push_back(std::make_pair(t_index, k));
+            queue.push_back(std::make_pair(n_index, k));
+        }
+    }
+}
+
+void CrossSection::split_triangle(int tri_index, SweepPoint p) {
+    int p_index = points.size();
+    points.push_back(p);
+    Triangle t = triangles[tri_index];
+    int a = t.vertices[0], b = t.vertices[1], c = t.vertices[2];
+    int t2 = triangles.size(), t3 = t2 + 1;
+    set_triangle(tri_index, a, b, p_index, t2, t3, t.neighbors[2],
+        -1, -1, t.segments[2], t.region);
+    set_triangle(t2, b, c, p_index, t3, tri_index, t.neighbors[0],
+        -1, -1, t.segments[0], t.region);
+    set_triangle(t3, c, a, p_index, tri_index, t2, t.neighbors[1],
+        -1, -1, t.segments[1], t.region);
+    fix_neighbor(t.neighbors[0], b, c, t2);
+    fix_neighbor(t.neighbors[1], c, a, t3);
+    legalize(tri_index, p_index);
+    legalize(t2, p_index);
+    legalize(t3, p_index);
+}
+
+void CrossSection::split_edge(int tri_index, int edge, SweepPoint p) {
+    int p_index = points.size();
+    points.push_back(p);
+    Triangle t = triangles[tri_index];
+    int c = t.vertices[edge];
+    int a = t.vertices[(edge + 1) % 3];
+    int b = t.vertices[(edge + 2) % 3];
+    int s = t.segments[edge];
+    int n_index = t.neighbors[edge];
+
+    int t2 = triangles.size();
+    int n2 = (n_index == -1) ? -1 : t2 + 1;
+    set_triangle(tri_index, c, a, p_index, n2, t2, t.neighbors[(edge + 2) % 3],
+        s, -1, t.segments[(edge + 2) % 3], t.region);
+    set_triangle(t2, c, p_index, b, n_index, t.neighbors[(edge + 1) % 3],
+        tri_index, s, t.segments[(edge + 1) % 3], -1, t.region);
+    fix_neighbor(t.neighbors[(edge + 1) % 3], b, c, t2);
+
+    if (n_index != -1) {
+        Triangle n = triangles[n_index];
+        int j = 0;
+        while (n.neighbors[j] != tri_index) ++j;
+        int d = n.vertices[j];
+        assert(n.vertices[(j + 1) % 3] == b && n.vertices[(j + 2) % 3] == a);
+        set_triangle(n_index, d, b, p_index, t2, n2, n.neighbors[(j + 2) % 3],
+            s, -1, n.segments[(j + 2) % 3], n.region);
+        set_triangle(n2, d, p_index, a, tri_index, n.neighbors[(j + 1) % 3],
+            n_index, s, n.segments[(j + 1) % 3], -1, n.region);
+        fix_neighbor(n.neighbors[(j + 1) % 3], a, d, n2);
+    }
+
+    legalize(tri_index, p_index);
+    legalize(t2, p_index);
+    if (n_index != -1) {
+        legalize(n_index, p_index);
+        legalize(n2, p_index);
+    }
+}
+
+/* Walks from 'start' towards 'p'. If it reaches the triangle that contains 'p',
+returns Inside, or OnEdge if 'p' lies on one of its edges. If the way is
+blocked by a segment, returns Blocked and that edge. */
+CrossSection::LocateResult CrossSection::locate(
+    int start, SweepPoint p, int *tri_out, int *edge_out
+) const {
+    int t_index = start;
+    for (int step = 0; ; ++step) {
+        assert(step <= static_cast<int>(triangles.size()));
+        const Triangle &t = triangles[t_index];
+        int next = -1, on_edge = -1;
+        for (int k = 0; k < 3; ++k) {
+            /* Rotate the starting edge so the walk can't cycle */
+            int i = (k + step) % 3;
+            double o = orientation(
+                point(t, (i + 1) % 3), point(t, (i + 2) % 3), p);
+            if (o < 0) {
+                next = i;
+                break;
+            } else if (o == 0) {
+                on_edge = i;
+            }
+        }
+        *tri_out = t_index;
+        if (next == -1) {
+            *edge_out = on_edge;
+            return (on_edge == -1) ? LocateResult::Inside
+                : LocateResult::OnEdge;
+        }
+        if (t.segments[next] != -1 || t.neighbors[next] == -1) {
+            *edge_out = next;
+            return LocateResult::Blocked;
+        }
+        t_index = t.neighbors[next];
+    }
+}
+
+/* Returns true if 'p' lies strictly inside the diametral circle of the edge */
+bool CrossSection::encroaches(int tri_index, int edge, SweepPoint p) const {
+    const Triangle &t = triangles[tri_index];
+    SweepPoint a = point(t, (edge + 1) % 3), b = point(t, (edge + 2) % 3);
+    return (a.u - p.u) * (b.u - p.u) + (a.v - p.v) * (b.v - p.v) < 0;
+}
+
+bool CrossSection::segment_needs_split(int tri_index, int edge) const {
+    const Triangle &t = triangles[tri_index];
+    double size = region_sizes[t.region];
+    double length = distance(
+        point(t, (edge + 1) % 3), point(t, (edge + 2) % 3));
+    if (length > size) {
+        return true;
+    }
+    return length > 2 * min_edge_fraction * size
+        && encroaches(tri_index, edge, point(t, edge));
+}
+
+bool CrossSection::triangle_needs_split(int tri_index) const {
+    const Triangle &t = triangles[tri_index];
+    double size = region_sizes[t.region];
+    double lengths[3];
+    int shortest = 0;
+    for (int i = 0; i < 3; ++i) {
+        lengths[i] = distance(point(t, (i + 1) % 3), point(t, (i + 2) % 3));
+        if (lengths[i] > size) {
+            return true;
+        }
+        if (lengths[i] < lengths[shortest]) {
+            shortest = i;
+        }
+    }
+    if (lengths[shortest] < min_edge_fraction * size) {
+        return false;
+    }
+    /* The smallest angle is opposite the shortest edge. If it lies between two
+    segments, it's an angle of the input that refinement can't improve. */
+    if (t.segments[(shortest + 1) % 3] != -1 &&
+            t.segments[(shortest + 2) % 3] != -1) {
+        return false;
+    }
+    double area = orientation(point(t, 0), point(t, 1), point(t, 2)) / 2;
+    double radius = lengths[0] * lengths[1] * lengths[2] / (4 * area);
+    return radius > max_radius_edge_ratio * lengths[shortest];
+}
+
+void CrossSection::split_segment(int tri_index, int edge) {
+    const Triangle &t = triangles[tri_index];
+    SweepPoint a = point(t, (edge + 1) % 3), b = point(t, (edge + 2) % 3);
+    split_edge(tri_index, edge,
+        SweepPoint((a.u + b.u) / 2, (a.v + b.v) / 2));
+}
+
+void CrossSection::insert_circumcenter(int tri_index) {
+    const Triangle &t = triangles[tri_index];
+    SweepPoint center = circumcenter(point(t, 0), point(t, 1), point(t, 2));
+    int found, edge;
+    LocateResult result = locate(tri_index, center, &found, &edge);
+
+    /* If the circumcenter is beyond a segment, or would encroach on one, split
+    the segment instead */
+    int blocking = -1, blocking_edge = -1;
+    if (result == LocateResult::Blocked ||
+            (result == LocateResult::OnEdge &&
+                triangles[found].segments[edge] != -1)) {
+        blocking = found;
+        blocking_edge = edge;
+    } else {
+        for (int i = 0; i < 3; ++i) {
+            if (triangles[found].segments[i] != -1 &&
+                    encroaches(found, i, center)) {
+                blocking = found;
+                blocking_edge = i;
+            }
+        }
+    }
+    if (blocking != -1) {
+        const Triangle &b = triangles[blocking];
+        double length = distance(point(b, (blocking_edge + 1) % 3),
+            point(b, (blocking_edge + 2) % 3));
+        if (length > 2 * min_edge_fraction * region_sizes[b.region]) {
+            split_segment(blocking, blocking_edge);
+        }
+        return;
+    }
+
+    if (result == LocateResult::OnEdge) {
+        split_edge(found, edge, center);
+    } else {
+        split_triangle(found, center);
+    }
+}
+
+void CrossSection::refine() {
+    std::deque<int> segment_queue, triangle_queue;
+    for (int t = 0; t < static_cast<int>(triangles.size()); ++t) {
+        segment_queue.push_back(t);
+        triangle_queue.push_back(t);
+    }
+    int max_points = points.size() + max_refinement_points;
+
+    while (!segment_queue.empty() || !triangle_queue.empty()) {
+        if (static_cast<int>(points.size()) > max_points) {
+            throw SweepError("sweep mesher: refinement of the cross-section "
+                "did not converge");
+        }
+        touched.clear();
+        if (!segment_queue.empty()) {
+            /* Split encroached segments before refining any triangles */
+            int t = segment_queue.front();
+            segment_queue.pop_front();
+            for (int i = 0; i < 3; ++i) {
+                if (triangles[t].segments[i] != -1 &&
+                        segment_needs_split(t, i)) {
+                    split_segment(t, i);
+                    break;
+                }
+            }
+        } else {
+            int t = triangle_queue.front();
+            triangle_queue.pop_front();
+            if (triangle_needs_split(t)) {
+                insert_circumcenter(t);
+            }
+        }
+        for (int t : touched) {
+            segment_queue.push_back(t);
+            triangle_queue.push_back(t);
+        }
+    }
+}
+
+int CrossSection::insert_point(SweepPoint p) {
+    int start = touched.empty() ? 0 : touched.back();
+    touched.clear();
+    int found, edge;
+    LocateResult result = locate(start, p, &found, &edge);
+    assert(result != LocateResult::Blocked);
+    const Triangle &t = triangles[found];
+    for (int i = 0; i < 3; ++i) {
+        if (point(t, i).u == p.u && point(t, i).v == p.v) {
+            return t.vertices[i];
+        }
+    }
+    if (result == LocateResult::OnEdge) {
+        split_edge(found, edge, p);
+    } else {
+        split_triangle(found, p);
+    }
+    return points.size() - 1;
+}
+
+std::vector<int> CrossSection::discard_outside() {
+    std::vector<int> new_triangles(triangles.size(), -1);
+    std::vector<Triangle> kept;
+    for (int t = 0; t < static_cast<int>(triangles.size()); ++t) {
+        if (triangles[t].region != -1) {
+            new_triangles[t] = kept.size();
+            kept.push_back(triangles[t]);
+        }
+    }
+
+    std::vector<int> new_points(points.size(), -1);
+    std::vector<SweepPoint> kept_points;
+    for (Triangle &tri : kept) {
+        for (int i = 0; i < 3; ++i) {
+            if (tri.neighbors[i] != -1) {
+                tri.neighbors[i] = new_triangles[tri.neighbors[i]];
+            }
+            int &vertex = tri.vertices[i];
+            if (new_points[vertex] == -1) {
+                new_points[vertex] = kept_points.size();
+                kept_points.push_back(points[vertex]);
+            }
+            vertex = new_points[vertex];
+        }
+    }
+
+    triangles = std::move(kept);
+    points = std::move(kept_points);
+    touched.clear();
+    return new_points;
+}
+
+static double quad_angle_deviation(const SweepPoint *p) {
+    double deviation = 0;
+    for (int i = 0; i < 4; ++i) {
+        SweepPoint prev = p[(i + 3) % 4], here = p[i], next = p[(i + 1) % 4];
+        double cross = orientation(here, next, prev);
+        if (cross <= 0) {
+            return HUGE_VAL;
+        }
+        double dot = (next.u - here.u) * (prev.u - here.u)
+            + (next.v - here.v) * (prev.v - here.v);
+        double angle = atan2(cross, dot);
+        deviation = std::max(deviation, fabs(angle - M_PI / 2));
+    }
+    return deviation;
+}
+
+std::vector<SweepCell> make_cells(
+    const CrossSection &cs,
+    bool make_quads
+) {
+    int num_triangles = cs.triangles.size();
+    std::vector<int> partners(num_triangles, -1);
+    if (make_quads) {
+        std::vector<std::pair<double, std::pair<int, int> > > candidates;
+        for (int t = 0; t < num_triangles; ++t) {
+            const CrossSection::Triangle &tri = cs.triangles[t];
+            for (int i = 0; i < 3; ++i) {
+                int n = tri.neighbors[i];
+                if (n < t || tri.segments[i] != -1) continue;
+                const CrossSection::Triangle &other = cs.triangles[n];
+                int j = 0;
+                while (other.neighbors[j] != t) ++j;
+                SweepPoint quad[4] = {
+                    cs.points[tri.vertices[i]],
+                    cs.points[tri.vertices[(i + 1) % 3]],
+                    cs.points[other.vertices[j]],
+                    cs.points[tri.vertices[(i + 2) % 3]]};
+                double deviation = quad_angle_deviation(quad);
+                if (deviation <= max_quad_angle_deviation) {
+                    candidates.push_back(
+                        std::make_pair(deviation, std::make_pair(t, n)));
+                }
+            }
+        }
+        std::sort(candidates.begin(), candidates.end());
+        for (const auto &candidate : candidates) {
+            int t = candidate.second.first, n = candidate.second.second;
+            if (partners[t] == -1 && partners[n] == -1) {
+                partners[t] = n;
+                partners[n] = t;
+            }
+        }
+    }
+
+    std::vector<SweepCell> cells;
+    for (int t = 0; t < num_triangles; ++t) {
+        const CrossSection::Triangle &tri = cs.triangles[t];
+        SweepCell cell;
+        cell.region = tri.region;
+        if (partners[t] == -1) {
+            cell.num_vertices = 3;
+            for (int i = 0; i < 3; ++i) {
+                cell.vertices[i] = tri.vertices[i];
+                cell.segments[i] = tri.segments[(i + 2) % 3];
+            }
+        } else if (partners[t] > t) {
+            const CrossSection::Triangle &other = cs.triangles[partners[t]];
+            int i = 0;
+            while (tri.neighbors[i] != partners[t]) ++i;
+            int j = 0;
+            while (other.neighbors[j] != t) ++j;
+            cell.num_vertices = 4;
+            cell.vertices[0] = tri.vertices[i];
+            cell.vertices[1] = tri.vertices[(i + 1) % 3];
+            cell.vertices[2] = other.vertices[j];
+            cell.vertices[3] = tri.vertices[(i + 2) % 3];
+            cell.segments[0] = tri.segments[(i + 2) % 3];
+            cell.segments[1] = other.segments[(j + 1) % 3];
+            cell.segments[2] = other.segments[(j + 2) % 3];
+            cell.segments[3] = tri.segments[(i + 1) % 3];
+        } else {
+            continue;
+        }
+        cells.push_back(cell);
+    }
+    return cells;
+}
+
+/* Finds which triangle of a set of triangles contains a given point */
+class SweepTriangleLocator {
+public:
+    SweepTriangleLocator(const std::vector<SweepPoint> &points_) :
+        points(points_) { }
+
+    void build(const std::vector<std::array<int, 3> > &triangles_) {
+        triangles = triangles_;
+        if (triangles.empty()) return;
+        u_min = v_min = HUGE_VAL;
+        double u_max = -HUGE_VAL, v_max = -HUGE_VAL;
+        for (const auto &tri : triangles) {
+            for (int vertex : tri) {
+                u_min = std::min(u_min, points[vertex].u);
+                v_min = std::min(v_min, points[vertex].v);
+                u_max = std::max(u_max, points[vertex].u);
+                v_max = std::max(v_max, points[vertex].v);
+            }
+        }
+        num_buckets = std::max(1,
+            static_cast<int>(sqrt(static_cast<double>(triangles.size()))));
+        bucket_u = std::max((u_max - u_min) / num_buckets, 1e-300);
+        bucket_v = std::max((v_max - v_min) / num_buckets, 1e-300);
+        buckets.assign(num_buckets * num_buckets, std::vector<int>());
+        for (int t = 0; t < static_cast<int>(triangles.size()); ++t) {
+            int lo[2] = {num_buckets, num_buckets}, hi[2] = {0, 0};
+            for (int vertex : triangles[t]) {
+                int bu = bucket_index(points[vertex].u, u_min, bucket_u);
+                int bv = bucket_index(points[vertex].v, v_min, bucket_v);
+                lo[0] = std::min(lo[0], bu);
+                lo[1] = std::min(lo[1], bv);
+                hi[0] = std::max(hi[0], bu);
+                hi[1] = std::max(hi[1], bv);
+            }
+            for (int bu = lo[0]; bu <= hi[0]; ++bu) {
+                for (int bv = lo[1]; bv <= hi[1]; ++bv) {
+                    buckets[bu + num_buckets * bv].push_back(t);
+                }
+            }
+        }
+    }
+
+    /* Returns the index of the triangle that contains 'p', or -1 */
+    int find(SweepPoint p) const {
+        if (triangles.empty()) return -1;
+        int bu = bucket_index(p.u, u_min, bucket_u);
+        int bv = bucket_index(p.v, v_min, bucket_v);
+        for (int t : buckets[bu + num_buckets * bv]) {
+            const auto &tri = triangles[t];
+            SweepPoint a = points[tri[0]], b = points[tri[1]];
+            SweepPoint c = points[tri[2]];
+            double area = orientation(a, b, c);
+            double epsilon = fabs(area) * 1e-9;
+            double oa = orientation(b, c, p), ob = orientation(c, a, p);
+            double oc = orientation(a, b, p);
+            if (area < 0) {
+                oa = -oa;
+                ob = -ob;
+                oc = -oc;
+            }
+            if (oa >= -epsilon && ob >= -epsilon && oc >= -epsilon) {
+                return t;
+            }
+        }
+        return -1;
+    }
+
+private:
+    int bucket_index(double x, double x_min, double bucket_size) const {
+        int index = static_cast<int>((x - x_min) / bucket_size);
+        return std::max(0, std::min(num_buckets - 1, index));
+    }
+
+    const std::vector<SweepPoint> &points;
+    std::vector<std::array<int, 3> > triangles;
+    double u_min, v_min, bucket_u, bucket_v;
+    int num_buckets;
+    std::vector<std::vector<int> > buckets;
+};
+
+/* Everything we learn about the prism from the Plc3 */
+class SweepPrism {
+public:
+    int axis, u_axis, v_axis;
+    double w_lower, w_upper;
+
+    /* The input vertices of the cross-section, which are the first
+    points of the CrossSection */
+    std::vector<SweepPoint> points;
+
+    /* For each vertex of the Plc3: the input vertex it's above or below, and
+    whether it's at the upper end */
+    std::vector<int> vertex_points;
+    std::vector<bool> vertex_upper;
+
+    /* The triangles at each end of the prism, as input vertices, and the
+    surfaces that they belong to */
+    std::vector<std::array<int, 3> > end_triangles[2];
+    std::vector<Plc3::SurfaceId> end_surfaces[2];
+
+    /* For each side edge of the prism, the surface that it belongs to */
+    std::map<std::pair<int, int>, Plc3::SurfaceId> side_surfaces;
+};
+
+static bool find_sweep_axis(const Plc3 &plc, int axis, SweepPrism *prism) {
+    Dimension dim = static_cast<Dimension>(axis);
+    prism->axis = axis;
+    prism->u_axis = (axis + 1) % 3;
+    prism->v_axis = (axis + 2) % 3;
+    Dimension u_dim = static_cast<Dimension>(prism->u_axis);
+    Dimension v_dim = static_cast<Dimension>(prism->v_axis);
+
+    prism->w_lower = prism->w_upper = plc.vertices[0].point.at(dim);
+    for (const Plc3::Vertex &vertex : plc.vertices) {
+        prism->w_lower = std::min(prism->w_lower, vertex.point.at(dim));
+        prism->w_upper = std::max(prism->w_upper, vertex.point.at(dim));
+    }
+    if (prism->w_lower == prism->w_upper) {
+        return false;
+    }
+    for (const Plc3::Vertex &vertex : plc.vertices) {
+        double w = vertex.point.at(dim);
+        if (w != prism->w_lower && w != prism->w_upper) {
+            return false;
+        }
+    }
+
+    /* Every vertex at one end must have a twin at the other end */
+    std::map<SweepPoint, int, LessSweepPoint> point_map;
+    prism->points.clear();
+    prism->vertex_points.clear();
+    prism->vertex_upper.clear();
+    for (const Plc3::Vertex &vertex : plc.vertices) {
+        SweepPoint p(vertex.point.at(u_dim), vertex.point.at(v_dim));
+        bool upper = (vertex.point.at(dim) == prism->w_upper);
+        auto it = point_map.find(p);
+        if (it == point_map.end()) {
+            it = point_map.insert(std::make_pair(p, prism->points.size()))
+                .first;
+            prism->points.push_back(p);
+        }
+        prism->vertex_points.push_back(it->second);
+        prism->vertex_upper.push_back(upper);
+    }
+    std::vector<int> ends_present(prism->points.size(), 0);
+    for (int i = 0; i < static_cast<int>(plc.vertices.size()); ++i) {
+        ends_present[prism->vertex_points[i]] |=
+            prism->vertex_upper[i] ? 2 : 1;
+    }
+    for (int ends : ends_present) {
+        if (ends != 3) {
+            return false;
+        }
+    }
+
+    prism->end_triangles[0].clear();
+    prism->end_triangles[1].clear();
+    prism->end_surfaces[0].clear();
+    prism->end_surfaces[1].clear();
+    prism->side_surfaces.clear();
+    for (Plc3::SurfaceId sid = 0;
+            sid < static_cast<int>(plc.surfaces.size()); ++sid) {
+        for (const Plc3::Surface::Triangle &tri : plc.surfaces[sid].triangles) {
+            std::array<int, 3> points;
+            int num_upper = 0;
+            for (int i = 0; i < 3; ++i) {
+                points[i] = prism->vertex_points[tri.vertices[i]];
+                num_upper += prism->vertex_upper[tri.vertices[i]];
+            }
+            if (num_upper == 0 || num_upper == 3) {
+                int end = (num_upper == 3);
+                prism->end_triangles[end].push_back(points);
+                prism->end_surfaces[end].push_back(sid);
+                continue;
+            }
+
+            /* A side triangle must be perpendicular to the ends, so its
+            vertices project onto a single edge */
+            SweepPoint p[3];
+            for (int i = 0; i < 3; ++i) {
+                p[i] = prism->points[points[i]];
+            }
+            double scale = 0;
+            for (int i = 0; i < 3; ++i) {
+                scale = std::max(scale, distance(p[i], p[(i + 1) % 3]));
+            }
+            if (fabs(orientation(p[0], p[1], p[2])) > 1e-9 * scale * scale) {
+                return false;
+            }
+            int a = points[0], b = points[1];
+            for (int i = 0; i < 3; ++i) {
+                for (int j = i + 1; j < 3; ++j) {
+                    if (distance(p[i], p[j]) == scale) {
+                        a = points[i];
+                        b = points[j];
+                    }
+                }
+            }
+            prism->side_surfaces[std::make_pair(
+                std::min(a, b), std::max(a, b))] = sid;
+        }
+    }
+    return true;
+}
+
+static CrossSection make_cross_section(
+    const Plc3 &plc,
+    const SweepPrism &prism,
+    MaxElementSize max_element_size_default,
+    const AttrOverrides<MaxElementSize> &max_element_size_overrides,
+    std::vector<Plc3::VolumeId> *region_volumes_out,
+    std::vector<Plc3::SurfaceId> *region_surfaces_out,
+    std::vector<Plc3::SurfaceId> *segment_surfaces_out
+) {
+    CrossSection cs;
+    cs.points = prism.points;
+
+    /* The lower end's triangles, oriented counterclockwise, are the initial
+    triangulation. Each combination of volume and surface is a region. */
+    std::map<std::pair<Plc3::VolumeId, Plc3::SurfaceId>, int> region_map;
+    const std::vector<std::array<int, 3> > &tris = prism.end_triangles[0];
+    std::map<std::pair<int, int>, std::pair<int, int> > edge_map;
+    for (int t = 0; t < static_cast<int>(tris.size()); ++t) {
+        Plc3::SurfaceId sid = prism.end_surfaces[0][t];
+        const Plc3::Surface &surface = plc.surfaces[sid];
+        Plc3::VolumeId volume = (surface.volumes[0] == plc.volume_outside)
+            ? surface.volumes[1] : surface.volumes[0];
+        auto key = std::make_pair(volume, sid);
+        auto it = region_map.find(key);
+        if (it == region_map.end()) {
+            it = region_map.insert(
+                std::make_pair(key, region_map.size())).first;
+            region_volumes_out->push_back(volume);
+            region_surfaces_out->push_back(sid);
+            cs.region_sizes.push_back(max_element_size_overrides.lookup(
+                plc.volumes[volume].attrs, max_element_size_default));
+        }
+
+        CrossSection::Triangle tri;
+        std::copy(tris[t].begin(), tris[t].end(), tri.vertices);
+        if (orientation(cs.points[tri.vertices[0]], cs.points[tri.vertices[1]],
+                cs.points[tri.vertices[2]]) < 0) {
+            std::swap(tri.vertices[1], tri.vertices[2]);
+        }
+        tri.region = it->second;
+        for (int i = 0; i < 3; ++i) {
+            tri.neighbors[i] = -1;
+            tri.segments[i] = -1;
+            int a = tri.vertices[(i + 1) % 3], b = tri.vertices[(i + 2) % 3];
+            auto edge_key = std::make_pair(std::min(a, b), std::max(a, b));
+            auto jt = edge_map.find(edge_key);
+            if (jt == edge_map.end()) {
+                edge_map[edge_key] = std::make_pair(t, i);
+            } else {
+                tri.neighbors[i] = jt->second.first;
+                cs.triangles[jt->second.first].neighbors[jt->second.second] =
+                    t;
+            }
+        }
+        cs.triangles.push_back(tri);
+    }
+
+    /* Edges on the boundary or between regions become segments */
+    for (const auto &pair : edge_map) {
+        int t = pair.second.first, i = pair.second.second;
+        int n = cs.triangles[t].neighbors[i];
+        if (n != -1 && cs.triangles[n].region == cs.triangles[t].region) {
+            continue;
+        }
+        auto it = prism.side_surfaces.find(pair.first);
+        int segment = segment_surfaces_out->size();
+        segment_surfaces_out->push_back(
+            (it == prism.side_surfaces.end()) ? -1 : it->second);
+        cs.triangles[t].segments[i] = segment;
+        if (n != -1) {
+            int j = 0;
+            while (cs.triangles[n].neighbors[j] != t) ++j;
+            cs.triangles[n].segments[j] = segment;
+        }
+    }
+
+    cs.legalize_all();
+    cs.refine();
+    return cs;
+}
+
+bool choose_sweep_element_types(
+    ElementType element_type,
+    ElementType *brick_type_out,
+    ElementType *wedge_type_out
+) {
+    switch (element_type) {
+    case ElementType::C3D8:
+        *brick_type_out = ElementType::C3D8;
+        *wedge_type_out = ElementType::C3D6;
+        return true;
+    case ElementType::C3D20:
+    case ElementType::C3D20R:
+    case ElementType::C3D20RI:
+        *brick_type_out = element_type;
+        *wedge_type_out = ElementType::C3D15;
+        return true;
+    case ElementType::C3D6:
+    case ElementType::C3D15:
+        *brick_type_out = *wedge_type_out = element_type;
+        return true;
+    default:
+        return false;
+    }
+}
+
+Element3 make_sweep_element(
+    const SweepCell &cell,
+    int layer,
+    const SweepNodes &nodes,
+    ElementType brick_type,
+    ElementType wedge_type
+) {
+    int n = cell.num_vertices;
+    Element3 element;
+    element.type = (n == 4) ? brick_type : wedge_type;
+    bool quadratic = (element_type_shape(element.type).order == 2);
+    for (int i = 0; i < n; ++i) {
+        int a = cell.vertices[i], b = cell.vertices[(i + 1) % n];
+        element.nodes[i] = nodes.corner(a, layer);
+        element.nodes[n + i] = nodes.corner(a, layer + 1);
+        if (quadratic) {
+            element.nodes[2 * n + i] = nodes.edge_middle(a, b, layer);
+            element.nodes[3 * n + i] = nodes.edge_middle(a, b, layer + 1);
+            element.nodes[4 * n + i] = nodes.layer_middle(a, layer);
+        }
+    }
+    return element;
+}
+
+Mesh3 mesher_sweep(
+    const Plc3 &plc,
+    MaxElementSize max_element_size_default,
+    const AttrOverrides<MaxElementSize> &max_element_size_overrides,
+    int min_layers,
+    ElementType element_type
+) {
+    ElementType brick_type, wedge_type;
+    if (!choose_sweep_element_types(element_type, &brick_type, &wedge_type)) {
+        throw std::domain_error("sweep mesher only supports element_type "
+            "C3D8, C3D20, C3D20R, C3D20RI, C3D6, or C3D15");
+    }
+    bool make_quads = (brick_type != wedge_type);
+    int order = element_type_shape(element_type).order;
+
+    Mesh3 mesh;
+    if (plc.vertices.empty()) {
+        return mesh;
+    }
+
+    /* A box is a prism along all three axes; sweep along the shortest one,
+    which needs the fewest layers */
+    SweepPrism prism;
+    bool found_axis = false;
+    for (int axis = 0; axis < 3; ++axis) {
+        SweepPrism candidate;
+        if (!find_sweep_axis(plc, axis, &candidate)) {
+            continue;
+        }
+        if (!found_axis || candidate.w_upper - candidate.w_lower <
+                prism.w_upper - prism.w_lower) {
+            prism = std::move(candidate);
+            found_axis = true;
+        }
+    }
+    if (!found_axis) {
+        throw SweepError("sweep mesher requires a prism whose ends are "
+            "perpendicular to the X, Y, or Z axis");
+    }
+
+    std::vector<Plc3::VolumeId> region_volumes;
+    std::vector<Plc3::SurfaceId> region_surfaces, segment_surfaces;
+    CrossSection cs = make_cross_section(plc, prism,
+        max_element_size_default, max_element_size_overrides,
+        &region_volumes, &region_surfaces, &segment_surfaces);
+    std::vector<SweepCell> cells = make_cells(cs, make_quads);
+
+    double min_size = *std::min_element(
+        cs.region_sizes.begin(), cs.region_sizes.end());
+    int num_layers = std::max(min_layers, static_cast<int>(
+        ceil((prism.w_upper - prism.w_lower) / min_size)));
+
+    auto place = [&](SweepPoint p, int step) {
+        double coords[3];
+        /* Put the last layer exactly on the upper end */
+        coords[prism.axis] = (step == 2 * num_layers) ? prism.w_upper
+            : prism.w_lower + (prism.w_upper - prism.w_lower) * step
+                / (2 * num_layers);
+        coords[prism.u_axis] = p.u;
+        coords[prism.v_axis] = p.v;
+        return Point(coords[0], coords[1], coords[2]);
+    };
+    SweepNodes nodes(cs, cells, num_layers, order, place, &mesh);
+    for (int i = 0; i < static_cast<int>(plc.vertices.size()); ++i) {
+        NodeId node_id = nodes.corner(prism.vertex_points[i],
+            prism.vertex_upper[i] ? num_layers : 0);
+        mesh.nodes[node_id].attrs = plc.vertices[i].attrs;
+    }
+
+    /* The surfaces of the upper end of the prism don't necessarily line up
+    with the regions, so find them for each cell */
+    SweepTriangleLocator upper_locator(cs.points);
+    upper_locator.build(prism.end_triangles[1]);
+    std::vector<AttrBitset> upper_attrs;
+    for (const SweepCell &cell : cells) {
+        SweepPoint center(0, 0);
+        for (int i = 0; i < cell.num_vertices; ++i) {
+            center.u += cs.points[cell.vertices[i]].u / cell.num_vertices;
+            center.v += cs.points[cell.vertices[i]].v / cell.num_vertices;
+        }
+        int t = upper_locator.find(center);
+        upper_attrs.push_back((t == -1)
+            ? plc.volumes[region_volumes[cell.region]].attrs
+            : plc.surfaces[prism.end_surfaces[1][t]].attrs);
+    }
+
+    for (int layer = 0; layer < num_layers; ++layer) {
+        for (int c = 0; c < static_cast<int>(cells.size()); ++c) {
+            const SweepCell &cell = cells[c];
+            Element3 element = make_sweep_element(
+                cell, layer, nodes, brick_type, wedge_type);
+            element.attrs = plc.volumes[region_volumes[cell.region]].attrs;
+            element.face_attrs[0] = (layer == 0)
+                ? plc.surfaces[region_surfaces[cell.region]].attrs
+                : element.attrs;
+            element.face_attrs[1] = (layer == num_layers - 1)
+                ? upper_attrs[c] : element.attrs;
+            for (int i = 0; i < cell.num_vertices; ++i) {
+                int segment = cell.segments[i];
+                element.face_attrs[2 + i] =
+                    (segment == -1 || segment_surfaces[segment] == -1)
+                    ? element.attrs
+                    : plc.surfaces[segment_surfaces[segment]].attrs;
+            }
+            mesh.elements.push_back(element);
+        }
+    }
+
+    return mesh;
+}
+
+} /* namespace os2cx */
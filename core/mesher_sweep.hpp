@@ -0,0 +1,39 @@
+#ifndef OS2CX_MESHER_SWEEP_HPP_
+#define OS2CX_MESHER_SWEEP_HPP_
+
+#include <stdexcept>
+
+#include "attrs.hpp"
+#include "mesh.hpp"
+#include "plc.hpp"
+
+namespace os2cx {
+
+class SweepError : public std::runtime_error {
+public:
+    SweepError(const std::string &s) : std::runtime_error(s) { }
+};
+
+/* Meshes 'plc' by meshing its cross-section in 2D and extruding it. 'plc' must
+be a prism along the X, Y, or Z axis: all of its vertices lie on two planes
+perpendicular to that axis, and every other triangle is parallel to it.
+Otherwise, SweepError is thrown. The axis is detected automatically; if 'plc'
+is a prism along several axes, the shortest one is used.
+
+The cross-section is triangulated with Delaunay refinement so that no edge is
+longer than the max_element_size that applies to its volume. If 'element_type'
+is a brick, pairs of triangles that form reasonably square quadrilaterals are
+merged and extruded into bricks, and the remaining triangles are extruded into
+wedges of the same order. If it's a wedge, only wedges are generated. Along the
+axis, the mesh has at least 'min_layers' layers of elements, and enough layers
+that none is thicker than the smallest max_element_size. */
+Mesh3 mesher_sweep(
+    const Plc3 &plc,
+    MaxElementSize max_element_size_default,
+    const AttrOverrides<MaxElementSize> &max_element_size_overrides,
+    int min_layers,
+    ElementType element_type);
+
+} /* namespace os2cx */
+
+#endif /* OS2CX_MESHER_SWEEP_HPP_ */
@@ -0,0 +1,223 @@
+#ifndef OS2CX_MESHER_SWEEP_INTERNAL_HPP_
+#define OS2CX_MESHER_SWEEP_INTERNAL_HPP_
+
+/* The 2D triangulation and extrusion machinery behind mesher_sweep(), which
+mesher_axisymmetric() uses to mesh and revolve its meridional section. */
+
+#include "mesher_sweep.hpp"
+
+#include <functional>
+#include <map>
+#include <vector>
+
+namespace os2cx {
+
+/* A point in the cross-section, in the coordinates of the two axes that are
+perpendicular to the sweep axis */
+class SweepPoint {
+public:
+    SweepPoint() { }
+    SweepPoint(double u_, double v_) : u(u_), v(v_) { }
+    double u, v;
+};
+
+class LessSweepPoint {
+public:
+    bool operator()(SweepPoint p1, SweepPoint p2) const {
+        return (p1.u < p2.u) || (p1.u == p2.u && p1.v < p2.v);
+    }
+};
+
+/* A triangulation of the cross-section, which starts out as the triangles of
+one end of the prism, or is built up point by point, and is then refined. Some
+edges are constrained: they lie
+on "segments" that separate different volumes or surfaces, or that bound the
+cross-section. They are never flipped, and every triangle's region is
+determined by the segments around it. */
+class CrossSection {
+public:
+    class Triangle {
+    public:
+        /* counterclockwise */
+        int vertices[3];
+
+        /* The triangle across the edge opposite each vertex, or -1 */
+        int neighbors[3];
+
+        /* The segment that the edge opposite each vertex lies on, or -1 */
+        int segments[3];
+
+        int region;
+    };
+
+    std::vector<SweepPoint> points;
+    std::vector<Triangle> triangles;
+
+    /* The maximum edge length in each region */
+    std::vector<double> region_sizes;
+
+    void legalize_all();
+    void refine();
+
+    /* Inserts 'p', which must lie inside the triangulation, and returns its
+    index. If 'p' is already a point of the triangulation, nothing changes. */
+    int insert_point(SweepPoint p);
+
+    /* Discards the triangles whose region is -1, and then the points that no
+    triangle uses. Returns the new index of each old point, or -1. */
+    std::vector<int> discard_outside();
+
+private:
+    enum class LocateResult { Inside, OnEdge, Blocked };
+
+    SweepPoint point(const Triangle &tri, int i) const {
+        return points[tri.vertices[i]];
+    }
+
+    void fix_neighbor(int tri_index, int a, int b, int new_neighbor);
+    void set_triangle(
+        int tri_index,
+        int a, int b, int c,
+        int na, int nb, int nc,
+        int sa, int sb, int sc,
+        int region);
+    void flip(int tri_index, int edge);
+    void legalize(int tri_index, int vertex);
+    void split_triangle(int tri_index, SweepPoint p);
+    void split_edge(int tri_index, int edge, SweepPoint p);
+
+    LocateResult locate(
+        int start, SweepPoint p, int *tri_out, int *edge_out) const;
+    bool segment_needs_split(int tri_index, int edge) const;
+    bool triangle_needs_split(int tri_index) const;
+    bool encroaches(int tri_index, int edge, SweepPoint p) const;
+    void split_segment(int tri_index, int edge);
+    void insert_circumcenter(int tri_index);
+
+    /* The triangles created or changed by the last insertion */
+    std::vector<int> touched;
+};
+
+/* A cell of the cross-section that's extruded into elements: a triangle, or a
+quadrilateral made of two triangles */
+class SweepCell {
+public:
+    int num_vertices;
+    /* counterclockwise */
+    int vertices[4];
+    /* The segment that the edge from vertices[i] to vertices[i+1] lies on, or
+    -1 */
+    int segments[4];
+    int region;
+};
+
+/* Greedily pairs up neighboring triangles into quadrilaterals, squarest
+first. Triangles are never paired across a segment. */
+std::vector<SweepCell> make_cells(
+    const CrossSection &cs,
+    bool make_quads);
+
+/* Creates the nodes of the mesh layer by layer, and looks them up. 'place'
+maps a point of the cross-section and a step along the sweep to a point in
+space; the steps count half-layers, from 0 at the first layer to
+2 * num_layers at the last one. */
+class SweepNodes {
+public:
+    SweepNodes(
+        const CrossSection &cs_,
+        const std::vector<SweepCell> &cells,
+        int num_layers,
+        int order,
+        const std::function<Point(SweepPoint, int)> &place,
+        Mesh3 *mesh
+    ) :
+        cs(cs_)
+    {
+        if (order == 2) {
+            for (const SweepCell &cell : cells) {
+                for (int i = 0; i < cell.num_vertices; ++i) {
+                    int a = cell.vertices[i];
+                    int b = cell.vertices[(i + 1) % cell.num_vertices];
+                    auto key = std::make_pair(std::min(a, b), std::max(a, b));
+                    if (!edge_indices.count(key)) {
+                        int index = edges.size();
+                        edge_indices[key] = index;
+                        edges.push_back(key);
+                    }
+                }
+            }
+        }
+
+        int num_points = cs.points.size();
+        int per_layer = num_points + edges.size();
+        int per_half_layer = (order == 2) ? num_points : 0;
+        first_node = mesh->nodes.key_end();
+        stride = per_layer + per_half_layer;
+        for (int layer = 0; layer <= num_layers; ++layer) {
+            for (const SweepPoint &p : cs.points) {
+                add_node(place(p, 2 * layer), mesh);
+            }
+            for (const auto &edge : edges) {
+                SweepPoint a = cs.points[edge.first];
+                SweepPoint b = cs.points[edge.second];
+                add_node(place(SweepPoint((a.u + b.u) / 2, (a.v + b.v) / 2),
+                    2 * layer), mesh);
+            }
+            if (layer != num_layers && order == 2) {
+                for (const SweepPoint &p : cs.points) {
+                    add_node(place(p, 2 * layer + 1), mesh);
+                }
+            }
+        }
+    }
+
+    NodeId corner(int point, int layer) const {
+        return NodeId::from_int(first_node.to_int() + layer * stride + point);
+    }
+
+    NodeId edge_middle(int a, int b, int layer) const {
+        int index = edge_indices.at(std::make_pair(std::min(a, b),
+            std::max(a, b)));
+        return NodeId::from_int(first_node.to_int() + layer * stride
+            + cs.points.size() + index);
+    }
+
+    NodeId layer_middle(int point, int layer) const {
+        return NodeId::from_int(first_node.to_int() + layer * stride
+            + cs.points.size() + edges.size() + point);
+    }
+
+private:
+    void add_node(Point point, Mesh3 *mesh) {
+        Node3 node;
+        node.point = point;
+        mesh->nodes.push_back(node);
+    }
+
+    const CrossSection &cs;
+    std::map<std::pair<int, int>, int> edge_indices;
+    std::vector<std::pair<int, int> > edges;
+    NodeId first_node;
+    int stride;
+};
+
+/* Chooses the element types for the quadrilateral and triangular cells.
+Returns false if 'element_type' can't be swept. */
+bool choose_sweep_element_types(
+    ElementType element_type,
+    ElementType *brick_type_out,
+    ElementType *wedge_type_out);
+
+/* Creates the element for 'cell' between 'layer' and the next layer, without
+any attributes. Face 0 lies on 'layer', face 1 on the next layer, and face
+2 + i on the edge from the cell's vertex i to vertex i + 1. */
+Element3 make_sweep_element(
+    const SweepCell &cell,
+    int layer,
+    const SweepNodes &nodes,
+    ElementType brick_type,
+    ElementType wedge_type);
+
+} /* namespace os2cx */
+
+#endif /* OS2CX_MESHER_SWEEP_INTERNAL_HPP_ */
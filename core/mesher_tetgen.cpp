@@ -1,20 +1,109 @@
 #include "mesher_tetgen.hpp"
 
+#include <algorithm>
+#include <array>
 #include <limits>
+#include <map>
+#include <mutex>
+#include <set>
 
 #define TETLIBRARY
 #include <tetgen.h>
 
+#include "parallel.hpp"
+#include "plc_facets.hpp"
 #include "plc_index.hpp"
 
 namespace os2cx {
 
+/* Storage for the tetgenio facet list. Tetgen would normally expect every
+facet, polygon, and vertex list to be a separate new[] allocation, which it
+frees in ~tetgenio(). Instead, we allocate them all from this arena in one go.
+The arena must be destroyed before the tetgenio; its destructor detaches the
+facet list so that ~tetgenio() doesn't try to free it. */
+class TetgenFacetArena {
+public:
+    explicit TetgenFacetArena(tetgenio *t) : tetgen(t) { }
+    ~TetgenFacetArena() {
+        if (tetgen->facetlist == facets.data()) {
+            tetgen->facetlist = nullptr;
+            tetgen->numberoffacets = 0;
+        }
+    }
+
+    tetgenio *tetgen;
+    std::vector<tetgenio::facet> facets;
+    std::vector<tetgenio::polygon> polygons;
+    std::vector<int> vertices;
+    std::vector<REAL> hole_points;
+};
+
+/* Finds a point strictly inside the given volume of the Plc3, to identify it
+to tetgen as a region. We step inwards from the centroid of one of the volume's
+larger triangles, halfway to the next surface in that direction. Returns false
+if no such point is found. */
+static bool find_point_in_volume(
+    const Plc3 &plc,
+    const Plc3Index &plc_index,
+    Plc3::VolumeId volume_id,
+    Point *point_out
+) {
+    class Candidate {
+    public:
+        double area;
+        Point centroid;
+        Vector inward;
+    };
+    std::vector<Candidate> candidates;
+    for (const Plc3::Surface &surface : plc.surfaces) {
+        double sign;
+        if (surface.volumes[0] == volume_id) {
+            sign = 1; /* triangle normals point into volumes[0] */
+        } else if (surface.volumes[1] == volume_id) {
+            sign = -1;
+        } else {
+            continue;
+        }
+        for (const Plc3::Surface::Triangle &tri : surface.triangles) {
+            Point p0 = plc.vertices[tri.vertices[0]].point;
+            Point p1 = plc.vertices[tri.vertices[1]].point;
+            Point p2 = plc.vertices[tri.vertices[2]].point;
+            Vector normal = (p1 - p0).cross(p2 - p0);
+            if (normal.magnitude() == 0) continue;
+            Point centroid = p0 + ((p1 - p0) + (p2 - p0)) / 3;
+            candidates.push_back(Candidate {
+                normal.magnitude(), centroid,
+                normal * (sign / normal.magnitude())});
+        }
+    }
+    std::sort(candidates.begin(), candidates.end(),
+        [](const Candidate &a, const Candidate &b) {
+            return a.area > b.area;
+        });
+
+    static const int max_attempts = 8;
+    for (int i = 0; i < std::min(max_attempts,
+            static_cast<int>(candidates.size())); ++i) {
+        const Candidate &c = candidates[i];
+        Length distance = plc_index.ray_hit_distance(c.centroid, c.inward);
+        if (distance == HUGE_VAL) continue;
+        Point point = c.centroid + c.inward * (distance / 2);
+        if (plc_index.volume_containing_point(point) == volume_id) {
+            *point_out = point;
+            return true;
+        }
+    }
+    return false;
+}
+
 void convert_input(
     const Plc3 &plc,
     MaxElementSize max_element_size_default,
     const AttrOverrides<MaxElementSize> &max_element_size_overrides,
-    tetgenio *tetgen
+    const std::vector<Length> *vertex_sizes,
+    TetgenFacetArena *arena
 ) {
+    tetgenio *tetgen = arena->tetgen;
     tetgen->numberofpoints = plc.vertices.size();
     tetgen->pointlist = new REAL[tetgen->numberofpoints * 3];
     for (Plc3::VertexId vid = 0; vid < (int)plc.vertices.size(); ++vid) {
@@ -23,11 +112,46 @@ void convert_input(
         tetgen->pointlist[3 * vid + 2] = plc.vertices[vid].point.z;
     }
 
-    tetgen->numberoffacets = 0;
-    for (const Plc3::Surface &surface : plc.surfaces) {
-        tetgen->numberoffacets += surface.triangles.size();
+    if (vertex_sizes != nullptr) {
+        /* With the "m" switch, tetgen interpolates these sizes over the
+        initial Delaunay tetrahedralization and uses them as the target edge
+        length when refining. */
+        assert(vertex_sizes->size() == plc.vertices.size());
+        tetgen->numberofpointmtrs = 1;
+        tetgen->pointmtrlist = new REAL[tetgen->numberofpoints];
+        std::copy(vertex_sizes->begin(), vertex_sizes->end(),
+            tetgen->pointmtrlist);
+    }
+
+    /* Merge each surface's coplanar triangles into polygons, so that tetgen
+    has far fewer facets to recover. A vertex left inside a merged polygon is
+    passed as a polygon of its own, a single point, so that it stays part of
+    the facet and the point list still matches the Plc3 vertices one-to-one.
+    Count everything first so the arena can be allocated up front; the
+    pointers into it must stay put. */
+    std::vector<std::vector<PlcPolygonFacet> > surface_facets(
+        plc.surfaces.size());
+    int num_facets = 0, num_polygons = 0, num_vertices = 0, num_holes = 0;
+    for (Plc3::SurfaceId sid = 0;
+            sid < static_cast<int>(plc.surfaces.size()); ++sid) {
+        surface_facets[sid] = compute_polygon_facets(plc, sid);
+        for (const PlcPolygonFacet &pf : surface_facets[sid]) {
+            ++num_facets;
+            num_polygons += pf.loops.size() + pf.interior_vertices.size();
+            for (const std::vector<Plc3::VertexId> &loop : pf.loops) {
+                num_vertices += loop.size();
+            }
+            num_vertices += pf.interior_vertices.size();
+            num_holes += pf.hole_points.size();
+        }
     }
-    tetgen->facetlist = new tetgenio::facet[tetgen->numberoffacets];
+    arena->facets.resize(num_facets);
+    arena->polygons.resize(num_polygons);
+    arena->vertices.resize(num_vertices);
+    arena->hole_points.resize(3 * num_holes);
+
+    tetgen->numberoffacets = num_facets;
+    tetgen->facetlist = arena->facets.data();
     tetgen->facetmarkerlist = new int[tetgen->numberoffacets];
 
     /* We'll have facet constraints on external surfaces, but not internal ones.
@@ -36,7 +160,8 @@ void convert_input(
     tetgen->numberoffacetconstraints = 0;
     tetgen->facetconstraintlist = new REAL[2 * plc.surfaces.size()];
 
-    int facet_counter = 0;
+    int facet_counter = 0, polygon_counter = 0, vertex_counter = 0;
+    int hole_counter = 0;
     for (Plc3::SurfaceId sid = 0;
             sid < static_cast<int>(plc.surfaces.size()); ++sid) {
         const Plc3::Surface &surface = plc.surfaces[sid];
@@ -69,40 +194,102 @@ void convert_input(
 
         if (facetmarker != 0) {
             /* Note, we have no way of applying max_element_size constraints
-            to internal surfaces. So e.g. a max_element_size_override on a
-            purely-internal volume would have no effect :( */
+            to internal surfaces. Volumes with a max_element_size_override get
+            a region volume constraint below instead, so that the override
+            still applies to purely-internal volumes. */
             int fcid = tetgen->numberoffacetconstraints++;
             tetgen->facetconstraintlist[2 * fcid] = facetmarker;
             tetgen->facetconstraintlist[2 * fcid + 1] =
                 (max_element_size * max_element_size) / 2;
         }
 
-        for (const Plc3::Surface::Triangle &tri : surface.triangles) {
+        for (const PlcPolygonFacet &pf : surface_facets[sid]) {
             tetgenio::facet *facet = &tetgen->facetlist[facet_counter];
-            facet->polygonlist = new tetgenio::polygon[1];
-            facet->numberofpolygons = 1;
-            facet->holelist = nullptr;
-            facet->numberofholes = 0;
-            facet->polygonlist[0].numberofvertices = 3;
-            facet->polygonlist[0].vertexlist = new int[3];
-
-            for (int i = 0; i < 3; ++i) {
-                int vid = tri.vertices[i];
-                facet->polygonlist[0].vertexlist[i] = vid;
+            facet->polygonlist = &arena->polygons[polygon_counter];
+            facet->numberofpolygons =
+                pf.loops.size() + pf.interior_vertices.size();
+            polygon_counter += facet->numberofpolygons;
+            for (int j = 0; j < static_cast<int>(pf.loops.size()); ++j) {
+                tetgenio::polygon *polygon = &facet->polygonlist[j];
+                polygon->numberofvertices = pf.loops[j].size();
+                polygon->vertexlist = &arena->vertices[vertex_counter];
+                std::copy(pf.loops[j].begin(), pf.loops[j].end(),
+                    polygon->vertexlist);
+                vertex_counter += pf.loops[j].size();
+            }
+            for (int j = 0; j < static_cast<int>(pf.interior_vertices.size());
+                    ++j) {
+                tetgenio::polygon *polygon =
+                    &facet->polygonlist[pf.loops.size() + j];
+                polygon->numberofvertices = 1;
+                polygon->vertexlist = &arena->vertices[vertex_counter];
+                polygon->vertexlist[0] = pf.interior_vertices[j];
+                ++vertex_counter;
+            }
+            if (pf.hole_points.empty()) {
+                facet->holelist = nullptr;
+                facet->numberofholes = 0;
+            } else {
+                facet->holelist = &arena->hole_points[3 * hole_counter];
+                facet->numberofholes = pf.hole_points.size();
+                for (const Point &hole : pf.hole_points) {
+                    arena->hole_points[3 * hole_counter + 0] = hole.x;
+                    arena->hole_points[3 * hole_counter + 1] = hole.y;
+                    arena->hole_points[3 * hole_counter + 2] = hole.z;
+                    ++hole_counter;
+                }
             }
 
             tetgen->facetmarkerlist[facet_counter] = facetmarker;
             ++facet_counter;
         }
     }
+
+    /* Each solid volume whose max_element_size differs from the default gets
+    a region with a maximum tetrahedron volume. Tetgen identifies a region by
+    any point strictly inside it. */
+    std::vector<Plc3::VolumeId> region_volumes;
+    std::vector<MaxElementSize> region_sizes;
+    for (Plc3::VolumeId vid = 0;
+            vid < static_cast<int>(plc.volumes.size()); ++vid) {
+        if (vid == plc.volume_outside) continue;
+        if (!plc.volumes[vid].attrs[attr_bit_solid()]) continue;
+        MaxElementSize max_element_size = max_element_size_overrides.lookup(
+            plc.volumes[vid].attrs, max_element_size_default);
+        if (max_element_size != max_element_size_default) {
+            region_volumes.push_back(vid);
+            region_sizes.push_back(max_element_size);
+        }
+    }
+    if (!region_volumes.empty()) {
+        Plc3Index plc_index(&plc);
+        tetgen->numberofregions = 0;
+        tetgen->regionlist = new REAL[5 * region_volumes.size()];
+        for (int i = 0; i < static_cast<int>(region_volumes.size()); ++i) {
+            Point point;
+            if (!find_point_in_volume(
+                    plc, plc_index, region_volumes[i], &point)) {
+                /* Without a seed point, the volume would silently get neither
+                its size constraint nor its region */
+                throw TetgenError("Couldn't find a point inside a volume "
+                    "with a max_element_size override; is it very thin?");
+            }
+            REAL *region = &tetgen->regionlist[5 * tetgen->numberofregions];
+            region[0] = point.x;
+            region[1] = point.y;
+            region[2] = point.z;
+            region[3] = region_volumes[i];
+            region[4] = pow(region_sizes[i], 3) / 6.0;
+            ++tetgen->numberofregions;
+        }
+    }
 }
 
 Mesh3 convert_output(tetgenio *tetgen) {
     Mesh3 mesh;
     mesh.nodes = ContiguousMap<NodeId, Node3>(
         NodeId::from_int(0));
-    mesh.elements = ContiguousMap<ElementId, Element3>(
-        ElementId::from_int(0));
+    mesh.elements = Element3Store(ElementId::from_int(0));
 
     mesh.nodes.reserve(tetgen->numberofpoints);
     for (int nid = 0; nid < tetgen->numberofpoints; ++nid) {
@@ -164,58 +351,116 @@ void transfer_attrs(const Plc3 &plc, Mesh3 *mesh) {
         }
     }
 
-    for (ElementId eid = mesh->elements.key_begin();
-            eid != mesh->elements.key_end(); ++eid) {
-        Element3 *element = &mesh->elements[eid];
-
+    /* Collect the center of every element and every element face up front, so
+    that the Plc3Index lookups can be done as one batch across threads. */
+    std::vector<Point> element_centers;
+    std::vector<Point> face_centers;
+    element_centers.reserve(mesh->elements.size());
+    for (ConstElement3Ref element : mesh->elements) {
         LengthVector sum = LengthVector::zero();
-        int num_nodes = element->num_nodes();
+        int num_nodes = element.num_nodes();
         for (int i = 0; i < num_nodes; ++i) {
-            sum += mesh->nodes[element->nodes[i]].point - Point::origin();
+            sum += mesh->nodes[element.nodes[i]].point - Point::origin();
         }
-        Point center = Point::origin() + sum / num_nodes;
-
-        Plc3::VolumeId volume_id = plc_index.volume_containing_point(center);
-        element->attrs = plc.volumes[volume_id].attrs;
+        element_centers.push_back(Point::origin() + sum / num_nodes);
 
-        FaceId fid;
-        fid.element_id = eid;
-        const ElementTypeShape *shape = &element_type_shape(element->type);
-        for (fid.face = 0; fid.face < static_cast<int>(shape->faces.size());
-                ++fid.face) {
+        const ElementTypeShape *shape = &element_type_shape(element.type);
+        for (const ElementTypeShape::Face &face : shape->faces) {
             LengthVector sum = LengthVector::zero();
-            for (int vertex_index : shape->faces[fid.face].vertices) {
-                sum += mesh->nodes[element->nodes[vertex_index]].point
+            for (int vertex_index : face.vertices) {
+                sum += mesh->nodes[element.nodes[vertex_index]].point
                     - Point::origin();
             }
-            Point center = Point::origin()
-                + sum / shape->faces[fid.face].vertices.size();
+            face_centers.push_back(
+                Point::origin() + sum / face.vertices.size());
+        }
+    }
 
-            Plc3::SurfaceId surface_id =
-                plc_index.surface_containing_point(center);
+    std::vector<Plc3::VolumeId> element_volumes;
+    std::vector<Plc3::SurfaceId> face_surfaces;
+    plc_index.classify_points(element_centers, &element_volumes, nullptr);
+    plc_index.classify_points(face_centers, nullptr, &face_surfaces);
+
+    int element_index = 0, face_index = 0;
+    for (ElementId eid = mesh->elements.key_begin();
+            eid != mesh->elements.key_end(); ++eid) {
+        Plc3::VolumeId volume_id = element_volumes[element_index++];
+        mesh->elements.set_attrs(eid, plc.volumes[volume_id].attrs);
+
+        const ElementTypeShape *shape =
+            &element_type_shape(mesh->elements[eid].type);
+        for (int face = 0; face < static_cast<int>(shape->faces.size());
+                ++face) {
+            Plc3::SurfaceId surface_id = face_surfaces[face_index++];
             if (surface_id == -1) {
                 /* internal face, not on any surface */
-                element->face_attrs[fid.face] = plc.volumes[volume_id].attrs;
+                mesh->elements.set_face_attrs(
+                    eid, face, plc.volumes[volume_id].attrs);
             } else {
                 /* copy attrs of the surface */
-                element->face_attrs[fid.face] = plc.surfaces[surface_id].attrs;
+                mesh->elements.set_face_attrs(
+                    eid, face, plc.surfaces[surface_id].attrs);
             }
         }
     }
 }
 
+/* Runs tetgen, translating its integer error codes into exceptions.
+
+tetgen's exactinit() sets global predicate constants from the bounding box of
+each input, so two concurrent calls would corrupt each other's predicates.
+tetrahedralize() calls exactinit() itself, so the lock can't be any narrower
+than the whole call. Mesh objects are meshed in parallel, so the calls are
+serialized here; a thread waiting for the lock hands its slot back to
+parallel_for(), so the rest of each object's work still gets every core. */
+static std::mutex tetgen_mutex;
+
+static void run_tetgen(
+    const std::string &flags,
+    tetgenio *tetgen_input,
+    tetgenio *tetgen_output
+) {
+    std::unique_lock<std::mutex> lock = parallel_lock(&tetgen_mutex);
+    try {
+        tetrahedralize(
+            const_cast<char *>(flags.c_str()),
+            tetgen_input,
+            tetgen_output);
+    } catch (int error_code) {
+        if (error_code == 1) {
+            throw std::bad_alloc();
+        } else if (error_code == 2) {
+            throw TetgenError("Tetgen has a bug in it");
+        } else if (error_code == 3) {
+            throw TetgenError("Tetgen found self-intersection");
+        } else if (error_code == 4) {
+            throw TetgenError("Tetgen found very small input feature");
+        } else if (error_code == 5) {
+            throw TetgenError("Tetgen found very close input facets");
+        } else if (error_code == 10) {
+            throw TetgenError("Tetgen input was not valid");
+        } else {
+            throw TetgenError("Tetgen threw an unknown error");
+        }
+    }
+}
+
 Mesh3 mesher_tetgen(
     const Plc3 &plc,
     MaxElementSize max_element_size_default,
     const AttrOverrides<MaxElementSize> &max_element_size_overrides,
+    const std::vector<Length> *vertex_sizes,
     ElementType element_type
 ) {
     tetgenio tetgen_input;
+    /* Declared after tetgen_input, so it gets destroyed first */
+    TetgenFacetArena facet_arena(&tetgen_input);
     convert_input(
         plc,
         max_element_size_default,
         max_element_size_overrides,
-        &tetgen_input);
+        vertex_sizes,
+        &facet_arena);
 
     /* Tetgen always respects the PLC exactly. If the PLC is malformed such that
     it e.g. has two edges that are very close together, then Tetgen may try to
@@ -223,8 +468,21 @@ Mesh3 mesher_tetgen(
     the number of Steiner points that Tetgen is allowed to insert, in order to
     force Tetgen to abort if this happens. */
     Volume approx_volume = pow(2 * plc.compute_approx_scale(), 3);
-    Volume approx_tet_volume = pow(max_element_size_default, 3) / 6.0;
-    int approx_num_tets = approx_volume / approx_tet_volume;
+    Length approx_element_size = max_element_size_default;
+    if (vertex_sizes != nullptr && !vertex_sizes->empty()) {
+        /* The number of tets goes as the inverse cube of the size, so average
+        that rather than the sizes themselves; otherwise a few small features
+        would be drowned out by the bulk and tetgen would hit the cap. */
+        double sum = 0;
+        for (Length size : *vertex_sizes) {
+            sum += 1 / pow(size, 3);
+        }
+        approx_element_size = std::min(approx_element_size,
+            pow(sum / vertex_sizes->size(), -1 / 3.0));
+    }
+    Volume approx_tet_volume = pow(approx_element_size, 3) / 6.0;
+    int approx_num_tets = std::min(approx_volume / approx_tet_volume,
+        static_cast<double>(std::numeric_limits<int>::max() / 3));
     int max_steiner_points = std::max(3 * approx_num_tets, 100);
 
     std::string flags;
@@ -232,6 +490,13 @@ Mesh3 mesher_tetgen(
     flags += "q1.414";
     flags += "S" + std::to_string(max_steiner_points);
     flags += "Q";
+    if (vertex_sizes != nullptr) {
+        flags += "m";
+    }
+    if (tetgen_input.numberofregions != 0) {
+        /* Read per-region volume constraints from the region list */
+        flags += "Aa";
+    }
 
     if (element_type == ElementType::C3D4) {
         (void)0;
@@ -243,28 +508,7 @@ Mesh3 mesher_tetgen(
     }
 
     tetgenio tetgen_output;
-    try {
-        tetrahedralize(
-            const_cast<char *>(flags.c_str()),
-            &tetgen_input,
-            &tetgen_output);
-    } catch (int error_code) {
-        if (error_code == 1) {
-            throw std::bad_alloc();
-        } else if (error_code == 2) {
-            throw TetgenError("Tetgen has a bug in it");
-        } else if (error_code == 3) {
-            throw TetgenError("Tetgen found self-intersection");
-        } else if (error_code == 4) {
-            throw TetgenError("Tetgen found very small input feature");
-        } else if (error_code == 5) {
-            throw TetgenError("Tetgen found very close input facets");
-        } else if (error_code == 10) {
-            throw TetgenError("Tetgen input was not valid");
-        } else {
-            throw TetgenError("Tetgen threw an unknown error");
-        }
-    }
+    run_tetgen(flags, &tetgen_input, &tetgen_output);
 
     Mesh3 mesh = convert_output(&tetgen_output);
 
@@ -273,4 +517,154 @@ Mesh3 mesher_tetgen(
     return mesh;
 }
 
+Mesh3 mesher_tetgen_refine(
+    const Plc3 &plc,
+    const Mesh3 &mesh,
+    const ContiguousMap<ElementId, Volume> &max_element_volumes,
+    ElementType element_type
+) {
+    /* Tetgen only takes the corners of each tetrahedron; any midside nodes
+    will be regenerated. transfer_attrs() expects the first
+    plc.vertices.size() points to be the Plc3 vertices, but the mesh may have
+    been renumbered since mesher_tetgen() returned it, so the Plc3 vertices are
+    found by position. The other corners are numbered after them. */
+    class LessPoint {
+    public:
+        bool operator()(Point p1, Point p2) const {
+            return
+                (p1.x < p2.x) ||
+                (p1.x == p2.x && p1.y < p2.y) ||
+                (p1.x == p2.x && p1.y == p2.y && p1.z < p2.z);
+        }
+    };
+    std::map<Point, Plc3::VertexId, LessPoint> vertices_by_point;
+    for (Plc3::VertexId vid = 0; vid < (int)plc.vertices.size(); ++vid) {
+        vertices_by_point.insert(
+            std::make_pair(plc.vertices[vid].point, vid));
+    }
+
+    ContiguousMap<NodeId, int> tetgen_ids(
+        mesh.nodes.key_begin(), mesh.nodes.key_end(), -1);
+    for (ConstElement3Ref element : mesh.elements) {
+        if (element.type != ElementType::C3D4 &&
+                element.type != ElementType::C3D10) {
+            throw TetgenError("tetgen can only refine C3D4 or C3D10 meshes");
+        }
+        for (int i = 0; i < 4; ++i) {
+            tetgen_ids[element.nodes[i]] = 0;
+        }
+    }
+    int num_points = plc.vertices.size();
+    for (NodeId nid = mesh.nodes.key_begin();
+            nid < mesh.nodes.key_end(); ++nid) {
+        auto it = vertices_by_point.find(mesh.nodes[nid].point);
+        if (it != vertices_by_point.end()) {
+            tetgen_ids[nid] = it->second;
+        } else if (tetgen_ids[nid] != -1) {
+            tetgen_ids[nid] = num_points++;
+        }
+    }
+
+    tetgenio tetgen_input;
+    tetgen_input.numberofpoints = num_points;
+    tetgen_input.pointlist = new REAL[3 * num_points];
+    for (Plc3::VertexId vid = 0; vid < (int)plc.vertices.size(); ++vid) {
+        tetgen_input.pointlist[3 * vid + 0] = plc.vertices[vid].point.x;
+        tetgen_input.pointlist[3 * vid + 1] = plc.vertices[vid].point.y;
+        tetgen_input.pointlist[3 * vid + 2] = plc.vertices[vid].point.z;
+    }
+    for (NodeId nid = mesh.nodes.key_begin();
+            nid < mesh.nodes.key_end(); ++nid) {
+        int id = tetgen_ids[nid];
+        if (id < (int)plc.vertices.size()) continue;
+        tetgen_input.pointlist[3 * id + 0] = mesh.nodes[nid].point.x;
+        tetgen_input.pointlist[3 * id + 1] = mesh.nodes[nid].point.y;
+        tetgen_input.pointlist[3 * id + 2] = mesh.nodes[nid].point.z;
+    }
+
+    tetgen_input.numberofcorners = 4;
+    tetgen_input.numberoftetrahedra = mesh.elements.size();
+    tetgen_input.tetrahedronlist = new int[4 * mesh.elements.size()];
+    tetgen_input.tetrahedronvolumelist = new REAL[mesh.elements.size()];
+    int tet_index = 0;
+    for (ElementId eid = mesh.elements.key_begin();
+            eid < mesh.elements.key_end(); ++eid) {
+        for (int i = 0; i < 4; ++i) {
+            tetgen_input.tetrahedronlist[4 * tet_index + i] =
+                tetgen_ids[mesh.elements[eid].nodes[i]];
+        }
+        tetgen_input.tetrahedronvolumelist[tet_index] =
+            max_element_volumes[eid];
+        ++tet_index;
+    }
+
+    /* Tetgen keeps the faces in the trifacelist when it refines, so list every
+    face that lies on a surface of the Plc3, including internal surfaces;
+    otherwise tetgen could flip them away and elements would straddle two
+    volumes. The corner indices of the four faces of a tetrahedron: */
+    static const int tet_faces[4][3] = {{1, 2, 3}, {0, 3, 2}, {0, 1, 3},
+        {0, 2, 1}};
+    std::vector<std::array<int, 3> > faces;
+    std::vector<Point> face_centers;
+    std::set<std::array<int, 3> > seen_faces;
+    for (ConstElement3Ref element : mesh.elements) {
+        for (const int (&tet_face)[3] : tet_faces) {
+            std::array<int, 3> face, key;
+            LengthVector sum = LengthVector::zero();
+            for (int i = 0; i < 3; ++i) {
+                NodeId nid = element.nodes[tet_face[i]];
+                face[i] = tetgen_ids[nid];
+                sum += mesh.nodes[nid].point - Point::origin();
+            }
+            key = face;
+            std::sort(key.begin(), key.end());
+            if (!seen_faces.insert(key).second) continue;
+            faces.push_back(face);
+            face_centers.push_back(Point::origin() + sum / 3);
+        }
+    }
+    Plc3Index plc_index(&plc);
+    std::vector<Plc3::SurfaceId> face_surfaces;
+    plc_index.classify_points(face_centers, nullptr, &face_surfaces);
+
+    int num_trifaces = 0;
+    for (Plc3::SurfaceId sid : face_surfaces) {
+        if (sid != -1) ++num_trifaces;
+    }
+    tetgen_input.numberoftrifaces = num_trifaces;
+    tetgen_input.trifacelist = new int[3 * num_trifaces];
+    tetgen_input.trifacemarkerlist = new int[num_trifaces];
+    int triface_index = 0;
+    for (int i = 0; i < static_cast<int>(faces.size()); ++i) {
+        if (face_surfaces[i] == -1) continue;
+        std::copy(faces[i].begin(), faces[i].end(),
+            &tetgen_input.trifacelist[3 * triface_index]);
+        tetgen_input.trifacemarkerlist[triface_index] = face_surfaces[i] + 1;
+        ++triface_index;
+    }
+
+    std::string flags;
+    flags += "r";
+    flags += "q1.414";
+    flags += "a";
+    flags += "Q";
+    if (element_type == ElementType::C3D4) {
+        (void)0;
+    } else if (element_type == ElementType::C3D10) {
+        flags += "o2";
+    } else {
+        throw TetgenError(
+            "tetgen mesher only supports element_type C3D4 or C3D10");
+    }
+
+    tetgenio tetgen_output;
+    run_tetgen(flags, &tetgen_input, &tetgen_output);
+
+    Mesh3 refined_mesh = convert_output(&tetgen_output);
+
+    transfer_attrs(plc, &refined_mesh);
+
+    return refined_mesh;
+}
+
 } /* namespace os2cx */
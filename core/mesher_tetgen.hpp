@@ -11,10 +11,26 @@ public:
     TetgenError(const char *s) : std::runtime_error(s) { }
 };
 
+/* If 'vertex_sizes' is not null, it must have one entry per vertex of 'plc';
+tetgen then grades the element size between those targets instead of using
+max_element_size everywhere. See compute_sizing_field(). */
 Mesh3 mesher_tetgen(
     const Plc3 &plc,
     MaxElementSize max_element_size_default,
     const AttrOverrides<MaxElementSize> &max_element_size_overrides,
+    const std::vector<Length> *vertex_sizes,
+    ElementType element_type);
+
+/* Refines a mesh that mesher_tetgen() produced from 'plc', using tetgen's "r"
+switch. Element 'eid' of 'mesh' is split until none of the resulting elements
+has a volume larger than max_element_volumes[eid]; a negative volume means that
+element has no constraint, although tetgen may still split it to keep the
+quality up next to its neighbors. The refined mesh still conforms to every
+surface of 'plc' and has its attrs transferred from 'plc' as usual. */
+Mesh3 mesher_tetgen_refine(
+    const Plc3 &plc,
+    const Mesh3 &mesh,
+    const ContiguousMap<ElementId, Volume> &max_element_volumes,
     ElementType element_type);
 
 } /* namespace os2cx */
@@ -3,6 +3,7 @@
 #include <iostream>
 #include <sstream>
 
+#include "mesher_axisymmetric.hpp"
 #include "openscad_run.hpp"
 
 namespace os2cx {
@@ -254,7 +255,7 @@ void do_mesh_directive(
     Project *project,
     const std::vector<OpenscadValue> &args
 ) {
-    check_arg_count(args, 5, "mesh");
+    check_arg_count(args, 9, "mesh");
 
     Project::MeshObjectName name = check_name_new(args[0], "mesh", project);
 
@@ -267,9 +268,19 @@ void do_mesh_directive(
     } else if (mesher_name == "naive_bricks") {
         object.mesher = Project::MeshObject::Mesher::NaiveBricks;
         object.element_type = ElementType::C3D20R; /* default */
+    } else if (mesher_name == "octree_bricks") {
+        object.mesher = Project::MeshObject::Mesher::OctreeBricks;
+        object.element_type = ElementType::C3D20R; /* default */
+    } else if (mesher_name == "sweep") {
+        object.mesher = Project::MeshObject::Mesher::Sweep;
+        object.element_type = ElementType::C3D20R; /* default */
+    } else if (mesher_name == "axisymmetric") {
+        object.mesher = Project::MeshObject::Mesher::Axisymmetric;
+        object.element_type = ElementType::C3D20; /* default, i.e. CAX8 */
     } else {
         throw UsageError("Invalid mesher name: '" + mesher_name +
-            "'. Expected 'tetgen' or 'naive_bricks'.");
+            "'. Expected 'tetgen', 'naive_bricks', 'octree_bricks', "
+            "'sweep', or 'axisymmetric'.");
     }
 
     if (args[2].type == OpenscadValue::Type::Undefined) {
@@ -288,12 +299,73 @@ void do_mesh_directive(
     if (args[4].type != OpenscadValue::Type::Undefined) {
         std::string element_type_name = check_string(args[4]);
         try {
-            object.element_type = element_type_from_string(element_type_name);
+            /* The axisymmetric mesher takes the names of the CAX elements
+            that it will write */
+            if (object.mesher == Project::MeshObject::Mesher::Axisymmetric) {
+                object.element_type =
+                    axisymmetric_element_type_from_string(element_type_name);
+            } else {
+                object.element_type =
+                    element_type_from_string(element_type_name);
+            }
         } catch (const std::domain_error &) {
             throw UsageError("unsupported element_type: " + element_type_name);
         }
     }
 
+    if (args[5].type == OpenscadValue::Type::Undefined) {
+        object.simplify_tolerance = 0;
+    } else {
+        object.simplify_tolerance = check_number(args[5]);
+        if (object.simplify_tolerance <= 0) {
+            throw UsageError("simplify_tolerance must be positive");
+        }
+    }
+
+    if (args[6].type == OpenscadValue::Type::Undefined) {
+        object.elements_per_thickness = 0;
+    } else {
+        object.elements_per_thickness = check_number(args[6]);
+        if (object.elements_per_thickness <= 0) {
+            throw UsageError("elements_per_thickness must be positive");
+        }
+        if (object.mesher == Project::MeshObject::Mesher::NaiveBricks ||
+                object.mesher == Project::MeshObject::Mesher::Axisymmetric) {
+            throw UsageError("elements_per_thickness is only supported by "
+                "the tetgen, octree_bricks, and sweep meshers");
+        }
+    }
+
+    if (args[7].type == OpenscadValue::Type::Undefined) {
+        object.boundary_condition_refinement = 0;
+    } else {
+        object.boundary_condition_refinement = check_number(args[7]);
+        if (object.boundary_condition_refinement <= 0 ||
+                object.boundary_condition_refinement > 1) {
+            throw UsageError("boundary_condition_refinement must be greater "
+                "than 0 and at most 1");
+        }
+        if (object.mesher == Project::MeshObject::Mesher::NaiveBricks ||
+                object.mesher == Project::MeshObject::Mesher::Sweep ||
+                object.mesher == Project::MeshObject::Mesher::Axisymmetric) {
+            throw UsageError("boundary_condition_refinement is only supported "
+                "by the tetgen and octree_bricks meshers");
+        }
+    }
+
+    if (args[8].type == OpenscadValue::Type::Undefined) {
+        object.optimize_passes = 0;
+    } else {
+        object.optimize_passes = check_integer(args[8]);
+        if (object.optimize_passes <= 0) {
+            throw UsageError("optimize_passes must be positive");
+        }
+        if (object.mesher != Project::MeshObject::Mesher::Tetgen) {
+            throw UsageError("optimize_passes is only supported by the "
+                "tetgen mesher");
+        }
+    }
+
     project->mesh_objects.insert(std::make_pair(name, object));
 }
 
@@ -318,6 +390,39 @@ void do_slice_directive(
     project->slice_objects.insert(std::make_pair(name, object));
 }
 
+void do_symmetry_directive(
+    Project *project,
+    const std::vector<OpenscadValue> &args
+) {
+    check_arg_count(args, 2, "symmetry");
+
+    Project::SymmetryPlane plane;
+    std::string plane_name = check_string(args[0]);
+    if (plane_name == "yz") {
+        plane.axis = Dimension::X;
+    } else if (plane_name == "xz") {
+        plane.axis = Dimension::Y;
+    } else if (plane_name == "xy") {
+        plane.axis = Dimension::Z;
+    } else {
+        throw UsageError("Invalid symmetry plane: '" + plane_name +
+            "'. Expected 'yz', 'xz', or 'xy'.");
+    }
+    for (const Project::SymmetryPlane &other : project->symmetry_planes) {
+        if (other.axis == plane.axis) {
+            throw UsageError("Can't call os2cx_symmetry() more than once "
+                "for the same plane.");
+        }
+    }
+    plane.position = check_number(args[1]);
+
+    /* If there are too many select_* directives, bit_index will be greater than
+    or equal to num_attr_bits; we'll check this later. */
+    plane.bit_index = project->next_bit_index++;
+
+    project->symmetry_planes.push_back(plane);
+}
+
 void do_select_volume_directive(
     Project *project,
     const std::vector<OpenscadValue> &args
@@ -553,6 +658,92 @@ void do_override_material_directive(
     project->material_overrides.add(attr_index, material_id);
 }
 
+void do_adaptive_refinement_directive(
+    Project *project,
+    const std::vector<OpenscadValue> &args
+) {
+    check_arg_count(args, 3, "adaptive_refinement");
+
+    if (project->adaptive_refinement.target_error != 0) {
+        throw UsageError("Can't call os2cx_adaptive_refinement() more than "
+            "once.");
+    }
+
+    double target_error = check_number(args[0]);
+    if (target_error <= 0) {
+        throw UsageError("target_error must be positive");
+    }
+    int max_elements = 0;
+    if (args[1].type != OpenscadValue::Type::Undefined) {
+        max_elements = check_integer(args[1]);
+        if (max_elements <= 0) {
+            throw UsageError("max_elements must be positive");
+        }
+    }
+    int max_iterations = check_integer(args[2]);
+    if (max_iterations <= 0) {
+        throw UsageError("max_iterations must be positive");
+    }
+
+    project->adaptive_refinement.target_error = target_error;
+    project->adaptive_refinement.max_elements = max_elements;
+    project->adaptive_refinement.max_iterations = max_iterations;
+}
+
+void do_resource_budget_directive(
+    Project *project,
+    const std::vector<OpenscadValue> &args
+) {
+    check_arg_count(args, 3, "resource_budget");
+
+    if (project->resource_budget.max_elements != 0 ||
+            project->resource_budget.max_memory_mb != 0) {
+        throw UsageError("Can't call os2cx_resource_budget() more than once.");
+    }
+
+    int max_elements = 0;
+    if (args[0].type != OpenscadValue::Type::Undefined) {
+        max_elements = check_integer(args[0]);
+        if (max_elements <= 0) {
+            throw UsageError("max_elements must be positive");
+        }
+    }
+    double max_memory_mb = 0;
+    if (args[1].type != OpenscadValue::Type::Undefined) {
+        max_memory_mb = check_number(args[1]);
+        if (max_memory_mb <= 0) {
+            throw UsageError("max_memory_mb must be positive");
+        }
+    }
+    if (max_elements == 0 && max_memory_mb == 0) {
+        throw UsageError("os2cx_resource_budget() needs max_elements or "
+            "max_memory_mb");
+    }
+    std::string on_exceed = check_string(args[2]);
+    if (on_exceed != "abort" && on_exceed != "coarsen") {
+        throw UsageError("on_exceed must be \"abort\" or \"coarsen\"");
+    }
+
+    project->resource_budget.max_elements = max_elements;
+    project->resource_budget.max_memory_mb = max_memory_mb;
+    project->resource_budget.coarsen = (on_exceed == "coarsen");
+}
+
+void do_renumber_directive(
+    Project *project,
+    const std::vector<OpenscadValue> &args
+) {
+    check_arg_count(args, 1, "renumber");
+
+    std::string method = check_string(args[0]);
+    try {
+        project->renumber_method = renumber_method_from_string(method);
+    } catch (const std::domain_error &) {
+        throw UsageError("Invalid renumbering method: '" + method +
+            "'. Expected 'rcm', 'hilbert', or 'none'.");
+    }
+}
+
 void do_measure_directive(
     Project *project,
     const std::vector<OpenscadValue> &args
@@ -615,6 +806,8 @@ void openscad_extract_inventory(Project *project) {
                 do_load_volume_directive(project, args);
             } else if (echo[1].string_value == "load_surface_directive") {
                 do_load_surface_directive(project, args);
+            } else if (echo[1].string_value == "symmetry_directive") {
+                do_symmetry_directive(project, args);
             } else if (echo[1].string_value == "slice_directive") {
                 do_slice_directive(project, args);
             } else if (echo[1].string_value ==
@@ -625,6 +818,13 @@ void openscad_extract_inventory(Project *project) {
                 do_override_max_element_size_directive(project, args);
             } else if (echo[1].string_value == "override_material_directive") {
                 do_override_material_directive(project, args);
+            } else if (echo[1].string_value ==
+                    "adaptive_refinement_directive") {
+                do_adaptive_refinement_directive(project, args);
+            } else if (echo[1].string_value == "resource_budget_directive") {
+                do_resource_budget_directive(project, args);
+            } else if (echo[1].string_value == "renumber_directive") {
+                do_renumber_directive(project, args);
             } else if (echo[1].string_value == "measure_directive") {
                 do_measure_directive(project, args);
             } else {
@@ -644,8 +844,8 @@ void openscad_extract_inventory(Project *project) {
 
     if (project->next_bit_index - 1 > num_attr_bits - 1) {
         std::stringstream msg;
-        msg << "There are too many os2cx_select_*() and/or "
-            << "os2cx_slice() directives. There are "
+        msg << "There are too many os2cx_select_*(), os2cx_slice(), "
+            << "and/or os2cx_symmetry() directives. There are "
             << (project->next_bit_index - 1)
             << ", but the limit is " << (num_attr_bits - 1) << ".";
         throw UsageError(msg.str());
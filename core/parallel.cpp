@@ -0,0 +1,109 @@
+#include "parallel.hpp"
+
+#include <assert.h>
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <thread>
+#include <vector>
+
+namespace os2cx {
+
+/* The number of running threads beyond the one that made the outermost
+parallel_for() call. Threads that are blocked in parallel_lock() don't count. */
+static std::atomic<int> num_extra_threads(0);
+
+int parallel_num_threads() {
+    /* hardware_concurrency() is allowed to return 0 if it doesn't know */
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+/* Claims up to 'wanted' slots in the thread budget and returns how many it got.
+Each worker spawned with one of the slots gives it back when it exits. */
+static int reserve_extra_threads(int wanted) {
+    int current = num_extra_threads.load();
+    int granted;
+    do {
+        granted = std::max(0,
+            std::min(wanted, parallel_num_threads() - 1 - current));
+    } while (granted > 0 &&
+        !num_extra_threads.compare_exchange_weak(current, current + granted));
+    return granted;
+}
+
+void parallel_for(
+    int count,
+    int chunk_size,
+    const std::function<void(int begin, int end)> &func
+) {
+    assert(chunk_size > 0);
+    if (count <= 0) {
+        return;
+    }
+    int num_chunks = (count + chunk_size - 1) / chunk_size;
+    int num_extra = 0;
+    if (num_chunks > 1) {
+        num_extra = reserve_extra_threads(
+            std::min(parallel_num_threads(), num_chunks) - 1);
+    }
+
+    if (num_extra == 0) {
+        /* Not worth spawning any threads, or there are none to spare */
+        for (int begin = 0; begin < count; begin += chunk_size) {
+            func(begin, std::min(begin + chunk_size, count));
+        }
+        return;
+    }
+
+    /* Each worker repeatedly claims the next unclaimed chunk. */
+    std::atomic<int> next_chunk(0);
+    std::atomic<bool> failed(false);
+    std::vector<std::exception_ptr> errors(num_chunks);
+    auto worker = [&]() {
+        while (!failed.load()) {
+            int chunk = next_chunk.fetch_add(1);
+            if (chunk >= num_chunks) {
+                break;
+            }
+            int begin = chunk * chunk_size;
+            try {
+                func(begin, std::min(begin + chunk_size, count));
+            } catch (...) {
+                errors[chunk] = std::current_exception();
+                failed.store(true);
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(num_extra);
+    for (int i = 0; i < num_extra; ++i) {
+        threads.emplace_back([&]() {
+            worker();
+            num_extra_threads.fetch_sub(1);
+        });
+    }
+    worker();
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+
+    for (const std::exception_ptr &error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+}
+
+std::unique_lock<std::mutex> parallel_lock(std::mutex *mutex) {
+    std::unique_lock<std::mutex> lock(*mutex, std::try_to_lock);
+    if (!lock.owns_lock()) {
+        num_extra_threads.fetch_sub(1);
+        lock.lock();
+        num_extra_threads.fetch_add(1);
+    }
+    return lock;
+}
+
+} /* namespace os2cx */
@@ -0,0 +1,40 @@
+#ifndef OS2CX_PARALLEL_HPP_
+#define OS2CX_PARALLEL_HPP_
+
+#include <functional>
+#include <mutex>
+
+namespace os2cx {
+
+/* Returns the number of worker threads that parallel_for() will use. */
+int parallel_num_threads();
+
+/* Splits [0, count) into consecutive chunks of 'chunk_size' items and calls
+'func(begin, end)' once per chunk, spread across worker threads. The chunk
+boundaries depend only on 'count' and 'chunk_size', never on the number of
+threads, so a 'func' that derives its state (e.g. a random seed) from 'begin'
+gives the same results on every machine.
+
+All parallel_for() calls share one budget of parallel_num_threads() running
+threads, so nested parallelism doesn't multiply the number of threads. A
+parallel_for() called from inside another one only spawns workers for the
+threads that are idle when it starts, e.g. because the outer one has fewer
+chunks left than threads; if there are none, it runs all of its chunks on the
+calling thread.
+
+'func' must be safe to call concurrently for different chunks. If any call
+throws, the remaining chunks are skipped and the exception from the
+lowest-numbered failing chunk is rethrown on the calling thread. */
+void parallel_for(
+    int count,
+    int chunk_size,
+    const std::function<void(int begin, int end)> &func);
+
+/* Locks 'mutex' for a thread that may be running a parallel_for() chunk. While
+the thread is blocked waiting for the mutex, its slot in the thread budget is
+handed back, so that parallel_for() calls elsewhere can use it. */
+std::unique_lock<std::mutex> parallel_lock(std::mutex *mutex);
+
+} /* namespace os2cx */
+
+#endif /* OS2CX_PARALLEL_HPP_ */
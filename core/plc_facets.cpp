@@ -0,0 +1,332 @@
+#include "plc_facets.hpp"
+
+#include <math.h>
+
+#include <algorithm>
+#include <map>
+#include <set>
+
+namespace os2cx {
+
+/* Two triangles or vertices are considered coplanar if they are within this
+fraction of the size of the Plc3 from the same plane. */
+static const double coplanar_tolerance = 1e-9;
+
+static int union_find_root(std::vector<int> *parent, int i) {
+    while ((*parent)[i] != i) {
+        (*parent)[i] = (*parent)[(*parent)[i]];
+        i = (*parent)[i];
+    }
+    return i;
+}
+
+static Point vertex_point(const Plc3 &plc, Plc3::VertexId vid) {
+    return plc.vertices[vid].point;
+}
+
+/* Returns the triangle's normal scaled by twice its area */
+static Vector triangle_area_normal(
+    const Plc3 &plc, const Plc3::Surface::Triangle &tri
+) {
+    Point p0 = vertex_point(plc, tri.vertices[0]);
+    Point p1 = vertex_point(plc, tri.vertices[1]);
+    Point p2 = vertex_point(plc, tri.vertices[2]);
+    return (p1 - p0).cross(p2 - p0);
+}
+
+/* Returns the loop's normal scaled by twice its area, by Newell's method */
+static Vector loop_area_normal(
+    const Plc3 &plc, const std::vector<Plc3::VertexId> &loop
+) {
+    Vector sum = Vector::zero();
+    for (int i = 0; i < static_cast<int>(loop.size()); ++i) {
+        Point a = vertex_point(plc, loop[i]);
+        Point b = vertex_point(plc, loop[(i + 1) % loop.size()]);
+        sum += (a - Point::origin()).cross(b - Point::origin());
+    }
+    return sum;
+}
+
+/* Projects points onto the plane perpendicular to the given normal, by
+dropping the coordinate along which the normal is largest. */
+class PlaneProjection {
+public:
+    explicit PlaneProjection(Vector normal) {
+        if (fabs(normal.x) >= fabs(normal.y) &&
+                fabs(normal.x) >= fabs(normal.z)) {
+            u = Dimension::Y;
+            v = Dimension::Z;
+        } else if (fabs(normal.y) >= fabs(normal.z)) {
+            u = Dimension::Z;
+            v = Dimension::X;
+        } else {
+            u = Dimension::X;
+            v = Dimension::Y;
+        }
+    }
+    Dimension u, v;
+};
+
+/* Returns true if 'point' is strictly inside the polygon formed by 'loop',
+after both are projected onto the plane. */
+static bool point_in_loop(
+    const Plc3 &plc,
+    const PlaneProjection &proj,
+    const std::vector<Plc3::VertexId> &loop,
+    Point point
+) {
+    double pu = point.at(proj.u), pv = point.at(proj.v);
+    bool inside = false;
+    for (int i = 0; i < static_cast<int>(loop.size()); ++i) {
+        Point a = vertex_point(plc, loop[i]);
+        Point b = vertex_point(plc, loop[(i + 1) % loop.size()]);
+        double au = a.at(proj.u), av = a.at(proj.v);
+        double bu = b.at(proj.u), bv = b.at(proj.v);
+        if ((av > pv) != (bv > pv)) {
+            double cross_u = au + (pv - av) * (bu - au) / (bv - av);
+            if (pu < cross_u) {
+                inside = !inside;
+            }
+        }
+    }
+    return inside;
+}
+
+/* Finds a point strictly inside the given hole loop, by stepping off the
+midpoint of one of its edges towards the hole side. Returns false if no edge
+gives a point that is clearly inside. */
+static bool find_hole_point(
+    const Plc3 &plc,
+    const std::vector<Plc3::VertexId> &loop,
+    Vector normal,
+    Point *point_out
+) {
+    PlaneProjection proj(normal);
+    /* The facet is on the left of each directed boundary edge, so the hole is
+    on the right. Prefer long edges, where the offset is least likely to reach
+    across the hole. */
+    std::vector<int> edges(loop.size());
+    for (int i = 0; i < static_cast<int>(loop.size()); ++i) edges[i] = i;
+    auto edge_length = [&](int i) {
+        return (vertex_point(plc, loop[(i + 1) % loop.size()]) -
+            vertex_point(plc, loop[i])).magnitude();
+    };
+    std::stable_sort(edges.begin(), edges.end(), [&](int i, int j) {
+        return edge_length(i) > edge_length(j);
+    });
+    for (int i : edges) {
+        Point a = vertex_point(plc, loop[i]);
+        Point b = vertex_point(plc, loop[(i + 1) % loop.size()]);
+        Point mid = a + (b - a) / 2;
+        Vector right = (b - a).cross(normal);
+        if (right.magnitude() == 0) continue;
+        right /= right.magnitude();
+        for (double offset = 1e-2; offset > 1e-6; offset /= 10) {
+            Point candidate = mid + right * (offset * (b - a).magnitude());
+            if (point_in_loop(plc, proj, loop, candidate)) {
+                *point_out = candidate;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+/* Tries to turn a group of coplanar, edge-connected triangles into a single
+polygon facet. Returns false if the group's boundary is not a simple outer loop
+plus simple hole loops. */
+static bool make_polygon_facet(
+    const Plc3 &plc,
+    const Plc3::Surface &surface,
+    const std::vector<int> &triangles,
+    PlcPolygonFacet *facet_out
+) {
+    /* Every edge that appears in only one direction within the group is on the
+    boundary. Interior edges appear once in each direction. */
+    std::map<std::pair<Plc3::VertexId, Plc3::VertexId>, int> directed_edges;
+    for (int t : triangles) {
+        const Plc3::Surface::Triangle &tri = surface.triangles[t];
+        for (int i = 0; i < 3; ++i) {
+            auto edge = std::make_pair(
+                tri.vertices[i], tri.vertices[(i + 1) % 3]);
+            if (++directed_edges[edge] > 1) {
+                /* Non-manifold; leave this to tetgen */
+                return false;
+            }
+        }
+    }
+    std::map<Plc3::VertexId, Plc3::VertexId> next_vertex;
+    for (const auto &pair : directed_edges) {
+        auto reverse = std::make_pair(pair.first.second, pair.first.first);
+        if (directed_edges.count(reverse)) {
+            continue;
+        }
+        if (!next_vertex.insert(pair.first).second) {
+            /* Two boundary edges leave the same vertex, so two boundary loops
+            touch there; tetgen's polygon loops can't express that. */
+            return false;
+        }
+    }
+
+    Vector normal = Vector::zero();
+    for (int t : triangles) {
+        normal += triangle_area_normal(plc, surface.triangles[t]);
+    }
+    normal /= normal.magnitude();
+
+    std::vector<std::vector<Plc3::VertexId> > outer_loops, hole_loops;
+    while (!next_vertex.empty()) {
+        std::vector<Plc3::VertexId> loop;
+        Plc3::VertexId start = next_vertex.begin()->first;
+        Plc3::VertexId current = start;
+        do {
+            auto it = next_vertex.find(current);
+            if (it == next_vertex.end()) {
+                return false;
+            }
+            loop.push_back(current);
+            current = it->second;
+            next_vertex.erase(it);
+        } while (current != start);
+
+        if (loop_area_normal(plc, loop).dot(normal) > 0) {
+            outer_loops.push_back(std::move(loop));
+        } else {
+            hole_loops.push_back(std::move(loop));
+        }
+    }
+    if (outer_loops.size() != 1) {
+        return false;
+    }
+
+    facet_out->loops.clear();
+    facet_out->hole_points.clear();
+    facet_out->interior_vertices.clear();
+    facet_out->loops.push_back(std::move(outer_loops[0]));
+    for (std::vector<Plc3::VertexId> &loop : hole_loops) {
+        Point hole_point;
+        if (!find_hole_point(plc, loop, normal, &hole_point)) {
+            return false;
+        }
+        facet_out->hole_points.push_back(hole_point);
+        facet_out->loops.push_back(std::move(loop));
+    }
+
+    std::set<Plc3::VertexId> interior;
+    for (int t : triangles) {
+        for (Plc3::VertexId vid : surface.triangles[t].vertices) {
+            interior.insert(vid);
+        }
+    }
+    for (const std::vector<Plc3::VertexId> &loop : facet_out->loops) {
+        for (Plc3::VertexId vid : loop) {
+            interior.erase(vid);
+        }
+    }
+    facet_out->interior_vertices.assign(interior.begin(), interior.end());
+    return true;
+}
+
+std::vector<PlcPolygonFacet> compute_polygon_facets(
+    const Plc3 &plc, Plc3::SurfaceId surface_id
+) {
+    const Plc3::Surface &surface = plc.surfaces[surface_id];
+    int num_triangles = surface.triangles.size();
+    double tolerance = coplanar_tolerance *
+        std::max(static_cast<double>(plc.compute_approx_scale()), 1.0);
+
+    std::vector<Vector> normals(num_triangles);
+    for (int t = 0; t < num_triangles; ++t) {
+        Vector n = triangle_area_normal(plc, surface.triangles[t]);
+        /* A degenerate triangle gets a zero normal, so it never merges */
+        normals[t] = (n.magnitude() > 0) ? n / n.magnitude() : Vector::zero();
+    }
+
+    /* Find pairs of triangles that share an edge, by sorting all the edges */
+    class Edge {
+    public:
+        Plc3::VertexId a, b;
+        int triangle;
+        bool operator<(const Edge &other) const {
+            return std::make_pair(a, b) < std::make_pair(other.a, other.b);
+        }
+    };
+    std::vector<Edge> edges;
+    edges.reserve(3 * num_triangles);
+    for (int t = 0; t < num_triangles; ++t) {
+        for (int i = 0; i < 3; ++i) {
+            Plc3::VertexId a = surface.triangles[t].vertices[i];
+            Plc3::VertexId b = surface.triangles[t].vertices[(i + 1) % 3];
+            edges.push_back(Edge { std::min(a, b), std::max(a, b), t });
+        }
+    }
+    std::sort(edges.begin(), edges.end());
+
+    /* Join triangles that share an edge and lie in the same plane */
+    std::vector<int> parent(num_triangles);
+    for (int t = 0; t < num_triangles; ++t) parent[t] = t;
+    for (int i = 0; i + 1 < static_cast<int>(edges.size()); ++i) {
+        const Edge &e1 = edges[i], &e2 = edges[i + 1];
+        if (e1.a != e2.a || e1.b != e2.b) continue;
+        if (i + 2 < static_cast<int>(edges.size()) &&
+                edges[i + 2].a == e1.a && edges[i + 2].b == e1.b) {
+            /* More than two triangles on this edge */
+            continue;
+        }
+        int t1 = e1.triangle, t2 = e2.triangle;
+        if (normals[t1].dot(normals[t2]) <= 0) continue;
+        Point origin = vertex_point(plc, surface.triangles[t1].vertices[0]);
+        bool coplanar = true;
+        for (Plc3::VertexId vid : surface.triangles[t2].vertices) {
+            double dist = (vertex_point(plc, vid) - origin).dot(normals[t1]);
+            if (fabs(dist) > tolerance) coplanar = false;
+        }
+        if (coplanar) {
+            parent[union_find_root(&parent, t1)] =
+                union_find_root(&parent, t2);
+        }
+    }
+
+    /* Collect the groups, in order of their lowest-numbered triangle */
+    std::map<int, std::vector<int> > groups_by_root;
+    std::vector<std::vector<int> *> groups;
+    for (int t = 0; t < num_triangles; ++t) {
+        std::vector<int> *group = &groups_by_root[union_find_root(&parent, t)];
+        if (group->empty()) groups.push_back(group);
+        group->push_back(t);
+    }
+
+    std::vector<PlcPolygonFacet> facets;
+    for (const std::vector<int> *group : groups) {
+        PlcPolygonFacet facet;
+        if (group->size() > 1) {
+            /* Small deviations can add up across a large group, so check the
+            whole group against a single plane before merging it. */
+            const Plc3::Surface::Triangle &first =
+                surface.triangles[group->front()];
+            Point origin = vertex_point(plc, first.vertices[0]);
+            bool planar = true;
+            for (int t : *group) {
+                for (Plc3::VertexId vid : surface.triangles[t].vertices) {
+                    double dist = (vertex_point(plc, vid) - origin)
+                        .dot(normals[group->front()]);
+                    if (fabs(dist) > tolerance) planar = false;
+                }
+            }
+            if (planar && make_polygon_facet(plc, surface, *group, &facet)) {
+                facets.push_back(std::move(facet));
+                continue;
+            }
+        }
+        for (int t : *group) {
+            const Plc3::Surface::Triangle &tri = surface.triangles[t];
+            PlcPolygonFacet single;
+            single.loops.push_back(std::vector<Plc3::VertexId>(
+                tri.vertices, tri.vertices + 3));
+            facets.push_back(std::move(single));
+        }
+    }
+    return facets;
+}
+
+} /* namespace os2cx */
@@ -0,0 +1,36 @@
+#ifndef OS2CX_PLC_FACETS_HPP_
+#define OS2CX_PLC_FACETS_HPP_
+
+#include <vector>
+
+#include "calc.hpp"
+#include "plc.hpp"
+
+namespace os2cx {
+
+/* A planar polygon with holes, made by merging triangles of a Plc3::Surface.
+'loops[0]' is the outer boundary, counterclockwise when seen from the
+surface's volumes[0] like the triangles themselves; any further loops are the
+boundaries of holes. Each entry of 'hole_points' is a point inside one of the
+holes, lying in the plane of the polygon. 'interior_vertices' are the vertices
+of the merged triangles that aren't on any loop; they still belong to the
+facet, or else tetgen would see them as isolated points. */
+class PlcPolygonFacet {
+public:
+    std::vector<std::vector<Plc3::VertexId> > loops;
+    std::vector<Point> hole_points;
+    std::vector<Plc3::VertexId> interior_vertices;
+};
+
+/* Groups the triangles of the given surface into as few planar polygons as
+possible. Triangles are merged when they share an edge and are coplanar to
+within a tolerance proportional to the size of the Plc3. If a group's boundary
+is awkward (e.g. two boundary loops touch at a single vertex), its triangles
+are returned individually instead, so every triangle of the surface is always
+covered by exactly one of the returned facets. */
+std::vector<PlcPolygonFacet> compute_polygon_facets(
+    const Plc3 &plc, Plc3::SurfaceId surface_id);
+
+} /* namespace os2cx */
+
+#endif /* OS2CX_PLC_FACETS_HPP_ */
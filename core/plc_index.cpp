@@ -1,161 +1,626 @@
 #include "plc_index.hpp"
 
-#include <CGAL/AABB_traits.h>
-#include <CGAL/AABB_tree.h>
-#include <CGAL/point_generators_3.h>
-#include <CGAL/Simple_cartesian.h>
+#include <math.h>
+
+#include <algorithm>
+
+#include "parallel.hpp"
+#include "simd.hpp"
+
+#ifdef OS2CX_X86_SIMD
+#include <immintrin.h>
+#endif
 
 namespace os2cx {
 
-typedef CGAL::Simple_cartesian<double> KS;
+/* Plc3IndexInternal is a bounding volume hierarchy over all of the triangles
+of the Plc3. Every node has up to four children, and the children's bounding
+boxes are stored in structure-of-arrays form, so that a ray or a point can be
+tested against all four boxes at once. If the CPU supports AVX, the box tests
+use explicit 4-wide double-precision instructions; otherwise they are plain
+loops over the four lanes. */
 
-/* This is a model of the concept CGAL::AABBPrimitiveWithSharedData */
-class PlcAabbPrimitive {
+static const int bvh_width = 4;
+static const int bvh_leaf_size = 4;
+
+class Plc3IndexInternal {
 public:
-    typedef CGAL::Point_3<KS> Point;
-    typedef CGAL::Triangle_3<KS> Datum;
-    typedef std::pair<Plc3::SurfaceId, int> Id;
-    typedef const Plc3 *Shared_data;
+    class Triangle {
+    public:
+        Plc3::SurfaceId surface;
+        int index;
+        Point vertices[3];
+    };
+
+    /* Child slot 'c' of a Node is empty if 'count[c] == -1', a leaf
+    containing 'triangles[child[c]...child[c]+count[c]-1]' if 'count[c] > 0', or
+    another Node 'nodes[child[c]]' if 'count[c] == 0'. Empty slots have inverted
+    bounding boxes, so the box tests reject them without a special case. */
+    class Node {
+    public:
+        double min_x[bvh_width], min_y[bvh_width], min_z[bvh_width];
+        double max_x[bvh_width], max_y[bvh_width], max_z[bvh_width];
+        int child[bvh_width];
+        int count[bvh_width];
+    };
+
+    class Ray {
+    public:
+        Ray(Point o, Vector d) : origin(o), direction(d) {
+            inverse = Vector(safe_inverse(d.x), safe_inverse(d.y),
+                safe_inverse(d.z));
+        }
+        /* A zero component would give an infinite inverse, and the slab test
+        would compute 0 * infinity = NaN; so use a huge finite value. */
+        static double safe_inverse(double c) {
+            static const double tiny = 1e-30;
+            if (fabs(c) < tiny) c = (c < 0) ? -tiny : tiny;
+            return 1 / c;
+        }
+        Point origin;
+        Vector direction, inverse;
+    };
+
+    class RayHit {
+    public:
+        int triangle;
+        double t;
+        /* True if the nearest hit can't be trusted: the ray grazed an edge or
+        vertex, or two triangles were hit at the same distance. */
+        bool ambiguous;
+    };
+
+    void build(const Plc3 *plc);
+    int build_node(int first, int count);
+    void set_slot(Node *node, int slot, int first, int count);
 
-    static Shared_data construct_shared_data(const Plc3 *pm) {
-        return pm;
+    /* Returns the first triangle hit by the ray at a distance of at least
+    'min_t', or a RayHit with 'triangle == -1' if there is none */
+    RayHit cast_ray(const Ray &ray, double min_t) const;
+
+    /* Returns the index of the triangle closest to 'point', considering only
+    triangles within 'sqrt(*sq_dist)'; or -1 if there are none. On success,
+    '*sq_dist' is set to the squared distance to that triangle. */
+    int closest_triangle(Point point, double *sq_dist) const;
+
+    /* For each of the four children of 'node', sets 'tnear[c]' to the distance
+    along the ray at which it enters the child's bounding box, or to infinity
+    if it misses the box or enters it after 'tmax'. */
+    void ray_node_test(
+        const Node &node, const Ray &ray, double tmax,
+        double tnear[bvh_width]) const;
+
+    /* For each of the four children of 'node', sets 'sq_dist[c]' to the
+    squared distance from 'point' to the child's bounding box. */
+    void point_node_test(
+        const Node &node, Point point, double sq_dist[bvh_width]) const;
+
+    std::vector<Triangle> triangles;
+    std::vector<Node> nodes;
+
+    /* Tolerance for deciding that two ray hits are at the same distance; this
+    is proportional to the size of the Plc3. */
+    double distance_tolerance;
+
+    /* Whether to use the AVX versions of the box tests */
+    bool use_avx;
+};
+
+static Point triangle_centroid(const Plc3IndexInternal::Triangle &tri) {
+    return Point::origin() + (
+        (tri.vertices[0] - Point::origin()) +
+        (tri.vertices[1] - Point::origin()) +
+        (tri.vertices[2] - Point::origin())) / 3;
+}
+
+void Plc3IndexInternal::build(const Plc3 *plc) {
+    double scale = 0;
+    for (Plc3::SurfaceId sid = 0;
+            sid < static_cast<int>(plc->surfaces.size()); ++sid) {
+        const Plc3::Surface &surface = plc->surfaces[sid];
+        for (int j = 0; j < static_cast<int>(surface.triangles.size()); ++j) {
+            Triangle tri;
+            tri.surface = sid;
+            tri.index = j;
+            for (int k = 0; k < 3; ++k) {
+                tri.vertices[k] =
+                    plc->vertices[surface.triangles[j].vertices[k]].point;
+                scale = std::max(scale, fabs(tri.vertices[k].x));
+                scale = std::max(scale, fabs(tri.vertices[k].y));
+                scale = std::max(scale, fabs(tri.vertices[k].z));
+            }
+            triangles.push_back(tri);
+        }
     }
+    distance_tolerance = std::max(scale, 1.0) * 1e-9;
+    use_avx = (simd_level() >= SimdLevel::Avx);
 
-    PlcAabbPrimitive() { }
+    if (triangles.empty()) {
+        return;
+    }
 
-    template<class Iterator>
-    PlcAabbPrimitive(Iterator it, const Plc3 *) : i(*it) { }
+    if (static_cast<int>(triangles.size()) <= bvh_leaf_size) {
+        /* Too few triangles to split; the root has a single leaf. */
+        Node root;
+        set_slot(&root, 0, 0, triangles.size());
+        for (int c = 1; c < bvh_width; ++c) {
+            set_slot(&root, c, 0, -1);
+        }
+        nodes.push_back(root);
+    } else {
+        build_node(0, triangles.size());
+    }
+}
 
-    Datum datum(const Plc3 *rm) const {
-        const Plc3::Surface::Triangle &tri =
-            rm->surfaces[i.first].triangles[i.second];
-        return CGAL::Triangle_3<KS>(
-            get_point(rm, tri.vertices[0]),
-            get_point(rm, tri.vertices[1]),
-            get_point(rm, tri.vertices[2]));
+/* Sorts 'triangles[first...first+count-1]' so that the first half and second
+half are separated along the longest axis of their centroids' bounding box. */
+static void split_triangles(
+    std::vector<Plc3IndexInternal::Triangle> *triangles,
+    int first,
+    int count
+) {
+    Point lo(HUGE_VAL, HUGE_VAL, HUGE_VAL);
+    Point hi(-HUGE_VAL, -HUGE_VAL, -HUGE_VAL);
+    for (int j = first; j < first + count; ++j) {
+        Point c = triangle_centroid((*triangles)[j]);
+        lo = Point(
+            std::min(lo.x, c.x), std::min(lo.y, c.y), std::min(lo.z, c.z));
+        hi = Point(
+            std::max(hi.x, c.x), std::max(hi.y, c.y), std::max(hi.z, c.z));
+    }
+    LengthVector extent = hi - lo;
+    Dimension axis = Dimension::X;
+    if (extent.y > extent.x && extent.y >= extent.z) {
+        axis = Dimension::Y;
+    } else if (extent.z > extent.x && extent.z > extent.y) {
+        axis = Dimension::Z;
     }
+    std::nth_element(
+        triangles->begin() + first,
+        triangles->begin() + first + count / 2,
+        triangles->begin() + first + count,
+        [axis](const Plc3IndexInternal::Triangle &a,
+                const Plc3IndexInternal::Triangle &b) {
+            return triangle_centroid(a).at(axis) <
+                triangle_centroid(b).at(axis);
+        });
+}
 
-    Id id() const {
-        return i;
+int Plc3IndexInternal::build_node(int first, int count) {
+    assert(count > bvh_leaf_size);
+    int node_index = nodes.size();
+    nodes.push_back(Node());
+
+    /* Split the triangles in half, then split each half in half again if it's
+    too big to be a leaf, giving up to four groups. */
+    std::pair<int, int> halves[2];
+    split_triangles(&triangles, first, count);
+    halves[0] = std::make_pair(first, count / 2);
+    halves[1] = std::make_pair(first + count / 2, count - count / 2);
+    std::vector<std::pair<int, int> > groups;
+    for (const std::pair<int, int> &half : halves) {
+        if (half.second <= bvh_leaf_size) {
+            groups.push_back(half);
+        } else {
+            split_triangles(&triangles, half.first, half.second);
+            int quarter = half.second / 2;
+            groups.push_back(std::make_pair(half.first, quarter));
+            groups.push_back(std::make_pair(
+                half.first + quarter, half.second - quarter));
+        }
     }
 
-    Point reference_point(const Plc3 *rm) const {
-        const Plc3::Surface::Triangle &tri =
-            rm->surfaces[i.first].triangles[i.second];
-        return get_point(rm, tri.vertices[0]);
+    Node node;
+    for (int c = 0; c < bvh_width; ++c) {
+        if (c >= static_cast<int>(groups.size())) {
+            set_slot(&node, c, 0, -1);
+        } else {
+            set_slot(&node, c, groups[c].first, groups[c].second);
+            if (groups[c].second > bvh_leaf_size) {
+                /* set_slot() computed the bounding box; now replace the leaf
+                with an interior node */
+                node.child[c] = build_node(groups[c].first, groups[c].second);
+                node.count[c] = 0;
+            }
+        }
     }
+    nodes[node_index] = node;
+    return node_index;
+}
 
-private:
-    Point get_point(const Plc3 *rm, Plc3::VertexId vid) const {
-        return CGAL::Point_3<KS>(
-            rm->vertices[vid].point.x,
-            rm->vertices[vid].point.y,
-            rm->vertices[vid].point.z);
+void Plc3IndexInternal::set_slot(Node *node, int slot, int first, int count) {
+    node->child[slot] = first;
+    node->count[slot] = count;
+    node->min_x[slot] = node->min_y[slot] = node->min_z[slot] = HUGE_VAL;
+    node->max_x[slot] = node->max_y[slot] = node->max_z[slot] = -HUGE_VAL;
+    for (int j = first; j < first + count; ++j) {
+        for (const Point &p : triangles[j].vertices) {
+            node->min_x[slot] = std::min(node->min_x[slot], p.x);
+            node->min_y[slot] = std::min(node->min_y[slot], p.y);
+            node->min_z[slot] = std::min(node->min_z[slot], p.z);
+            node->max_x[slot] = std::max(node->max_x[slot], p.x);
+            node->max_y[slot] = std::max(node->max_y[slot], p.y);
+            node->max_z[slot] = std::max(node->max_z[slot], p.z);
+        }
     }
+}
 
-    Id i;
-};
+#ifdef OS2CX_X86_SIMD
 
-class PlcAabbPrimitiveIterator {
-public:
-    bool operator!=(const PlcAabbPrimitiveIterator &other) {
-        return pm != other.pm || pair != other.pair;
+__attribute__((target("avx")))
+static void ray_node_test_avx(
+    const double *lo_x, const double *lo_y, const double *lo_z,
+    const double *hi_x, const double *hi_y, const double *hi_z,
+    const Plc3IndexInternal::Ray &ray, double tmax, double tnear[bvh_width]
+) {
+    __m256d ox = _mm256_set1_pd(ray.origin.x);
+    __m256d oy = _mm256_set1_pd(ray.origin.y);
+    __m256d oz = _mm256_set1_pd(ray.origin.z);
+    __m256d ix = _mm256_set1_pd(ray.inverse.x);
+    __m256d iy = _mm256_set1_pd(ray.inverse.y);
+    __m256d iz = _mm256_set1_pd(ray.inverse.z);
+    __m256d t0 = _mm256_max_pd(
+        _mm256_max_pd(
+            _mm256_mul_pd(_mm256_sub_pd(_mm256_loadu_pd(lo_x), ox), ix),
+            _mm256_mul_pd(_mm256_sub_pd(_mm256_loadu_pd(lo_y), oy), iy)),
+        _mm256_max_pd(
+            _mm256_mul_pd(_mm256_sub_pd(_mm256_loadu_pd(lo_z), oz), iz),
+            _mm256_setzero_pd()));
+    __m256d t1 = _mm256_min_pd(
+        _mm256_min_pd(
+            _mm256_mul_pd(_mm256_sub_pd(_mm256_loadu_pd(hi_x), ox), ix),
+            _mm256_mul_pd(_mm256_sub_pd(_mm256_loadu_pd(hi_y), oy), iy)),
+        _mm256_min_pd(
+            _mm256_mul_pd(_mm256_sub_pd(_mm256_loadu_pd(hi_z), oz), iz),
+            _mm256_set1_pd(tmax)));
+    __m256d hit = _mm256_cmp_pd(t0, t1, _CMP_LE_OQ);
+    _mm256_storeu_pd(tnear,
+        _mm256_blendv_pd(_mm256_set1_pd(HUGE_VAL), t0, hit));
+}
+
+__attribute__((target("avx")))
+static void point_node_test_avx(
+    const Plc3IndexInternal::Node &node, Point point,
+    double sq_dist[bvh_width]
+) {
+    __m256d zero = _mm256_setzero_pd();
+    __m256d px = _mm256_set1_pd(point.x);
+    __m256d py = _mm256_set1_pd(point.y);
+    __m256d pz = _mm256_set1_pd(point.z);
+    __m256d dx = _mm256_max_pd(
+        _mm256_max_pd(_mm256_sub_pd(_mm256_loadu_pd(node.min_x), px), zero),
+        _mm256_sub_pd(px, _mm256_loadu_pd(node.max_x)));
+    __m256d dy = _mm256_max_pd(
+        _mm256_max_pd(_mm256_sub_pd(_mm256_loadu_pd(node.min_y), py), zero),
+        _mm256_sub_pd(py, _mm256_loadu_pd(node.max_y)));
+    __m256d dz = _mm256_max_pd(
+        _mm256_max_pd(_mm256_sub_pd(_mm256_loadu_pd(node.min_z), pz), zero),
+        _mm256_sub_pd(pz, _mm256_loadu_pd(node.max_z)));
+    _mm256_storeu_pd(sq_dist, _mm256_add_pd(
+        _mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy)),
+        _mm256_mul_pd(dz, dz)));
+}
+
+#endif /* OS2CX_X86_SIMD */
+
+void Plc3IndexInternal::ray_node_test(
+    const Node &node, const Ray &ray, double tmax, double tnear[bvh_width]
+) const {
+    /* Standard slab test. Directions may have zero components (for example
+    from compute_thicknesses()), but Ray::safe_inverse() keeps the inverse
+    finite. Swapping the slabs for negative directions means the near plane is
+    always 'lo'. */
+    const double *lo_x = ray.inverse.x >= 0 ? node.min_x : node.max_x;
+    const double *hi_x = ray.inverse.x >= 0 ? node.max_x : node.min_x;
+    const double *lo_y = ray.inverse.y >= 0 ? node.min_y : node.max_y;
+    const double *hi_y = ray.inverse.y >= 0 ? node.max_y : node.min_y;
+    const double *lo_z = ray.inverse.z >= 0 ? node.min_z : node.max_z;
+    const double *hi_z = ray.inverse.z >= 0 ? node.max_z : node.min_z;
+#ifdef OS2CX_X86_SIMD
+    if (use_avx) {
+        ray_node_test_avx(
+            lo_x, lo_y, lo_z, hi_x, hi_y, hi_z, ray, tmax, tnear);
+        return;
     }
-    PlcAabbPrimitiveIterator &operator++() {
-        pair.second += 1;
-        while (pair.first != static_cast<int>(pm->surfaces.size()) &&
-                pair.second == static_cast<int>(
-                    pm->surfaces[pair.first].triangles.size())) {
-            ++pair.first;
-            pair.second = 0;
+#endif
+    for (int c = 0; c < bvh_width; ++c) {
+        double t0 = std::max(
+            std::max((lo_x[c] - ray.origin.x) * ray.inverse.x,
+                (lo_y[c] - ray.origin.y) * ray.inverse.y),
+            std::max((lo_z[c] - ray.origin.z) * ray.inverse.z, 0.0));
+        double t1 = std::min(
+            std::min((hi_x[c] - ray.origin.x) * ray.inverse.x,
+                (hi_y[c] - ray.origin.y) * ray.inverse.y),
+            std::min((hi_z[c] - ray.origin.z) * ray.inverse.z, tmax));
+        tnear[c] = (t0 <= t1) ? t0 : HUGE_VAL;
+    }
+}
+
+void Plc3IndexInternal::point_node_test(
+    const Node &node, Point point, double sq_dist[bvh_width]
+) const {
+#ifdef OS2CX_X86_SIMD
+    if (use_avx) {
+        point_node_test_avx(node, point, sq_dist);
+        return;
+    }
+#endif
+    for (int c = 0; c < bvh_width; ++c) {
+        double dx = std::max(
+            std::max(node.min_x[c] - point.x, 0.0), point.x - node.max_x[c]);
+        double dy = std::max(
+            std::max(node.min_y[c] - point.y, 0.0), point.y - node.max_y[c]);
+        double dz = std::max(
+            std::max(node.min_z[c] - point.z, 0.0), point.z - node.max_z[c]);
+        sq_dist[c] = dx * dx + dy * dy + dz * dz;
+    }
+}
+
+/* Sorts the child slots of a node by the given keys, ascending, and returns
+how many of them have a finite key. */
+static int sort_slots(const double key[bvh_width], int order[bvh_width]) {
+    int n = 0;
+    for (int c = 0; c < bvh_width; ++c) {
+        if (key[c] == HUGE_VAL) continue;
+        int j = n++;
+        while (j > 0 && key[order[j - 1]] > key[c]) {
+            order[j] = order[j - 1];
+            --j;
         }
-        return *this;
+        order[j] = c;
     }
-    PlcAabbPrimitiveIterator operator++(int) {
-        PlcAabbPrimitiveIterator copy = *this;
-        ++*this;
-        return copy;
+    return n;
+}
+
+/* Intersects the ray with the triangle using the Moller-Trumbore algorithm.
+Returns true and sets '*t' if the ray passes through the triangle or within a
+small tolerance of its boundary; '*on_edge' is set if the ray is within that
+tolerance of an edge or vertex, where the answer could go either way. */
+static bool ray_triangle_test(
+    const Plc3IndexInternal::Ray &ray,
+    const Plc3IndexInternal::Triangle &tri,
+    double *t,
+    bool *on_edge
+) {
+    static const double barycentric_epsilon = 1e-9;
+    LengthVector e1 = tri.vertices[1] - tri.vertices[0];
+    LengthVector e2 = tri.vertices[2] - tri.vertices[0];
+    Vector p = ray.direction.cross(e2);
+    double det = e1.dot(p);
+    if (fabs(det) <= 1e-12 * e1.magnitude() * e2.magnitude()) {
+        /* The ray is parallel to the triangle. If it lies in the triangle's
+        plane, it will also graze a neighboring triangle's edge, which gets
+        reported as ambiguous; so it's safe to ignore this triangle. */
+        return false;
     }
-    const std::pair<Plc3::SurfaceId, int> &operator*() const {
-        return pair;
+    double inv_det = 1 / det;
+    LengthVector s = ray.origin - tri.vertices[0];
+    double u = s.dot(p) * inv_det;
+    Vector q = s.cross(e1);
+    double v = ray.direction.dot(q) * inv_det;
+    double w = 1 - u - v;
+    double min_bary = std::min(std::min(u, v), w);
+    if (min_bary < -barycentric_epsilon) {
+        return false;
     }
-    const std::pair<Plc3::SurfaceId, int> *operator->() const {
-        return &pair;
+    *t = e2.dot(q) * inv_det;
+    *on_edge = (min_bary < barycentric_epsilon);
+    return true;
+}
+
+Plc3IndexInternal::RayHit Plc3IndexInternal::cast_ray(
+    const Ray &ray, double min_t
+) const {
+    RayHit best;
+    best.triangle = -1;
+    best.t = HUGE_VAL;
+    best.ambiguous = false;
+    if (nodes.empty()) {
+        return best;
     }
 
-    const Plc3 *pm;
-    std::pair<Plc3::SurfaceId, int> pair;
-};
+    int stack[64 * bvh_width];
+    int stack_size = 0;
+    stack[stack_size++] = 0;
+    while (stack_size > 0) {
+        const Node &node = nodes[stack[--stack_size]];
+        double tnear[bvh_width];
+        ray_node_test(node, ray, best.t + distance_tolerance, tnear);
+        int order[bvh_width];
+        int num_hit = sort_slots(tnear, order);
 
-typedef CGAL::AABB_traits<KS, PlcAabbPrimitive> PlcAabbTraits;
-typedef CGAL::AABB_tree<PlcAabbTraits> PlcAabbTree;
+        /* Push the farthest child first, so the nearest one is visited first
+        and shrinks 'best.t' as early as possible. */
+        for (int k = num_hit - 1; k >= 0; --k) {
+            int c = order[k];
+            if (node.count[c] == 0) {
+                assert(stack_size < static_cast<int>(
+                    sizeof(stack) / sizeof(stack[0])));
+                stack[stack_size++] = node.child[c];
+                continue;
+            }
+            for (int j = node.child[c]; j < node.child[c] + node.count[c];
+                    ++j) {
+                double t;
+                bool on_edge;
+                if (!ray_triangle_test(ray, triangles[j], &t, &on_edge)) {
+                    continue;
+                }
+                if (t < min_t) {
+                    continue;
+                }
+                if (t < best.t - distance_tolerance) {
+                    best.triangle = j;
+                    best.t = t;
+                    best.ambiguous = on_edge;
+                } else if (t <= best.t + distance_tolerance) {
+                    /* Two triangles at the same distance; we can't tell which
+                    one the ray really passed through first. */
+                    best.ambiguous = true;
+                    if (t < best.t) {
+                        best.triangle = j;
+                        best.t = t;
+                    }
+                }
+            }
+        }
+    }
+    return best;
+}
 
-class Plc3IndexInternal {
-public:
-    PlcAabbTree tree;
-};
+int Plc3IndexInternal::closest_triangle(Point point, double *sq_dist) const {
+    int best = -1;
+    if (nodes.empty()) {
+        return best;
+    }
+
+    int stack[64 * bvh_width];
+    int stack_size = 0;
+    stack[stack_size++] = 0;
+    while (stack_size > 0) {
+        const Node &node = nodes[stack[--stack_size]];
+        double box_sq_dist[bvh_width];
+        point_node_test(node, point, box_sq_dist);
+        for (int c = 0; c < bvh_width; ++c) {
+            if (box_sq_dist[c] > *sq_dist) box_sq_dist[c] = HUGE_VAL;
+        }
+        int order[bvh_width];
+        int num_near = sort_slots(box_sq_dist, order);
+        for (int k = num_near - 1; k >= 0; --k) {
+            int c = order[k];
+            if (node.count[c] == 0) {
+                assert(stack_size < static_cast<int>(
+                    sizeof(stack) / sizeof(stack[0])));
+                stack[stack_size++] = node.child[c];
+                continue;
+            }
+            for (int j = node.child[c]; j < node.child[c] + node.count[c];
+                    ++j) {
+                const Triangle &tri = triangles[j];
+                LengthVector delta = closest_point_on_triangle(point,
+                    tri.vertices[0], tri.vertices[1], tri.vertices[2]) - point;
+                double d = delta.dot(delta);
+                if (d < *sq_dist || (best == -1 && d <= *sq_dist)) {
+                    *sq_dist = d;
+                    best = j;
+                }
+            }
+        }
+    }
+    return best;
+}
+
+/* Returns the direction to use for the given attempt at casting a ray. The
+directions are spread over the sphere, and every component is kept well away
+from zero so the ray is never parallel to an axis-aligned face (which are very
+common in practice) and never exactly along a diagonal. */
+static Vector ray_direction(int attempt) {
+    static const double golden = 0.6180339887498949;
+    static const double plastic = 0.7548776662466927;
+    for (int k = attempt; ; k += 32) {
+        double z = 1 - 2 * fmod(0.2113248654 + golden * k, 1.0);
+        double theta = 2 * M_PI * fmod(0.3371 + plastic * k, 1.0);
+        double r = sqrt(1 - z * z);
+        Vector dir(r * cos(theta), r * sin(theta), z);
+        if (fabs(dir.x) > 0.05 && fabs(dir.y) > 0.05 && fabs(dir.z) > 0.05) {
+            return dir;
+        }
+    }
+}
 
 Plc3Index::Plc3Index(const Plc3 *plc_) : plc(plc_)
 {
     i.reset(new Plc3IndexInternal);
-    PlcAabbPrimitiveIterator begin {plc, {0, 0}};
-    PlcAabbPrimitiveIterator end {plc, {plc->surfaces.size(), 0}};
-    i->tree.rebuild(begin, end, plc);
-    i->tree.accelerate_distance_queries();
+    i->build(plc);
 }
 
 Plc3Index::~Plc3Index() { }
 
-Plc3::VolumeId Plc3Index::volume_containing_point(Point point) const {
-    /* Shoot a ray in a random direction, until it hits a triangle. Then ask
-    which volume is on the side of the triangle that was hit. */
-
-    CGAL::Random_points_on_sphere_3<CGAL::Point_3<KS> > random;
-    CGAL::Vector_3<KS> direction(CGAL::ORIGIN, *random);
-    CGAL::Ray_3<KS> ray(
-        CGAL::Point_3<KS>(point.x, point.y, point.z),
-        direction);
-
-    boost::optional<PlcAabbPrimitive::Id> hit =
-        i->tree.first_intersected_primitive(ray);
-    if (!hit) return plc->volume_outside;
+Plc3::VolumeId Plc3Index::volume_containing_point_by_winding_number(
+    Point point
+) const {
+    /* Each triangle contributes its signed solid angle (Van Oosterom and
+    Strackee) to the volume its normal points away from, and the negation to
+    the volume its normal points into. That sums to 1 for the volume that
+    contains the point and 0 for every other bounded volume, and to -1 for the
+    outside volume when the point is inside something. So count the outside
+    volume from 1 instead of 0. On a surface, the volumes on either side tie,
+    up to rounding. */
+    std::vector<double> winding(plc->volumes.size(), 0.0);
+    winding[plc->volume_outside] = 1;
+    for (const Plc3IndexInternal::Triangle &tri : i->triangles) {
+        LengthVector a = tri.vertices[0] - point;
+        LengthVector b = tri.vertices[1] - point;
+        LengthVector c = tri.vertices[2] - point;
+        double triple = a.dot(b.cross(c));
+        if (triple == 0) {
+            /* The point is in the triangle's plane. If it's on the triangle
+            itself, the solid angle is a full half-sphere whose sign depends on
+            rounding; counting it as zero instead makes the two sides tie. */
+            continue;
+        }
+        double la = a.magnitude(), lb = b.magnitude(), lc = c.magnitude();
+        double solid_angle = 2 * atan2(triple,
+            la * lb * lc + a.dot(b) * lc + a.dot(c) * lb + b.dot(c) * la);
+        const Plc3::Surface &surface = plc->surfaces[tri.surface];
+        winding[surface.volumes[1]] += solid_angle / (4 * M_PI);
+        winding[surface.volumes[0]] -= solid_angle / (4 * M_PI);
+    }
+    return std::max_element(winding.begin(), winding.end()) - winding.begin();
+}
 
-    const Plc3::Surface &surface = plc->surfaces[hit->first];
-    const Plc3::Surface::Triangle &tri = surface.triangles[hit->second];
+Plc3::VolumeId Plc3Index::volume_containing_point(Point point) const {
+    /* Shoot a ray from the point until it hits a triangle. Then ask which
+    volume is on the side of the triangle that was hit. If the ray grazes an
+    edge or vertex, the answer is unreliable, so try again in a different
+    direction. If every direction is ambiguous, the point is probably right at
+    an edge or vertex itself, so use the winding number instead, which doesn't
+    depend on a direction at all. */
+    static const int max_attempts = 8;
+    Plc3IndexInternal::RayHit hit;
+    Vector direction;
+    for (int attempt = 0; ; ++attempt) {
+        if (attempt == max_attempts) {
+            return volume_containing_point_by_winding_number(point);
+        }
+        direction = ray_direction(attempt);
+        hit = i->cast_ray(Plc3IndexInternal::Ray(point, direction),
+            -i->distance_tolerance);
+        if (!hit.ambiguous) break;
+    }
+    if (hit.triangle == -1) return plc->volume_outside;
 
+    const Plc3IndexInternal::Triangle &tri = i->triangles[hit.triangle];
     Vector normal = triangle_normal(
-        plc->vertices[tri.vertices[0]].point,
-        plc->vertices[tri.vertices[1]].point,
-        plc->vertices[tri.vertices[2]].point);
-    double dot =
-        direction.x() * normal.x +
-        direction.y() * normal.y +
-        direction.z() * normal.z;
+        tri.vertices[0], tri.vertices[1], tri.vertices[2]);
     /* The normal vector points into 'surface.volumes[0]' */
-    return surface.volumes[(dot > 0) ? 1 : 0];
+    const Plc3::Surface &surface = plc->surfaces[tri.surface];
+    return surface.volumes[(direction.dot(normal) > 0) ? 1 : 0];
 }
 
 static const double epsilon = 1e-9;
 
 Plc3::SurfaceId Plc3Index::surface_containing_point(Point point) const {
-    CGAL::Point_3<KS> point2(point.x, point.y, point.z);
-    PlcAabbTree::Point_and_primitive_id hit =
-        i->tree.closest_point_and_primitive(point2);
-    double sq_dist = CGAL::squared_distance(hit.first, point2);
-    if (sq_dist > epsilon * epsilon) {
+    double sq_dist = epsilon * epsilon;
+    int tri = i->closest_triangle(point, &sq_dist);
+    if (tri == -1) {
         return -1;
     }
-    return hit.second.first;
+    return i->triangles[tri].surface;
 }
 
 Plc3::VertexId Plc3Index::vertex_at_point(Point point) const {
     /* Find the nearest triangle to the given point. Then check whether any
-    vertex of that triangle coincides with the given point. */
-    CGAL::Point_3<KS> point2(point.x, point.y, point.z);
-    PlcAabbTree::Point_and_primitive_id hit =
-        i->tree.closest_point_and_primitive(point2);
-    Plc3::Surface::Triangle triangle =
-        plc->surfaces[hit.second.first].triangles[hit.second.second];
+    vertex of that triangle coincides with the given point. Only triangles
+    within epsilon can have such a vertex, so don't look any farther. */
+    double sq_dist = epsilon * epsilon;
+    int tri = i->closest_triangle(point, &sq_dist);
+    if (tri == -1) {
+        return -1;
+    }
+    const Plc3::Surface::Triangle &triangle =
+        plc->surfaces[i->triangles[tri].surface]
+            .triangles[i->triangles[tri].index];
     for (int j = 0; j < 3; ++j) {
         Plc3::VertexId vertex = triangle.vertices[j];
         double dist = (point - plc->vertices[vertex].point).magnitude();
@@ -166,5 +631,36 @@ Plc3::VertexId Plc3Index::vertex_at_point(Point point) const {
     return -1;
 }
 
+Length Plc3Index::ray_hit_distance(Point origin, Vector direction) const {
+    /* Skip hits right at the origin, so that rays cast from a point on the
+    surface don't just hit the surface they started from. */
+    Plc3IndexInternal::RayHit hit = i->cast_ray(
+        Plc3IndexInternal::Ray(origin, direction / direction.magnitude()),
+        1000 * i->distance_tolerance);
+    return (hit.triangle == -1) ? HUGE_VAL : hit.t;
+}
+
+void Plc3Index::classify_points(
+    const std::vector<Point> &points,
+    std::vector<Plc3::VolumeId> *volumes_out,
+    std::vector<Plc3::SurfaceId> *surfaces_out
+) const {
+    if (volumes_out) volumes_out->resize(points.size());
+    if (surfaces_out) surfaces_out->resize(points.size());
+
+    /* The index is never modified after construction and the ray directions
+    are fixed, so the queries can run concurrently with no further setup. */
+    static const int chunk_size = 256;
+    parallel_for(points.size(), chunk_size, [&](int begin, int end) {
+        for (int j = begin; j < end; ++j) {
+            if (volumes_out) {
+                (*volumes_out)[j] = volume_containing_point(points[j]);
+            }
+            if (surfaces_out) {
+                (*surfaces_out)[j] = surface_containing_point(points[j]);
+            }
+        }
+    });
+}
 
 } /* namespace os2cx */
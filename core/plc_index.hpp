@@ -2,6 +2,7 @@
 #define OS2CX_PLC_INDEX_HPP_
 
 #include <memory>
+#include <vector>
 
 #include "calc.hpp"
 #include "plc.hpp"
@@ -17,6 +18,13 @@ public:
 
     Plc3::VolumeId volume_containing_point(Point p) const;
 
+    /* Like volume_containing_point(), but computed from generalized winding
+    numbers instead of by casting rays. This visits every triangle, so it's much
+    slower; volume_containing_point() only falls back to it for points where
+    every ray grazes an edge or vertex. A point on a surface may be reported in
+    either of the volumes on each side. */
+    Plc3::VolumeId volume_containing_point_by_winding_number(Point p) const;
+
     /* If the point is on a surface (to within some epsilon), returns that
     surface; otherwise, returns -1. */
     Plc3::SurfaceId surface_containing_point(Point p) const;
@@ -25,6 +33,21 @@ public:
     vertex; otherwise, returns -1. */
     Plc3::VertexId vertex_at_point(Point p) const;
 
+    /* Returns the distance from 'origin' to the nearest surface in the given
+    direction, or infinity if there is none. Surfaces passing through 'origin'
+    itself are ignored. */
+    Length ray_hit_distance(Point origin, Vector direction) const;
+
+    /* Equivalent to calling volume_containing_point() and
+    surface_containing_point() on each of the given points, but the queries are
+    spread across worker threads. Either output may be null if the caller
+    doesn't need it; otherwise it's resized to match 'points'. The results are
+    the same from run to run regardless of the number of threads. */
+    void classify_points(
+        const std::vector<Point> &points,
+        std::vector<Plc3::VolumeId> *volumes_out,
+        std::vector<Plc3::SurfaceId> *surfaces_out) const;
+
     const Plc3 *plc;
     std::unique_ptr<Plc3IndexInternal> i;
 };
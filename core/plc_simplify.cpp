@@ -0,0 +1,540 @@
+#include "plc_simplify.hpp"
+
+#include <math.h>
+
+#include <algorithm>
+#include <array>
+#include <map>
+#include <queue>
+#include <set>
+#include <tuple>
+
+namespace os2cx {
+
+/* Returns true if the segment from 'p' to 'q' passes through the interior of
+the triangle. Touching at a vertex or edge doesn't count. */
+static bool segment_crosses_triangle(
+    Point p, Point q, const Point (&tri)[3]
+) {
+    Vector normal = (tri[1] - tri[0]).cross(tri[2] - tri[0]);
+    double dp = normal.dot(p - tri[0]), dq = normal.dot(q - tri[0]);
+    if (dp == 0 || dq == 0 || (dp > 0) == (dq > 0)) {
+        return false;
+    }
+    Point x = p + (q - p) * (dp / (dp - dq));
+    for (int i = 0; i < 3; ++i) {
+        Point a = tri[i], b = tri[(i + 1) % 3];
+        if ((b - a).cross(x - a).dot(normal) <= 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool triangles_intersect(
+    const Point (&t1)[3], const Point (&t2)[3]
+) {
+    for (int i = 0; i < 3; ++i) {
+        if (segment_crosses_triangle(t1[i], t1[(i + 1) % 3], t2) ||
+                segment_crosses_triangle(t2[i], t2[(i + 1) % 3], t1)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+class PlcSimplifier {
+public:
+    enum class VertexKind {
+        /* Never removed */
+        Locked,
+        /* All triangles belong to a single surface, and not on any border */
+        Interior,
+        /* In the middle of exactly one border */
+        Border
+    };
+
+    class VertexState {
+    public:
+        VertexKind kind;
+        bool alive;
+        /* Incremented whenever the vertex's neighborhood changes, so that stale
+        entries in the queue can be recognized */
+        int version;
+        /* Triangles that use this vertex; may include dead triangles */
+        std::vector<int> triangles;
+        /* For border vertices, the neighbors along the border; and the
+        original points that have been removed between this vertex and
+        'border_next'. */
+        Plc3::VertexId border_prev, border_next;
+        std::vector<Point> border_removed;
+    };
+
+    class Triangle {
+    public:
+        Plc3::SurfaceId surface;
+        Plc3::VertexId vertices[3];
+        bool alive;
+        /* Original points that have been removed and that now lie closest to
+        this triangle */
+        std::vector<Point> removed;
+        /* The original triangles of the same surface that this triangle now
+        stands in for, as sorted indices into 'original_points' */
+        std::vector<int> originals;
+    };
+
+    /* A candidate collapse of vertex 'from' into vertex 'to' */
+    class Candidate {
+    public:
+        double sq_length;
+        Plc3::VertexId from, to;
+        int version;
+        bool operator>(const Candidate &other) const {
+            return std::tie(sq_length, from, to) >
+                std::tie(other.sq_length, other.from, other.to);
+        }
+    };
+
+    PlcSimplifier(const Plc3 &p, double tol) : plc(p), tolerance(tol) { }
+
+    void setup() {
+        vertices.resize(plc.vertices.size());
+        for (VertexState &vs : vertices) {
+            vs.kind = VertexKind::Locked;
+            vs.alive = true;
+            vs.version = 0;
+            vs.border_prev = vs.border_next = -1;
+        }
+        for (Plc3::SurfaceId sid = 0;
+                sid < static_cast<int>(plc.surfaces.size()); ++sid) {
+            for (const Plc3::Surface::Triangle &tri :
+                    plc.surfaces[sid].triangles) {
+                Triangle t;
+                t.surface = sid;
+                std::copy(tri.vertices, tri.vertices + 3, t.vertices);
+                t.alive = true;
+                t.originals.push_back(triangles.size());
+                std::array<Point, 3> points;
+                for (int i = 0; i < 3; ++i) {
+                    points[i] = plc.vertices[tri.vertices[i]].point;
+                }
+                original_points.push_back(points);
+                for (Plc3::VertexId vid : tri.vertices) {
+                    vertices[vid].triangles.push_back(triangles.size());
+                }
+                triangles.push_back(std::move(t));
+            }
+        }
+
+        /* Vertices whose triangles are all in one surface are Interior, unless
+        they carry attrs that the surface doesn't have */
+        for (Plc3::VertexId vid = 0;
+                vid < static_cast<int>(vertices.size()); ++vid) {
+            VertexState &vs = vertices[vid];
+            if (vs.triangles.empty()) continue;
+            Plc3::SurfaceId sid = triangles[vs.triangles[0]].surface;
+            bool one_surface = true;
+            for (int t : vs.triangles) {
+                if (triangles[t].surface != sid) one_surface = false;
+            }
+            AttrBitset extra_attrs =
+                plc.vertices[vid].attrs & ~plc.surfaces[sid].attrs;
+            if (one_surface && extra_attrs.none()) {
+                vs.kind = VertexKind::Interior;
+            }
+        }
+
+        /* Border vertices override the above. A vertex that's in the middle of
+        one border becomes Border; anything else on a border is Locked. */
+        std::vector<int> border_count(vertices.size(), 0);
+        for (const Plc3::Border &border : plc.borders) {
+            for (Plc3::VertexId vid : border.vertices) {
+                ++border_count[vid];
+            }
+        }
+        for (const Plc3::Border &border : plc.borders) {
+            int n = border.vertices.size();
+            for (int i = 0; i < n; ++i) {
+                Plc3::VertexId vid = border.vertices[i];
+                VertexState &vs = vertices[vid];
+                bool middle = (i != 0 && i != n - 1);
+                if (middle && border_count[vid] == 1 &&
+                        plc.vertices[vid].attrs == border.attrs) {
+                    vs.kind = VertexKind::Border;
+                    vs.border_prev = border.vertices[i - 1];
+                    vs.border_next = border.vertices[i + 1];
+                } else {
+                    vs.kind = VertexKind::Locked;
+                }
+            }
+        }
+        /* The endpoints of a border are Locked, so every Border vertex's
+        neighbors along the border are either Locked or Border. Make sure a
+        Border vertex's neighbors know about it. */
+        for (Plc3::VertexId vid = 0;
+                vid < static_cast<int>(vertices.size()); ++vid) {
+            if (vertices[vid].kind != VertexKind::Border) continue;
+            vertices[vertices[vid].border_prev].border_next = vid;
+            vertices[vertices[vid].border_next].border_prev = vid;
+        }
+
+        for (Plc3::VertexId vid = 0;
+                vid < static_cast<int>(vertices.size()); ++vid) {
+            push_candidates(vid);
+        }
+    }
+
+    /* Returns the vertices that share a live triangle with 'vid' */
+    std::set<Plc3::VertexId> neighbors(Plc3::VertexId vid) const {
+        std::set<Plc3::VertexId> result;
+        for (int t : vertices[vid].triangles) {
+            if (!triangles[t].alive) continue;
+            for (Plc3::VertexId other : triangles[t].vertices) {
+                if (other != vid) result.insert(other);
+            }
+        }
+        return result;
+    }
+
+    void push_candidates(Plc3::VertexId from) {
+        const VertexState &vs = vertices[from];
+        if (!vs.alive) return;
+        std::vector<Plc3::VertexId> targets;
+        if (vs.kind == VertexKind::Interior) {
+            std::set<Plc3::VertexId> n = neighbors(from);
+            targets.assign(n.begin(), n.end());
+        } else if (vs.kind == VertexKind::Border) {
+            targets.push_back(vs.border_prev);
+            targets.push_back(vs.border_next);
+        }
+        for (Plc3::VertexId to : targets) {
+            LengthVector delta =
+                plc.vertices[to].point - plc.vertices[from].point;
+            queue.push(Candidate { delta.dot(delta), from, to, vs.version });
+        }
+    }
+
+    Point point(Plc3::VertexId vid) const {
+        return plc.vertices[vid].point;
+    }
+
+    /* Returns the triangle's vertices, with 'from' replaced by 'to' */
+    void replaced_points(
+        const Triangle &tri, Plc3::VertexId from, Plc3::VertexId to,
+        Point out[3]
+    ) const {
+        for (int i = 0; i < 3; ++i) {
+            out[i] = point(tri.vertices[i] == from ? to : tri.vertices[i]);
+        }
+    }
+
+    double distance_to_triangle(Point p, const Point (&tri)[3]) const {
+        return (closest_point_on_triangle(p, tri[0], tri[1], tri[2]) - p)
+            .magnitude();
+    }
+
+    /* Returns true if every sample point of 'tri' is within tolerance of one
+    of the given original triangles. The corners are original vertices, so
+    only the points along the edges and inside are sampled. */
+    bool near_originals(
+        const Point (&tri)[3], const std::vector<int> &originals
+    ) const {
+        static const int n = 4;
+        int num_originals = originals.size();
+        /* Neighboring samples are usually near the same original triangle, so
+        start each search from the one that matched last */
+        int hint = 0;
+        for (int i = 0; i <= n; ++i) {
+            for (int j = 0; i + j <= n; ++j) {
+                if (i == n || j == n || i + j == 0) continue;
+                Point p = tri[0] + (tri[1] - tri[0]) * (i / double(n))
+                    + (tri[2] - tri[0]) * (j / double(n));
+                bool near = false;
+                for (int k = 0; k < num_originals; ++k) {
+                    int index = (hint + k) % num_originals;
+                    const std::array<Point, 3> &op =
+                        original_points[originals[index]];
+                    Point q = closest_point_on_triangle(p, op[0], op[1], op[2]);
+                    if ((q - p).magnitude() <= tolerance) {
+                        near = true;
+                        hint = index;
+                        break;
+                    }
+                }
+                if (!near) return false;
+            }
+        }
+        return true;
+    }
+
+    /* Attempts to collapse 'from' into 'to'. Returns true on success. */
+    bool try_collapse(Plc3::VertexId from, Plc3::VertexId to) {
+        VertexState &vs_from = vertices[from];
+
+        /* Partition the triangles around 'from' into the ones that will
+        disappear (they contain the edge) and the ones that will be kept */
+        std::vector<int> edge_tris, fan_tris;
+        std::set<Plc3::VertexId> edge_opposites;
+        for (int t : vs_from.triangles) {
+            const Triangle &tri = triangles[t];
+            if (!tri.alive) continue;
+            if (std::count(tri.vertices, tri.vertices + 3, to)) {
+                edge_tris.push_back(t);
+                for (Plc3::VertexId v : tri.vertices) {
+                    if (v != from && v != to) edge_opposites.insert(v);
+                }
+            } else {
+                fan_tris.push_back(t);
+            }
+        }
+        if (edge_tris.empty() || fan_tris.empty()) {
+            return false;
+        }
+
+        /* Link condition: the only vertices adjacent to both ends of the edge
+        must be the ones opposite the edge; otherwise the collapse would pinch
+        the surface. */
+        std::set<Plc3::VertexId> n_from = neighbors(from), n_to = neighbors(to);
+        std::vector<Plc3::VertexId> common;
+        std::set_intersection(n_from.begin(), n_from.end(),
+            n_to.begin(), n_to.end(), std::back_inserter(common));
+        if (!std::equal(common.begin(), common.end(), edge_opposites.begin()) ||
+                common.size() != edge_opposites.size()) {
+            return false;
+        }
+
+        /* The surviving triangles must not flip over or become degenerate */
+        double min_area2 = 1e-12 * tolerance * tolerance;
+        for (int t : fan_tris) {
+            Point old_pts[3], new_pts[3];
+            replaced_points(triangles[t], from, from, old_pts);
+            replaced_points(triangles[t], from, to, new_pts);
+            Vector old_n = (old_pts[1] - old_pts[0]).cross(
+                old_pts[2] - old_pts[0]);
+            Vector new_n = (new_pts[1] - new_pts[0]).cross(
+                new_pts[2] - new_pts[0]);
+            if (new_n.magnitude() <= min_area2 || old_n.dot(new_n) <= 0) {
+                return false;
+            }
+        }
+
+        /* Every original point that used to be represented by the affected
+        triangles must still be within tolerance of the new triangles of the
+        same surface. For a border vertex, the border itself must also stay
+        within tolerance. */
+        std::vector<std::pair<Plc3::SurfaceId, Point> > points;
+        for (int t : vs_from.triangles) {
+            if (!triangles[t].alive) continue;
+            for (const Point &p : triangles[t].removed) {
+                points.push_back(std::make_pair(triangles[t].surface, p));
+            }
+        }
+        if (vs_from.kind == VertexKind::Interior) {
+            points.push_back(std::make_pair(
+                triangles[fan_tris[0]].surface, point(from)));
+        }
+        std::vector<int> assignment(points.size());
+        for (int i = 0; i < static_cast<int>(points.size()); ++i) {
+            double best = HUGE_VAL;
+            for (int t : fan_tris) {
+                if (triangles[t].surface != points[i].first) continue;
+                Point new_pts[3];
+                replaced_points(triangles[t], from, to, new_pts);
+                double dist = distance_to_triangle(points[i].second, new_pts);
+                if (dist < best) {
+                    best = dist;
+                    assignment[i] = t;
+                }
+            }
+            if (best > tolerance) {
+                return false;
+            }
+        }
+
+        /* The reverse must hold too: the new triangles must stay within
+        tolerance of the part of the original surface that the triangles
+        around 'from' stood in for. Otherwise a new triangle could cut across
+        a trough even though every removed point is close to it. */
+        std::map<Plc3::SurfaceId, std::vector<int> > surface_originals;
+        for (int t : vs_from.triangles) {
+            if (!triangles[t].alive) continue;
+            std::vector<int> *originals =
+                &surface_originals[triangles[t].surface];
+            std::vector<int> merged;
+            std::set_union(originals->begin(), originals->end(),
+                triangles[t].originals.begin(), triangles[t].originals.end(),
+                std::back_inserter(merged));
+            originals->swap(merged);
+        }
+        for (int t : fan_tris) {
+            Point new_pts[3];
+            replaced_points(triangles[t], from, to, new_pts);
+            if (!near_originals(
+                    new_pts, surface_originals[triangles[t].surface])) {
+                return false;
+            }
+        }
+
+        /* The new triangles must not pass through any other triangle nearby,
+        or tetgen would reject the PLC as self-intersecting. Triangles that
+        share a vertex with the new triangle are covered by the flip check
+        above; the others are only looked for among the triangles around the
+        neighbors of 'from' and 'to', since the new triangles stay within
+        tolerance of where the old ones were. */
+        std::set<int> nearby;
+        std::set<Plc3::VertexId> ring = n_to;
+        ring.insert(n_from.begin(), n_from.end());
+        for (Plc3::VertexId vid : ring) {
+            for (int t : vertices[vid].triangles) {
+                if (!triangles[t].alive) continue;
+                const Plc3::VertexId *tv = triangles[t].vertices;
+                if (std::count(tv, tv + 3, from)) continue;
+                nearby.insert(t);
+            }
+        }
+        for (int t : fan_tris) {
+            Point new_pts[3];
+            replaced_points(triangles[t], from, to, new_pts);
+            for (int other : nearby) {
+                const Plc3::VertexId *ov = triangles[other].vertices;
+                bool shares_vertex = false;
+                for (Plc3::VertexId v : triangles[t].vertices) {
+                    if (std::count(ov, ov + 3, v == from ? to : v)) {
+                        shares_vertex = true;
+                    }
+                }
+                if (shares_vertex) continue;
+                Point other_pts[3];
+                replaced_points(triangles[other], from, from, other_pts);
+                if (triangles_intersect(new_pts, other_pts)) {
+                    return false;
+                }
+            }
+        }
+
+        Plc3::VertexId seg_start = -1, seg_end = -1;
+        std::vector<Point> seg_points;
+        if (vs_from.kind == VertexKind::Border) {
+            /* The two border segments around 'from' become one segment */
+            seg_start = (to == vs_from.border_next) ? vs_from.border_prev : to;
+            seg_end = (to == vs_from.border_next) ? to : vs_from.border_next;
+            seg_points = vertices[seg_start].border_removed;
+            seg_points.push_back(point(from));
+            seg_points.insert(seg_points.end(),
+                vs_from.border_removed.begin(), vs_from.border_removed.end());
+            for (const Point &p : seg_points) {
+                Point q = closest_point_on_segment(
+                    p, point(seg_start), point(seg_end));
+                if ((q - p).magnitude() > tolerance) {
+                    return false;
+                }
+            }
+        }
+
+        /* All checks passed; apply the collapse */
+        for (int t : vs_from.triangles) {
+            triangles[t].removed.clear();
+        }
+        for (int t : edge_tris) {
+            triangles[t].alive = false;
+        }
+        for (int t : fan_tris) {
+            for (Plc3::VertexId &v : triangles[t].vertices) {
+                if (v == from) v = to;
+            }
+            triangles[t].originals = surface_originals[triangles[t].surface];
+            vertices[to].triangles.push_back(t);
+        }
+        for (int i = 0; i < static_cast<int>(points.size()); ++i) {
+            triangles[assignment[i]].removed.push_back(points[i].second);
+        }
+        if (vs_from.kind == VertexKind::Border) {
+            vertices[seg_start].border_next = seg_end;
+            vertices[seg_end].border_prev = seg_start;
+            vertices[seg_start].border_removed = std::move(seg_points);
+        }
+        vs_from.alive = false;
+        vs_from.triangles.clear();
+
+        /* Everything around 'to' has changed shape, so re-queue it all */
+        std::set<Plc3::VertexId> touched = neighbors(to);
+        touched.insert(to);
+        for (Plc3::VertexId vid : touched) {
+            ++vertices[vid].version;
+            push_candidates(vid);
+        }
+        return true;
+    }
+
+    void run() {
+        while (!queue.empty()) {
+            Candidate c = queue.top();
+            queue.pop();
+            const VertexState &vs = vertices[c.from];
+            if (!vs.alive || !vertices[c.to].alive ||
+                    vs.version != c.version) {
+                continue;
+            }
+            try_collapse(c.from, c.to);
+        }
+    }
+
+    Plc3 result() const {
+        Plc3 out;
+        std::vector<Plc3::VertexId> new_ids(vertices.size(), -1);
+        for (Plc3::VertexId vid = 0;
+                vid < static_cast<int>(vertices.size()); ++vid) {
+            if (!vertices[vid].alive) continue;
+            new_ids[vid] = out.vertices.size();
+            out.vertices.push_back(plc.vertices[vid]);
+        }
+        out.volumes = plc.volumes;
+        out.volume_outside = plc.volume_outside;
+        out.surfaces.resize(plc.surfaces.size());
+        for (Plc3::SurfaceId sid = 0;
+                sid < static_cast<int>(plc.surfaces.size()); ++sid) {
+            out.surfaces[sid].volumes[0] = plc.surfaces[sid].volumes[0];
+            out.surfaces[sid].volumes[1] = plc.surfaces[sid].volumes[1];
+            out.surfaces[sid].attrs = plc.surfaces[sid].attrs;
+        }
+        for (const Triangle &tri : triangles) {
+            if (!tri.alive) continue;
+            Plc3::Surface::Triangle new_tri;
+            for (int i = 0; i < 3; ++i) {
+                new_tri.vertices[i] = new_ids[tri.vertices[i]];
+                assert(new_tri.vertices[i] != -1);
+            }
+            out.surfaces[tri.surface].triangles.push_back(new_tri);
+        }
+        for (const Plc3::Border &border : plc.borders) {
+            Plc3::Border new_border;
+            new_border.surfaces = border.surfaces;
+            new_border.attrs = border.attrs;
+            for (Plc3::VertexId vid : border.vertices) {
+                if (new_ids[vid] != -1) {
+                    new_border.vertices.push_back(new_ids[vid]);
+                }
+            }
+            out.borders.push_back(std::move(new_border));
+        }
+        return out;
+    }
+
+    const Plc3 &plc;
+    double tolerance;
+    std::vector<VertexState> vertices;
+    std::vector<Triangle> triangles;
+    /* The corners of each triangle as it was in the original Plc3 */
+    std::vector<std::array<Point, 3> > original_points;
+    std::priority_queue<Candidate, std::vector<Candidate>,
+        std::greater<Candidate> > queue;
+};
+
+Plc3 plc_simplify(const Plc3 &plc, Length tolerance) {
+    PlcSimplifier simplifier(plc, tolerance);
+    simplifier.setup();
+    simplifier.run();
+    return simplifier.result();
+}
+
+} /* namespace os2cx */
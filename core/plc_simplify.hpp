@@ -0,0 +1,27 @@
+#ifndef OS2CX_PLC_SIMPLIFY_HPP_
+#define OS2CX_PLC_SIMPLIFY_HPP_
+
+#include "calc.hpp"
+#include "plc.hpp"
+
+namespace os2cx {
+
+/* plc_simplify() reduces the number of triangles in the Plc3 by collapsing
+short edges, as long as every vertex of the original Plc3 stays within
+'tolerance' of the simplified surface, and (judging by sample points) the
+simplified surface stays within 'tolerance' of the original. A collapse is also
+refused if a new triangle would pass through a nearby triangle that it doesn't
+share a vertex with. This is mostly useful for curved
+surfaces that OpenSCAD tessellated much more finely than the mesh needs, which
+would otherwise force tetgen to put many tiny elements on the boundary.
+
+Vertices are only ever removed, never moved. The endpoints of borders,
+vertices whose attrs aren't implied by their surface (e.g. the target of
+os2cx_select_node()), and isolated vertices are never removed. Vertices in the
+middle of a border are only collapsed along the border, so borders keep their
+shape to within 'tolerance' as well. The surviving vertices are renumbered. */
+Plc3 plc_simplify(const Plc3 &plc, Length tolerance);
+
+} /* namespace os2cx */
+
+#endif /* OS2CX_PLC_SIMPLIFY_HPP_ */
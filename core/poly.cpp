@@ -42,6 +42,20 @@ Poly3 Poly3::from_box(const Box &box) {
     return r;
 }
 
+Box Poly3::bounding_box() const {
+    Box box(HUGE_VAL, HUGE_VAL, HUGE_VAL, -HUGE_VAL, -HUGE_VAL, -HUGE_VAL);
+    for (auto it = i->p.vertices_begin(); it != i->p.vertices_end(); ++it) {
+        const CGAL::Point_3<K> &point = it->point();
+        box.xl = std::min(box.xl, point.x());
+        box.yl = std::min(box.yl, point.y());
+        box.zl = std::min(box.zl, point.z());
+        box.xh = std::max(box.xh, point.x());
+        box.yh = std::max(box.yh, point.y());
+        box.zh = std::max(box.zh, point.z());
+    }
+    return box;
+}
+
 Poly3::Poly3() { }
 Poly3::Poly3(Poly3 &&other) : i(std::move(other.i)) { }
 Poly3::~Poly3() { }
@@ -23,6 +23,9 @@ class Poly3 {
 public:
     static Poly3 from_box(const Box &box);
 
+    /* Returns the smallest box that contains the polyhedron */
+    Box bounding_box() const;
+
     Poly3();
     Poly3(Poly3 &&other);
     ~Poly3();
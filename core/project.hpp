@@ -1,12 +1,15 @@
 #ifndef OS2CX_PROJECT_HPP_
 #define OS2CX_PROJECT_HPP_
 
+#include <math.h>
+
 #include <map>
 #include <string>
 
 #include "compute_attrs.hpp"
 #include "mesh.hpp"
 #include "mesh_index.hpp"
+#include "mesh_renumber.hpp"
 #include "openscad_value.hpp"
 #include "plc.hpp"
 #include "plc_nef.hpp"
@@ -34,6 +37,7 @@ public:
         progress(Progress::NothingDone),
         errored(false),
         next_bit_index(attr_bit_solid() + 1),
+        renumber_method(RenumberMethod::None),
         approx_scale(Length(0))
         { }
 
@@ -93,7 +97,10 @@ public:
 
     class MeshObject : public VolumeObject {
     public:
-        enum class Mesher { Tetgen, NaiveBricks };
+        /* An Axisymmetric mesh object is written to CalculiX as CAX elements;
+        see mesher_axisymmetric(). It can't be combined with other meshers. */
+        enum class Mesher {
+            Tetgen, NaiveBricks, OctreeBricks, Sweep, Axisymmetric };
         Mesher mesher;
 
         /* If max_element_size is set to the magic value
@@ -106,15 +113,36 @@ public:
 
         ElementType element_type;
 
+        /* If positive, the PLC is simplified before meshing, such that it
+        deviates from the original PLC by at most this much. */
+        Length simplify_tolerance;
+
+        /* If positive, the element size is also graded to fit about this many
+        elements through the thickness of thin sections, and to follow curved
+        surfaces. Only supported by the tetgen and octree_bricks meshers; the
+        sweep mesher instead uses it as the minimum number of layers of
+        elements along the sweep axis. */
+        double elements_per_thickness;
+
+        /* If positive, the element size is multiplied by this ratio near the
+        selections that loads and the CalculiX deck refer to, and graded back
+        up away from them. Only supported by the tetgen and octree_bricks
+        meshers. */
+        double boundary_condition_refinement;
+
+        /* If positive, the tetgen mesh is improved by this many passes of
+        flips and smoothing before it's used; see mesh_optimize(). */
+        int optimize_passes;
+
         std::shared_ptr<const Poly3> solid;
         std::shared_ptr<const Plc3> plc;
 
         /* The partial_meshes of all the individual MeshObjects will be combined
         to form the overall project mesh. The nodes and elements will be
         assigned new IDs when this happens, so partial_mesh shouldn't be used
-        for anything on its own. In addition, it will be nulled after it's been
-        combined into the overall project mesh. */
-        std::shared_ptr<const Mesh3> partial_mesh;
+        for anything on its own. Combining the meshes moves the nodes and
+        elements out of partial_mesh, and then it's nulled. */
+        std::shared_ptr<Mesh3> partial_mesh;
 
         /* Each SliceObject is applied separately to each MeshObject, and the
         results are stored temporarily in partial_slices. Later, all the Slices
@@ -125,6 +153,13 @@ public:
         after the Slices have been combined. */
         std::map<SliceObjectName, std::shared_ptr<const Slice> > partial_slices;
 
+        /* The octree_bricks mesher ties its hanging nodes to the neighboring
+        elements with equations, which are stored in partial_equations in terms
+        of the partial_mesh's node IDs. When the meshes are combined, they're
+        moved to 'equations' and converted to the combined mesh's node IDs. */
+        std::shared_ptr<const std::vector<LinearEquation> > partial_equations;
+        std::shared_ptr<const std::vector<LinearEquation> > equations;
+
         /* Once the partial meshes have been combined, we record here the ranges
         of node and element IDs in the combined mesh that corresponded to this
         mesh object. */
@@ -182,9 +217,57 @@ public:
     std::map<CreateNodeObjectName, CreateNodeObject>
         create_node_objects;
 
+    /* Set by os2cx_symmetry(). Each mesh is cut by the plane perpendicular to
+    'axis' at 'position', and only the part on the positive side is meshed and
+    solved. The nodes on the cut faces are fixed along 'axis', and after the
+    analysis the mesh and results are mirrored to show the full body. */
+    class SymmetryPlane {
+    public:
+        Dimension axis;
+        double position;
+        AttrBitIndex bit_index;
+        std::shared_ptr<const NodeSet> node_set;
+    };
+    std::vector<SymmetryPlane> symmetry_planes;
+
     AttrOverrides<MaxElementSize> max_element_size_overrides;
     AttrOverrides<MaterialId> material_overrides;
 
+    /* Set by os2cx_adaptive_refinement(). If target_error is zero, the mesh
+    is solved once as-is. Otherwise, after each solve the mesh is refined where
+    the estimated stress error is largest, until the relative error is below
+    target_error, the mesh would exceed max_elements (if nonzero), or the
+    analysis has been run max_iterations times. */
+    class AdaptiveRefinement {
+    public:
+        AdaptiveRefinement() :
+            target_error(0), max_elements(0), max_iterations(0) { }
+        double target_error;
+        int max_elements;
+        int max_iterations;
+    };
+    AdaptiveRefinement adaptive_refinement;
+
+    /* Set by os2cx_resource_budget(). Before meshing, the number of elements
+    and the memory needed to mesh and solve are estimated from the geometry.
+    If they would exceed max_elements or max_memory_mb (where nonzero), the
+    run is aborted, or if coarsen is true, every element size is scaled up
+    until the estimate fits. */
+    class ResourceBudget {
+    public:
+        ResourceBudget() :
+            max_elements(0), max_memory_mb(0), coarsen(false) { }
+        int max_elements;
+        double max_memory_mb;
+        bool coarsen;
+    };
+    ResourceBudget resource_budget;
+
+    /* Set by os2cx_renumber(). When the meshes are merged, the nodes and
+    elements of each mesh object are reordered within its range of IDs, so
+    that neighbors are numbered close together. */
+    RenumberMethod renumber_method;
+
     /* This mesh is formed by combining the meshes of all the individual mesh
     objects. */
     std::shared_ptr<const Mesh3> mesh;
@@ -233,6 +316,21 @@ public:
     scale. Will be zero until all the Poly3s have been loaded. */
     Length approx_scale;
 
+    /* The part of the full body that's meshed: half for each symmetry plane.
+    Loads given as totals for the full body are scaled by this. */
+    double symmetry_fraction() const {
+        return ldexp(1.0, -static_cast<int>(symmetry_planes.size()));
+    }
+
+    bool is_axisymmetric() const {
+        for (const auto &pair : mesh_objects) {
+            if (pair.second.mesher == MeshObject::Mesher::Axisymmetric) {
+                return true;
+            }
+        }
+        return false;
+    }
+
     const VolumeObject *find_volume_object(const VolumeObjectName &name) const {
         auto it = mesh_objects.find(name);
         if (it != mesh_objects.end()) {
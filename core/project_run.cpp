@@ -1,263 +1,492 @@
 #include "project_run.hpp"
 
+#include <math.h>
+
+#include <algorithm>
+#include <exception>
 #include <fstream>
+#include <set>
 
 #include "calculix_frd_read.hpp"
 #include "calculix_inp_write.hpp"
 #include "calculix_run.hpp"
+#include "error_estimate.hpp"
+#include "mesh_optimize.hpp"
+#include "mesh_quality.hpp"
+#include "mesh_renumber.hpp"
+#include "mesher_axisymmetric.hpp"
 #include "mesher_naive_bricks.hpp"
+#include "mesher_octree_bricks.hpp"
+#include "mesher_sweep.hpp"
 #include "mesher_tetgen.hpp"
 #include "openscad_extract.hpp"
 #include "openscad_run.hpp"
+#include "parallel.hpp"
 #include "plc_nef_to_plc.hpp"
+#include "plc_simplify.hpp"
+#include "resource_estimate.hpp"
+#include "sizing_field.hpp"
 
 namespace os2cx {
 
-void project_run(Project *p, ProjectRunCallbacks *callbacks) {
-    /* If scad_path="/foo/bar.scad", then project_name="bar" */
-    p->project_name = p->scad_path;
-    int last_slash_pos = p->project_name.rfind("/");
-    if (last_slash_pos != (int)std::string::npos) {
-        p->project_name = p->project_name.substr(last_slash_pos + 1);
-    }
-    int last_dot_pos = p->project_name.rfind(".");
-    if (last_dot_pos != (int)std::string::npos) {
-        p->project_name = p->project_name.substr(0, last_dot_pos);
+/* The element sizes that one MeshObject will be meshed with. These are
+computed before any meshing happens, so that the resource budget can be checked
+and, if necessary, the sizes coarsened. */
+class MeshObjectSizing {
+public:
+    MaxElementSize max_element_size;
+    AttrOverrides<MaxElementSize> max_element_size_overrides;
+    bool use_sizing_field;
+    std::vector<Length> vertex_sizes;
+
+    void scale(double factor) {
+        max_element_size *= factor;
+        for (AttrBitIndex i = 0; i < num_attr_bits; ++i) {
+            if (max_element_size_overrides.overridden_attrs[i]) {
+                max_element_size_overrides.values[i] *= factor;
+            }
+        }
+        for (Length &size : vertex_sizes) {
+            size *= factor;
+        }
     }
-    assert(!p->project_name.empty());
+};
 
-    /* If scad_path="/foo/bar.scad", then temp_dir="/foo/bar.scad.os2cx" */
-    p->temp_dir = p->scad_path + ".os2cx";
-    maybe_create_directory(p->temp_dir);
+/* The results of meshing and slicing one MeshObject. */
+class MeshObjectTask {
+public:
+    std::shared_ptr<Mesh3> partial_mesh;
+    std::map<Project::SliceObjectName, std::shared_ptr<const Slice> >
+        partial_slices;
+    std::shared_ptr<const std::vector<LinearEquation> > partial_equations;
+    std::vector<std::string> log;
+    std::exception_ptr error;
+};
 
-    callbacks->project_run_log("Scanning OpenSCAD file...");
-    try {
-        openscad_extract_inventory(p);
-    } catch (const OpenscadRunError &error) {
-        callbacks->project_run_log("Error running OpenSCAD:");
-        for (const std::string &error_line : error.errors) {
-            callbacks->project_run_log(error_line);
-        }
-        p->errored = true;
-        return;
-    } catch (const UsageError &error) {
-        callbacks->project_run_log("Error in OpenSCAD file:");
-        callbacks->project_run_log(error.what());
-        p->errored = true;
-        return;
-    } catch (const BadEchoError &error) {
-        callbacks->project_run_log("Malformed echo from OpenSCAD:");
-        callbacks->project_run_log(error.what());
-        p->errored = true;
-        return;
+/* Passes log messages through to another ProjectRunCallbacks, but holds back
+checkpoints. This is for stretches of work during which the Project is only
+partly updated, so that the GUI never gets a copy of it in that state. */
+class ProjectRunCallbacksWithoutCheckpoints : public ProjectRunCallbacks {
+public:
+    explicit ProjectRunCallbacksWithoutCheckpoints(ProjectRunCallbacks *i) :
+        inner(i) { }
+    void project_run_log(const std::string &str) {
+        inner->project_run_log(str);
     }
-    p->progress = Project::Progress::InventoryDone;
-    callbacks->project_run_checkpoint();
+    void project_run_checkpoint() { }
+    ProjectRunCallbacks *inner;
+};
 
-    for (auto &pair : p->mesh_objects) {
-        callbacks->project_run_log("Loading mesh '" + pair.first + "'...");
-        pair.second.solid = openscad_extract_poly3(
-            p, "mesh", pair.first);
-        callbacks->project_run_checkpoint();
+/* Returns the attr bits of every selection that a load refers to, or that an
+nset, elset, or surface macro in the CalculiX deck refers to. These are where
+the boundary conditions are applied. The deck hasn't been processed yet when
+we mesh, so we look for the macros in the raw deck. */
+static AttrBitset compute_boundary_condition_attrs(const Project &project) {
+    std::set<std::string> names;
+    for (const auto &pair : project.load_volume_objects) {
+        names.insert(pair.second.volume);
     }
-    for (auto &pair : p->slice_objects) {
-        callbacks->project_run_log("Loading slice '" + pair.first + "'...");
-        pair.second.mask = openscad_extract_poly3(
-            p, "slice", pair.first);
-        callbacks->project_run_checkpoint();
+    for (const auto &pair : project.load_surface_objects) {
+        names.insert(pair.second.surface);
     }
-    for (auto &pair : p->select_volume_objects) {
-        callbacks->project_run_log("Loading volume '" + pair.first + "'...");
-        pair.second.mask = openscad_extract_poly3(
-            p, "select_volume", pair.first);
-        callbacks->project_run_checkpoint();
-    }
-    for (auto &pair : p->select_surface_objects) {
-        callbacks->project_run_log("Loading surface '" + pair.first + "'...");
-        pair.second.mask = openscad_extract_poly3(
-            p, "select_surface", pair.first);
-        callbacks->project_run_checkpoint();
+    for (const OpenscadValue &card_raw : project.calculix_deck_raw) {
+        if (card_raw.type != OpenscadValue::Type::Vector) continue;
+        for (const OpenscadValue &part_raw : card_raw.vector_value) {
+            if (part_raw.type != OpenscadValue::Type::Vector
+                    || part_raw.vector_value.size() != 2
+                    || part_raw.vector_value[0].type !=
+                        OpenscadValue::Type::String
+                    || part_raw.vector_value[1].type !=
+                        OpenscadValue::Type::String) {
+                continue;
+            }
+            const std::string &macro = part_raw.vector_value[0].string_value;
+            if (macro == "nset" || macro == "elset" || macro == "surface") {
+                names.insert(part_raw.vector_value[1].string_value);
+            }
+        }
     }
-    p->progress = Project::Progress::PolysDone;
-    callbacks->project_run_checkpoint();
 
-    for (auto &pair : p->mesh_objects) {
-        callbacks->project_run_log(
-            "Preprocessing mesh '" + pair.first + "'...");
-        PlcNef3 solid_nef = compute_plc_nef_for_solid(*pair.second.solid);
-        for (auto &slice_pair : p->slice_objects) {
-            compute_plc_nef_select_surface_internal(
-                &solid_nef,
-                *slice_pair.second.mask,
-                slice_pair.second.direction_vector,
-                slice_pair.second.direction_angle_tolerance,
-                slice_pair.second.bit_index);
+    AttrBitset attrs;
+    for (const std::string &name : names) {
+        auto it = project.select_volume_objects.find(name);
+        if (it != project.select_volume_objects.end()) {
+            attrs.set(it->second.bit_index);
         }
-        for (auto &select_volume_pair : p->select_volume_objects) {
-            compute_plc_nef_select_volume(
-                &solid_nef,
-                *select_volume_pair.second.mask,
-                select_volume_pair.second.bit_index);
+        auto jt = project.select_surface_objects.find(name);
+        if (jt != project.select_surface_objects.end()) {
+            attrs.set(jt->second.bit_index);
         }
-        for (auto &select_surface_pair : p->select_surface_objects) {
-            if (select_surface_pair.second.mode ==
-                    Project::SelectSurfaceObject::Mode::External) {
-                compute_plc_nef_select_surface_external(
-                    &solid_nef,
-                    *select_surface_pair.second.mask,
-                    select_surface_pair.second.direction_vector,
-                    select_surface_pair.second.direction_angle_tolerance,
-                    select_surface_pair.second.bit_index);
-            } else {
-                compute_plc_nef_select_surface_internal(
-                    &solid_nef,
-                    *select_surface_pair.second.mask,
-                    select_surface_pair.second.direction_vector,
-                    select_surface_pair.second.direction_angle_tolerance,
-                    select_surface_pair.second.bit_index);
-            }
+        auto kt = project.select_node_objects.find(name);
+        if (kt != project.select_node_objects.end()) {
+            attrs.set(kt->second.bit_index);
         }
-        for (auto &select_node_pair : p->select_node_objects) {
-            compute_plc_nef_select_node(
-                &solid_nef,
-                select_node_pair.second.point,
-                select_node_pair.second.bit_index);
+    }
+    return attrs;
+}
+
+static MeshObjectSizing compute_mesh_object_sizing(
+    const Project &project,
+    const Project::MeshObjectName &name,
+    const Project::MeshObject &mesh_object,
+    ProjectRunCallbacks *callbacks
+) {
+    MeshObjectSizing sizing;
+    sizing.max_element_size = mesh_object.max_element_size;
+    if (sizing.max_element_size ==
+            Project::MeshObject::SUGGEST_MAX_ELEMENT_SIZE) {
+        sizing.max_element_size = suggest_max_element_size(*mesh_object.plc);
+        callbacks->project_run_log("Automatically chose max_element_size=" +
+            std::to_string(sizing.max_element_size) + " for '" + name + "'");
+    }
+    sizing.max_element_size_overrides = project.max_element_size_overrides;
+
+    sizing.use_sizing_field =
+        mesh_object.mesher != Project::MeshObject::Mesher::NaiveBricks &&
+        mesh_object.mesher != Project::MeshObject::Mesher::Sweep &&
+        mesh_object.mesher != Project::MeshObject::Mesher::Axisymmetric && (
+            mesh_object.elements_per_thickness > 0 ||
+            mesh_object.boundary_condition_refinement > 0);
+    if (sizing.use_sizing_field) {
+        sizing.vertex_sizes = compute_sizing_field(
+            *mesh_object.plc,
+            sizing.max_element_size,
+            sizing.max_element_size_overrides,
+            mesh_object.elements_per_thickness);
+        if (mesh_object.boundary_condition_refinement > 0) {
+            refine_sizing_field_near_attrs(
+                *mesh_object.plc,
+                compute_boundary_condition_attrs(project),
+                mesh_object.boundary_condition_refinement,
+                &sizing.vertex_sizes);
+        }
+    }
+    return sizing;
+}
+
+/* Estimates the resources needed to mesh and solve every MeshObject with the
+given sizes, logs the estimate, and enforces the project's resource budget:
+either throws a UsageError, or scales up all of 'sizings' so that the estimate
+fits within the budget. */
+static void apply_resource_budget(
+    const Project &project,
+    std::vector<MeshObjectSizing> *sizings,
+    ProjectRunCallbacks *callbacks
+) {
+    auto estimate_all = [&]() {
+        ResourceEstimate total;
+        int j = 0;
+        for (const auto &pair : project.mesh_objects) {
+            const MeshObjectSizing &sizing = (*sizings)[j++];
+            total += estimate_mesh_resources(
+                *pair.second.plc,
+                sizing.max_element_size,
+                sizing.max_element_size_overrides,
+                sizing.use_sizing_field ? &sizing.vertex_sizes : nullptr,
+                pair.second.element_type);
         }
+        return total;
+    };
 
-        pair.second.plc.reset(new Plc3(plc_nef_to_plc(solid_nef)));
+    ResourceEstimate estimate = estimate_all();
+    callbacks->project_run_log("Estimated " + estimate.describe());
 
-        callbacks->project_run_checkpoint();
+    const Project::ResourceBudget &budget = project.resource_budget;
+    double factor = compute_coarsening_factor(
+        estimate, budget.max_elements, budget.max_memory_mb * 1e6);
+    if (factor == 1) {
+        return;
+    }
+    if (!budget.coarsen) {
+        throw UsageError("The mesh would exceed os2cx_resource_budget(); "
+            "increase max_element_size by a factor of about " +
+            std::to_string(factor) + ", or pass on_exceed=\"coarsen\".");
     }
 
-    for (auto &pair : p->mesh_objects) {
-        p->approx_scale = std::max(
-            p->approx_scale,
-            pair.second.plc->compute_approx_scale());
+    /* The estimate is rough, so leave a little margin */
+    static const double coarsening_margin = 1.05;
+    for (MeshObjectSizing &sizing : *sizings) {
+        sizing.scale(factor * coarsening_margin);
     }
-    p->progress = Project::Progress::PolyAttrsDone;
-    callbacks->project_run_checkpoint();
+    estimate = estimate_all();
+    callbacks->project_run_log("Coarsened element sizes by a factor of " +
+        std::to_string(factor * coarsening_margin) +
+        " to fit os2cx_resource_budget(); now estimated " +
+        estimate.describe());
+}
 
-    for (auto &pair : p->mesh_objects) {
-        callbacks->project_run_log("Meshing '" + pair.first + "'...");
-        double max_element_size = pair.second.max_element_size;
-        if (max_element_size == Project::MeshObject::SUGGEST_MAX_ELEMENT_SIZE) {
-            max_element_size = suggest_max_element_size(*pair.second.plc);
-            callbacks->project_run_log("Automatically chose max_element_size=" +
-                std::to_string(max_element_size));
-        }
-
-        Mesh3 partial_mesh;
-        switch(pair.second.mesher) {
-        case Project::MeshObject::Mesher::Tetgen: {
-            partial_mesh = mesher_tetgen(
-                *pair.second.plc,
-                max_element_size,
-                p->max_element_size_overrides,
-                pair.second.element_type
-            );
-            break;
+/* Meshes a single MeshObject and applies every slice to it. This may run
+concurrently for different MeshObjects, so it must only read from the Project,
+and it records its log messages in the task instead of reporting them. */
+static void mesh_and_slice_object(
+    const Project &project,
+    const Project::MeshObjectName &name,
+    const Project::MeshObject &mesh_object,
+    const MeshObjectSizing &sizing,
+    MeshObjectTask *task
+) {
+    Mesh3 partial_mesh;
+    switch(mesh_object.mesher) {
+    case Project::MeshObject::Mesher::Tetgen: {
+        partial_mesh = mesher_tetgen(
+            *mesh_object.plc,
+            sizing.max_element_size,
+            sizing.max_element_size_overrides,
+            sizing.use_sizing_field ? &sizing.vertex_sizes : nullptr,
+            mesh_object.element_type
+        );
+        if (mesh_object.optimize_passes > 0) {
+            task->log.push_back("Quality of '" + name + "' before "
+                "optimization:");
+            for (const std::string &line :
+                    compute_mesh_quality(partial_mesh).describe()) {
+                task->log.push_back(line);
+            }
+            mesh_optimize(&partial_mesh, mesh_object.optimize_passes);
+            task->log.push_back("Quality of '" + name + "' after "
+                "optimization:");
+            for (const std::string &line :
+                    compute_mesh_quality(partial_mesh).describe()) {
+                task->log.push_back(line);
+            }
         }
-        case Project::MeshObject::Mesher::NaiveBricks: {
-            for (const Plc3::Volume &v : pair.second.plc->volumes) {
-                MaxElementSize modified_max_element_size =
-                    p->max_element_size_overrides.lookup(
-                        v.attrs, max_element_size);
-                if (modified_max_element_size != max_element_size) {
-                    throw UsageError("naive_bricks mesher does not support "
-                        "os2cx_override_max_element_size().");
-                }
+        break;
+    }
+    case Project::MeshObject::Mesher::NaiveBricks: {
+        for (const Plc3::Volume &v : mesh_object.plc->volumes) {
+            MaxElementSize modified_max_element_size =
+                sizing.max_element_size_overrides.lookup(
+                    v.attrs, sizing.max_element_size);
+            if (modified_max_element_size != sizing.max_element_size) {
+                throw UsageError("naive_bricks mesher does not support "
+                    "os2cx_override_max_element_size().");
             }
-            partial_mesh = mesher_naive_bricks(
-                *pair.second.plc,
-                max_element_size,
-                1,
-                pair.second.element_type
-            );
-            break;
         }
-        default: assert(false);
+        partial_mesh = mesher_naive_bricks(
+            *mesh_object.plc,
+            sizing.max_element_size,
+            1,
+            mesh_object.element_type
+        );
+        break;
+    }
+    case Project::MeshObject::Mesher::OctreeBricks: {
+        std::vector<LinearEquation> equations;
+        partial_mesh = mesher_octree_bricks(
+            *mesh_object.plc,
+            sizing.max_element_size,
+            sizing.max_element_size_overrides,
+            sizing.use_sizing_field ? &sizing.vertex_sizes : nullptr,
+            mesh_object.element_type,
+            &equations
+        );
+        task->partial_equations.reset(
+            new std::vector<LinearEquation>(std::move(equations)));
+        break;
+    }
+    case Project::MeshObject::Mesher::Sweep: {
+        int min_layers = 1;
+        if (mesh_object.elements_per_thickness > 0) {
+            min_layers = static_cast<int>(
+                ceil(mesh_object.elements_per_thickness));
         }
+        partial_mesh = mesher_sweep(
+            *mesh_object.plc,
+            sizing.max_element_size,
+            sizing.max_element_size_overrides,
+            min_layers,
+            mesh_object.element_type
+        );
+        break;
+    }
+    case Project::MeshObject::Mesher::Axisymmetric: {
+        partial_mesh = mesher_axisymmetric(
+            *mesh_object.plc,
+            sizing.max_element_size,
+            sizing.max_element_size_overrides,
+            mesh_object.element_type
+        );
+        break;
+    }
+    default: assert(false);
+    }
 
-        /* Slicing mutates the mesh and invalidates node/element IDs, so do it
-        immediately after meshing, before we perform any operations that might
-        save a node/element ID */
-        for (auto &slice_pair : p->slice_objects) {
-            callbacks->project_run_log(
-                "Computing slice '" + slice_pair.first +
-                "' on mesh '" + pair.first + "'...");
-            FaceSet slice_face_set = compute_face_set_from_attr_bit(
-                partial_mesh,
-                partial_mesh.elements.key_begin(),
-                partial_mesh.elements.key_end(),
-                slice_pair.second.direction_vector,
-                slice_pair.second.direction_angle_tolerance,
-                slice_pair.second.bit_index);
-            pair.second.partial_slices[slice_pair.first] =
-                std::make_shared<Slice>(compute_slice(
-                    &partial_mesh,
-                    slice_face_set
-                ));
+    /* Slicing mutates the mesh and invalidates node/element IDs, so do it
+    immediately after meshing, before we perform any operations that might
+    save a node/element ID */
+    for (auto &slice_pair : project.slice_objects) {
+        task->log.push_back(
+            "Computing slice '" + slice_pair.first +
+            "' on mesh '" + name + "'...");
+        FaceSet slice_face_set = compute_face_set_from_attr_bit(
+            partial_mesh,
+            partial_mesh.elements.key_begin(),
+            partial_mesh.elements.key_end(),
+            slice_pair.second.direction_vector,
+            slice_pair.second.direction_angle_tolerance,
+            slice_pair.second.bit_index);
+        task->partial_slices[slice_pair.first] =
+            std::make_shared<Slice>(compute_slice(
+                &partial_mesh,
+                slice_face_set
+            ));
+    }
+
+    task->partial_mesh.reset(new Mesh3(std::move(partial_mesh)));
+}
+
+/* Reorders the nodes and elements of each MeshObject within its own range of
+IDs, and moves the slices and equations that refer to them along. */
+static void renumber_mesh(
+    Project *p,
+    Mesh3 *mesh,
+    std::map<Project::SliceObjectName, Slice> *slices,
+    ProjectRunCallbacks *callbacks
+) {
+    if (p->renumber_method == RenumberMethod::None) return;
+    callbacks->project_run_log("Renumbering mesh...");
+    MeshProfile before = compute_mesh_profile(*mesh);
+
+    MeshRenumbering renumbering = MeshRenumbering::identity(*mesh);
+    for (const auto &pair : p->mesh_objects) {
+        compute_mesh_renumbering(
+            *mesh,
+            pair.second.node_begin,
+            pair.second.node_end,
+            pair.second.element_begin,
+            pair.second.element_end,
+            p->renumber_method,
+            &renumbering);
+    }
+    apply_mesh_renumbering(renumbering, mesh);
+
+    for (auto &slice_pair : *slices) {
+        for (Slice::Pair &pair : slice_pair.second.pairs) {
+            pair.nodes[0] = renumbering.nodes[pair.nodes[0]];
+            pair.nodes[1] = renumbering.nodes[pair.nodes[1]];
         }
+    }
+    for (auto &pair : p->mesh_objects) {
+        if (!pair.second.equations) continue;
+        std::vector<LinearEquation> equations;
+        for (const LinearEquation &old_equation : *pair.second.equations) {
+            LinearEquation equation;
+            for (const auto &term : old_equation.terms) {
+                LinearEquation::Variable variable(
+                    renumbering.nodes[term.first.node_id],
+                    term.first.dimension);
+                equation.terms[variable] = term.second;
+            }
+            equations.push_back(equation);
+        }
+        pair.second.equations.reset(
+            new std::vector<LinearEquation>(std::move(equations)));
+    }
+
+    MeshProfile after = compute_mesh_profile(*mesh);
+    callbacks->project_run_log("Bandwidth " +
+        std::to_string(before.bandwidth) + " -> " +
+        std::to_string(after.bandwidth) + ", profile " +
+        std::to_string(before.profile) + " -> " +
+        std::to_string(after.profile));
+}
 
-        pair.second.partial_mesh.reset(new Mesh3(std::move(partial_mesh)));
+/* Combines the partial meshes and slices of all the MeshObjects into the
+project's mesh, and records the range of node and element IDs that each
+MeshObject ended up with. */
+static void merge_meshes(Project *p, ProjectRunCallbacks *callbacks) {
+    Mesh3 combined_mesh;
+    std::map<Project::SliceObjectName, Slice> combined_slices;
 
-        callbacks->project_run_checkpoint();
+    for (auto &pair : p->create_node_objects) {
+        Node3 node;
+        node.point = pair.second.point;
+        pair.second.node_id = combined_mesh.nodes.push_back(node);
     }
 
-    {
-        callbacks->project_run_log("Merging meshes...");
+    /* Allocate the combined mesh once at its full size, then move each
+    partial mesh into it, so that there's never a second copy of the whole
+    mesh in memory */
+    std::vector<const Mesh3 *> partial_meshes;
+    for (const auto &pair : p->mesh_objects) {
+        partial_meshes.push_back(pair.second.partial_mesh.get());
+    }
+    combined_mesh.reserve_for_append(partial_meshes);
 
-        Mesh3 combined_mesh;
-        std::map<Project::SliceObjectName, Slice> combined_slices;
+    for (auto &pair : p->mesh_objects) {
+        Mesh3 *partial_mesh = pair.second.partial_mesh.get();
+        NodeId partial_node_begin = partial_mesh->nodes.key_begin();
+        NodeId partial_node_end = partial_mesh->nodes.key_end();
+        ElementId partial_element_begin = partial_mesh->elements.key_begin();
+        ElementId partial_element_end = partial_mesh->elements.key_end();
+        MeshIdMapping id_mapping;
+        combined_mesh.append_mesh(std::move(*partial_mesh), &id_mapping);
+        pair.second.node_begin = id_mapping.convert_node_id(
+            partial_node_begin);
+        pair.second.node_end = id_mapping.convert_node_id(partial_node_end);
+        pair.second.element_begin = id_mapping.convert_element_id(
+            partial_element_begin);
+        pair.second.element_end = id_mapping.convert_element_id(
+            partial_element_end);
+        pair.second.partial_mesh = nullptr;
 
-        for (auto &pair : p->create_node_objects) {
-            Node3 node;
-            node.point = pair.second.point;
-            pair.second.node_id = combined_mesh.nodes.push_back(node);
-        }
+        pair.second.element_set.reset(new ElementSet(
+            compute_element_set_from_range(
+                pair.second.element_begin, pair.second.element_end)
+        ));
+        pair.second.node_set.reset(new NodeSet(
+            compute_node_set_from_range(
+                pair.second.node_begin, pair.second.node_end)
+        ));
 
-        for (auto &pair : p->mesh_objects) {
-            MeshIdMapping id_mapping;
-            combined_mesh.append_mesh(*pair.second.partial_mesh, &id_mapping);
-            pair.second.node_begin = id_mapping.convert_node_id(
-                pair.second.partial_mesh->nodes.key_begin());
-            pair.second.node_end = id_mapping.convert_node_id(
-                pair.second.partial_mesh->nodes.key_end());
-            pair.second.element_begin = id_mapping.convert_element_id(
-                pair.second.partial_mesh->elements.key_begin());
-            pair.second.element_end = id_mapping.convert_element_id(
-                pair.second.partial_mesh->elements.key_end());
-            pair.second.partial_mesh = nullptr;
-
-            pair.second.element_set.reset(new ElementSet(
-                compute_element_set_from_range(
-                    pair.second.element_begin, pair.second.element_end)
-            ));
-            pair.second.node_set.reset(new NodeSet(
-                compute_node_set_from_range(
-                    pair.second.node_begin, pair.second.node_end)
-            ));
+        for (auto &partial_slice_pair : pair.second.partial_slices) {
+            combined_slices[partial_slice_pair.first].append_slice(
+                *partial_slice_pair.second,
+                id_mapping);
+        }
+        pair.second.partial_slices.clear();
 
-            for (auto &partial_slice_pair : pair.second.partial_slices) {
-                combined_slices[partial_slice_pair.first].append_slice(
-                    *partial_slice_pair.second,
-                    id_mapping);
+        if (pair.second.partial_equations) {
+            std::vector<LinearEquation> equations;
+            for (const LinearEquation &partial_equation :
+                    *pair.second.partial_equations) {
+                LinearEquation equation;
+                for (const auto &term : partial_equation.terms) {
+                    LinearEquation::Variable variable(
+                        id_mapping.convert_node_id(term.first.node_id),
+                        term.first.dimension);
+                    equation.terms[variable] = term.second;
+                }
+                equations.push_back(equation);
             }
-            pair.second.partial_slices.clear();
+            pair.second.equations.reset(
+                new std::vector<LinearEquation>(std::move(equations)));
+            pair.second.partial_equations = nullptr;
         }
+    }
 
-        p->mesh.reset(new Mesh3(std::move(combined_mesh)));
-        p->mesh_index.reset(new Mesh3Index(*p->mesh));
+    renumber_mesh(p, &combined_mesh, &combined_slices, callbacks);
 
-        for (auto &combined_slice_pair : combined_slices) {
-            p->slice_objects.at(combined_slice_pair.first).slice.reset(
-                new Slice(std::move(combined_slice_pair.second)));
-        }
+    p->mesh.reset(new Mesh3(std::move(combined_mesh)));
+    p->mesh_index.reset(new Mesh3Index(*p->mesh));
 
-        p->progress = Project::Progress::MeshDone;
-        callbacks->project_run_checkpoint();
+    for (auto &combined_slice_pair : combined_slices) {
+        p->slice_objects.at(combined_slice_pair.first).slice.reset(
+            new Slice(std::move(combined_slice_pair.second)));
     }
+}
 
+static void report_mesh_quality(Project *p, ProjectRunCallbacks *callbacks) {
+    callbacks->project_run_log("Checking mesh quality...");
+    MeshQuality quality = compute_mesh_quality(*p->mesh);
+    for (const std::string &line : quality.describe()) {
+        callbacks->project_run_log(line);
+    }
+}
+
+/* Computes the element, face, and node sets of all the selections, and the
+loads, on the project's current mesh. */
+static void compute_mesh_attrs(Project *p, ProjectRunCallbacks *callbacks) {
     for (auto &pair : p->slice_objects) {
         pair.second.equations.reset(new std::vector<LinearEquation>(
             compute_equations_for_slice(*pair.second.slice)));
@@ -337,16 +566,47 @@ void project_run(Project *p, ProjectRunCallbacks *callbacks) {
         callbacks->project_run_checkpoint();
     }
 
+    for (Project::SymmetryPlane &plane : p->symmetry_planes) {
+        callbacks->project_run_log("Computing symmetry plane...");
+        /* The cut faces face towards the negative side of the plane */
+        Vector outwards = Vector::zero();
+        outwards.set_at(plane.axis, -1);
+        FaceSet face_set;
+        for (auto &mesh_pair : p->mesh_objects) {
+            FaceSet partial_face_set = compute_face_set_from_attr_bit(
+                *p->mesh,
+                mesh_pair.second.element_begin,
+                mesh_pair.second.element_end,
+                outwards,
+                45,
+                plane.bit_index);
+            face_set.faces.insert(
+                partial_face_set.faces.begin(),
+                partial_face_set.faces.end());
+        }
+        if (face_set.faces.empty()) {
+            throw UsageError("os2cx_symmetry() plane doesn't cut any solid "
+                "meshes.");
+        }
+        plane.node_set.reset(new NodeSet(
+            compute_node_set_from_face_set(*p->mesh, face_set)));
+        callbacks->project_run_checkpoint();
+    }
+
     for (auto &pair : p->load_volume_objects) {
         callbacks->project_run_log("Computing load '" + pair.first + "'...");
         const ElementSet &element_set =
             *p->find_volume_object(pair.second.volume)->element_set;
+        Vector force = p->unit_system.unit_to_system(
+            pair.second.force_total_or_per_volume);
+        if (!pair.second.force_is_per_volume) {
+            force *= p->symmetry_fraction();
+        }
         pair.second.load.reset(new ConcentratedLoad(
             compute_load_from_element_set(
                 *p->mesh,
                 element_set,
-                p->unit_system.unit_to_system(
-                    pair.second.force_total_or_per_volume),
+                force,
                 pair.second.force_is_per_volume)
         ));
         callbacks->project_run_checkpoint();
@@ -356,21 +616,32 @@ void project_run(Project *p, ProjectRunCallbacks *callbacks) {
         callbacks->project_run_log("Computing load '" + pair.first + "'...");
         const FaceSet &face_set =
             *p->find_surface_object(pair.second.surface)->face_set;
+        Vector force = p->unit_system.unit_to_system(
+            pair.second.force_total_or_per_area);
+        if (!pair.second.force_is_per_area) {
+            force *= p->symmetry_fraction();
+        }
         pair.second.load.reset(new ConcentratedLoad(
             compute_load_from_face_set(
                 *p->mesh,
                 face_set,
-                p->unit_system.unit_to_system(
-                    pair.second.force_total_or_per_area),
+                force,
                 pair.second.force_is_per_area)
         ));
         callbacks->project_run_checkpoint();
     }
+}
 
-    p->progress = Project::Progress::MeshAttrsDone;
-    callbacks->project_run_checkpoint();
-
+/* Writes the CalculiX input files for the project's current mesh, runs
+CalculiX, and reads back the results. Returns false if CalculiX failed or its
+output couldn't be read; the error has already been logged. */
+static bool run_analysis(
+    Project *p,
+    ProjectRunCallbacks *callbacks,
+    Results *results_out
+) {
     callbacks->project_run_log("Expanding macros in CalculiX deck...");
+    p->calculix_deck.clear();
     openscad_process_deck(p);
 
     callbacks->project_run_log("Writing CalculiX input files...");
@@ -382,7 +653,7 @@ void project_run(Project *p, ProjectRunCallbacks *callbacks) {
     } catch (const CalculixRunError &error) {
         callbacks->project_run_log("CalculiX failed.");
         p->errored = true;
-        return;
+        return false;
     }
 
     callbacks->project_run_log("Reading CalculiX output files...");
@@ -398,11 +669,536 @@ void project_run(Project *p, ProjectRunCallbacks *callbacks) {
         callbacks->project_run_log("Error reading CalculiX output file:");
         callbacks->project_run_log(error.what());
         p->errored = true;
+        return false;
+    }
+
+    *results_out = Results();
+    results_from_frd_analyses(frd_analyses, results_out);
+    if (p->is_axisymmetric()) {
+        results_expand_axisymmetric(*p->mesh,
+            compute_axisymmetric_meridian_nodes(*p->mesh), results_out);
+    }
+    return true;
+}
+
+/* Copies the nodes and elements of one MeshObject out of the project's mesh,
+renumbered to start at zero, as mesher_tetgen() would have returned them. */
+static Mesh3 extract_partial_mesh(
+    const Mesh3 &mesh,
+    const Project::MeshObject &mesh_object
+) {
+    Mesh3 partial_mesh;
+    partial_mesh.nodes = ContiguousMap<NodeId, Node3>(NodeId::from_int(0));
+    partial_mesh.elements = Element3Store(ElementId::from_int(0));
+    int node_offset = mesh_object.node_begin.to_int();
+    for (NodeId nid = mesh_object.node_begin;
+            nid != mesh_object.node_end; ++nid) {
+        partial_mesh.nodes.push_back(mesh.nodes[nid]);
+    }
+    for (ElementId eid = mesh_object.element_begin;
+            eid != mesh_object.element_end; ++eid) {
+        Element3 element = mesh.elements[eid].to_element();
+        for (int i = 0; i < element.num_nodes(); ++i) {
+            element.nodes[i] =
+                NodeId::from_int(element.nodes[i].to_int() - node_offset);
+        }
+        partial_mesh.elements.push_back(element);
+    }
+    return partial_mesh;
+}
+
+/* Estimates the stress error of 'results' on the project's current mesh. If
+it's above the target and no limit has been reached, refines each MeshObject
+where the error is concentrated, merges the refined meshes, and returns true.
+Otherwise returns false and leaves the mesh alone. */
+static bool refine_adaptively(
+    Project *p,
+    ProjectRunCallbacks *callbacks,
+    const Results &results,
+    int iteration
+) {
+    const Project::AdaptiveRefinement &settings = p->adaptive_refinement;
+
+    const Results::Dataset *displacements = nullptr, *stresses = nullptr;
+    if (!results.results.empty() &&
+            results.results[0].type == Results::Result::Type::Static &&
+            !results.results[0].steps.empty()) {
+        const auto &datasets = results.results[0].steps[0].datasets;
+        auto it = datasets.find("DISP");
+        if (it != datasets.end() && it->second.node_vector) {
+            displacements = &it->second;
+        }
+        auto jt = datasets.find("STRESS");
+        if (jt != datasets.end() && jt->second.node_matrix) {
+            stresses = &jt->second;
+        }
+    }
+    if (!displacements || !stresses) {
+        callbacks->project_run_log("Adaptive refinement needs DISP and "
+            "STRESS results from a static analysis; not refining.");
+        return false;
+    }
+
+    ContiguousMap<ElementId, ElasticMaterial> materials(
+        p->mesh->elements.key_begin(), p->mesh->elements.key_end(),
+        ElasticMaterial());
+    std::map<MaterialId, const Project::MaterialObject *> material_objects;
+    for (const auto &pair : p->material_objects) {
+        material_objects[pair.second.id] = &pair.second;
+    }
+    for (const auto &pair : p->mesh_objects) {
+        std::vector<MaterialId> set_materials =
+            p->material_overrides.lookup_table(
+                p->mesh->elements.attr_sets(), pair.second.material);
+        for (ElementId eid = pair.second.element_begin;
+                eid != pair.second.element_end; ++eid) {
+            const Project::MaterialObject *material = material_objects.at(
+                set_materials[p->mesh->elements.attr_set_id(eid)]);
+            materials[eid].youngs_modulus =
+                p->unit_system.unit_to_system(material->youngs_modulus);
+            materials[eid].poissons_ratio = material->poissons_ratio;
+        }
+    }
+
+    StressErrorEstimate estimate = estimate_stress_error(
+        *p->mesh,
+        *displacements->node_vector,
+        *stresses->node_matrix,
+        [&](ElementId eid) { return materials[eid]; });
+
+    int num_elements = p->mesh->elements.size();
+    callbacks->project_run_log("Adaptive iteration " +
+        std::to_string(iteration) + ": " + std::to_string(num_elements) +
+        " elements, estimated stress error " +
+        std::to_string(100 * estimate.relative_error()) + "%");
+
+    if (estimate.relative_error() <= settings.target_error) {
+        callbacks->project_run_log("Reached target error.");
+        return false;
+    }
+    if (iteration >= settings.max_iterations) {
+        callbacks->project_run_log("Reached max_iterations without reaching "
+            "target error.");
+        return false;
+    }
+
+    /* Aim to spread the error evenly over the elements. An element's error
+    shrinks as (element size)^order, so that's how much smaller it should be;
+    but never shrink an element's size by more than half in one iteration. */
+    double allowed_error = settings.target_error * estimate.total_stress
+        / sqrt(num_elements);
+    class Refinement {
+    public:
+        ElementId element_id;
+        double error;
+        double volume_ratio;
+    };
+    std::vector<Refinement> refinements;
+    for (ElementId eid = p->mesh->elements.key_begin();
+            eid != p->mesh->elements.key_end(); ++eid) {
+        double error = estimate.element_errors[eid];
+        if (error <= allowed_error) continue;
+        int order = (p->mesh->elements[eid].type == ElementType::C3D4) ? 1 : 2;
+        double size_ratio =
+            std::max(pow(allowed_error / error, 1.0 / order), 0.5);
+        refinements.push_back(Refinement { eid, error, pow(size_ratio, 3) });
+    }
+
+    /* If the refined mesh would exceed max_elements, only refine the elements
+    with the largest errors */
+    std::stable_sort(refinements.begin(), refinements.end(),
+        [](const Refinement &a, const Refinement &b) {
+            return a.error > b.error;
+        });
+    double predicted_elements = num_elements;
+    int num_refinements = 0;
+    for (const Refinement &refinement : refinements) {
+        double added = 1 / refinement.volume_ratio - 1;
+        if (settings.max_elements != 0 &&
+                predicted_elements + added > settings.max_elements) {
+            break;
+        }
+        predicted_elements += added;
+        ++num_refinements;
+    }
+    if (num_refinements == 0) {
+        callbacks->project_run_log("Reached max_elements without reaching "
+            "target error.");
+        return false;
+    }
+    refinements.resize(num_refinements);
+
+    ContiguousMap<ElementId, Volume> max_volumes(
+        p->mesh->elements.key_begin(), p->mesh->elements.key_end(), -1);
+    for (const Refinement &refinement : refinements) {
+        Point center;
+        Volume volume;
+        p->mesh->center_of_mass(
+            p->mesh->elements[refinement.element_id], &center, &volume);
+        max_volumes[refinement.element_id] = volume * refinement.volume_ratio;
+    }
+
+    std::vector<std::pair<const Project::MeshObjectName,
+        Project::MeshObject> *> mesh_pairs;
+    for (auto &pair : p->mesh_objects) {
+        callbacks->project_run_log("Refining '" + pair.first + "'...");
+        mesh_pairs.push_back(&pair);
+    }
+    std::vector<Mesh3> refined_meshes(mesh_pairs.size());
+    parallel_for(mesh_pairs.size(), 1, [&](int begin, int end) {
+        for (int j = begin; j < end; ++j) {
+            const Project::MeshObject &mesh_object = mesh_pairs[j]->second;
+            ContiguousMap<ElementId, Volume> partial_max_volumes(
+                ElementId::from_int(0));
+            for (ElementId eid = mesh_object.element_begin;
+                    eid != mesh_object.element_end; ++eid) {
+                partial_max_volumes.push_back(max_volumes[eid]);
+            }
+            refined_meshes[j] = mesher_tetgen_refine(
+                *mesh_object.plc,
+                extract_partial_mesh(*p->mesh, mesh_object),
+                partial_max_volumes,
+                mesh_object.element_type);
+        }
+    });
+    for (int j = 0; j < static_cast<int>(mesh_pairs.size()); ++j) {
+        mesh_pairs[j]->second.partial_mesh.reset(
+            new Mesh3(std::move(refined_meshes[j])));
+    }
+
+    merge_meshes(p, callbacks);
+    return true;
+}
+
+/* Mirrors the project's mesh and 'results' in each symmetry plane in turn, so
+they cover the full body. The original nodes and elements keep their IDs, so
+the selections and loads still refer to the half that was actually solved. */
+static void mirror_symmetry_planes(
+    Project *p,
+    ProjectRunCallbacks *callbacks,
+    Results *results
+) {
+    callbacks->project_run_log("Mirroring symmetry planes...");
+    Mesh3 mesh = *p->mesh;
+    std::vector<std::set<NodeId> > plane_nodes;
+    for (const Project::SymmetryPlane &plane : p->symmetry_planes) {
+        plane_nodes.push_back(plane.node_set->nodes);
+    }
+    for (int i = 0; i < static_cast<int>(p->symmetry_planes.size()); ++i) {
+        const Project::SymmetryPlane &plane = p->symmetry_planes[i];
+        NodeId original_end = mesh.nodes.key_end();
+        ContiguousMap<NodeId, NodeId> sources = mesh.append_mirror_image(
+            plane.axis, plane.position, plane_nodes[i]);
+        results_append_mirror_image(sources, plane.axis, results);
+
+        /* The images of the nodes on the later planes are on them too */
+        for (int j = i + 1; j < static_cast<int>(plane_nodes.size()); ++j) {
+            for (NodeId node_id = original_end;
+                    node_id != sources.key_end(); ++node_id) {
+                if (plane_nodes[j].count(sources[node_id])) {
+                    plane_nodes[j].insert(node_id);
+                }
+            }
+        }
+    }
+    p->mesh.reset(new Mesh3(std::move(mesh)));
+    p->mesh_index.reset(new Mesh3Index(*p->mesh));
+}
+
+/* Throws UsageError if the OpenSCAD file combines features that each work on
+their own but not together. */
+static void check_inventory(const Project &project) {
+    if (project.adaptive_refinement.target_error != 0) {
+        /* Slicing changes the mesh in ways tetgen can't refine, and only
+        tetgen meshes can be refined at all */
+        if (!project.slice_objects.empty()) {
+            throw UsageError("os2cx_adaptive_refinement() can't be used "
+                "together with os2cx_slice().");
+        }
+        for (const auto &pair : project.mesh_objects) {
+            if (pair.second.mesher != Project::MeshObject::Mesher::Tetgen) {
+                throw UsageError("os2cx_adaptive_refinement() only supports "
+                    "the tetgen mesher.");
+            }
+        }
+    }
+    if (!project.slice_objects.empty()) {
+        /* Slicing would split the hanging nodes away from the elements that
+        their equations refer to */
+        for (const auto &pair : project.mesh_objects) {
+            if (pair.second.mesher ==
+                    Project::MeshObject::Mesher::OctreeBricks) {
+                throw UsageError("octree_bricks mesher does not support "
+                    "os2cx_slice().");
+            }
+        }
+    }
+    if (project.is_axisymmetric()) {
+        /* The whole CalculiX deck is either axisymmetric or not */
+        for (const auto &pair : project.mesh_objects) {
+            if (pair.second.mesher !=
+                    Project::MeshObject::Mesher::Axisymmetric) {
+                throw UsageError("the axisymmetric mesher can't be used "
+                    "together with other meshers.");
+            }
+        }
+        if (!project.symmetry_planes.empty()) {
+            throw UsageError("the axisymmetric mesher can't be used "
+                "together with os2cx_symmetry().");
+        }
+        /* A slice would separate the revolved nodes from the meridian nodes
+        that CalculiX actually solves for */
+        if (!project.slice_objects.empty()) {
+            throw UsageError("the axisymmetric mesher can't be used "
+                "together with os2cx_slice().");
+        }
+    }
+}
+
+void project_run(Project *p, ProjectRunCallbacks *callbacks) {
+    /* If scad_path="/foo/bar.scad", then project_name="bar" */
+    p->project_name = p->scad_path;
+    int last_slash_pos = p->project_name.rfind("/");
+    if (last_slash_pos != (int)std::string::npos) {
+        p->project_name = p->project_name.substr(last_slash_pos + 1);
+    }
+    int last_dot_pos = p->project_name.rfind(".");
+    if (last_dot_pos != (int)std::string::npos) {
+        p->project_name = p->project_name.substr(0, last_dot_pos);
+    }
+    assert(!p->project_name.empty());
+
+    /* If scad_path="/foo/bar.scad", then temp_dir="/foo/bar.scad.os2cx" */
+    p->temp_dir = p->scad_path + ".os2cx";
+    maybe_create_directory(p->temp_dir);
+
+    callbacks->project_run_log("Scanning OpenSCAD file...");
+    try {
+        openscad_extract_inventory(p);
+        check_inventory(*p);
+    } catch (const OpenscadRunError &error) {
+        callbacks->project_run_log("Error running OpenSCAD:");
+        for (const std::string &error_line : error.errors) {
+            callbacks->project_run_log(error_line);
+        }
+        p->errored = true;
+        return;
+    } catch (const UsageError &error) {
+        callbacks->project_run_log("Error in OpenSCAD file:");
+        callbacks->project_run_log(error.what());
+        p->errored = true;
+        return;
+    } catch (const BadEchoError &error) {
+        callbacks->project_run_log("Malformed echo from OpenSCAD:");
+        callbacks->project_run_log(error.what());
+        p->errored = true;
         return;
     }
 
+    p->progress = Project::Progress::InventoryDone;
+    callbacks->project_run_checkpoint();
+
+    for (auto &pair : p->mesh_objects) {
+        callbacks->project_run_log("Loading mesh '" + pair.first + "'...");
+        pair.second.solid = openscad_extract_poly3(
+            p, "mesh", pair.first);
+        callbacks->project_run_checkpoint();
+    }
+    for (auto &pair : p->slice_objects) {
+        callbacks->project_run_log("Loading slice '" + pair.first + "'...");
+        pair.second.mask = openscad_extract_poly3(
+            p, "slice", pair.first);
+        callbacks->project_run_checkpoint();
+    }
+    for (auto &pair : p->select_volume_objects) {
+        callbacks->project_run_log("Loading volume '" + pair.first + "'...");
+        pair.second.mask = openscad_extract_poly3(
+            p, "select_volume", pair.first);
+        callbacks->project_run_checkpoint();
+    }
+    for (auto &pair : p->select_surface_objects) {
+        callbacks->project_run_log("Loading surface '" + pair.first + "'...");
+        pair.second.mask = openscad_extract_poly3(
+            p, "select_surface", pair.first);
+        callbacks->project_run_checkpoint();
+    }
+    p->progress = Project::Progress::PolysDone;
+    callbacks->project_run_checkpoint();
+
+    for (auto &pair : p->mesh_objects) {
+        callbacks->project_run_log(
+            "Preprocessing mesh '" + pair.first + "'...");
+        PlcNef3 solid_nef = compute_plc_nef_for_solid(*pair.second.solid);
+        if (!p->symmetry_planes.empty()) {
+            Box solid_bounds = pair.second.solid->bounding_box();
+            for (const Project::SymmetryPlane &plane : p->symmetry_planes) {
+                compute_plc_nef_symmetry_cut(
+                    &solid_nef,
+                    solid_bounds,
+                    plane.axis,
+                    plane.position,
+                    plane.bit_index);
+            }
+        }
+        for (auto &slice_pair : p->slice_objects) {
+            compute_plc_nef_select_surface_internal(
+                &solid_nef,
+                *slice_pair.second.mask,
+                slice_pair.second.direction_vector,
+                slice_pair.second.direction_angle_tolerance,
+                slice_pair.second.bit_index);
+        }
+        for (auto &select_volume_pair : p->select_volume_objects) {
+            compute_plc_nef_select_volume(
+                &solid_nef,
+                *select_volume_pair.second.mask,
+                select_volume_pair.second.bit_index);
+        }
+        for (auto &select_surface_pair : p->select_surface_objects) {
+            if (select_surface_pair.second.mode ==
+                    Project::SelectSurfaceObject::Mode::External) {
+                compute_plc_nef_select_surface_external(
+                    &solid_nef,
+                    *select_surface_pair.second.mask,
+                    select_surface_pair.second.direction_vector,
+                    select_surface_pair.second.direction_angle_tolerance,
+                    select_surface_pair.second.bit_index);
+            } else {
+                compute_plc_nef_select_surface_internal(
+                    &solid_nef,
+                    *select_surface_pair.second.mask,
+                    select_surface_pair.second.direction_vector,
+                    select_surface_pair.second.direction_angle_tolerance,
+                    select_surface_pair.second.bit_index);
+            }
+        }
+        for (auto &select_node_pair : p->select_node_objects) {
+            compute_plc_nef_select_node(
+                &solid_nef,
+                select_node_pair.second.point,
+                select_node_pair.second.bit_index);
+        }
+
+        Plc3 plc = plc_nef_to_plc(solid_nef);
+        if (pair.second.simplify_tolerance > 0) {
+            int num_before = 0, num_after = 0;
+            for (const Plc3::Surface &surface : plc.surfaces) {
+                num_before += surface.triangles.size();
+            }
+            plc = plc_simplify(plc, pair.second.simplify_tolerance);
+            for (const Plc3::Surface &surface : plc.surfaces) {
+                num_after += surface.triangles.size();
+            }
+            callbacks->project_run_log("Simplified '" + pair.first +
+                "' from " + std::to_string(num_before) + " to " +
+                std::to_string(num_after) + " triangles");
+        }
+        pair.second.plc.reset(new Plc3(std::move(plc)));
+
+        callbacks->project_run_checkpoint();
+    }
+
+    for (auto &pair : p->mesh_objects) {
+        p->approx_scale = std::max(
+            p->approx_scale,
+            pair.second.plc->compute_approx_scale());
+    }
+    p->progress = Project::Progress::PolyAttrsDone;
+    callbacks->project_run_checkpoint();
+
+    std::vector<MeshObjectSizing> sizings;
+    for (auto &pair : p->mesh_objects) {
+        sizings.push_back(compute_mesh_object_sizing(
+            *p, pair.first, pair.second, callbacks));
+    }
+    try {
+        apply_resource_budget(*p, &sizings, callbacks);
+    } catch (const UsageError &error) {
+        callbacks->project_run_log("Error in OpenSCAD file:");
+        callbacks->project_run_log(error.what());
+        p->errored = true;
+        return;
+    }
+    callbacks->project_run_checkpoint();
+
+    {
+        /* Each mesh object is meshed and sliced independently of the others,
+        so run them all concurrently. The tasks don't touch the Project or the
+        callbacks; their log messages and errors are collected and reported
+        afterwards, in the same order as if they had run one after another. */
+        std::vector<std::pair<const Project::MeshObjectName,
+            Project::MeshObject> *> mesh_pairs;
+        for (auto &pair : p->mesh_objects) {
+            mesh_pairs.push_back(&pair);
+        }
+
+        std::vector<MeshObjectTask> tasks(mesh_pairs.size());
+        parallel_for(mesh_pairs.size(), 1, [&](int begin, int end) {
+            for (int j = begin; j < end; ++j) {
+                MeshObjectTask *task = &tasks[j];
+                try {
+                    mesh_and_slice_object(*p, mesh_pairs[j]->first,
+                        mesh_pairs[j]->second, sizings[j], task);
+                } catch (...) {
+                    task->error = std::current_exception();
+                }
+            }
+        });
+
+        for (int j = 0; j < static_cast<int>(mesh_pairs.size()); ++j) {
+            MeshObjectTask *task = &tasks[j];
+            callbacks->project_run_log(
+                "Meshing '" + mesh_pairs[j]->first + "'...");
+            for (const std::string &line : task->log) {
+                callbacks->project_run_log(line);
+            }
+            if (task->error) {
+                std::rethrow_exception(task->error);
+            }
+            Project::MeshObject *mesh_object = &mesh_pairs[j]->second;
+            mesh_object->partial_mesh = std::move(task->partial_mesh);
+            mesh_object->partial_slices = std::move(task->partial_slices);
+            mesh_object->partial_equations =
+                std::move(task->partial_equations);
+            callbacks->project_run_checkpoint();
+        }
+    }
+
+    callbacks->project_run_log("Merging meshes...");
+    merge_meshes(p, callbacks);
+    report_mesh_quality(p, callbacks);
+    p->progress = Project::Progress::MeshDone;
+    callbacks->project_run_checkpoint();
+
+    compute_mesh_attrs(p, callbacks);
+    p->progress = Project::Progress::MeshAttrsDone;
+    callbacks->project_run_checkpoint();
+
+    /* The results of intermediate adaptive iterations are never published;
+    only the results for the final mesh end up on the Project. */
     Results results;
-    results_from_frd_analyses(frd_analyses, &results);
+    for (int iteration = 1; ; ++iteration) {
+        if (!run_analysis(p, callbacks, &results)) {
+            return;
+        }
+        /* Until the selections and loads have been recomputed, they still
+        refer to the old mesh. Progress only ever moves forwards, so instead of
+        stepping it back, hold back checkpoints until the Project is consistent
+        again; the log reports each iteration. */
+        ProjectRunCallbacksWithoutCheckpoints refine_callbacks(callbacks);
+        if (p->adaptive_refinement.target_error == 0 ||
+                !refine_adaptively(p, &refine_callbacks, results, iteration)) {
+            break;
+        }
+        report_mesh_quality(p, &refine_callbacks);
+        compute_mesh_attrs(p, &refine_callbacks);
+        callbacks->project_run_checkpoint();
+    }
+
+    if (!p->symmetry_planes.empty()) {
+        mirror_symmetry_planes(p, callbacks, &results);
+    }
+
     p->results.reset(new Results(std::move(results)));
     p->progress = Project::Progress::ResultsDone;
     callbacks->project_run_log("Done.");
@@ -0,0 +1,170 @@
+#include "resource_estimate.hpp"
+
+#include <math.h>
+
+#include <algorithm>
+#include <sstream>
+
+#include "mesh.hpp"
+
+namespace os2cx {
+
+/* The volume of a regular tetrahedron with unit edges. Tetgen's quality bound
+keeps tetrahedra close enough to regular that this is a fair average. */
+static const double unit_tetrahedron_volume = sqrt(2.0) / 12;
+
+/* The volume of a wedge with unit edges and an equilateral cross-section */
+static const double unit_wedge_volume = sqrt(3.0) / 4;
+
+/* Bytes per element and per node of the CalculiX input deck: the "*ELEMENT"
+line has the element ID and its node IDs, the "*NODE" line has the node ID and
+three coordinates, and each element and node also appears in a few sets. */
+static const double deck_bytes_per_element_node = 8;
+static const double deck_bytes_per_element = 24;
+static const double deck_bytes_per_node = 64;
+
+/* For a sparse direct solve of a 3D elasticity problem with nested dissection
+ordering, the factor has on the order of dofs^(4/3) nonzeros. The constant is
+fitted to CalculiX's default solver on typical tetrahedral meshes. */
+static const double solver_nonzeros_constant = 20;
+static const double solver_bytes_per_nonzero = 12;
+
+static double estimate_solver_bytes(double num_nodes) {
+    double dofs = 3 * num_nodes;
+    return solver_bytes_per_nonzero * solver_nonzeros_constant
+        * pow(dofs, 4 / 3.0);
+}
+
+/* Returns the average number of nodes per element in a large mesh of the given
+element type. Neighboring elements share nodes, so this is much less than the
+number of nodes in a single element. */
+static double nodes_per_element(ElementType element_type) {
+    const ElementTypeShape &shape = element_type_shape(element_type);
+    if (shape.category == ElementTypeShape::Category::Tetrahedron) {
+        /* A large tetrahedral mesh has about six tetrahedra per vertex and
+        seven edges per tetrahedron, shared among about six tetrahedra each */
+        return (shape.order == 1) ? 1 / 6.0 : 1 / 6.0 + 7 / 6.0;
+    } else if (shape.category == ElementTypeShape::Category::Wedge) {
+        /* Two wedges per corner, plus three edges per wedge shared among about
+        two wedges each, plus half a vertical edge */
+        return (shape.order == 1) ? 1 / 2.0 : 1 / 2.0 + 3 / 2.0 + 1 / 2.0;
+    } else {
+        /* One corner per brick, plus three edges per brick */
+        return (shape.order == 1) ? 1 : 4;
+    }
+}
+
+ResourceEstimate &ResourceEstimate::operator+=(const ResourceEstimate &other) {
+    num_elements += other.num_elements;
+    num_nodes += other.num_nodes;
+    mesh_bytes += other.mesh_bytes;
+    deck_bytes += other.deck_bytes;
+    solver_bytes = estimate_solver_bytes(num_nodes);
+    return *this;
+}
+
+std::string ResourceEstimate::describe() const {
+    std::stringstream stream;
+    stream << "about " << static_cast<long long>(num_elements)
+        << " elements and " << static_cast<long long>(num_nodes)
+        << " nodes; " << static_cast<long long>(mesh_bytes / 1e6)
+        << " MB for the mesh, " << static_cast<long long>(deck_bytes / 1e6)
+        << " MB of CalculiX input, "
+        << static_cast<long long>(solver_bytes / 1e6)
+        << " MB for the CalculiX solver";
+    return stream.str();
+}
+
+ResourceEstimate estimate_mesh_resources(
+    const Plc3 &plc,
+    MaxElementSize max_element_size_default,
+    const AttrOverrides<MaxElementSize> &max_element_size_overrides,
+    const std::vector<Length> *vertex_sizes,
+    ElementType element_type
+) {
+    /* Compute the volume of each Plc3 volume by the divergence theorem.
+    Triangle normals point into volumes[0], so out of volumes[1]. */
+    std::vector<Volume> volumes(plc.volumes.size(), 0);
+    /* The mean of 1/size^3 over the vertices of each volume, which is how
+    densely the volume is meshed if the sizing field is used */
+    std::vector<double> inverse_cube_sums(plc.volumes.size(), 0);
+    std::vector<int> vertex_counts(plc.volumes.size(), 0);
+    for (const Plc3::Surface &surface : plc.surfaces) {
+        for (const Plc3::Surface::Triangle &tri : surface.triangles) {
+            Vector a = plc.vertices[tri.vertices[0]].point - Point::origin();
+            Vector b = plc.vertices[tri.vertices[1]].point - Point::origin();
+            Vector c = plc.vertices[tri.vertices[2]].point - Point::origin();
+            Volume signed_volume = a.dot(b.cross(c)) / 6;
+            volumes[surface.volumes[1]] += signed_volume;
+            volumes[surface.volumes[0]] -= signed_volume;
+            if (vertex_sizes == nullptr) continue;
+            for (Plc3::VertexId vid : tri.vertices) {
+                double inverse_cube = 1 / pow((*vertex_sizes)[vid], 3);
+                for (Plc3::VolumeId volume_id : surface.volumes) {
+                    inverse_cube_sums[volume_id] += inverse_cube;
+                    ++vertex_counts[volume_id];
+                }
+            }
+        }
+    }
+
+    const ElementTypeShape &shape = element_type_shape(element_type);
+    double element_volume_factor = 1;
+    if (shape.category == ElementTypeShape::Category::Tetrahedron) {
+        element_volume_factor = unit_tetrahedron_volume;
+    } else if (shape.category == ElementTypeShape::Category::Wedge) {
+        element_volume_factor = unit_wedge_volume;
+    }
+
+    ResourceEstimate estimate;
+    for (Plc3::VolumeId vid = 0;
+            vid < static_cast<int>(plc.volumes.size()); ++vid) {
+        if (vid == plc.volume_outside) continue;
+        if (!plc.volumes[vid].attrs[attr_bit_solid()]) continue;
+        double inverse_cube;
+        if (vertex_sizes != nullptr && vertex_counts[vid] != 0) {
+            inverse_cube = inverse_cube_sums[vid] / vertex_counts[vid];
+        } else {
+            MaxElementSize size = max_element_size_overrides.lookup(
+                plc.volumes[vid].attrs, max_element_size_default);
+            inverse_cube = 1 / pow(size, 3);
+        }
+        /* Every volume gets at least one element */
+        estimate.num_elements += std::max(
+            fabs(volumes[vid]) * inverse_cube / element_volume_factor, 1.0);
+    }
+
+    estimate.num_nodes =
+        estimate.num_elements * nodes_per_element(element_type);
+    estimate.mesh_bytes = estimate.num_elements
+            * Element3Store::bytes_per_element(element_type)
+        + estimate.num_nodes * sizeof(Node3);
+    estimate.deck_bytes = estimate.num_elements *
+            (deck_bytes_per_element +
+                deck_bytes_per_element_node * shape.vertices.size())
+        + estimate.num_nodes * deck_bytes_per_node;
+    estimate.solver_bytes = estimate_solver_bytes(estimate.num_nodes);
+    return estimate;
+}
+
+double compute_coarsening_factor(
+    const ResourceEstimate &estimate,
+    double max_elements,
+    double max_memory_bytes
+) {
+    /* The element count goes as 1/size^3, and the memory at least as fast, so
+    scaling the size by the cube root of the overshoot is always enough. */
+    double factor = 1;
+    if (max_elements > 0 && estimate.num_elements > max_elements) {
+        factor = std::max(factor,
+            pow(estimate.num_elements / max_elements, 1 / 3.0));
+    }
+    double memory_bytes = estimate.mesh_bytes + estimate.solver_bytes;
+    if (max_memory_bytes > 0 && memory_bytes > max_memory_bytes) {
+        factor = std::max(factor,
+            pow(memory_bytes / max_memory_bytes, 1 / 3.0));
+    }
+    return factor;
+}
+
+} /* namespace os2cx */
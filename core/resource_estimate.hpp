@@ -0,0 +1,63 @@
+#ifndef OS2CX_RESOURCE_ESTIMATE_HPP_
+#define OS2CX_RESOURCE_ESTIMATE_HPP_
+
+#include <string>
+#include <vector>
+
+#include "attrs.hpp"
+#include "mesh_type_info.hpp"
+#include "plc.hpp"
+
+namespace os2cx {
+
+/* A rough prediction of how big a job will be, made from the Plc3 before any
+meshing happens. The numbers are only meant to be within a small factor of the
+truth; they're for catching jobs that are orders of magnitude too big. */
+class ResourceEstimate {
+public:
+    ResourceEstimate() :
+        num_elements(0), num_nodes(0), mesh_bytes(0), deck_bytes(0),
+        solver_bytes(0) { }
+
+    double num_elements;
+    double num_nodes;
+
+    /* Memory for the Mesh3 in our own process */
+    double mesh_bytes;
+
+    /* Size of the CalculiX input files */
+    double deck_bytes;
+
+    /* Memory that CalculiX's sparse direct solver will need */
+    double solver_bytes;
+
+    /* Adds another mesh to the estimate. The solver memory isn't additive, so
+    it's recomputed for the combined number of nodes. */
+    ResourceEstimate &operator+=(const ResourceEstimate &other);
+
+    std::string describe() const;
+};
+
+/* Estimates the resources for meshing 'plc' with the given element size and
+type. If 'vertex_sizes' is not null, it's the sizing field that will be passed
+to the mesher (see compute_sizing_field()), and it's used instead of the max
+element sizes to predict how densely each volume will be meshed. */
+ResourceEstimate estimate_mesh_resources(
+    const Plc3 &plc,
+    MaxElementSize max_element_size_default,
+    const AttrOverrides<MaxElementSize> &max_element_size_overrides,
+    const std::vector<Length> *vertex_sizes,
+    ElementType element_type);
+
+/* Returns the factor by which every element size would have to be multiplied
+for 'estimate' to fit within 'max_elements' elements and 'max_memory_bytes'
+of memory (the mesh plus the solver). Returns 1 if it already fits. Either
+limit may be zero to disable it. */
+double compute_coarsening_factor(
+    const ResourceEstimate &estimate,
+    double max_elements,
+    double max_memory_bytes);
+
+} /* namespace os2cx */
+
+#endif /* OS2CX_RESOURCE_ESTIMATE_HPP_ */
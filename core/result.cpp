@@ -201,6 +201,123 @@ const std::map<std::string, UnitType> dataset_name_to_unit_type = {
     {"CSHEAR2", UnitType::Pressure},
 };
 
+void results_expand_axisymmetric(
+    const Mesh3 &mesh,
+    const ContiguousMap<NodeId, NodeId> &meridian_nodes,
+    Results *results
+) {
+    for (Results::Result &result : results->results) {
+        for (Results::Result::Step &step : result.steps) {
+            for (auto &pair : step.datasets) {
+                Results::Dataset &dataset = pair.second;
+
+                /* The meridian nodes are rotated in place too, so read the
+                values that CalculiX reported from a copy */
+                Results::Dataset raw;
+                if (dataset.node_vector) {
+                    raw.node_vector.reset(new ContiguousMap<NodeId, Vector>(
+                        *dataset.node_vector));
+                } else if (dataset.node_complex_vector) {
+                    raw.node_complex_vector.reset(
+                        new ContiguousMap<NodeId, ComplexVector>(
+                            *dataset.node_complex_vector));
+                } else if (dataset.node_matrix) {
+                    raw.node_matrix.reset(new ContiguousMap<NodeId, Matrix>(
+                        *dataset.node_matrix));
+                }
+
+                for (NodeId node_id = dataset.node_begin();
+                        node_id != dataset.node_end(); ++node_id) {
+                    NodeId source = meridian_nodes[node_id];
+                    if (source == NodeId::invalid()) {
+                        continue;
+                    }
+
+                    /* The components are given in the R, Z, and hoop
+                    directions at the meridian. 'rotation' takes them to the
+                    global axes at 'node_id', and 'rotation_t' is its
+                    transpose. The meridian itself is at angle 0, where the
+                    R, Z, and hoop directions are X, Z, and -Y. */
+                    Point point = mesh.nodes[node_id].point;
+                    double angle = atan2(point.y, point.x);
+                    double c = cos(angle), s = sin(angle);
+                    Matrix rotation, rotation_t;
+                    rotation.cols[0] = Vector(c, s, 0);
+                    rotation.cols[1] = Vector(0, 0, 1);
+                    rotation.cols[2] = Vector(s, -c, 0);
+                    rotation_t.cols[0] = Vector(c, 0, s);
+                    rotation_t.cols[1] = Vector(s, 0, -c);
+                    rotation_t.cols[2] = Vector(0, 1, 0);
+
+                    if (dataset.node_scalar) {
+                        (*dataset.node_scalar)[node_id] =
+                            (*dataset.node_scalar)[source];
+                    } else if (dataset.node_vector) {
+                        (*dataset.node_vector)[node_id] = rotation.apply(
+                            (*raw.node_vector)[source]);
+                    } else if (dataset.node_complex_vector) {
+                        ComplexVector v = (*raw.node_complex_vector)[source];
+                        (*dataset.node_complex_vector)[node_id] =
+                            ComplexVector(rotation.apply(v.real()),
+                                rotation.apply(v.imag()));
+                    } else if (dataset.node_matrix) {
+                        const Matrix &m = (*raw.node_matrix)[source];
+                        Matrix rm, rmr;
+                        for (int i = 0; i < 3; ++i) {
+                            rm.cols[i] = rotation.apply(m.cols[i]);
+                        }
+                        for (int i = 0; i < 3; ++i) {
+                            rmr.cols[i] = rm.apply(rotation_t.cols[i]);
+                        }
+                        (*dataset.node_matrix)[node_id] = rmr;
+                    }
+                }
+            }
+        }
+    }
+}
+
+void results_append_mirror_image(
+    const ContiguousMap<NodeId, NodeId> &sources,
+    Dimension axis,
+    Results *results
+) {
+    /* A reflection negates the component along 'axis', and the off-diagonal
+    components of a tensor that involve it */
+    Matrix reflection = Matrix::identity();
+    reflection.cols[static_cast<int>(axis)] *= -1;
+    for (Results::Result &result : results->results) {
+        for (Results::Result::Step &step : result.steps) {
+            for (auto &pair : step.datasets) {
+                Results::Dataset &dataset = pair.second;
+                for (NodeId node_id = dataset.node_end();
+                        node_id != sources.key_end(); ++node_id) {
+                    NodeId source = sources[node_id];
+                    if (dataset.node_scalar) {
+                        dataset.node_scalar->push_back(
+                            (*dataset.node_scalar)[source]);
+                    } else if (dataset.node_vector) {
+                        dataset.node_vector->push_back(reflection.apply(
+                            (*dataset.node_vector)[source]));
+                    } else if (dataset.node_complex_vector) {
+                        ComplexVector v =
+                            (*dataset.node_complex_vector)[source];
+                        v.set_at(axis, -v.at(axis));
+                        dataset.node_complex_vector->push_back(v);
+                    } else if (dataset.node_matrix) {
+                        Matrix m = (*dataset.node_matrix)[source];
+                        for (int i = 0; i < 3; ++i) {
+                            m.cols[i] = reflection.apply(m.cols[i]);
+                        }
+                        m.cols[static_cast<int>(axis)] *= -1;
+                        dataset.node_matrix->push_back(m);
+                    }
+                }
+            }
+        }
+    }
+}
+
 UnitType guess_unit_type_for_dataset(const std::string &name) {
     auto it = dataset_name_to_unit_type.find(name);
     if (it != dataset_name_to_unit_type.end()) {
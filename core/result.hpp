@@ -70,6 +70,22 @@ void results_from_frd_analyses(
     const std::vector<FrdAnalysis> &frd_analyses,
     Results *results_out);
 
+/* CalculiX only reports results for the nodes of axisymmetric elements, which
+are the meridian nodes of a mesh from mesher_axisymmetric(), with components
+in the R, Z, and hoop directions. This rotates them to the global axes and
+copies them to the other nodes. */
+void results_expand_axisymmetric(
+    const Mesh3 &mesh,
+    const ContiguousMap<NodeId, NodeId> &meridian_nodes,
+    Results *results);
+
+/* Extends every dataset to the nodes that Mesh3::append_mirror_image() added,
+given the map that it returned, reflecting vectors and tensors to match */
+void results_append_mirror_image(
+    const ContiguousMap<NodeId, NodeId> &sources,
+    Dimension axis,
+    Results *results);
+
 UnitType guess_unit_type_for_dataset(const std::string &name);
 
 } /* namespace os2cx */
@@ -0,0 +1,32 @@
+#include "simd.hpp"
+
+#include <algorithm>
+#include <atomic>
+
+namespace os2cx {
+
+static std::atomic<int> max_level(static_cast<int>(SimdLevel::Avx2));
+
+static SimdLevel cpu_simd_level() {
+#ifdef OS2CX_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return SimdLevel::Avx2;
+    } else if (__builtin_cpu_supports("avx")) {
+        return SimdLevel::Avx;
+    }
+#endif
+    return SimdLevel::Scalar;
+}
+
+SimdLevel simd_level() {
+    static const SimdLevel cpu_level = cpu_simd_level();
+    return static_cast<SimdLevel>(
+        std::min(static_cast<int>(cpu_level), max_level.load()));
+}
+
+void simd_set_max_level(SimdLevel level) {
+    max_level.store(static_cast<int>(level));
+}
+
+} /* namespace os2cx */
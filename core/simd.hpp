@@ -0,0 +1,27 @@
+#ifndef OS2CX_SIMD_HPP_
+#define OS2CX_SIMD_HPP_
+
+namespace os2cx {
+
+/* The hand-written SIMD kernels are compiled for their instruction set with
+target attributes, whatever flags the rest of the build uses, alongside a
+portable version. simd_level() decides at runtime which one to call. The
+wider kernels only exist on x86 with GCC or Clang. */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define OS2CX_X86_SIMD 1
+#endif
+
+enum class SimdLevel { Scalar, Avx, Avx2 };
+
+/* Returns the widest instruction set that the CPU supports, but no wider than
+the last simd_set_max_level() */
+SimdLevel simd_level();
+
+/* Caps simd_level(), so that tests can run the portable kernels on any CPU.
+Objects that cache simd_level() when they're constructed, like Plc3Index, keep
+the level they started with. */
+void simd_set_max_level(SimdLevel level);
+
+} /* namespace os2cx */
+
+#endif /* OS2CX_SIMD_HPP_ */
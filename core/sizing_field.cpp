@@ -0,0 +1,284 @@
+#include "sizing_field.hpp"
+
+#include <math.h>
+
+#include <algorithm>
+#include <map>
+#include <queue>
+#include <set>
+
+#include "parallel.hpp"
+#include "plc_index.hpp"
+
+namespace os2cx {
+
+/* No vertex asks for elements smaller than this fraction of the
+max_element_size, however thin or sharply curved the geometry is there. */
+static const double min_size_ratio = 0.05;
+
+/* Along an edge of the Plc3, the requested size may grow by at most this much
+per unit of length. */
+static const double grading = 0.5;
+
+/* Neighboring triangles that meet at less than this angle are treated as
+facets of a smooth curved surface; steeper angles are genuine edges. */
+static const double max_curvature_angle = M_PI / 6;
+
+/* Neighboring triangles that meet at less than this angle are treated as flat.
+*/
+static const double min_curvature_angle = 1e-3;
+
+/* On a curved surface, each element should span at most this angle of arc. */
+static const double element_arc_angle = M_PI / 6;
+
+static Vector triangle_area_normal(
+    const Plc3 &plc, const Plc3::Surface::Triangle &tri
+) {
+    Point p0 = plc.vertices[tri.vertices[0]].point;
+    Point p1 = plc.vertices[tri.vertices[1]].point;
+    Point p2 = plc.vertices[tri.vertices[2]].point;
+    return (p1 - p0).cross(p2 - p0);
+}
+
+/* Returns the smallest max_element_size of any solid volume next to each
+vertex. Vertices that don't touch any surface get the default. */
+static std::vector<Length> compute_max_sizes(
+    const Plc3 &plc,
+    MaxElementSize max_element_size_default,
+    const AttrOverrides<MaxElementSize> &max_element_size_overrides
+) {
+    std::vector<Length> max_sizes(plc.vertices.size(), HUGE_VAL);
+    for (const Plc3::Surface &surface : plc.surfaces) {
+        Length size = HUGE_VAL;
+        for (Plc3::VolumeId volume_id : surface.volumes) {
+            if (volume_id == plc.volume_outside) continue;
+            size = std::min(size, max_element_size_overrides.lookup(
+                plc.volumes[volume_id].attrs, max_element_size_default));
+        }
+        for (const Plc3::Surface::Triangle &tri : surface.triangles) {
+            for (Plc3::VertexId vid : tri.vertices) {
+                max_sizes[vid] = std::min(max_sizes[vid], size);
+            }
+        }
+    }
+    for (Length &size : max_sizes) {
+        if (size == HUGE_VAL) size = max_element_size_default;
+    }
+    return max_sizes;
+}
+
+/* Returns the thickness of the solid at each vertex, or infinity if it can't
+be measured. For each distinct direction of the triangles touching the vertex,
+we cast a ray from the vertex along the triangle's normal into every solid
+volume on either side, and take the shortest distance to another surface. A
+single normal averaged over all the triangles would point diagonally out of a
+corner, and overestimate the thickness of e.g. a plate. */
+static std::vector<Length> compute_thicknesses(const Plc3 &plc) {
+    class VertexNormal {
+    public:
+        Plc3::SurfaceId surface;
+        Vector normal;
+    };
+    std::vector<std::vector<VertexNormal> > vertex_normals(
+        plc.vertices.size());
+    for (Plc3::SurfaceId sid = 0;
+            sid < static_cast<int>(plc.surfaces.size()); ++sid) {
+        for (const Plc3::Surface::Triangle &tri : plc.surfaces[sid].triangles) {
+            Vector normal = triangle_area_normal(plc, tri);
+            if (normal.magnitude() == 0) continue;
+            normal /= normal.magnitude();
+            for (Plc3::VertexId vid : tri.vertices) {
+                std::vector<VertexNormal> *normals = &vertex_normals[vid];
+                bool duplicate = false;
+                for (const VertexNormal &vn : *normals) {
+                    if (vn.surface == sid && vn.normal.dot(normal) > 1 - 1e-9) {
+                        duplicate = true;
+                    }
+                }
+                if (!duplicate) {
+                    normals->push_back(VertexNormal { sid, normal });
+                }
+            }
+        }
+    }
+
+    Plc3Index plc_index(&plc);
+    std::vector<Length> thicknesses(plc.vertices.size(), HUGE_VAL);
+    static const int chunk_size = 64;
+    parallel_for(plc.vertices.size(), chunk_size, [&](int begin, int end) {
+        for (Plc3::VertexId vid = begin; vid < end; ++vid) {
+            Point point = plc.vertices[vid].point;
+            for (const VertexNormal &vn : vertex_normals[vid]) {
+                const Plc3::Surface &surface = plc.surfaces[vn.surface];
+                /* Triangle normals point into volumes[0] */
+                if (surface.volumes[0] != plc.volume_outside) {
+                    thicknesses[vid] = std::min(thicknesses[vid],
+                        plc_index.ray_hit_distance(point, vn.normal));
+                }
+                if (surface.volumes[1] != plc.volume_outside) {
+                    thicknesses[vid] = std::min(thicknesses[vid],
+                        plc_index.ray_hit_distance(point, -vn.normal));
+                }
+            }
+        }
+    });
+    return thicknesses;
+}
+
+/* Applies the curvature limit to 'sizes'. For each pair of triangles in the
+same surface that share an edge and meet at a shallow angle, the surface is
+approximately an arc of radius (spacing) / (angle between normals); both
+triangles' vertices are limited to element_arc_angle of it. The spacing is the
+mean height of the two triangles above the shared edge, which is the facet width
+for the long strips that OpenSCAD tessellates cylinders into. */
+static void apply_curvature(
+    const Plc3 &plc,
+    std::vector<Length> *sizes
+) {
+    for (const Plc3::Surface &surface : plc.surfaces) {
+        std::map<std::pair<Plc3::VertexId, Plc3::VertexId>, int> edges;
+        for (int t = 0; t < static_cast<int>(surface.triangles.size()); ++t) {
+            const Plc3::Surface::Triangle &tri = surface.triangles[t];
+            for (int i = 0; i < 3; ++i) {
+                edges[std::make_pair(
+                    tri.vertices[i], tri.vertices[(i + 1) % 3])] = t;
+            }
+        }
+        for (const auto &pair : edges) {
+            if (pair.first.first > pair.first.second) continue;
+            auto reverse = edges.find(
+                std::make_pair(pair.first.second, pair.first.first));
+            if (reverse == edges.end()) continue;
+            const Plc3::Surface::Triangle &tri1 =
+                surface.triangles[pair.second];
+            const Plc3::Surface::Triangle &tri2 =
+                surface.triangles[reverse->second];
+            Vector n1 = triangle_area_normal(plc, tri1);
+            Vector n2 = triangle_area_normal(plc, tri2);
+            if (n1.magnitude() == 0 || n2.magnitude() == 0) continue;
+            double cos_angle = n1.dot(n2) / (n1.magnitude() * n2.magnitude());
+            double angle = acos(std::max(-1.0, std::min(1.0, cos_angle)));
+            if (angle < min_curvature_angle || angle > max_curvature_angle) {
+                continue;
+            }
+            Length edge_length = (plc.vertices[pair.first.second].point -
+                plc.vertices[pair.first.first].point).magnitude();
+            Length spacing =
+                (n1.magnitude() + n2.magnitude()) / (2 * edge_length);
+            Length radius = spacing / angle;
+            Length size = radius * element_arc_angle;
+            for (const Plc3::Surface::Triangle *tri : { &tri1, &tri2 }) {
+                for (Plc3::VertexId vid : tri->vertices) {
+                    (*sizes)[vid] = std::min((*sizes)[vid], size);
+                }
+            }
+        }
+    }
+}
+
+/* Limits 'sizes' so that along every edge of the Plc3, the size grows by at
+most 'grading' per unit of length. This is a shortest-path search seeded by
+every vertex at once, so each vertex ends up with the smallest value of
+(size of u) + grading * (distance from u) over all vertices u. */
+static void apply_grading(const Plc3 &plc, std::vector<Length> *sizes) {
+    std::vector<std::set<Plc3::VertexId> > neighbors(plc.vertices.size());
+    for (const Plc3::Surface &surface : plc.surfaces) {
+        for (const Plc3::Surface::Triangle &tri : surface.triangles) {
+            for (int i = 0; i < 3; ++i) {
+                neighbors[tri.vertices[i]].insert(tri.vertices[(i + 1) % 3]);
+                neighbors[tri.vertices[(i + 1) % 3]].insert(tri.vertices[i]);
+            }
+        }
+    }
+
+    typedef std::pair<Length, Plc3::VertexId> Entry;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry> > queue;
+    for (Plc3::VertexId vid = 0;
+            vid < static_cast<int>(plc.vertices.size()); ++vid) {
+        queue.push(Entry((*sizes)[vid], vid));
+    }
+    while (!queue.empty()) {
+        Entry entry = queue.top();
+        queue.pop();
+        if (entry.first != (*sizes)[entry.second]) {
+            /* stale entry; the vertex was lowered again since */
+            continue;
+        }
+        Point point = plc.vertices[entry.second].point;
+        for (Plc3::VertexId other : neighbors[entry.second]) {
+            Length limit = entry.first + grading *
+                (plc.vertices[other].point - point).magnitude();
+            if (limit < (*sizes)[other]) {
+                (*sizes)[other] = limit;
+                queue.push(Entry(limit, other));
+            }
+        }
+    }
+}
+
+std::vector<Length> compute_sizing_field(
+    const Plc3 &plc,
+    MaxElementSize max_element_size_default,
+    const AttrOverrides<MaxElementSize> &max_element_size_overrides,
+    double elements_per_thickness
+) {
+    std::vector<Length> max_sizes = compute_max_sizes(
+        plc, max_element_size_default, max_element_size_overrides);
+    std::vector<Length> sizes = max_sizes;
+
+    if (elements_per_thickness > 0) {
+        std::vector<Length> thicknesses = compute_thicknesses(plc);
+        for (Plc3::VertexId vid = 0;
+                vid < static_cast<int>(plc.vertices.size()); ++vid) {
+            sizes[vid] = std::min(sizes[vid],
+                thicknesses[vid] / elements_per_thickness);
+        }
+
+        apply_curvature(plc, &sizes);
+    }
+
+    for (Plc3::VertexId vid = 0;
+            vid < static_cast<int>(plc.vertices.size()); ++vid) {
+        sizes[vid] = std::max(sizes[vid], min_size_ratio * max_sizes[vid]);
+    }
+
+    apply_grading(plc, &sizes);
+
+    return sizes;
+}
+
+void refine_sizing_field_near_attrs(
+    const Plc3 &plc,
+    AttrBitset attrs,
+    double ratio,
+    std::vector<Length> *sizes
+) {
+    assert(sizes->size() == plc.vertices.size());
+    assert(ratio > 0 && ratio <= 1);
+
+    std::vector<bool> refine(plc.vertices.size(), false);
+    for (const Plc3::Surface &surface : plc.surfaces) {
+        /* A selected surface, or a surface where a selected volume ends */
+        AttrBitset volume_change = plc.volumes[surface.volumes[0]].attrs
+            ^ plc.volumes[surface.volumes[1]].attrs;
+        if (((surface.attrs | volume_change) & attrs).none()) continue;
+        for (const Plc3::Surface::Triangle &tri : surface.triangles) {
+            for (Plc3::VertexId vid : tri.vertices) {
+                refine[vid] = true;
+            }
+        }
+    }
+    for (Plc3::VertexId vid = 0;
+            vid < static_cast<int>(plc.vertices.size()); ++vid) {
+        if ((plc.vertices[vid].attrs & attrs).any()) {
+            refine[vid] = true;
+        }
+        if (refine[vid]) {
+            (*sizes)[vid] *= ratio;
+        }
+    }
+
+    apply_grading(plc, sizes);
+}
+
+} /* namespace os2cx */
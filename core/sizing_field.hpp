@@ -0,0 +1,51 @@
+#ifndef OS2CX_SIZING_FIELD_HPP_
+#define OS2CX_SIZING_FIELD_HPP_
+
+#include <vector>
+
+#include "attrs.hpp"
+#include "calc.hpp"
+#include "plc.hpp"
+
+namespace os2cx {
+
+/* compute_sizing_field() returns a target element size for every vertex of the
+Plc3. The size starts out as the max_element_size that applies to the solid
+volumes next to the vertex.
+
+If 'elements_per_thickness' is positive, the size also follows the local
+feature size of the geometry:
+
+- Thickness: the distance from each vertex to the opposing surface of the solid,
+  measured inwards along the normals of the triangles around it, is divided by
+  'elements_per_thickness'. So a thin plate gets several elements through its
+  thickness even if 'max_element_size_default' is much larger than the plate.
+- Curvature: where neighboring triangles meet at a shallow angle, the surface is
+  treated as a tessellated curve and the size is limited so that each element
+  spans only a modest arc of it.
+
+The size never drops below a fixed fraction of the max_element_size.
+Finally the sizes are graded along the edges of the Plc3, so that neighboring
+vertices don't ask for wildly different element sizes. */
+std::vector<Length> compute_sizing_field(
+    const Plc3 &plc,
+    MaxElementSize max_element_size_default,
+    const AttrOverrides<MaxElementSize> &max_element_size_overrides,
+    double elements_per_thickness);
+
+/* refine_sizing_field_near_attrs() multiplies the size by 'ratio' at every
+vertex that touches one of the given attrs: vertices of a surface that has one
+of the attrs, vertices on the boundary between a volume that has one of the
+attrs and a volume that doesn't, and vertices that have one of the attrs
+themselves. The sizes are then graded again, so that the refinement fades out
+with distance. This is meant for the selections that loads and constraints are
+applied to, where stresses tend to concentrate. */
+void refine_sizing_field_near_attrs(
+    const Plc3 &plc,
+    AttrBitset attrs,
+    double ratio,
+    std::vector<Length> *sizes);
+
+} /* namespace os2cx */
+
+#endif /* OS2CX_SIZING_FIELD_HPP_ */
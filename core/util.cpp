@@ -103,15 +103,23 @@ private:
     DIR *dir;
 };
 
-void TempDir::cleanup() {
-    DirWalker dir_walker(_path.c_str());
+/* Removes the directory at 'path' along with everything in it, including any
+subdirectories, such as the ".os2cx" directory that project_run() creates next
+to the .scad file. */
+static void remove_directory_recursive(const std::string &path) {
+    DirWalker dir_walker(path.c_str());
     struct dirent *dirent;
     while ((dirent = dir_walker.next()) != nullptr) {
         if (strcmp(dirent->d_name, ".") == 0
             || strcmp(dirent->d_name, "..") == 0) {
             continue;
         }
-        std::string full_path = (_path + "/") + dirent->d_name;
+        std::string full_path = (path + "/") + dirent->d_name;
+        struct stat st;
+        if (lstat(full_path.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) {
+            remove_directory_recursive(full_path);
+            continue;
+        }
         int res = remove(full_path.c_str());
         if (res != 0) {
             throw std::runtime_error(
@@ -119,11 +127,15 @@ void TempDir::cleanup() {
                 std::string(strerror(errno)));
         }
     }
-    int res = rmdir(_path.c_str());
+    int res = rmdir(path.c_str());
     if (res != 0) {
         throw std::runtime_error(
-            "rmdir(" + _path + ") failed: " + std::string(strerror(errno)));
+            "rmdir(" + path + ") failed: " + std::string(strerror(errno)));
     }
 }
 
+void TempDir::cleanup() {
+    remove_directory_recursive(_path);
+}
+
 } /* namespace os2cx */
@@ -4,6 +4,7 @@
 #include <assert.h>
 
 #include <algorithm>
+#include <iterator>
 #include <string>
 #include <vector>
 
@@ -77,6 +78,14 @@ public:
         values.push_back(value);
         return Key::from_int(offset + values.size() - 1);
     }
+    /* Moves the values of 'other' onto the end of this map and frees its
+    storage, leaving it empty */
+    void append(ContiguousMap &&other) {
+        values.insert(values.end(),
+            std::make_move_iterator(other.values.begin()),
+            std::make_move_iterator(other.values.end()));
+        std::vector<Value>().swap(other.values);
+    }
 private:
     int offset;
     std::vector<Value> values;
@@ -285,7 +285,7 @@ public:
             }
         } else if (focus_element_set) {
             for (ElementId eid : focus_element_set->elements) {
-                const Element3 &element = project->mesh->elements[eid];
+                ConstElement3Ref element = project->mesh->elements[eid];
                 const ElementTypeShape *shape =
                         &element_type_shape(element.type);
                 for (int face = 0; face < static_cast<int>(shape->faces.size());
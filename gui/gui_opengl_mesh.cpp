@@ -9,7 +9,7 @@ void gui_opengl_scene_mesh_face(
     bool xray,
     GuiOpenglScene *scene
 ) {
-    const Element3 &element = project.mesh->elements[face_id.element_id];
+    ConstElement3Ref element = project.mesh->elements[face_id.element_id];
     const ElementTypeShape &shape = element_type_shape(element.type);
     NodeId node_ids[ElementTypeShape::max_vertices_per_face];
     const ElementTypeShape::Face &face = shape.faces[face_id.face];
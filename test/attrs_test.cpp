@@ -38,14 +38,16 @@ void do_load_volume_test(const std::function<Mesh3(const Plc3 &)> &mesher) {
 TEST(AttrsTest, LoadVolumeC3D4) {
     do_load_volume_test([](const Plc3 &plc) {
         return mesher_tetgen(
-            plc, 0.5, AttrOverrides<MaxElementSize>(), ElementType::C3D4);
+            plc, 0.5, AttrOverrides<MaxElementSize>(), nullptr,
+            ElementType::C3D4);
     });
 }
 
 TEST(AttrsTest, LoadVolumeC3D10) {
     do_load_volume_test([](const Plc3 &plc) {
         return mesher_tetgen(
-            plc, 0.5, AttrOverrides<MaxElementSize>(), ElementType::C3D10);
+            plc, 0.5, AttrOverrides<MaxElementSize>(), nullptr,
+            ElementType::C3D10);
     });
 }
 
@@ -108,14 +110,16 @@ void do_load_surface_test(const std::function<Mesh3(const Plc3 &)> &mesher) {
 TEST(AttrsTest, LoadSurfaceC3D4) {
     do_load_surface_test([](const Plc3 &plc) {
         return mesher_tetgen(
-            plc, 0.5, AttrOverrides<MaxElementSize>(), ElementType::C3D4);
+            plc, 0.5, AttrOverrides<MaxElementSize>(), nullptr,
+            ElementType::C3D4);
     });
 }
 
 TEST(AttrsTest, LoadSurfaceC3D10) {
     do_load_surface_test([](const Plc3 &plc) {
         return mesher_tetgen(
-            plc, 0.5, AttrOverrides<MaxElementSize>(), ElementType::C3D10);
+            plc, 0.5, AttrOverrides<MaxElementSize>(), nullptr,
+            ElementType::C3D10);
     });
 }
 
@@ -154,7 +158,8 @@ TEST(AttrsTest, ComputeSlice) {
         bit_index_mask);
     Plc3 plc = plc_nef_to_plc(solid_nef);
     Mesh3 mesh = mesher_tetgen(
-        plc, 0.5, AttrOverrides<MaxElementSize>(), ElementType::C3D10);
+        plc, 0.5, AttrOverrides<MaxElementSize>(), nullptr,
+        ElementType::C3D10);
     FaceSet face_set = compute_face_set_from_attr_bit(
         mesh,
         mesh.elements.key_begin(),
@@ -182,7 +187,7 @@ TEST(AttrsTest, ComputeSlice) {
     Mesh3Index mesh_index(mesh);
     for (ElementId element_id = mesh.elements.key_begin();
             element_id != mesh.elements.key_end(); ++element_id) {
-        const Element3 &element = mesh.elements[element_id];
+        ConstElement3Ref element = mesh.elements[element_id];
         const ElementTypeShape &shape = element_type_shape(element.type);
         for (int face = 0; face < static_cast<int>(shape.faces.size());
                 ++face) {
@@ -42,7 +42,7 @@ TEST(CalculixReadTest, ReadCalculixNodesAndElements) {
     EXPECT_FLOAT_EQ(-0.3, n3.point.z);
 
     ASSERT_EQ(1, mesh.elements.size());
-    const Element3 &e = mesh.elements[ElementId::from_int(1)];
+    ConstElement3Ref e = mesh.elements[ElementId::from_int(1)];
     EXPECT_EQ(ElementType::C3D4, e.type);
     EXPECT_EQ(1, e.nodes[0].to_int());
     EXPECT_EQ(2, e.nodes[1].to_int());
@@ -0,0 +1,81 @@
+#include <gtest/gtest.h>
+
+#include "error_estimate.hpp"
+
+namespace os2cx {
+
+/* A single element of the given type, stretched to twice its natural size
+along x, with the displacement field u = (0.001 * x, 0, 0) and the nodal
+stresses that CalculiX would report for it */
+static void make_stretched_element(
+    ElementType type,
+    Mesh3 *mesh_out,
+    ContiguousMap<NodeId, Vector> *displacements_out,
+    ContiguousMap<NodeId, Matrix> *stresses_out
+) {
+    mesh_out->nodes = ContiguousMap<NodeId, Node3>(NodeId::from_int(0));
+    mesh_out->elements = Element3Store(ElementId::from_int(0));
+    *displacements_out = ContiguousMap<NodeId, Vector>(NodeId::from_int(0));
+    *stresses_out = ContiguousMap<NodeId, Matrix>(NodeId::from_int(0));
+
+    /* With E = 1000 and poissons_ratio = 0, the stress is 1 along x */
+    Matrix stress = Matrix::zero();
+    stress.cols[0].x = 1;
+
+    const ElementTypeShape &shape = element_type_shape(type);
+    AffineTransform transform(Matrix::scale(2, 1, 1));
+    Element3 element;
+    element.type = type;
+    for (int i = 0; i < static_cast<int>(shape.vertices.size()); ++i) {
+        Node3 node;
+        node.point = transform.apply(shape.vertices[i].uvw);
+        element.nodes[i] = mesh_out->nodes.push_back(node);
+        displacements_out->push_back(Vector(0.001 * node.point.x, 0, 0));
+        stresses_out->push_back(stress);
+    }
+    mesh_out->elements.push_back(element);
+}
+
+static ElasticMaterial test_material(ElementId) {
+    ElasticMaterial material;
+    material.youngs_modulus = 1000;
+    material.poissons_ratio = 0;
+    return material;
+}
+
+TEST(ErrorEstimateTest, ExactFieldHasNoError) {
+    for (ElementType type : {ElementType::C3D4, ElementType::C3D10}) {
+        Mesh3 mesh;
+        ContiguousMap<NodeId, Vector> displacements;
+        ContiguousMap<NodeId, Matrix> stresses;
+        make_stretched_element(type, &mesh, &displacements, &stresses);
+
+        StressErrorEstimate estimate = estimate_stress_error(
+            mesh, displacements, stresses, &test_material);
+        EXPECT_NEAR(0, estimate.total_error, 1e-9);
+        EXPECT_NEAR(0, estimate.relative_error(), 1e-9);
+        /* The stress is 1 over a volume of 2/6 */
+        EXPECT_NEAR(sqrt(2 / 6.0), estimate.total_stress, 1e-9);
+    }
+}
+
+TEST(ErrorEstimateTest, DisagreementIsError) {
+    Mesh3 mesh;
+    ContiguousMap<NodeId, Vector> displacements;
+    ContiguousMap<NodeId, Matrix> stresses;
+    make_stretched_element(
+        ElementType::C3D4, &mesh, &displacements, &stresses);
+
+    /* Recovered stress twice the raw stress everywhere */
+    for (Matrix &stress : stresses) {
+        stress.cols[0].x = 2;
+    }
+    StressErrorEstimate estimate = estimate_stress_error(
+        mesh, displacements, stresses, &test_material);
+    EXPECT_NEAR(sqrt(2 / 6.0), estimate.total_error, 1e-9);
+    EXPECT_NEAR(0.5, estimate.relative_error(), 1e-9);
+    EXPECT_NEAR(estimate.total_error,
+        estimate.element_errors[ElementId::from_int(0)], 1e-9);
+}
+
+} /* namespace os2cx */
@@ -0,0 +1,127 @@
+#include <gtest/gtest.h>
+
+#include "mesh_batch.hpp"
+#include "simd.hpp"
+
+namespace os2cx {
+
+/* A mesh with a few differently distorted elements of every type, interleaved
+so that the batches have to be regrouped by type */
+static Mesh3 make_mixed_mesh() {
+    static const ElementType types[] = {
+        ElementType::C3D8, ElementType::C3D20, ElementType::C3D20R,
+        ElementType::C3D20RI, ElementType::C3D4, ElementType::C3D10,
+        ElementType::C3D6, ElementType::C3D15};
+    Mesh3 mesh;
+    for (int copy = 0; copy < 6; ++copy) {
+        for (ElementType type : types) {
+            const ElementTypeShape &shape = element_type_shape(type);
+            Element3 element;
+            element.type = type;
+            for (int i = 0; i < static_cast<int>(shape.vertices.size()); ++i) {
+                const Point &uvw = shape.vertices[i].uvw;
+                /* A mild nonlinear distortion, so that the Jacobian varies
+                between integration points */
+                Node3 node;
+                node.point = Point(
+                    uvw.x * (1 + 0.1 * copy) + 0.05 * uvw.y * uvw.z,
+                    uvw.y + 0.1 * uvw.x * uvw.x,
+                    uvw.z * (2 - 0.1 * copy) + copy);
+                element.nodes[i] = mesh.nodes.push_back(node);
+            }
+            mesh.elements.push_back(element);
+        }
+    }
+    return mesh;
+}
+
+TEST(MeshBatchTest, Volumes) {
+    Mesh3 mesh = make_mixed_mesh();
+    std::vector<ElementId> element_ids;
+    for (ElementId element_id = mesh.elements.key_begin();
+            element_id != mesh.elements.key_end(); ++element_id) {
+        element_ids.push_back(element_id);
+    }
+    ElementVolumeBatch batch = compute_element_volume_batch(mesh, element_ids);
+    for (int i = 0; i < static_cast<int>(element_ids.size()); ++i) {
+        ConstElement3Ref element = mesh.elements[element_ids[i]];
+        EXPECT_NEAR(mesh.volume(element), batch.volumes[i], 1e-12);
+        Volume volumes[ElementTypeShape::max_vertices_per_element];
+        mesh.volumes_for_nodes(element, volumes);
+        for (int j = 0; j < element.num_nodes(); ++j) {
+            EXPECT_NEAR(volumes[j],
+                batch.node_volumes[batch.node_offsets[i] + j], 1e-12);
+        }
+    }
+}
+
+TEST(MeshBatchTest, Areas) {
+    Mesh3 mesh = make_mixed_mesh();
+    std::vector<FaceId> face_ids;
+    for (ElementId element_id = mesh.elements.key_begin();
+            element_id != mesh.elements.key_end(); ++element_id) {
+        const ElementTypeShape &shape =
+            element_type_shape(mesh.elements[element_id].type);
+        for (int face = 0; face < static_cast<int>(shape.faces.size());
+                ++face) {
+            face_ids.push_back(FaceId(element_id, face));
+        }
+    }
+    FaceAreaBatch batch = compute_face_area_batch(mesh, face_ids);
+    for (int i = 0; i < static_cast<int>(face_ids.size()); ++i) {
+        ConstElement3Ref element = mesh.elements[face_ids[i].element_id];
+        int face = face_ids[i].face;
+        Vector area = mesh.oriented_area(element, face);
+        EXPECT_NEAR(area.x, batch.area(i).x, 1e-12);
+        EXPECT_NEAR(area.y, batch.area(i).y, 1e-12);
+        EXPECT_NEAR(area.z, batch.area(i).z, 1e-12);
+
+        Vector areas[ElementTypeShape::max_vertices_per_element];
+        mesh.oriented_areas_for_nodes(element, face, areas);
+        const std::vector<int> &vertices =
+            element_type_shape(element.type).faces[face].vertices;
+        for (int k = 0; k < static_cast<int>(vertices.size()); ++k) {
+            Vector node_area = batch.node_area(i, k);
+            EXPECT_NEAR(areas[vertices[k]].x, node_area.x, 1e-12);
+            EXPECT_NEAR(areas[vertices[k]].y, node_area.y, 1e-12);
+            EXPECT_NEAR(areas[vertices[k]].z, node_area.z, 1e-12);
+        }
+    }
+}
+
+TEST(MeshBatchTest, ScalarMatchesSimd) {
+    /* Whichever kernels this CPU runs by default, the portable ones must give
+    exactly the same results */
+    Mesh3 mesh = make_mixed_mesh();
+    std::vector<ElementId> element_ids;
+    std::vector<FaceId> face_ids;
+    for (ElementId element_id = mesh.elements.key_begin();
+            element_id != mesh.elements.key_end(); ++element_id) {
+        element_ids.push_back(element_id);
+        const ElementTypeShape &shape =
+            element_type_shape(mesh.elements[element_id].type);
+        for (int face = 0; face < static_cast<int>(shape.faces.size());
+                ++face) {
+            face_ids.push_back(FaceId(element_id, face));
+        }
+    }
+    ElementVolumeBatch simd_volumes =
+        compute_element_volume_batch(mesh, element_ids);
+    FaceAreaBatch simd_areas = compute_face_area_batch(mesh, face_ids);
+    simd_set_max_level(SimdLevel::Scalar);
+    ElementVolumeBatch scalar_volumes =
+        compute_element_volume_batch(mesh, element_ids);
+    FaceAreaBatch scalar_areas = compute_face_area_batch(mesh, face_ids);
+    simd_set_max_level(SimdLevel::Avx2);
+
+    EXPECT_EQ(scalar_volumes.volumes, simd_volumes.volumes);
+    EXPECT_EQ(scalar_volumes.node_volumes, simd_volumes.node_volumes);
+    EXPECT_EQ(scalar_areas.area_x, simd_areas.area_x);
+    EXPECT_EQ(scalar_areas.area_y, simd_areas.area_y);
+    EXPECT_EQ(scalar_areas.area_z, simd_areas.area_z);
+    EXPECT_EQ(scalar_areas.node_area_x, simd_areas.node_area_x);
+    EXPECT_EQ(scalar_areas.node_area_y, simd_areas.node_area_y);
+    EXPECT_EQ(scalar_areas.node_area_z, simd_areas.node_area_z);
+}
+
+} /* namespace os2cx */
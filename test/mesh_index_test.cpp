@@ -44,4 +44,88 @@ TEST(MeshIndexTest, Mesh3Index) {
     }
 }
 
+/* An n*n*n block of C3D8 bricks, with the nodes numbered along X, then Y,
+then Z */
+static Mesh3 make_brick_block(int n) {
+    int m = n + 1;
+    Mesh3 mesh;
+    for (int i = 0; i < m * m * m; ++i) {
+        Node3 node;
+        node.point = Point(i % m, (i / m) % m, i / (m * m));
+        mesh.nodes.push_back(node);
+    }
+    const ElementTypeShape &shape = element_type_shape(ElementType::C3D8);
+    for (int z = 0; z < n; ++z) {
+        for (int y = 0; y < n; ++y) {
+            for (int x = 0; x < n; ++x) {
+                Element3 element;
+                element.type = ElementType::C3D8;
+                for (int i = 0; i < 8; ++i) {
+                    const Point &uvw = shape.vertices[i].uvw;
+                    element.nodes[i] = NodeId::from_int(
+                        mesh.nodes.key_begin().to_int()
+                        + (x + (uvw.x > 0)) + (y + (uvw.y > 0)) * m
+                        + (z + (uvw.z > 0)) * m * m);
+                }
+                mesh.elements.push_back(element);
+            }
+        }
+    }
+    return mesh;
+}
+
+TEST(MeshIndexTest, Block) {
+    /* Every interior face is matched with its neighbor's, and only the 6*n*n
+    faces on the outside are unmatched */
+    static const int n = 4;
+    Mesh3 mesh = make_brick_block(n);
+    Mesh3Index index(mesh);
+    EXPECT_EQ(6u * n * n, index.unmatched_faces.size());
+    int num_matched = 0;
+    for (ElementId eid = mesh.elements.key_begin();
+            eid != mesh.elements.key_end(); ++eid) {
+        for (int face = 0; face < 6; ++face) {
+            FaceId match = index.matching_face(FaceId(eid, face));
+            if (match == FaceId::invalid()) continue;
+            ++num_matched;
+            EXPECT_NE(eid, match.element_id);
+            EXPECT_EQ(FaceId(eid, face), index.matching_face(match));
+        }
+    }
+    EXPECT_EQ(6 * n * n * n - 6 * n * n, num_matched);
+}
+
+TEST(MeshIndexTest, NodeAdjacency) {
+    Mesh3 mesh = make_brick_block(3);
+    Mesh3Index index(mesh);
+    for (NodeId node_id = mesh.nodes.key_begin();
+            node_id != mesh.nodes.key_end(); ++node_id) {
+        std::vector<ElementId> expected_elements;
+        std::vector<FaceId> expected_faces;
+        for (ElementId eid = mesh.elements.key_begin();
+                eid != mesh.elements.key_end(); ++eid) {
+            ConstElement3Ref element = mesh.elements[eid];
+            const ElementTypeShape &shape = element_type_shape(element.type);
+            for (int i = 0; i < element.num_nodes(); ++i) {
+                if (element.nodes[i] == node_id) {
+                    expected_elements.push_back(eid);
+                }
+            }
+            for (int face = 0; face < 6; ++face) {
+                for (int vertex : shape.faces[face].vertices) {
+                    if (element.nodes[vertex] == node_id) {
+                        expected_faces.push_back(FaceId(eid, face));
+                    }
+                }
+            }
+        }
+        Mesh3Index::Range<ElementId> elements = index.node_elements(node_id);
+        EXPECT_EQ(expected_elements,
+            std::vector<ElementId>(elements.begin(), elements.end()));
+        Mesh3Index::Range<FaceId> faces = index.node_faces(node_id);
+        EXPECT_EQ(expected_faces,
+            std::vector<FaceId>(faces.begin(), faces.end()));
+    }
+}
+
 } /* namespace os2cx */
@@ -0,0 +1,229 @@
+#include <gtest/gtest.h>
+
+#include "mesh_index.hpp"
+#include "mesh_optimize.hpp"
+#include "mesh_quality.hpp"
+
+namespace os2cx {
+
+/* Returns the ID of the i'th node of the mesh */
+static NodeId node(const Mesh3 &mesh, int i) {
+    return NodeId::from_int(mesh.nodes.key_begin().to_int() + i);
+}
+
+/* Adds a C3D4 element with the given nodes, swapping two corners if necessary
+so that it's positively oriented */
+static void add_tet(Mesh3 *mesh, int a, int b, int c, int d) {
+    Point pa = mesh->nodes[node(*mesh, a)].point;
+    Point pb = mesh->nodes[node(*mesh, b)].point;
+    Point pc = mesh->nodes[node(*mesh, c)].point;
+    Point pd = mesh->nodes[node(*mesh, d)].point;
+    if ((pb - pa).dot((pc - pa).cross(pd - pa)) < 0) {
+        std::swap(b, c);
+    }
+    Element3 element;
+    element.type = ElementType::C3D4;
+    element.nodes[0] = node(*mesh, a);
+    element.nodes[1] = node(*mesh, b);
+    element.nodes[2] = node(*mesh, c);
+    element.nodes[3] = node(*mesh, d);
+    mesh->elements.push_back(element);
+}
+
+static NodeId add_node(Mesh3 *mesh, Point point) {
+    Node3 node;
+    node.point = point;
+    return mesh->nodes.push_back(node);
+}
+
+/* The attrs that the boundary faces of the test meshes get */
+static AttrBitset surface_attrs() {
+    return AttrBitset().set(1);
+}
+
+/* Sets the attrs the way transfer_attrs() does for a tetgen mesh of a single
+solid volume: every element is solid, faces on the boundary get the attrs of
+the surface, and every other face gets the attrs of its element. */
+static void set_attrs_like_tetgen(Mesh3 *mesh) {
+    std::vector<FaceId> boundary_faces = Mesh3Index(*mesh).unmatched_faces;
+    for (ElementId eid = mesh->elements.key_begin();
+            eid != mesh->elements.key_end(); ++eid) {
+        AttrBitset attrs = mesh->elements[eid].attrs;
+        attrs.set(attr_bit_solid());
+        mesh->elements.set_attrs(eid, attrs);
+        for (int face = 0; face < 4; ++face) {
+            mesh->elements.set_face_attrs(eid, face, attrs);
+        }
+    }
+    for (FaceId face_id : boundary_faces) {
+        mesh->elements.set_face_attrs(
+            face_id.element_id, face_id.face, surface_attrs());
+    }
+}
+
+/* Checks that the mesh still follows the convention of set_attrs_like_tetgen()
+after faces have been flipped */
+static void expect_attrs_like_tetgen(const Mesh3 &mesh) {
+    Mesh3Index index(mesh);
+    for (ElementId eid = mesh.elements.key_begin();
+            eid != mesh.elements.key_end(); ++eid) {
+        ConstElement3Ref element = mesh.elements[eid];
+        for (int face = 0; face < 4; ++face) {
+            if (index.matching_face(FaceId(eid, face)) == FaceId::invalid()) {
+                EXPECT_EQ(surface_attrs(), element.face_attrs[face]);
+            } else {
+                EXPECT_EQ(element.attrs, element.face_attrs[face]);
+            }
+        }
+    }
+}
+
+/* The unit cube, split into twelve tetrahedra around an interior node */
+static Mesh3 make_cube_around(Point center) {
+    Mesh3 mesh;
+    for (int i = 0; i < 8; ++i) {
+        add_node(&mesh, Point(i & 1, (i & 2) / 2, (i & 4) / 4));
+    }
+    add_node(&mesh, center);
+    int c = 8;
+    int quads[6][4] = {
+        {0, 1, 3, 2}, {4, 5, 7, 6}, {0, 1, 5, 4},
+        {2, 3, 7, 6}, {0, 2, 6, 4}, {1, 3, 7, 5}};
+    for (const auto &q : quads) {
+        add_tet(&mesh, q[0], q[1], q[2], c);
+        add_tet(&mesh, q[0], q[2], q[3], c);
+    }
+    set_attrs_like_tetgen(&mesh);
+    return mesh;
+}
+
+static Volume total_volume(const Mesh3 &mesh) {
+    Volume volume = 0;
+    for (ConstElement3Ref element : mesh.elements) {
+        volume += mesh.volume(element);
+    }
+    return volume;
+}
+
+static double min_radius_ratio(const Mesh3 &mesh) {
+    return compute_mesh_quality(mesh).radius_ratio.min_value;
+}
+
+TEST(MeshOptimizeTest, SmoothsInteriorNode) {
+    Mesh3 mesh = make_cube_around(Point(0.9, 0.5, 0.5));
+    double before = min_radius_ratio(mesh);
+    mesh_optimize(&mesh, 5);
+
+    ASSERT_EQ(9, mesh.nodes.size());
+    for (int i = 0; i < 8; ++i) {
+        Point corner(i & 1, (i & 2) / 2, (i & 4) / 4);
+        EXPECT_EQ(corner, mesh.nodes[node(mesh, i)].point);
+    }
+    EXPECT_LT(mesh.nodes[node(mesh, 8)].point.x, 0.7);
+    EXPECT_GT(min_radius_ratio(mesh), before);
+}
+
+TEST(MeshOptimizeTest, KeepsNodesWithAttrs) {
+    Mesh3 mesh = make_cube_around(Point(0.9, 0.5, 0.5));
+    mesh.nodes[node(mesh, 8)].attrs.set(4);
+    mesh_optimize(&mesh, 5);
+    EXPECT_EQ(Point(0.9, 0.5, 0.5), mesh.nodes[node(mesh, 8)].point);
+}
+
+TEST(MeshOptimizeTest, KeepsAttrSurfaces) {
+    /* Two volumes meet at the interior node, so it can't move */
+    Mesh3 mesh = make_cube_around(Point(0.9, 0.5, 0.5));
+    for (ElementId eid = mesh.elements.key_begin();
+            eid != mesh.elements.key_end(); ++eid) {
+        if (eid.to_int() % 2 == 0) {
+            AttrBitset attrs = mesh.elements[eid].attrs;
+            mesh.elements.set_attrs(eid, attrs.set(3));
+        }
+    }
+    set_attrs_like_tetgen(&mesh);
+    mesh_optimize(&mesh, 5);
+    EXPECT_EQ(Point(0.9, 0.5, 0.5), mesh.nodes[node(mesh, 8)].point);
+}
+
+TEST(MeshOptimizeTest, FlipsSliverPair) {
+    /* Two flat tetrahedra sharing a large face; replacing them by three
+    tetrahedra around the short line between their apexes removes the
+    slivers */
+    Mesh3 mesh;
+    add_node(&mesh, Point(0, 0, 0));
+    add_node(&mesh, Point(1, 0, 0));
+    add_node(&mesh, Point(0.5, sqrt(0.75), 0));
+    add_node(&mesh, Point(0.5, sqrt(0.75) / 3, -0.2));
+    add_node(&mesh, Point(0.5, sqrt(0.75) / 3, 0.2));
+    add_tet(&mesh, 0, 1, 2, 3);
+    add_tet(&mesh, 0, 1, 2, 4);
+    set_attrs_like_tetgen(&mesh);
+    double before = min_radius_ratio(mesh);
+    Volume volume_before = total_volume(mesh);
+    mesh_optimize(&mesh, 1);
+    EXPECT_EQ(3, mesh.elements.size());
+    EXPECT_GT(min_radius_ratio(mesh), before);
+    EXPECT_NEAR(volume_before, total_volume(mesh), 1e-9);
+    expect_attrs_like_tetgen(mesh);
+}
+
+TEST(MeshOptimizeTest, FlipsEdgeWithThreeTets) {
+    /* Three needles around a long edge become two well-shaped tetrahedra */
+    Mesh3 mesh;
+    add_node(&mesh, Point(0, 0, 0));
+    add_node(&mesh, Point(1, 0, 0));
+    add_node(&mesh, Point(0.5, sqrt(0.75), 0));
+    add_node(&mesh, Point(0.5, sqrt(0.75) / 3, -1));
+    add_node(&mesh, Point(0.5, sqrt(0.75) / 3, 1));
+    add_tet(&mesh, 0, 1, 3, 4);
+    add_tet(&mesh, 1, 2, 3, 4);
+    add_tet(&mesh, 2, 0, 3, 4);
+    set_attrs_like_tetgen(&mesh);
+    double before = min_radius_ratio(mesh);
+    Volume volume_before = total_volume(mesh);
+    mesh_optimize(&mesh, 1);
+    EXPECT_EQ(2, mesh.elements.size());
+    EXPECT_GT(min_radius_ratio(mesh), before);
+    EXPECT_NEAR(volume_before, total_volume(mesh), 1e-9);
+    expect_attrs_like_tetgen(mesh);
+}
+
+TEST(MeshOptimizeTest, MidsideNodesFollowCorners) {
+    Mesh3 linear = make_cube_around(Point(0.9, 0.5, 0.5));
+    Mesh3 mesh;
+    mesh.nodes = linear.nodes;
+    /* Give each edge a midside node */
+    std::map<std::pair<int, int>, NodeId> edges;
+    static const int tet_edges[6][2] = {
+        {0, 1}, {1, 2}, {2, 0}, {0, 3}, {1, 3}, {2, 3}};
+    for (ConstElement3Ref linear_element : linear.elements) {
+        Element3 element = linear_element.to_element();
+        element.type = ElementType::C3D10;
+        for (int k = 0; k < 6; ++k) {
+            NodeId p = element.nodes[tet_edges[k][0]];
+            NodeId q = element.nodes[tet_edges[k][1]];
+            auto key = std::make_pair(
+                std::min(p.to_int(), q.to_int()),
+                std::max(p.to_int(), q.to_int()));
+            if (!edges.count(key)) {
+                Point a = mesh.nodes[p].point, b = mesh.nodes[q].point;
+                edges[key] = add_node(&mesh, a + (b - a) / 2);
+            }
+            element.nodes[4 + k] = edges[key];
+        }
+        mesh.elements.push_back(element);
+    }
+
+    mesh_optimize(&mesh, 5);
+    EXPECT_LT(mesh.nodes[node(mesh, 8)].point.x, 0.7);
+    for (ConstElement3Ref element : mesh.elements) {
+        for (int k = 0; k < 6; ++k) {
+            Point a = mesh.nodes[element.nodes[tet_edges[k][0]]].point;
+            Point b = mesh.nodes[element.nodes[tet_edges[k][1]]].point;
+            Point mid = mesh.nodes[element.nodes[4 + k]].point;
+            EXPECT_NEAR(0, (a + (b - a) / 2 - mid).magnitude(), 1e-12);
+        }
+    }
+}
+
+} /* namespace os2cx */
@@ -0,0 +1,85 @@
+#include <gtest/gtest.h>
+
+#include "mesh_quality.hpp"
+
+namespace os2cx {
+
+/* Adds one element of the given type, with its corners at 'corners' and its
+edge nodes (if any) at the midpoints of the straight edges between them. */
+static void add_element(
+    Mesh3 *mesh,
+    ElementType type,
+    const std::vector<Point> &corners
+) {
+    const ElementTypeShape &shape = element_type_shape(type);
+    const ElementTypeShape &linear_shape = element_type_shape(
+        shape.category == ElementTypeShape::Category::Tetrahedron
+        ? ElementType::C3D4 : ElementType::C3D8);
+    Element3 element;
+    element.type = type;
+    for (int i = 0; i < static_cast<int>(shape.vertices.size()); ++i) {
+        double sf[ElementTypeShape::max_vertices_per_element];
+        linear_shape.shape_functions(shape.vertices[i].uvw, sf);
+        Vector point = Vector::zero();
+        for (int j = 0; j < static_cast<int>(corners.size()); ++j) {
+            point += (corners[j] - Point::origin()) * sf[j];
+        }
+        Node3 node;
+        node.point = Point::origin() + point;
+        element.nodes[i] = mesh->nodes.push_back(node);
+    }
+    mesh->elements.push_back(element);
+}
+
+TEST(MeshQualityTest, RegularTetrahedron) {
+    Mesh3 mesh;
+    add_element(&mesh, ElementType::C3D10, {
+        Point(1, 1, 1), Point(-1, 1, -1), Point(1, -1, -1), Point(-1, -1, 1)});
+    MeshQuality quality = compute_mesh_quality(mesh);
+    const ElementQuality &q = quality.elements[mesh.elements.key_begin()];
+    EXPECT_NEAR(1, q.radius_ratio, 1e-9);
+    EXPECT_NEAR(acos(1 / 3.0), q.min_dihedral_angle, 1e-9);
+    EXPECT_NEAR(1, q.jacobian_ratio, 1e-9);
+}
+
+TEST(MeshQualityTest, CubeAndSliver) {
+    Mesh3 mesh;
+    add_element(&mesh, ElementType::C3D8, {
+        Point(0, 0, 0), Point(1, 0, 0), Point(1, 1, 0), Point(0, 1, 0),
+        Point(0, 0, 1), Point(1, 0, 1), Point(1, 1, 1), Point(0, 1, 1)});
+    /* Four nearly coplanar points */
+    add_element(&mesh, ElementType::C3D4, {
+        Point(0, 0, 0), Point(1, 0, 0.01), Point(1, 1, 0), Point(0, 1, 0.01)});
+    MeshQuality quality = compute_mesh_quality(mesh);
+
+    ElementId cube = mesh.elements.key_begin();
+    ElementId sliver = ElementId::from_int(cube.to_int() + 1);
+    EXPECT_TRUE(std::isnan(quality.elements[cube].radius_ratio));
+    EXPECT_NEAR(M_PI / 2, quality.elements[cube].min_dihedral_angle, 1e-9);
+    EXPECT_NEAR(1, quality.elements[cube].jacobian_ratio, 1e-9);
+    EXPECT_LT(quality.elements[sliver].radius_ratio, 0.1);
+    EXPECT_LT(quality.elements[sliver].min_dihedral_angle, 0.1);
+
+    /* The cube has no radius ratio, so only the sliver is counted */
+    EXPECT_EQ(1, quality.radius_ratio.count);
+    EXPECT_EQ(1, quality.radius_ratio.histogram[0]);
+    EXPECT_EQ(2, quality.min_dihedral_angle.count);
+    EXPECT_EQ(1, quality.min_dihedral_angle.histogram[0]);
+    EXPECT_EQ(1, quality.min_dihedral_angle.histogram.back());
+    ASSERT_EQ(2u, quality.min_dihedral_angle.worst_elements.size());
+    EXPECT_EQ(sliver, quality.min_dihedral_angle.worst_elements[0]);
+    EXPECT_FALSE(quality.describe().empty());
+}
+
+TEST(MeshQualityTest, DistortedBrick) {
+    Mesh3 mesh;
+    /* A brick with one corner pushed most of the way towards the opposite
+    corner, so the Jacobian varies a lot across the element */
+    add_element(&mesh, ElementType::C3D8, {
+        Point(0, 0, 0), Point(1, 0, 0), Point(1, 1, 0), Point(0, 1, 0),
+        Point(0, 0, 1), Point(1, 0, 1), Point(0.2, 0.2, 0.2), Point(0, 1, 1)});
+    MeshQuality quality = compute_mesh_quality(mesh);
+    EXPECT_LT(quality.elements[mesh.elements.key_begin()].jacobian_ratio, 0.5);
+}
+
+} /* namespace os2cx */
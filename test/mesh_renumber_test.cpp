@@ -0,0 +1,88 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <set>
+
+#include "mesh_renumber.hpp"
+
+namespace os2cx {
+
+/* A block of n*n*n C3D8 bricks whose nodes are numbered in a scrambled order,
+as if they came out of a mesher that doesn't care about locality */
+static Mesh3 make_scrambled_block(int n) {
+    Mesh3 mesh;
+    int m = n + 1;
+    std::vector<int> order(m * m * m);
+    for (int i = 0; i < static_cast<int>(order.size()); ++i) {
+        order[i] = (i * 7919) % order.size();
+    }
+    std::vector<NodeId> node_ids(order.size());
+    for (int index : order) {
+        Node3 node;
+        node.point = Point(index % m, (index / m) % m, index / (m * m));
+        node_ids[index] = mesh.nodes.push_back(node);
+    }
+    for (int z = 0; z < n; ++z) {
+        for (int y = 0; y < n; ++y) {
+            for (int x = 0; x < n; ++x) {
+                Element3 element;
+                element.type = ElementType::C3D8;
+                const ElementTypeShape &shape =
+                    element_type_shape(element.type);
+                for (int i = 0; i < 8; ++i) {
+                    const Point &uvw = shape.vertices[i].uvw;
+                    int index = (x + (uvw.x > 0)) + (y + (uvw.y > 0)) * m
+                        + (z + (uvw.z > 0)) * m * m;
+                    element.nodes[i] = node_ids[index];
+                }
+                mesh.elements.push_back(element);
+            }
+        }
+    }
+    return mesh;
+}
+
+TEST(MeshRenumberTest, ReducesProfile) {
+    for (RenumberMethod method : {RenumberMethod::ReverseCuthillMcKee,
+            RenumberMethod::Hilbert}) {
+        Mesh3 original = make_scrambled_block(6);
+        Mesh3 mesh = original;
+        MeshRenumbering renumbering = MeshRenumbering::identity(mesh);
+        compute_mesh_renumbering(
+            mesh,
+            mesh.nodes.key_begin(), mesh.nodes.key_end(),
+            mesh.elements.key_begin(), mesh.elements.key_end(),
+            method, &renumbering);
+        apply_mesh_renumbering(renumbering, &mesh);
+
+        /* Every node and element has moved to exactly one new ID */
+        std::set<NodeId> new_node_ids;
+        for (NodeId nid = original.nodes.key_begin();
+                nid != original.nodes.key_end(); ++nid) {
+            new_node_ids.insert(renumbering.nodes[nid]);
+            EXPECT_EQ(original.nodes[nid].point,
+                mesh.nodes[renumbering.nodes[nid]].point);
+        }
+        EXPECT_EQ(original.nodes.size(), new_node_ids.size());
+        std::set<ElementId> new_element_ids;
+        for (ElementId eid = original.elements.key_begin();
+                eid != original.elements.key_end(); ++eid) {
+            ElementId new_eid = renumbering.elements[eid];
+            new_element_ids.insert(new_eid);
+            ConstElement3Ref element = original.elements[eid];
+            ConstElement3Ref new_element = mesh.elements[new_eid];
+            for (int i = 0; i < element.num_nodes(); ++i) {
+                EXPECT_EQ(renumbering.nodes[element.nodes[i]],
+                    new_element.nodes[i]);
+            }
+        }
+        EXPECT_EQ(original.elements.size(), new_element_ids.size());
+
+        MeshProfile before = compute_mesh_profile(original);
+        MeshProfile after = compute_mesh_profile(mesh);
+        EXPECT_LT(after.bandwidth, before.bandwidth);
+        EXPECT_LT(after.profile, before.profile / 2);
+    }
+}
+
+} /* namespace os2cx */
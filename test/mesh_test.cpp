@@ -19,6 +19,125 @@ Mesh3 make_example_mesh(ElementType type, AffineTransform transform) {
     return mesh;
 }
 
+TEST(MeshTest, Element3Store) {
+    /* Elements of different sizes are packed next to each other, and can be
+    modified in place without disturbing their neighbors */
+    Element3Store store(ElementId::from_int(1));
+    std::vector<Element3> originals;
+    int next_node = 1;
+    for (ElementType type : {ElementType::C3D20, ElementType::C3D4,
+            ElementType::C3D6, ElementType::C3D10}) {
+        const ElementTypeShape &shape = element_type_shape(type);
+        Element3 element;
+        element.type = type;
+        for (int i = 0; i < static_cast<int>(shape.vertices.size()); ++i) {
+            element.nodes[i] = NodeId::from_int(next_node++);
+        }
+        element.attrs.set(originals.size());
+        for (int f = 0; f < static_cast<int>(shape.faces.size()); ++f) {
+            element.face_attrs[f].set(f);
+        }
+        EXPECT_EQ(ElementId::from_int(1 + originals.size()),
+            store.push_back(element));
+        originals.push_back(element);
+    }
+    ASSERT_EQ(4, store.size());
+
+    /* The first element's attrs are the same as its face 0 attrs, so they're
+    interned as the same set */
+    EXPECT_EQ(store.attr_set_id(ElementId::from_int(1)),
+        store.face_attr_set_id(ElementId::from_int(1), 0));
+
+    Element3Ref tet = store[ElementId::from_int(2)];
+    tet.nodes[3] = NodeId::from_int(100);
+    AttrBitset attrs = tet.attrs;
+    store.set_attrs(ElementId::from_int(2), attrs.set(10));
+    store.set_face_attrs(ElementId::from_int(2), 3, AttrBitset());
+    originals[1].nodes[3] = NodeId::from_int(100);
+    originals[1].attrs.set(10);
+    originals[1].face_attrs[3].reset();
+
+    const Element3Store &const_store = store;
+    int index = 0;
+    for (ConstElement3Ref element : const_store) {
+        const Element3 &original = originals[index++];
+        const ElementTypeShape &shape = element_type_shape(original.type);
+        EXPECT_EQ(original.type, element.type);
+        for (int i = 0; i < static_cast<int>(shape.vertices.size()); ++i) {
+            EXPECT_EQ(original.nodes[i], element.nodes[i]);
+        }
+        EXPECT_EQ(original.attrs, element.attrs);
+        for (int f = 0; f < static_cast<int>(shape.faces.size()); ++f) {
+            EXPECT_EQ(original.face_attrs[f], element.face_attrs[f]);
+        }
+    }
+    EXPECT_EQ(4, index);
+}
+
+TEST(MeshTest, Element3StoreDefaultOffset) {
+    Element3Store store;
+    EXPECT_EQ(ElementId::from_int(0), store.key_begin());
+    Element3 element;
+    element.type = ElementType::C3D4;
+    for (int i = 0; i < 4; ++i) {
+        element.nodes[i] = NodeId::from_int(i + 1);
+    }
+    EXPECT_EQ(ElementId::from_int(0), store.push_back(element));
+    EXPECT_EQ(ElementId::from_int(1), store.key_end());
+}
+
+TEST(MeshTest, AppendMeshMove) {
+    /* Moving meshes into a combined mesh gives the same result as copying
+    them, even though each part has its own attr sets */
+    std::vector<Mesh3> parts;
+    parts.push_back(make_example_mesh(
+        ElementType::C3D20, AffineTransform(Matrix::identity())));
+    parts.push_back(make_example_mesh(
+        ElementType::C3D4, AffineTransform(Matrix::identity())));
+    parts[0].elements.set_attrs(
+        parts[0].elements.key_begin(), AttrBitset().set(1));
+    parts[1].elements.set_face_attrs(
+        parts[1].elements.key_begin(), 2, AttrBitset().set(2));
+
+    Mesh3 copied, moved;
+    std::vector<const Mesh3 *> part_pointers;
+    for (const Mesh3 &part : parts) {
+        part_pointers.push_back(&part);
+    }
+    moved.reserve_for_append(part_pointers);
+    for (Mesh3 &part : parts) {
+        MeshIdMapping copied_mapping, moved_mapping;
+        copied.append_mesh(part, &copied_mapping);
+        NodeId node_begin = part.nodes.key_begin();
+        moved.append_mesh(std::move(part), &moved_mapping);
+        EXPECT_EQ(copied_mapping.convert_node_id(node_begin),
+            moved_mapping.convert_node_id(node_begin));
+        EXPECT_EQ(0, part.nodes.size());
+        EXPECT_EQ(0, part.elements.size());
+    }
+
+    ASSERT_EQ(copied.nodes.size(), moved.nodes.size());
+    for (NodeId node_id = copied.nodes.key_begin();
+            node_id != copied.nodes.key_end(); ++node_id) {
+        EXPECT_EQ(copied.nodes[node_id].point, moved.nodes[node_id].point);
+    }
+    ASSERT_EQ(2, moved.elements.size());
+    for (ElementId element_id = copied.elements.key_begin();
+            element_id != copied.elements.key_end(); ++element_id) {
+        ConstElement3Ref expected = copied.elements[element_id];
+        ConstElement3Ref element = moved.elements[element_id];
+        ASSERT_EQ(expected.type, element.type);
+        for (int i = 0; i < expected.num_nodes(); ++i) {
+            EXPECT_EQ(expected.nodes[i], element.nodes[i]);
+        }
+        EXPECT_EQ(expected.attrs, element.attrs);
+        const ElementTypeShape &shape = element_type_shape(element.type);
+        for (int f = 0; f < static_cast<int>(shape.faces.size()); ++f) {
+            EXPECT_EQ(expected.face_attrs[f], element.face_attrs[f]);
+        }
+    }
+}
+
 TEST(MeshTest, VolumeC3D8) {
     Mesh3 mesh = make_example_mesh(
         ElementType::C3D8,
@@ -59,6 +178,39 @@ TEST(MeshTest, VolumeTransform) {
     EXPECT_FLOAT_EQ(1/6.0, mesh2.volume(*mesh2.elements.begin()));
 }
 
+TEST(MeshTest, VolumesForNodes) {
+    /* The per-node volumes add up to the volume, and weighting the vertices by
+    them gives the center of mass */
+    AffineTransform transform(Matrix::scale(3, 4, 5), Vector(1, 2, 3));
+    for (ElementType type : {ElementType::C3D4, ElementType::C3D10,
+            ElementType::C3D8, ElementType::C3D20, ElementType::C3D20R,
+            ElementType::C3D6, ElementType::C3D15}) {
+        Mesh3 mesh = make_example_mesh(type, transform);
+        ConstElement3Ref element = *mesh.elements.begin();
+        Volume volumes[ElementTypeShape::max_vertices_per_element];
+        mesh.volumes_for_nodes(element, volumes);
+        Volume total = 0;
+        for (int i = 0; i < element.num_nodes(); ++i) {
+            total += volumes[i];
+        }
+        EXPECT_NEAR(mesh.volume(element), total, 1e-12);
+
+        Mesh3 reference = make_example_mesh(
+            type, AffineTransform(Matrix::identity()));
+        Point reference_center, center;
+        Volume reference_volume, volume;
+        reference.center_of_mass(
+            *reference.elements.begin(), &reference_center,
+            &reference_volume);
+        mesh.center_of_mass(element, &center, &volume);
+        EXPECT_NEAR(60 * reference_volume, volume, 1e-12);
+        Point expected_center = transform.apply(reference_center);
+        EXPECT_NEAR(expected_center.x, center.x, 1e-12);
+        EXPECT_NEAR(expected_center.y, center.y, 1e-12);
+        EXPECT_NEAR(expected_center.z, center.z, 1e-12);
+    }
+}
+
 TEST(MeshTest, AreaRectangle4) {
     Mesh3 mesh = make_example_mesh(
         ElementType::C3D8,
@@ -117,4 +269,61 @@ TEST(MeshTest, AreaTransform) {
     EXPECT_FLOAT_EQ(-1/2.0*cos(1.23), area2.z);
 }
 
+TEST(MeshTest, AppendMirrorImage) {
+    for (ElementType type : {ElementType::C3D4, ElementType::C3D10,
+            ElementType::C3D8, ElementType::C3D20, ElementType::C3D6,
+            ElementType::C3D15}) {
+        Mesh3 mesh = make_example_mesh(
+            type, AffineTransform(Matrix::identity()));
+        const ElementTypeShape &shape = element_type_shape(type);
+        ElementId original = mesh.elements.key_begin();
+        mesh.elements.set_face_attrs(original, 0, AttrBitset().set(1));
+
+        /* Mirror in the plane X=1; the nodes that are on it stay shared */
+        std::set<NodeId> plane_nodes;
+        for (NodeId node_id = mesh.nodes.key_begin();
+                node_id != mesh.nodes.key_end(); ++node_id) {
+            if (mesh.nodes[node_id].point.x == 1) {
+                plane_nodes.insert(node_id);
+            }
+        }
+        NodeId original_end = mesh.nodes.key_end();
+        ContiguousMap<NodeId, NodeId> sources =
+            mesh.append_mirror_image(Dimension::X, 1, plane_nodes);
+
+        EXPECT_EQ(2 * shape.vertices.size() - plane_nodes.size(),
+            mesh.nodes.size());
+        ASSERT_EQ(2, mesh.elements.size());
+        for (NodeId node_id = mesh.nodes.key_begin();
+                node_id != mesh.nodes.key_end(); ++node_id) {
+            if (node_id < original_end) {
+                EXPECT_EQ(node_id, sources[node_id]);
+                continue;
+            }
+            Point point = mesh.nodes[node_id].point;
+            Point source = mesh.nodes[sources[node_id]].point;
+            EXPECT_EQ(2 - source.x, point.x);
+            EXPECT_EQ(source.y, point.y);
+            EXPECT_EQ(source.z, point.z);
+        }
+
+        ConstElement3Ref image =
+            mesh.elements[ElementId::from_int(original.to_int() + 1)];
+        EXPECT_FLOAT_EQ(
+            mesh.volume(mesh.elements[original]), mesh.volume(image));
+        int num_marked_faces = 0;
+        for (int i = 0; i < static_cast<int>(shape.faces.size()); ++i) {
+            if (!image.face_attrs[i][1]) continue;
+            ++num_marked_faces;
+            /* The attrs moved to the mirror image of face 0 */
+            Vector area = mesh.oriented_area(mesh.elements[original], 0);
+            Vector image_area = mesh.oriented_area(image, i);
+            EXPECT_NEAR(-area.x, image_area.x, 1e-12);
+            EXPECT_NEAR(area.y, image_area.y, 1e-12);
+            EXPECT_NEAR(area.z, image_area.z, 1e-12);
+        }
+        EXPECT_EQ(1, num_marked_faces);
+    }
+}
+
 } /* namespace os2cx */
@@ -106,6 +106,23 @@ public:
                 + (coeffs[2][2][0] + coeffs[0][2][2] + coeffs[2][0][2]) / 1260
                 + (coeffs[2][2][1] + coeffs[1][2][2] + coeffs[2][1][2]) / 10080
                 + coeffs[2][2][2] / 45360;
+        } else if (category == ElementTypeShape::Category::Wedge) {
+            /* The integral of u^pu * v^pv over the triangle is
+            pu! * pv! / (pu + pv + 2)!, and of w^pw from -1 to 1 is
+            2 / (pw + 1) if pw is even */
+            static const double factorial[7] = {1, 1, 2, 6, 24, 120, 720};
+            double total = 0;
+            for (int pu = 0; pu <= 2; ++pu) {
+                for (int pv = 0; pv <= 2; ++pv) {
+                    for (int pw = 0; pw <= 2; pw += 2) {
+                        total += coeffs[pu][pv][pw]
+                            * factorial[pu] * factorial[pv]
+                            / factorial[pu + pv + 2]
+                            * 2 / (pw + 1);
+                    }
+                }
+            }
+            return total;
         } else {
             assert(false);
         }
@@ -137,6 +154,10 @@ void check_element_type_shape(const ElementTypeShape &shape) {
             u = rand_float(0, 1);
             v = rand_float(0, u);
             w = rand_float(0, v);
+        } else if (shape.category == ElementTypeShape::Category::Wedge) {
+            u = rand_float(0, 1);
+            v = rand_float(0, 1 - u);
+            w = rand_float(-1, 1);
         } else {
             assert(false);
         }
@@ -172,5 +193,11 @@ TEST(MeshTypeInfoTest, C3D4) {
 TEST(MeshTypeInfoTest, C3D10) {
     check_element_type_shape(element_type_shape(ElementType::C3D10));
 }
+TEST(MeshTypeInfoTest, C3D6) {
+    check_element_type_shape(element_type_shape(ElementType::C3D6));
+}
+TEST(MeshTypeInfoTest, C3D15) {
+    check_element_type_shape(element_type_shape(ElementType::C3D15));
+}
 
 } /* namespace os2cx */
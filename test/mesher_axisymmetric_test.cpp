@@ -0,0 +1,68 @@
+#include <gtest/gtest.h>
+
+#include "mesher_axisymmetric.hpp"
+#include "plc_nef_to_plc.hpp"
+
+namespace os2cx {
+
+/* Checks that every revolved element came out right side out, and returns
+their total volume */
+static Volume revolved_volume(const Mesh3 &mesh) {
+    Volume volume = 0;
+    for (ConstElement3Ref element : mesh.elements) {
+        Volume element_volume = mesh.volume(element);
+        EXPECT_LT(0, element_volume);
+        volume += element_volume;
+    }
+    return volume;
+}
+
+TEST(MesherAxisymmetricTest, Box) {
+    /* The meridional section of this box is the rectangle 0<=X<=1, 0<=Z<=0.5,
+    and it's revolved by 2 degrees */
+    Plc3 plc = plc_nef_to_plc(PlcNef3::from_poly(Poly3::from_box(
+        Box(-1, -1, 0, 1, 1, 0.5))));
+    for (ElementType element_type : {ElementType::C3D8, ElementType::C3D15}) {
+        Mesh3 mesh = mesher_axisymmetric(
+            plc, 0.2, AttrOverrides<MaxElementSize>(), element_type);
+        /* The revolved elements have straight edges, so they're slightly
+        smaller than the true sector */
+        double sector_volume = 0.5 * 0.5 * (2 * M_PI / 180);
+        EXPECT_NEAR(sector_volume, revolved_volume(mesh), 1e-3 * sector_volume);
+
+        ContiguousMap<NodeId, NodeId> meridian_nodes =
+            compute_axisymmetric_meridian_nodes(mesh);
+        for (NodeId node_id = mesh.nodes.key_begin();
+                node_id != mesh.nodes.key_end(); ++node_id) {
+            NodeId meridian_node_id = meridian_nodes[node_id];
+            ASSERT_NE(NodeId::invalid(), meridian_node_id);
+            Point point = mesh.nodes[node_id].point;
+            Point meridian_point = mesh.nodes[meridian_node_id].point;
+            EXPECT_EQ(0, meridian_point.y);
+            EXPECT_NEAR(meridian_point.x, hypot(point.x, point.y), 1e-12);
+            EXPECT_EQ(meridian_point.z, point.z);
+        }
+    }
+}
+
+TEST(MesherAxisymmetricTest, ElementNames) {
+    for (const char *name : {"CAX3", "CAX4", "CAX6", "CAX8", "CAX8R"}) {
+        EXPECT_EQ(name, axisymmetric_element_name(
+            axisymmetric_element_type_from_string(name)));
+    }
+    EXPECT_THROW(axisymmetric_element_type_from_string("CAX8RI"),
+        std::domain_error);
+    EXPECT_THROW(axisymmetric_element_name(ElementType::C3D4),
+        std::domain_error);
+}
+
+TEST(MesherAxisymmetricTest, RejectsBodyOffTheHalfPlane) {
+    Plc3 plc = plc_nef_to_plc(PlcNef3::from_poly(Poly3::from_box(
+        Box(-1, 1, 0, 1, 2, 0.5))));
+    EXPECT_THROW(
+        mesher_axisymmetric(plc, 0.2, AttrOverrides<MaxElementSize>(),
+            ElementType::C3D8),
+        AxisymmetricError);
+}
+
+} /* namespace os2cx */
@@ -112,7 +112,7 @@ Vector transform_vector(const Vector &v, int t) {
     return v3;
 }
 
-Box element_to_box(const Mesh3 &mesh, const Element3 &element) {
+Box element_to_box(const Mesh3 &mesh, ConstElement3Ref element) {
     Point p[20];
     for (int i = 0; i < element.num_nodes(); ++i) {
         p[i] = mesh.nodes[element.nodes[i]].point;
@@ -174,7 +174,7 @@ void try_mnb(
     }
     std::set<Box, BoxLess> unmatched_boxes = expected_boxes;
 
-    for (const Element3 &element : mesh.elements) {
+    for (ConstElement3Ref element : mesh.elements) {
         ASSERT_EQ(element_type, element.type);
         Box box = element_to_box(mesh, element);
         if (expected_boxes.count(box)) {
@@ -246,6 +246,24 @@ TEST(MesherNaiveBricksTest, SingleBrickSecondOrder) {
     );
 }
 
+TEST(MesherNaiveBricksTest, TallColumnSharesNodes) {
+    /* Enough Z-intervals that the mesher splits them into several chunks; the
+    chunks must share the nodes on the planes where they meet */
+    PlcNef3 example = PlcNef3::from_poly(Poly3::from_box(
+        Box(0, 0, 0, 1, 1, 64)));
+    Plc3 plc = plc_nef_to_plc(example);
+    Mesh3 mesh = mesher_naive_bricks(plc, 1.0, 1, ElementType::C3D20);
+    EXPECT_EQ(64, mesh.elements.size());
+    EXPECT_EQ(65 * 8 + 64 * 4, mesh.nodes.size());
+    for (ElementId eid = mesh.elements.key_begin();
+            eid != mesh.elements.key_end(); ++eid) {
+        /* Bricks are created bottom to top */
+        ConstElement3Ref element = mesh.elements[eid];
+        EXPECT_EQ(eid.to_int() - mesh.elements.key_begin().to_int(),
+            mesh.nodes[element.nodes[0]].point.z);
+    }
+}
+
 std::vector<Box> two_bricks_in({
     Box(0, 0, 0, 1, 1, 1),
     Box(2, 0, 0, 3, 1, 1)
@@ -439,7 +457,7 @@ void try_mnb_attr(int transform) {
     int face1 = unit_vector_to_brick_face_index(vector_external);
     int face2 = unit_vector_to_brick_face_index(vector_internal);
 
-    for (const Element3 &element : mesh.elements) {
+    for (ConstElement3Ref element : mesh.elements) {
         Box box = element_to_box(mesh, element);
         if (box == transform_box(Box(0, 0, 0, 1, 1, 1), transform)) {
             ASSERT_EQ(attr_solid|attr_volume,
@@ -0,0 +1,98 @@
+#include <gtest/gtest.h>
+
+#include <set>
+
+#include "mesher_octree_bricks.hpp"
+#include "plc_nef_to_plc.hpp"
+
+namespace os2cx {
+
+/* Returns the total volume of the bricks computed from their opposite corners,
+which only adds up to the volume of the solid if every brick is axis-aligned */
+static Volume total_brick_volume(const Mesh3 &mesh) {
+    Volume volume = 0;
+    for (ConstElement3Ref element : mesh.elements) {
+        LengthVector diagonal = mesh.nodes[element.nodes[6]].point
+            - mesh.nodes[element.nodes[0]].point;
+        volume += diagonal.x * diagonal.y * diagonal.z;
+    }
+    return volume;
+}
+
+/* Checks that the equations hold for the displacement field u(p) = p, which
+every brick can represent exactly, and that they only refer to nodes that
+aren't hanging themselves. */
+static void check_equations(
+    const Mesh3 &mesh,
+    const std::vector<LinearEquation> &equations
+) {
+    ASSERT_EQ(0, equations.size() % 3);
+    std::set<NodeId> hanging_nodes;
+    for (const LinearEquation &equation : equations) {
+        for (const auto &term : equation.terms) {
+            if (term.second == 1) {
+                hanging_nodes.insert(term.first.node_id);
+            }
+        }
+    }
+    EXPECT_EQ(equations.size() / 3, hanging_nodes.size());
+
+    for (const LinearEquation &equation : equations) {
+        double sum = 0;
+        for (const auto &term : equation.terms) {
+            Point point = mesh.nodes[term.first.node_id].point;
+            sum += term.second * point.at(term.first.dimension);
+            if (term.second != 1) {
+                EXPECT_EQ(0, hanging_nodes.count(term.first.node_id));
+            }
+        }
+        EXPECT_NEAR(0, sum, 1e-12);
+    }
+}
+
+TEST(MesherOctreeBricksTest, UniformBox) {
+    Plc3 plc = plc_nef_to_plc(PlcNef3::from_poly(Poly3::from_box(
+        Box(0, 0, 0, 1, 2, 4))));
+    std::vector<LinearEquation> equations;
+    Mesh3 mesh = mesher_octree_bricks(
+        plc, 1, AttrOverrides<MaxElementSize>(), nullptr,
+        ElementType::C3D8, &equations);
+    EXPECT_EQ(8, mesh.elements.size());
+    EXPECT_EQ(2 * 3 * 5, mesh.nodes.size());
+    EXPECT_EQ(0, equations.size());
+    EXPECT_NEAR(8, total_brick_volume(mesh), 1e-12);
+}
+
+TEST(MesherOctreeBricksTest, RefinesNearVertex) {
+    for (ElementType element_type : {ElementType::C3D8, ElementType::C3D20}) {
+        Plc3 plc = plc_nef_to_plc(PlcNef3::from_poly(Poly3::from_box(
+            Box(0, 0, 0, 1, 1, 1))));
+        std::vector<Length> vertex_sizes(plc.vertices.size(), 1);
+        for (int i = 0; i < static_cast<int>(plc.vertices.size()); ++i) {
+            if (plc.vertices[i].point == Point(0, 0, 0)) {
+                vertex_sizes[i] = 0.1;
+            }
+        }
+        std::vector<LinearEquation> equations;
+        Mesh3 mesh = mesher_octree_bricks(
+            plc, 1, AttrOverrides<MaxElementSize>(), &vertex_sizes,
+            element_type, &equations);
+
+        /* Small bricks at the origin, large ones at the far corner */
+        double min_size = 1, max_size = 0;
+        for (ConstElement3Ref element : mesh.elements) {
+            Point p0 = mesh.nodes[element.nodes[0]].point;
+            Point p6 = mesh.nodes[element.nodes[6]].point;
+            min_size = std::min(min_size, p6.x - p0.x);
+            max_size = std::max(max_size, p6.x - p0.x);
+        }
+        EXPECT_LE(min_size, 0.1);
+        EXPECT_GE(max_size, 0.25);
+
+        EXPECT_NEAR(1, total_brick_volume(mesh), 1e-12);
+        EXPECT_LT(0, equations.size());
+        check_equations(mesh, equations);
+    }
+}
+
+} /* namespace os2cx */
@@ -0,0 +1,65 @@
+#include <gtest/gtest.h>
+
+#include "mesher_sweep.hpp"
+#include "plc_nef_to_plc.hpp"
+
+namespace os2cx {
+
+/* Checks that every swept element came out right side out, and returns their
+total volume */
+static Volume swept_volume(const Mesh3 &mesh) {
+    Volume volume = 0;
+    for (ConstElement3Ref element : mesh.elements) {
+        Volume element_volume = mesh.volume(element);
+        EXPECT_LT(0, element_volume);
+        volume += element_volume;
+    }
+    return volume;
+}
+
+TEST(MesherSweepTest, Box) {
+    Plc3 plc = plc_nef_to_plc(PlcNef3::from_poly(Poly3::from_box(
+        Box(0, 0, 0, 2, 1, 0.25))));
+    Mesh3 mesh = mesher_sweep(
+        plc, 0.5, AttrOverrides<MaxElementSize>(), 3, ElementType::C3D20R);
+    EXPECT_NEAR(0.5, swept_volume(mesh), 1e-12);
+    for (ConstElement3Ref element : mesh.elements) {
+        EXPECT_TRUE(element.type == ElementType::C3D20R ||
+            element.type == ElementType::C3D15);
+        /* Three layers, even though one would be thin enough */
+        double min_z = 1, max_z = 0;
+        for (int i = 0; i < element.num_nodes(); ++i) {
+            double z = mesh.nodes[element.nodes[i]].point.z;
+            min_z = std::min(min_z, z);
+            max_z = std::max(max_z, z);
+        }
+        EXPECT_NEAR(0.25 / 3, max_z - min_z, 1e-12);
+    }
+}
+
+TEST(MesherSweepTest, Wedges) {
+    Plc3 plc = plc_nef_to_plc(PlcNef3::from_poly(Poly3::from_box(
+        Box(0, 0, 0, 0.5, 3, 1))));
+    Mesh3 mesh = mesher_sweep(
+        plc, 0.4, AttrOverrides<MaxElementSize>(), 1, ElementType::C3D6);
+    EXPECT_NEAR(1.5, swept_volume(mesh), 1e-12);
+    for (ConstElement3Ref element : mesh.elements) {
+        EXPECT_EQ(ElementType::C3D6, element.type);
+    }
+}
+
+TEST(MesherSweepTest, RejectsNonPrism) {
+    Plc3 plc = plc_nef_to_plc(PlcNef3::from_poly(Poly3::from_box(
+        Box(0, 0, 0, 1, 1, 1))));
+    for (Plc3::Vertex &vertex : plc.vertices) {
+        if (vertex.point == Point(1, 1, 1)) {
+            vertex.point = Point(1.5, 1.5, 1.5);
+        }
+    }
+    EXPECT_THROW(
+        mesher_sweep(plc, 0.5, AttrOverrides<MaxElementSize>(), 1,
+            ElementType::C3D8),
+        SweepError);
+}
+
+} /* namespace os2cx */
@@ -0,0 +1,59 @@
+#include <gtest/gtest.h>
+
+#include "mesh_renumber.hpp"
+#include "mesher_tetgen.hpp"
+#include "plc_nef_to_plc.hpp"
+
+namespace os2cx {
+
+TEST(MesherTetgenTest, RefineAfterRenumbering) {
+    Plc3 plc = plc_nef_to_plc(PlcNef3::from_poly(Poly3::from_box(
+        Box(0, 0, 0, 2, 1, 1))));
+    Mesh3 mesh = mesher_tetgen(
+        plc, 0.5, AttrOverrides<MaxElementSize>(), nullptr,
+        ElementType::C3D10);
+
+    /* Renumbering moves the Plc3 vertices away from the first node IDs, where
+    mesher_tetgen() put them */
+    MeshRenumbering renumbering = MeshRenumbering::identity(mesh);
+    compute_mesh_renumbering(
+        mesh,
+        mesh.nodes.key_begin(), mesh.nodes.key_end(),
+        mesh.elements.key_begin(), mesh.elements.key_end(),
+        RenumberMethod::ReverseCuthillMcKee,
+        &renumbering);
+    apply_mesh_renumbering(renumbering, &mesh);
+    int num_moved = 0;
+    for (Plc3::VertexId vid = 0;
+            vid < static_cast<int>(plc.vertices.size()); ++vid) {
+        if (!(mesh.nodes[NodeId::from_int(vid)].point ==
+                plc.vertices[vid].point)) {
+            ++num_moved;
+        }
+    }
+    ASSERT_LT(0, num_moved);
+
+    /* Split the elements at one end */
+    ContiguousMap<ElementId, Volume> max_volumes(
+        mesh.elements.key_begin(), mesh.elements.key_end(), -1);
+    for (ElementId eid = mesh.elements.key_begin();
+            eid != mesh.elements.key_end(); ++eid) {
+        ConstElement3Ref element = mesh.elements[eid];
+        if (mesh.nodes[element.nodes[0]].point.x < 0.5) {
+            max_volumes[eid] = mesh.volume(element) / 4;
+        }
+    }
+    Mesh3 refined = mesher_tetgen_refine(
+        plc, mesh, max_volumes, ElementType::C3D10);
+    EXPECT_LT(mesh.elements.size(), refined.elements.size());
+
+    /* The Plc3 vertices are the first nodes again, with their attrs */
+    for (Plc3::VertexId vid = 0;
+            vid < static_cast<int>(plc.vertices.size()); ++vid) {
+        const Node3 &node = refined.nodes[NodeId::from_int(vid)];
+        EXPECT_EQ(plc.vertices[vid].point, node.point);
+        EXPECT_EQ(plc.vertices[vid].attrs, node.attrs);
+    }
+}
+
+} /* namespace os2cx */
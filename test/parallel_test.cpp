@@ -0,0 +1,78 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#include "parallel.hpp"
+
+namespace os2cx {
+
+TEST(ParallelTest, VisitsEveryIndexOnce) {
+    std::vector<int> visits(1000, 0);
+    std::vector<int> chunk_begins(1000, -1);
+    parallel_for(visits.size(), 64, [&](int begin, int end) {
+        EXPECT_EQ(0, begin % 64);
+        EXPECT_LE(end - begin, 64);
+        for (int i = begin; i < end; ++i) {
+            ++visits[i];
+            chunk_begins[i] = begin;
+        }
+    });
+    for (int i = 0; i < static_cast<int>(visits.size()); ++i) {
+        EXPECT_EQ(1, visits[i]);
+        EXPECT_EQ(i - i % 64, chunk_begins[i]);
+    }
+
+    parallel_for(0, 64, [&](int, int) {
+        ADD_FAILURE() << "should not be called for an empty range";
+    });
+}
+
+TEST(ParallelTest, RethrowsException) {
+    EXPECT_THROW(
+        parallel_for(1000, 10, [&](int begin, int) {
+            if (begin == 500) {
+                throw std::runtime_error("chunk failed");
+            }
+        }),
+        std::runtime_error);
+}
+
+TEST(ParallelTest, NestedCallsVisitEveryIndexOnce) {
+    std::vector<std::atomic<int> > visits(16 * 100);
+    for (std::atomic<int> &visit : visits) {
+        visit.store(0);
+    }
+    parallel_for(16, 1, [&](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            parallel_for(100, 7, [&](int inner_begin, int inner_end) {
+                for (int j = inner_begin; j < inner_end; ++j) {
+                    visits[i * 100 + j].fetch_add(1);
+                }
+            });
+        }
+    });
+    for (const std::atomic<int> &visit : visits) {
+        EXPECT_EQ(1, visit.load());
+    }
+}
+
+TEST(ParallelTest, LockIsExclusive) {
+    std::mutex mutex;
+    int inside = 0, max_inside = 0, total = 0;
+    parallel_for(64, 1, [&](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            std::unique_lock<std::mutex> lock = parallel_lock(&mutex);
+            max_inside = std::max(max_inside, ++inside);
+            ++total;
+            --inside;
+        }
+    });
+    EXPECT_EQ(1, max_inside);
+    EXPECT_EQ(64, total);
+}
+
+} /* namespace os2cx */
@@ -0,0 +1,122 @@
+#include <gtest/gtest.h>
+
+#include <set>
+
+#include "plc_facets.hpp"
+
+namespace os2cx {
+
+/* Builds a Plc3 with a single surface made of unit squares in the z=0 plane,
+one for each (x, y) in 'squares', each split into two triangles. */
+static Plc3 make_squares(const std::vector<std::pair<int, int> > &squares) {
+    Plc3 plc;
+    plc.volumes.resize(2);
+    plc.volume_outside = 0;
+    plc.surfaces.resize(1);
+    plc.surfaces[0].volumes[0] = 0;
+    plc.surfaces[0].volumes[1] = 1;
+    auto vertex = [&](int x, int y) {
+        Point p(x, y, 0);
+        for (int i = 0; i < static_cast<int>(plc.vertices.size()); ++i) {
+            if (plc.vertices[i].point == p) return i;
+        }
+        plc.vertices.push_back(Plc3::Vertex { p, AttrBitset() });
+        return static_cast<int>(plc.vertices.size()) - 1;
+    };
+    for (const std::pair<int, int> &sq : squares) {
+        int x = sq.first, y = sq.second;
+        int a = vertex(x, y), b = vertex(x + 1, y);
+        int c = vertex(x + 1, y + 1), d = vertex(x, y + 1);
+        plc.surfaces[0].triangles.push_back({{a, b, c}});
+        plc.surfaces[0].triangles.push_back({{a, c, d}});
+    }
+    return plc;
+}
+
+TEST(PlcFacetsTest, MergeSquare) {
+    Plc3 plc = make_squares({{0, 0}, {1, 0}});
+    std::vector<PlcPolygonFacet> facets = compute_polygon_facets(plc, 0);
+    ASSERT_EQ(1, facets.size());
+    ASSERT_EQ(1, facets[0].loops.size());
+    EXPECT_EQ(6, facets[0].loops[0].size());
+    EXPECT_EQ(0, facets[0].hole_points.size());
+}
+
+TEST(PlcFacetsTest, MergeWithHole) {
+    std::vector<std::pair<int, int> > squares;
+    for (int x = 0; x < 3; ++x) {
+        for (int y = 0; y < 3; ++y) {
+            if (x != 1 || y != 1) squares.push_back({x, y});
+        }
+    }
+    Plc3 plc = make_squares(squares);
+    std::vector<PlcPolygonFacet> facets = compute_polygon_facets(plc, 0);
+    ASSERT_EQ(1, facets.size());
+    ASSERT_EQ(2, facets[0].loops.size());
+    EXPECT_EQ(12, facets[0].loops[0].size());
+    EXPECT_EQ(4, facets[0].loops[1].size());
+    ASSERT_EQ(1, facets[0].hole_points.size());
+    Point hole = facets[0].hole_points[0];
+    EXPECT_GT(hole.x, 1);
+    EXPECT_LT(hole.x, 2);
+    EXPECT_GT(hole.y, 1);
+    EXPECT_LT(hole.y, 2);
+    EXPECT_EQ(0, hole.z);
+}
+
+TEST(PlcFacetsTest, NoOrphanedVertices) {
+    /* Every vertex of the surface must be passed to tetgen as part of some
+    facet, including the four that end up inside the merged polygon */
+    std::vector<std::pair<int, int> > squares;
+    for (int x = 0; x < 3; ++x) {
+        for (int y = 0; y < 3; ++y) {
+            squares.push_back({x, y});
+        }
+    }
+    Plc3 plc = make_squares(squares);
+    std::vector<PlcPolygonFacet> facets = compute_polygon_facets(plc, 0);
+    ASSERT_EQ(1, facets.size());
+    ASSERT_EQ(1, facets[0].loops.size());
+    EXPECT_EQ(12, facets[0].loops[0].size());
+    EXPECT_EQ(4, facets[0].interior_vertices.size());
+
+    std::set<Plc3::VertexId> emitted;
+    for (const PlcPolygonFacet &facet : facets) {
+        for (const std::vector<Plc3::VertexId> &loop : facet.loops) {
+            emitted.insert(loop.begin(), loop.end());
+        }
+        for (Plc3::VertexId vid : facet.interior_vertices) {
+            EXPECT_TRUE(emitted.insert(vid).second);
+        }
+    }
+    EXPECT_EQ(plc.vertices.size(), emitted.size());
+}
+
+TEST(PlcFacetsTest, FallBackOnPinch) {
+    /* Two squares that only touch at a corner aren't edge-connected, so they
+    become separate facets */
+    Plc3 plc = make_squares({{0, 0}, {1, 1}});
+    std::vector<PlcPolygonFacet> facets = compute_polygon_facets(plc, 0);
+    EXPECT_EQ(2, facets.size());
+
+    /* Connecting them with a ring of other squares makes one group, but its
+    boundary touches itself at (1, 1), so every triangle is kept separate */
+    plc = make_squares(
+        {{0, 0}, {-1, 0}, {-1, 1}, {-1, 2}, {0, 2}, {1, 2}, {1, 1}});
+    facets = compute_polygon_facets(plc, 0);
+    ASSERT_EQ(14, facets.size());
+    for (const PlcPolygonFacet &facet : facets) {
+        ASSERT_EQ(1, facet.loops.size());
+        EXPECT_EQ(3, facet.loops[0].size());
+    }
+}
+
+TEST(PlcFacetsTest, KeepNonCoplanarSeparate) {
+    Plc3 plc = make_squares({{0, 0}});
+    /* Lift one corner so the two triangles are no longer coplanar */
+    plc.vertices[2].point.z = 0.1;
+    std::vector<PlcPolygonFacet> facets = compute_polygon_facets(plc, 0);
+    EXPECT_EQ(2, facets.size());
+}
+
+} /* namespace os2cx */
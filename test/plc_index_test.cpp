@@ -0,0 +1,236 @@
+#include <gtest/gtest.h>
+
+#include <set>
+
+#include "plc_index.hpp"
+#include "simd.hpp"
+
+namespace os2cx {
+
+/* Returns the vertex of 'plc' at 'point', adding one if necessary */
+static Plc3::VertexId add_vertex(Plc3 *plc, Point point) {
+    for (Plc3::VertexId vid = 0;
+            vid < static_cast<int>(plc->vertices.size()); ++vid) {
+        if (plc->vertices[vid].point == point) return vid;
+    }
+    plc->vertices.push_back(Plc3::Vertex { point, AttrBitset() });
+    return plc->vertices.size() - 1;
+}
+
+/* Adds a planar quad to the given surface as two triangles, ordered so that
+their normals point into the surface's volumes[0] along 'normal'. */
+static void add_quad(
+    Plc3 *plc, Plc3::SurfaceId sid, const Point (&corners)[4], Vector normal
+) {
+    Plc3::VertexId v[4];
+    for (int i = 0; i < 4; ++i) v[i] = add_vertex(plc, corners[i]);
+    bool flip = triangle_normal(corners[0], corners[1], corners[2])
+        .dot(normal) < 0;
+    for (int t = 0; t < 2; ++t) {
+        Plc3::Surface::Triangle tri;
+        tri.vertices[0] = v[0];
+        tri.vertices[1] = v[flip ? 2 + t : 1 + t];
+        tri.vertices[2] = v[flip ? 1 + t : 2 + t];
+        plc->surfaces[sid].triangles.push_back(tri);
+    }
+}
+
+/* Adds the six faces of the box [x0,x1]*[0,1]*[0,1] to the given surface,
+except for the faces at x0 and/or x1 if 'skip_x0'/'skip_x1' are set. */
+static void add_box(
+    Plc3 *plc, Plc3::SurfaceId sid, double x0, double x1,
+    bool skip_x0, bool skip_x1
+) {
+    if (!skip_x0) {
+        add_quad(plc, sid, {{x0, 0, 0}, {x0, 1, 0}, {x0, 1, 1}, {x0, 0, 1}},
+            Vector(-1, 0, 0));
+    }
+    if (!skip_x1) {
+        add_quad(plc, sid, {{x1, 0, 0}, {x1, 1, 0}, {x1, 1, 1}, {x1, 0, 1}},
+            Vector(1, 0, 0));
+    }
+    add_quad(plc, sid, {{x0, 0, 0}, {x1, 0, 0}, {x1, 0, 1}, {x0, 0, 1}},
+        Vector(0, -1, 0));
+    add_quad(plc, sid, {{x0, 1, 0}, {x1, 1, 0}, {x1, 1, 1}, {x0, 1, 1}},
+        Vector(0, 1, 0));
+    add_quad(plc, sid, {{x0, 0, 0}, {x1, 0, 0}, {x1, 1, 0}, {x0, 1, 0}},
+        Vector(0, 0, -1));
+    add_quad(plc, sid, {{x0, 0, 1}, {x1, 0, 1}, {x1, 1, 1}, {x0, 1, 1}},
+        Vector(0, 0, 1));
+}
+
+/* Two unit cubes side by side, [0,1]*[0,1]*[0,1] and [1,2]*[0,1]*[0,1],
+sharing an internal wall at x=1. Volume 0 is the outside, volume 1 is the left
+cube, and volume 2 is the right cube. */
+static Plc3 make_two_cubes() {
+    Plc3 plc;
+    plc.volumes.resize(3);
+    plc.volume_outside = 0;
+    plc.surfaces.resize(3);
+    plc.surfaces[0].volumes[0] = 0;
+    plc.surfaces[0].volumes[1] = 1;
+    add_box(&plc, 0, 0, 1, false, true);
+    plc.surfaces[1].volumes[0] = 0;
+    plc.surfaces[1].volumes[1] = 2;
+    add_box(&plc, 1, 1, 2, true, false);
+    plc.surfaces[2].volumes[0] = 2;
+    plc.surfaces[2].volumes[1] = 1;
+    add_quad(&plc, 2, {{1, 0, 0}, {1, 1, 0}, {1, 1, 1}, {1, 0, 1}},
+        Vector(1, 0, 0));
+    return plc;
+}
+
+TEST(PlcIndexTest, VolumeContainingPoint) {
+    Plc3 plc = make_two_cubes();
+    Plc3Index index(&plc);
+
+    /* Sample a grid that includes points on the diagonal planes and in line
+    with the cubes' edges, where a ray is most likely to graze an edge. */
+    for (int xi = -2; xi <= 10; ++xi) {
+        for (int yi = -2; yi <= 6; ++yi) {
+            for (int zi = -2; zi <= 6; ++zi) {
+                Point p(
+                    xi * 0.25 + 0.125, yi * 0.25 + 0.125, zi * 0.25 + 0.125);
+                Plc3::VolumeId expected = 0;
+                if (p.y > 0 && p.y < 1 && p.z > 0 && p.z < 1) {
+                    if (p.x > 0 && p.x < 1) expected = 1;
+                    if (p.x > 1 && p.x < 2) expected = 2;
+                }
+                EXPECT_EQ(expected, index.volume_containing_point(p)) << p;
+            }
+        }
+    }
+}
+
+TEST(PlcIndexTest, VolumeContainingPointByWindingNumber) {
+    Plc3 plc = make_two_cubes();
+    Plc3Index index(&plc);
+
+    for (int xi = -2; xi <= 10; ++xi) {
+        for (int yi = -2; yi <= 6; ++yi) {
+            for (int zi = -2; zi <= 6; ++zi) {
+                Point p(
+                    xi * 0.25 + 0.125, yi * 0.25 + 0.125, zi * 0.25 + 0.125);
+                EXPECT_EQ(index.volume_containing_point(p),
+                    index.volume_containing_point_by_winding_number(p)) << p;
+            }
+        }
+    }
+}
+
+TEST(PlcIndexTest, VolumeContainingPointAtEdgesAndVertices) {
+    Plc3 plc = make_two_cubes();
+    Plc3Index index(&plc);
+
+    /* Just off the edges and corners where the internal wall meets the outer
+    walls, where rays in most directions graze an edge */
+    static const double d = 1e-7;
+    struct { Point point; Plc3::VolumeId expected; } near_cases[] = {
+        { Point(1 - d, d, d), 1 },
+        { Point(1 + d, d, d), 2 },
+        { Point(1 - d, 1 - d, 1 - d), 1 },
+        { Point(1 + d, 1 - d, 1 - d), 2 },
+        { Point(1 - d, 0.5, d), 1 },
+        { Point(1 + d, d, 0.5), 2 },
+        { Point(1, -d, -d), 0 },
+        { Point(1, 0.5, 1 + d), 0 },
+        { Point(2 + d, 1 + d, 1 + d), 0 },
+    };
+    for (const auto &c : near_cases) {
+        EXPECT_EQ(c.expected, index.volume_containing_point(c.point))
+            << c.point;
+        EXPECT_EQ(c.expected,
+            index.volume_containing_point_by_winding_number(c.point))
+            << c.point;
+    }
+
+    /* Exactly on the shared edges and vertices, any volume that touches the
+    point is acceptable, but nothing else is */
+    struct { Point point; std::set<Plc3::VolumeId> allowed; } on_cases[] = {
+        { Point(1, 0, 0), {0, 1, 2} },
+        { Point(1, 1, 1), {0, 1, 2} },
+        { Point(1, 0.5, 0), {0, 1, 2} },
+        { Point(1, 0.5, 0.5), {1, 2} },
+        { Point(0, 0, 0), {0, 1} },
+        { Point(2, 0.5, 1), {0, 2} },
+    };
+    for (const auto &c : on_cases) {
+        EXPECT_EQ(1u, c.allowed.count(index.volume_containing_point(c.point)))
+            << c.point;
+        EXPECT_EQ(1u, c.allowed.count(
+            index.volume_containing_point_by_winding_number(c.point)))
+            << c.point;
+    }
+}
+
+TEST(PlcIndexTest, SurfaceAndVertexAtPoint) {
+    Plc3 plc = make_two_cubes();
+    Plc3Index index(&plc);
+
+    EXPECT_EQ(0, index.surface_containing_point(Point(0, 0.3, 0.6)));
+    EXPECT_EQ(1, index.surface_containing_point(Point(1.5, 0.3, 1)));
+    EXPECT_EQ(2, index.surface_containing_point(Point(1, 0.3, 0.6)));
+    EXPECT_EQ(-1, index.surface_containing_point(Point(0.5, 0.5, 0.5)));
+    EXPECT_EQ(-1, index.surface_containing_point(Point(3, 0.5, 0.5)));
+
+    Plc3::VertexId corner = index.vertex_at_point(Point(2, 1, 1));
+    ASSERT_NE(-1, corner);
+    EXPECT_EQ(Point(2, 1, 1), plc.vertices[corner].point);
+    EXPECT_EQ(-1, index.vertex_at_point(Point(2, 0.5, 1)));
+}
+
+TEST(PlcIndexTest, RayHitDistance) {
+    Plc3 plc = make_two_cubes();
+    Plc3Index index(&plc);
+
+    EXPECT_NEAR(0.75, index.ray_hit_distance(
+        Point(0.25, 0.5, 0.5), Vector(1, 0, 0)), 1e-9);
+    /* Starting on a surface, that surface is ignored */
+    EXPECT_NEAR(1, index.ray_hit_distance(
+        Point(1, 0.5, 0.5), Vector(2, 0, 0)), 1e-9);
+    EXPECT_NEAR(1, index.ray_hit_distance(
+        Point(0.5, 0.5, 0), Vector(0, 0, 1)), 1e-9);
+    EXPECT_EQ(HUGE_VAL, index.ray_hit_distance(
+        Point(0.5, 0.5, 1), Vector(0, 0, 1)));
+}
+
+TEST(PlcIndexTest, ClassifyPointsMatchesSingleQueries) {
+    Plc3 plc = make_two_cubes();
+    Plc3Index index(&plc);
+
+    std::vector<Point> points;
+    for (int j = 0; j < 2000; ++j) {
+        points.push_back(Point(
+            (j % 23) * 0.1 - 0.05, (j % 13) * 0.1 - 0.05, (j % 7) * 0.2));
+    }
+    std::vector<Plc3::VolumeId> volumes;
+    std::vector<Plc3::SurfaceId> surfaces;
+    index.classify_points(points, &volumes, &surfaces);
+    ASSERT_EQ(points.size(), volumes.size());
+    ASSERT_EQ(points.size(), surfaces.size());
+    for (int j = 0; j < static_cast<int>(points.size()); ++j) {
+        EXPECT_EQ(index.volume_containing_point(points[j]), volumes[j]);
+        EXPECT_EQ(index.surface_containing_point(points[j]), surfaces[j]);
+    }
+}
+
+TEST(PlcIndexTest, ScalarBoxTestsMatchSimd) {
+    Plc3 plc = make_two_cubes();
+    Plc3Index simd_index(&plc);
+    simd_set_max_level(SimdLevel::Scalar);
+    Plc3Index scalar_index(&plc);
+    simd_set_max_level(SimdLevel::Avx2);
+
+    for (int j = 0; j < 500; ++j) {
+        Point p((j % 23) * 0.1 - 0.05, (j % 13) * 0.1 - 0.05, (j % 7) * 0.2);
+        Vector dir((j % 5) - 2, (j % 3) - 1, 1);
+        EXPECT_EQ(simd_index.volume_containing_point(p),
+            scalar_index.volume_containing_point(p)) << p;
+        EXPECT_EQ(simd_index.surface_containing_point(p),
+            scalar_index.surface_containing_point(p)) << p;
+        EXPECT_EQ(simd_index.ray_hit_distance(p, dir),
+            scalar_index.ray_hit_distance(p, dir)) << p;
+    }
+}
+
+} /* namespace os2cx */
@@ -0,0 +1,311 @@
+#include <gtest/gtest.h>
+
+#include <map>
+
+#include "plc_simplify.hpp"
+
+namespace os2cx {
+
+class PlcBuilder {
+public:
+    PlcBuilder() {
+        plc.volumes.resize(2);
+        plc.volume_outside = 0;
+        plc.surfaces.resize(1);
+        plc.surfaces[0].volumes[0] = 0;
+        plc.surfaces[0].volumes[1] = 1;
+    }
+    Plc3::VertexId vertex(Point p) {
+        auto key = std::make_tuple(p.x, p.y, p.z);
+        auto it = ids.find(key);
+        if (it != ids.end()) return it->second;
+        plc.vertices.push_back(Plc3::Vertex { p, AttrBitset() });
+        return ids[key] = plc.vertices.size() - 1;
+    }
+    /* Adds a triangle whose normal points out of the solid */
+    void triangle(Point a, Point b, Point c) {
+        plc.surfaces[0].triangles.push_back({{
+            vertex(a), vertex(b), vertex(c)}});
+    }
+    void quad(Point a, Point b, Point c, Point d) {
+        triangle(a, b, c);
+        triangle(a, c, d);
+    }
+    Plc3 plc;
+    std::map<std::tuple<double, double, double>, Plc3::VertexId> ids;
+};
+
+/* A unit cube with each face split into an n*n grid */
+static Plc3 make_grid_cube(int n) {
+    PlcBuilder b;
+    for (int axis = 0; axis < 3; ++axis) {
+        for (int side = 0; side < 2; ++side) {
+            for (int i = 0; i < n; ++i) {
+                for (int j = 0; j < n; ++j) {
+                    Point corners[4];
+                    int uv[4][2] = {{i, j}, {i + 1, j}, {i + 1, j + 1},
+                        {i, j + 1}};
+                    for (int k = 0; k < 4; ++k) {
+                        double c[3];
+                        c[axis] = side;
+                        c[(axis + 1) % 3] = uv[k][0] / double(n);
+                        c[(axis + 2) % 3] = uv[k][1] / double(n);
+                        corners[k] = Point(c[0], c[1], c[2]);
+                    }
+                    if (side == 1) {
+                        b.quad(corners[0], corners[1], corners[2], corners[3]);
+                    } else {
+                        b.quad(corners[0], corners[3], corners[2], corners[1]);
+                    }
+                }
+            }
+        }
+    }
+    return b.plc;
+}
+
+static int count_triangles(const Plc3 &plc) {
+    int count = 0;
+    for (const Plc3::Surface &surface : plc.surfaces) {
+        count += surface.triangles.size();
+    }
+    return count;
+}
+
+static double enclosed_volume(const Plc3 &plc) {
+    double volume = 0;
+    for (const Plc3::Surface &surface : plc.surfaces) {
+        for (const Plc3::Surface::Triangle &tri : surface.triangles) {
+            LengthVector a = plc.vertices[tri.vertices[0]].point
+                - Point::origin();
+            LengthVector b = plc.vertices[tri.vertices[1]].point
+                - Point::origin();
+            LengthVector c = plc.vertices[tri.vertices[2]].point
+                - Point::origin();
+            volume += a.dot(b.cross(c)) / 6;
+        }
+    }
+    return volume;
+}
+
+/* Checks that every edge is used exactly once in each direction */
+static void expect_closed(const Plc3 &plc) {
+    std::map<std::pair<int, int>, int> edges;
+    for (const Plc3::Surface &surface : plc.surfaces) {
+        for (const Plc3::Surface::Triangle &tri : surface.triangles) {
+            for (int i = 0; i < 3; ++i) {
+                ++edges[std::make_pair(
+                    tri.vertices[i], tri.vertices[(i + 1) % 3])];
+            }
+        }
+    }
+    for (const auto &pair : edges) {
+        EXPECT_EQ(1, pair.second);
+        EXPECT_EQ(1, edges.count(
+            std::make_pair(pair.first.second, pair.first.first)));
+    }
+}
+
+/* Returns the largest distance from a vertex of 'original' to 'simplified' */
+static double max_deviation(const Plc3 &original, const Plc3 &simplified) {
+    double max_dist = 0;
+    for (const Plc3::Vertex &v : original.vertices) {
+        double best = HUGE_VAL;
+        for (const Plc3::Surface &surface : simplified.surfaces) {
+            for (const Plc3::Surface::Triangle &tri : surface.triangles) {
+                Point q = closest_point_on_triangle(v.point,
+                    simplified.vertices[tri.vertices[0]].point,
+                    simplified.vertices[tri.vertices[1]].point,
+                    simplified.vertices[tri.vertices[2]].point);
+                best = std::min(best, (q - v.point).magnitude());
+            }
+        }
+        max_dist = std::max(max_dist, best);
+    }
+    return max_dist;
+}
+
+/* Returns the largest distance from a sample point of a triangle of
+'simplified' to 'original'; the reverse of max_deviation() */
+static double max_reverse_deviation(
+    const Plc3 &original, const Plc3 &simplified
+) {
+    static const int n = 4;
+    double max_dist = 0;
+    for (const Plc3::Surface &surface : simplified.surfaces) {
+        for (const Plc3::Surface::Triangle &tri : surface.triangles) {
+            Point a = simplified.vertices[tri.vertices[0]].point;
+            Point b = simplified.vertices[tri.vertices[1]].point;
+            Point c = simplified.vertices[tri.vertices[2]].point;
+            for (int i = 0; i <= n; ++i) {
+                for (int j = 0; i + j <= n; ++j) {
+                    Point p = a + (b - a) * (i / double(n))
+                        + (c - a) * (j / double(n));
+                    double best = HUGE_VAL;
+                    for (const Plc3::Surface &os : original.surfaces) {
+                        for (const Plc3::Surface::Triangle &ot :
+                                os.triangles) {
+                            Point q = closest_point_on_triangle(p,
+                                original.vertices[ot.vertices[0]].point,
+                                original.vertices[ot.vertices[1]].point,
+                                original.vertices[ot.vertices[2]].point);
+                            best = std::min(best, (q - p).magnitude());
+                        }
+                    }
+                    max_dist = std::max(max_dist, best);
+                }
+            }
+        }
+    }
+    return max_dist;
+}
+
+TEST(PlcSimplifyTest, FlatFacesCollapse) {
+    Plc3 plc = make_grid_cube(6);
+    Plc3 simple = plc_simplify(plc, 1e-6);
+    expect_closed(simple);
+    EXPECT_NEAR(1, enclosed_volume(simple), 1e-9);
+    EXPECT_LT(max_deviation(plc, simple), 1e-6);
+    EXPECT_LT(count_triangles(simple), count_triangles(plc) / 4);
+    /* The corners of the cube can never be removed */
+    EXPECT_GE(simple.vertices.size(), 8);
+}
+
+TEST(PlcSimplifyTest, CurvedSurfaceWithinTolerance) {
+    /* A dome on the top face; its rim stays on the edges of the cube */
+    Plc3 plc = make_grid_cube(16);
+    int num_dome_vertices = 0;
+    for (Plc3::Vertex &v : plc.vertices) {
+        if (v.point.z == 1 && v.point.x > 0 && v.point.x < 1 &&
+                v.point.y > 0 && v.point.y < 1) {
+            v.point.z += 1.6 * v.point.x * (1 - v.point.x)
+                * v.point.y * (1 - v.point.y);
+            ++num_dome_vertices;
+        }
+    }
+    double tolerance = 0.01;
+    Plc3 simple = plc_simplify(plc, tolerance);
+    expect_closed(simple);
+    EXPECT_LE(max_deviation(plc, simple), tolerance);
+    EXPECT_LT(count_triangles(simple), count_triangles(plc));
+
+    /* A tolerance that's smaller than the tessellation error of the dome lets
+    the flat faces collapse but not the dome */
+    Plc3 tight = plc_simplify(plc, 1e-6);
+    int num_tight_dome_vertices = 0;
+    for (const Plc3::Vertex &v : tight.vertices) {
+        if (v.point.z > 1) ++num_tight_dome_vertices;
+    }
+    EXPECT_EQ(num_dome_vertices, num_tight_dome_vertices);
+    EXPECT_LT(count_triangles(tight), count_triangles(plc));
+}
+
+TEST(PlcSimplifyTest, RippledSurfaceWithinToleranceBothWays) {
+    /* Ripples in the top face: removing a single vertex can leave it close to
+    the new triangles even though the new triangles cut across a trough */
+    Plc3 plc = make_grid_cube(16);
+    for (Plc3::Vertex &v : plc.vertices) {
+        if (v.point.z == 1 && v.point.x > 0 && v.point.x < 1 &&
+                v.point.y > 0 && v.point.y < 1) {
+            v.point.z += 0.02 * sin(4 * M_PI * v.point.x)
+                * sin(4 * M_PI * v.point.y);
+        }
+    }
+    double tolerance = 0.005;
+    Plc3 simple = plc_simplify(plc, tolerance);
+    expect_closed(simple);
+    EXPECT_LT(count_triangles(simple), count_triangles(plc));
+    EXPECT_LE(max_deviation(plc, simple), tolerance);
+    EXPECT_LE(max_reverse_deviation(plc, simple), tolerance);
+}
+
+/* Returns true if the segment from 'p' to 'q' passes through the interior of
+the triangle */
+static bool segment_crosses(Point p, Point q, Point a, Point b, Point c) {
+    Vector normal = (b - a).cross(c - a);
+    double dp = normal.dot(p - a), dq = normal.dot(q - a);
+    if ((dp > 0) == (dq > 0) || dp == 0 || dq == 0) return false;
+    Point x = p + (q - p) * (dp / (dp - dq));
+    return (b - a).cross(x - a).dot(normal) > 0 &&
+        (c - b).cross(x - b).dot(normal) > 0 &&
+        (a - c).cross(x - c).dot(normal) > 0;
+}
+
+/* Counts the pairs of triangles that don't share a vertex but intersect */
+static int count_intersections(const Plc3 &plc) {
+    std::vector<Plc3::Surface::Triangle> tris;
+    for (const Plc3::Surface &surface : plc.surfaces) {
+        tris.insert(tris.end(),
+            surface.triangles.begin(), surface.triangles.end());
+    }
+    int count = 0;
+    for (int i = 0; i < static_cast<int>(tris.size()); ++i) {
+        for (int j = i + 1; j < static_cast<int>(tris.size()); ++j) {
+            bool shared = false;
+            for (Plc3::VertexId v : tris[i].vertices) {
+                for (Plc3::VertexId w : tris[j].vertices) {
+                    if (v == w) shared = true;
+                }
+            }
+            if (shared) continue;
+            bool crosses = false;
+            for (int swap = 0; swap < 2; ++swap) {
+                const Plc3::Surface::Triangle &e = tris[swap ? j : i];
+                const Plc3::Surface::Triangle &f = tris[swap ? i : j];
+                for (int k = 0; k < 3; ++k) {
+                    crosses = crosses || segment_crosses(
+                        plc.vertices[e.vertices[k]].point,
+                        plc.vertices[e.vertices[(k + 1) % 3]].point,
+                        plc.vertices[f.vertices[0]].point,
+                        plc.vertices[f.vertices[1]].point,
+                        plc.vertices[f.vertices[2]].point);
+                }
+            }
+            if (crosses) ++count;
+        }
+    }
+    return count;
+}
+
+TEST(PlcSimplifyTest, ThinRippledPlateDoesNotSelfIntersect) {
+    /* The plate is thinner than the tolerance, so a collapse on the rippled
+    top could easily push a triangle through the flat bottom */
+    Plc3 plc = make_grid_cube(16);
+    for (Plc3::Vertex &v : plc.vertices) {
+        if (v.point.z == 1 && v.point.x > 0 && v.point.x < 1 &&
+                v.point.y > 0 && v.point.y < 1) {
+            v.point.z = 0.004 + 0.0035 * sin(2 * M_PI * v.point.x)
+                * sin(6 * M_PI * v.point.y);
+        } else {
+            v.point.z *= 0.004;
+        }
+    }
+    ASSERT_EQ(0, count_intersections(plc));
+    Plc3 simple = plc_simplify(plc, 0.005);
+    expect_closed(simple);
+    EXPECT_LT(count_triangles(simple), count_triangles(plc));
+    EXPECT_EQ(0, count_intersections(simple));
+}
+
+TEST(PlcSimplifyTest, KeepsVertexWithExtraAttrs) {
+    Plc3 plc = make_grid_cube(4);
+    Plc3::VertexId marked = -1;
+    for (Plc3::VertexId vid = 0;
+            vid < static_cast<int>(plc.vertices.size()); ++vid) {
+        if (plc.vertices[vid].point == Point(0.5, 0.5, 1)) marked = vid;
+    }
+    ASSERT_NE(-1, marked);
+    plc.vertices[marked].attrs.set(5);
+
+    Plc3 simple = plc_simplify(plc, 1e-6);
+    int found = 0;
+    for (const Plc3::Vertex &v : simple.vertices) {
+        if (v.point == Point(0.5, 0.5, 1)) {
+            ++found;
+            EXPECT_TRUE(v.attrs[5]);
+        }
+    }
+    EXPECT_EQ(1, found);
+}
+
+} /* namespace os2cx */
@@ -0,0 +1,54 @@
+#include <fstream>
+
+#include <gtest/gtest.h>
+
+#include "project_run.hpp"
+#include "util.hpp"
+
+namespace os2cx {
+
+class ProjectRunTestCallbacks : public ProjectRunCallbacks {
+public:
+    void project_run_log(const std::string &str) {
+        log.push_back(str);
+    }
+    std::vector<std::string> log;
+};
+
+TEST(ProjectRunTest, ResourceBudgetExceeded) {
+    std::ifstream file_checker("openscad2calculix.scad");
+    ASSERT_FALSE(file_checker.fail()) <<
+      "File openscad2calculix.scad not found. Tests should be run in the root os2cx/ directory.";
+    file_checker.close();
+
+    TempDir temp_dir(
+        "./test_project_runXXXXXX",
+        TempDir::AutoCleanup::Yes);
+
+    FilePath scad_path = temp_dir.path() + "/test.scad";
+    std::ofstream stream(scad_path);
+    stream << "use <../openscad2calculix.scad>;" << std::endl;
+    stream << "os2cx_material_elastic_simple(\"steel\", "
+        "youngs_modulus=[209, \"GPa\"], poissons_ratio=0.3, "
+        "density=[7.87, \"g/cm^3\"]);" << std::endl;
+    stream << "os2cx_mesh(\"m\", max_element_size=0.1, material=\"steel\") "
+        "{ cube([10, 10, 10]); }" << std::endl;
+    stream << "os2cx_resource_budget(max_elements=100);" << std::endl;
+    stream.close();
+
+    /* Without on_exceed="coarsen", exceeding the budget must be reported like
+    any other mistake in the OpenSCAD file, not thrown out of project_run() */
+    Project project(scad_path);
+    ProjectRunTestCallbacks callbacks;
+    ASSERT_NO_THROW(project_run(&project, &callbacks));
+
+    EXPECT_TRUE(project.errored);
+    EXPECT_EQ(nullptr, project.mesh);
+    ASSERT_GE(callbacks.log.size(), 2);
+    EXPECT_EQ("Error in OpenSCAD file:",
+        callbacks.log[callbacks.log.size() - 2]);
+    EXPECT_NE(std::string::npos,
+        callbacks.log.back().find("os2cx_resource_budget()"));
+}
+
+} /* namespace os2cx */
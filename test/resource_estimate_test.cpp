@@ -0,0 +1,104 @@
+#include <gtest/gtest.h>
+
+#include "resource_estimate.hpp"
+
+namespace os2cx {
+
+/* The box [0,s]^3, with its interior marked solid */
+static Plc3 make_solid_cube(double s) {
+    Plc3 plc;
+    plc.volumes.resize(2);
+    plc.volume_outside = 0;
+    plc.volumes[1].attrs.set(attr_bit_solid());
+    Point p[8];
+    for (int i = 0; i < 8; ++i) {
+        p[i] = Point((i & 1) ? s : 0, (i & 2) ? s : 0, (i & 4) ? s : 0);
+        plc.vertices.push_back(Plc3::Vertex { p[i], AttrBitset() });
+    }
+    plc.surfaces.resize(1);
+    plc.surfaces[0].volumes[0] = 0;
+    plc.surfaces[0].volumes[1] = 1;
+    /* Quads whose normals point out of the solid */
+    int quads[6][4] = {
+        {0, 2, 3, 1}, {4, 5, 7, 6}, {0, 1, 5, 4},
+        {2, 6, 7, 3}, {0, 4, 6, 2}, {1, 3, 7, 5}};
+    for (const auto &q : quads) {
+        plc.surfaces[0].triangles.push_back({{q[0], q[1], q[2]}});
+        plc.surfaces[0].triangles.push_back({{q[0], q[2], q[3]}});
+    }
+    return plc;
+}
+
+TEST(ResourceEstimateTest, BricksFillVolume) {
+    Plc3 plc = make_solid_cube(10);
+    ResourceEstimate estimate = estimate_mesh_resources(
+        plc, 1, AttrOverrides<MaxElementSize>(), nullptr, ElementType::C3D8);
+    EXPECT_NEAR(1000, estimate.num_elements, 1e-6);
+    EXPECT_NEAR(1000, estimate.num_nodes, 1e-6);
+    EXPECT_GT(estimate.mesh_bytes, 0);
+    EXPECT_GT(estimate.deck_bytes, 0);
+    EXPECT_GT(estimate.solver_bytes, 0);
+
+    /* Halving the element size gives eight times as many elements */
+    ResourceEstimate finer = estimate_mesh_resources(
+        plc, 0.5, AttrOverrides<MaxElementSize>(), nullptr, ElementType::C3D8);
+    EXPECT_NEAR(8000, finer.num_elements, 1e-6);
+    EXPECT_GT(finer.solver_bytes, 8 * estimate.solver_bytes);
+}
+
+TEST(ResourceEstimateTest, SizingFieldAndOverrides) {
+    Plc3 plc = make_solid_cube(10);
+    ResourceEstimate tets = estimate_mesh_resources(
+        plc, 1, AttrOverrides<MaxElementSize>(), nullptr, ElementType::C3D4);
+    /* Tetrahedra are smaller than cubes of the same edge length */
+    EXPECT_GT(tets.num_elements, 5000);
+    EXPECT_LT(tets.num_elements, 10000);
+
+    std::vector<Length> sizes(plc.vertices.size(), 2);
+    ResourceEstimate sized = estimate_mesh_resources(
+        plc, 1, AttrOverrides<MaxElementSize>(), &sizes, ElementType::C3D4);
+    EXPECT_NEAR(tets.num_elements / 8, sized.num_elements, 1e-6);
+
+    plc.volumes[1].attrs.set(3);
+    AttrOverrides<MaxElementSize> overrides;
+    overrides.add(3, 0.5);
+    ResourceEstimate overridden = estimate_mesh_resources(
+        plc, 1, overrides, nullptr, ElementType::C3D4);
+    EXPECT_NEAR(tets.num_elements * 8, overridden.num_elements, 1e-6);
+}
+
+TEST(ResourceEstimateTest, EveryVolumeGetsAnElement) {
+    /* Two tiny solid cubes, far smaller than the element size */
+    Plc3 plc = make_solid_cube(0.01);
+    plc.volumes.resize(3);
+    plc.volumes[2].attrs.set(attr_bit_solid());
+    int offset = plc.vertices.size();
+    for (int i = 0; i < offset; ++i) {
+        Plc3::Vertex vertex = plc.vertices[i];
+        vertex.point.x += 1;
+        plc.vertices.push_back(vertex);
+    }
+    Plc3::Surface surface = plc.surfaces[0];
+    surface.volumes[1] = 2;
+    for (Plc3::Surface::Triangle &tri : surface.triangles) {
+        for (Plc3::VertexId &vid : tri.vertices) vid += offset;
+    }
+    plc.surfaces.push_back(surface);
+
+    ResourceEstimate estimate = estimate_mesh_resources(
+        plc, 1, AttrOverrides<MaxElementSize>(), nullptr, ElementType::C3D8);
+    EXPECT_EQ(2, estimate.num_elements);
+}
+
+TEST(ResourceEstimateTest, CoarseningFactor) {
+    ResourceEstimate estimate;
+    estimate.num_elements = 8000;
+    estimate.mesh_bytes = 1e6;
+    estimate.solver_bytes = 1e6;
+    EXPECT_EQ(1, compute_coarsening_factor(estimate, 0, 0));
+    EXPECT_EQ(1, compute_coarsening_factor(estimate, 10000, 3e6));
+    EXPECT_NEAR(2, compute_coarsening_factor(estimate, 1000, 0), 1e-9);
+    EXPECT_NEAR(3, compute_coarsening_factor(estimate, 1000, 2e6 / 27), 1e-9);
+}
+
+} /* namespace os2cx */
@@ -0,0 +1,132 @@
+#include <gtest/gtest.h>
+
+#include "result.hpp"
+
+namespace os2cx {
+
+static Matrix symmetric_matrix(
+    double xx, double yy, double zz, double xy, double xz, double yz
+) {
+    Matrix m;
+    m.cols[0] = Vector(xx, xy, xz);
+    m.cols[1] = Vector(xy, yy, yz);
+    m.cols[2] = Vector(xz, yz, zz);
+    return m;
+}
+
+static void expect_matrix_near(const Matrix &expected, const Matrix &actual) {
+    for (int i = 0; i < 3; ++i) {
+        EXPECT_NEAR(expected.cols[i].x, actual.cols[i].x, 1e-12);
+        EXPECT_NEAR(expected.cols[i].y, actual.cols[i].y, 1e-12);
+        EXPECT_NEAR(expected.cols[i].z, actual.cols[i].z, 1e-12);
+    }
+}
+
+TEST(ResultTest, ExpandAxisymmetric) {
+    /* A meridian node at radius 2, and a node revolved 30 degrees from it */
+    double angle = M_PI / 6, c = cos(angle), s = sin(angle);
+    Mesh3 mesh;
+    NodeId meridian = mesh.nodes.key_end();
+    mesh.nodes.push_back(Node3 { Point(2, 0, 1), AttrBitset() });
+    NodeId revolved = mesh.nodes.key_end();
+    mesh.nodes.push_back(Node3 { Point(2 * c, 2 * s, 1), AttrBitset() });
+    ContiguousMap<NodeId, NodeId> meridian_nodes(
+        mesh.nodes.key_begin(), mesh.nodes.key_end(), meridian);
+
+    /* CalculiX reports the components in the R, Z, and hoop directions, and
+    only at the meridian */
+    double a = 1, b = 2, h = 3, t = 4;
+    Results::Result::Step step;
+    Results::Dataset &disp = step.datasets["DISP"];
+    disp.node_vector.reset(new ContiguousMap<NodeId, Vector>(
+        mesh.nodes.key_begin(), mesh.nodes.key_end(), Vector::zero()));
+    (*disp.node_vector)[meridian] = Vector(1, 2, 3);
+    Results::Dataset &stress = step.datasets["STRESS"];
+    stress.node_matrix.reset(new ContiguousMap<NodeId, Matrix>(
+        mesh.nodes.key_begin(), mesh.nodes.key_end(), Matrix::zero()));
+    (*stress.node_matrix)[meridian] = symmetric_matrix(a, b, h, t, 0, 0);
+    Results results;
+    results.results.resize(1);
+    results.results[0].type = Results::Result::Type::Static;
+    results.results[0].steps.push_back(std::move(step));
+
+    results_expand_axisymmetric(mesh, meridian_nodes, &results);
+    const Results::Result::Step &expanded = results.results[0].steps[0];
+    const ContiguousMap<NodeId, Vector> &vectors =
+        *expanded.datasets.at("DISP").node_vector;
+    const ContiguousMap<NodeId, Matrix> &matrices =
+        *expanded.datasets.at("STRESS").node_matrix;
+
+    /* At the meridian, R, Z, and hoop are X, Z, and -Y */
+    EXPECT_NEAR(1, vectors[meridian].x, 1e-12);
+    EXPECT_NEAR(-3, vectors[meridian].y, 1e-12);
+    EXPECT_NEAR(2, vectors[meridian].z, 1e-12);
+    expect_matrix_near(
+        symmetric_matrix(a, h, b, 0, t, 0),
+        matrices[meridian]);
+
+    /* Elsewhere, R is (c, s, 0) and hoop is (s, -c, 0) */
+    EXPECT_NEAR(1 * c + 3 * s, vectors[revolved].x, 1e-12);
+    EXPECT_NEAR(1 * s - 3 * c, vectors[revolved].y, 1e-12);
+    EXPECT_NEAR(2, vectors[revolved].z, 1e-12);
+    expect_matrix_near(
+        symmetric_matrix(
+            a * c * c + h * s * s,
+            a * s * s + h * c * c,
+            b,
+            (a - h) * c * s,
+            t * c,
+            t * s),
+        matrices[revolved]);
+}
+
+TEST(ResultTest, AppendMirrorImage) {
+    /* Two nodes, mirrored in a plane perpendicular to X */
+    NodeId n0 = NodeId::from_int(1), n1 = NodeId::from_int(2);
+    ContiguousMap<NodeId, NodeId> sources(n0);
+    for (NodeId source : {n0, n1, n0, n1}) {
+        sources.push_back(source);
+    }
+
+    Results::Result::Step step;
+    Results::Dataset &disp = step.datasets["DISP"];
+    disp.node_vector.reset(new ContiguousMap<NodeId, Vector>(n0));
+    disp.node_vector->push_back(Vector(1, 2, 3));
+    disp.node_vector->push_back(Vector(-4, 5, 6));
+    Results::Dataset &stress = step.datasets["STRESS"];
+    stress.node_matrix.reset(new ContiguousMap<NodeId, Matrix>(n0));
+    stress.node_matrix->push_back(symmetric_matrix(1, 2, 3, 4, 5, 6));
+    stress.node_matrix->push_back(symmetric_matrix(7, 8, 9, 10, 11, 12));
+    Results results;
+    results.results.resize(1);
+    results.results[0].type = Results::Result::Type::Static;
+    results.results[0].steps.push_back(std::move(step));
+
+    results_append_mirror_image(sources, Dimension::X, &results);
+    const Results::Result::Step &mirrored = results.results[0].steps[0];
+    const ContiguousMap<NodeId, Vector> &vectors =
+        *mirrored.datasets.at("DISP").node_vector;
+    const ContiguousMap<NodeId, Matrix> &matrices =
+        *mirrored.datasets.at("STRESS").node_matrix;
+    ASSERT_EQ(4, vectors.size());
+    ASSERT_EQ(4, matrices.size());
+
+    /* The originals are untouched */
+    EXPECT_EQ(1, vectors[n0].x);
+    EXPECT_EQ(-4, vectors[n1].x);
+    expect_matrix_near(symmetric_matrix(1, 2, 3, 4, 5, 6), matrices[n0]);
+
+    /* The images negate X, and the XY and XZ shear */
+    NodeId i0 = NodeId::from_int(3), i1 = NodeId::from_int(4);
+    EXPECT_EQ(-1, vectors[i0].x);
+    EXPECT_EQ(2, vectors[i0].y);
+    EXPECT_EQ(3, vectors[i0].z);
+    EXPECT_EQ(4, vectors[i1].x);
+    EXPECT_EQ(5, vectors[i1].y);
+    EXPECT_EQ(6, vectors[i1].z);
+    expect_matrix_near(symmetric_matrix(1, 2, 3, -4, -5, 6), matrices[i0]);
+    expect_matrix_near(
+        symmetric_matrix(7, 8, 9, -10, -11, 12), matrices[i1]);
+}
+
+} /* namespace os2cx */
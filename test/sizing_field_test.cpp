@@ -0,0 +1,140 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "sizing_field.hpp"
+
+namespace os2cx {
+
+/* A prism of height 'h' over the convex polygon 'section', which lies in the
+z=0 plane and winds counterclockwise. The caps are fanned out from the first
+corner of the polygon. */
+static Plc3 make_prism(const std::vector<Point> &section, double h) {
+    int n = section.size();
+    Plc3 plc;
+    plc.volumes.resize(2);
+    plc.volume_outside = 0;
+    plc.surfaces.resize(1);
+    plc.surfaces[0].volumes[0] = 0;
+    plc.surfaces[0].volumes[1] = 1;
+    for (const Point &p : section) {
+        plc.vertices.push_back(Plc3::Vertex { p, AttrBitset() });
+    }
+    for (const Point &p : section) {
+        plc.vertices.push_back(
+            Plc3::Vertex { Point(p.x, p.y, h), AttrBitset() });
+    }
+    std::vector<Plc3::Surface::Triangle> &triangles =
+        plc.surfaces[0].triangles;
+    for (int i = 0; i < n; ++i) {
+        int j = (i + 1) % n;
+        triangles.push_back({{i, j, n + j}});
+        triangles.push_back({{i, n + j, n + i}});
+    }
+    for (int i = 1; i + 1 < n; ++i) {
+        triangles.push_back({{0, i + 1, i}});
+        triangles.push_back({{n, n + i, n + i + 1}});
+    }
+    return plc;
+}
+
+/* The box [0,sx]*[0,sy]*[0,sz] */
+static Plc3 make_box(double sx, double sy, double sz) {
+    return make_prism(
+        {Point(0, 0, 0), Point(sx, 0, 0), Point(sx, sy, 0), Point(0, sy, 0)},
+        sz);
+}
+
+/* A cylinder of radius 'r' and height 'h' around the z axis, with 'fn' sides */
+static Plc3 make_cylinder(double r, double h, int fn) {
+    std::vector<Point> section;
+    for (int i = 0; i < fn; ++i) {
+        double a = 2 * M_PI * i / fn;
+        section.push_back(Point(r * cos(a), r * sin(a), 0));
+    }
+    return make_prism(section, h);
+}
+
+TEST(SizingFieldTest, ThickBoxUsesMaxElementSize) {
+    Plc3 plc = make_box(10, 10, 10);
+    std::vector<Length> sizes = compute_sizing_field(
+        plc, 2, AttrOverrides<MaxElementSize>(), 2);
+    ASSERT_EQ(plc.vertices.size(), sizes.size());
+    for (Length size : sizes) {
+        EXPECT_DOUBLE_EQ(2, size);
+    }
+}
+
+TEST(SizingFieldTest, ThinPlateFollowsThickness) {
+    Plc3 plc = make_box(10, 10, 0.5);
+    std::vector<Length> sizes = compute_sizing_field(
+        plc, 2, AttrOverrides<MaxElementSize>(), 2);
+    for (Length size : sizes) {
+        EXPECT_NEAR(0.25, size, 1e-9);
+    }
+
+    /* Never smaller than the fixed fraction of max_element_size */
+    sizes = compute_sizing_field(plc, 2, AttrOverrides<MaxElementSize>(), 100);
+    for (Length size : sizes) {
+        EXPECT_NEAR(0.1, size, 1e-9);
+    }
+}
+
+TEST(SizingFieldTest, OverrideLimitsSize) {
+    Plc3 plc = make_box(10, 10, 10);
+    plc.volumes[1].attrs.set(3);
+    AttrOverrides<MaxElementSize> overrides;
+    overrides.add(3, 1);
+    std::vector<Length> sizes = compute_sizing_field(plc, 2, overrides, 2);
+    for (Length size : sizes) {
+        EXPECT_DOUBLE_EQ(1, size);
+    }
+}
+
+TEST(SizingFieldTest, CurvedSurfaceRefines) {
+    Plc3 plc = make_cylinder(5, 10, 32);
+    std::vector<Length> sizes = compute_sizing_field(
+        plc, 10, AttrOverrides<MaxElementSize>(), 1);
+    for (Plc3::VertexId vid = 0;
+            vid < static_cast<int>(plc.vertices.size()); ++vid) {
+        /* About 30 degrees of arc of radius 5 */
+        EXPECT_GT(sizes[vid], 2);
+        EXPECT_LT(sizes[vid], 3);
+    }
+}
+
+TEST(SizingFieldTest, RefineNearAttrs) {
+    Plc3 plc = make_box(10, 10, 10);
+    Plc3::VertexId marked = 0;
+    plc.vertices[marked].attrs.set(5);
+    std::vector<Length> sizes = compute_sizing_field(
+        plc, 2, AttrOverrides<MaxElementSize>(), 0);
+
+    /* Attrs that nothing has leave the sizes alone */
+    AttrBitset other;
+    other.set(6);
+    refine_sizing_field_near_attrs(plc, other, 0.25, &sizes);
+    for (Length size : sizes) {
+        EXPECT_DOUBLE_EQ(2, size);
+    }
+
+    AttrBitset selected;
+    selected.set(5);
+    refine_sizing_field_near_attrs(plc, selected, 0.25, &sizes);
+    for (Plc3::VertexId vid = 0;
+            vid < static_cast<int>(plc.vertices.size()); ++vid) {
+        EXPECT_DOUBLE_EQ(vid == marked ? 0.5 : 2, sizes[vid]);
+    }
+
+    /* Selecting the whole surface refines every vertex */
+    plc.surfaces[0].attrs.set(7);
+    AttrBitset surface;
+    surface.set(7);
+    refine_sizing_field_near_attrs(plc, surface, 0.5, &sizes);
+    for (Plc3::VertexId vid = 0;
+            vid < static_cast<int>(plc.vertices.size()); ++vid) {
+        EXPECT_DOUBLE_EQ(vid == marked ? 0.25 : 1, sizes[vid]);
+    }
+}
+
+} /* namespace os2cx */
@@ -19,10 +19,27 @@ SOURCES = $$CORE_SOURCES \
     beacon_test.cpp \
     plc_nef_test.cpp \
     plc_test.cpp \
+    plc_index_test.cpp \
+    plc_facets_test.cpp \
+    plc_simplify_test.cpp \
+    sizing_field_test.cpp \
+    error_estimate_test.cpp \
+    resource_estimate_test.cpp \
+    mesh_quality_test.cpp \
+    mesh_optimize_test.cpp \
+    mesh_renumber_test.cpp \
+    mesh_batch_test.cpp \
+    result_test.cpp \
     units_test.cpp \
     mesh_test.cpp \
     mesher_naive_bricks_test.cpp \
-    mesh_type_info_test.cpp
+    mesher_octree_bricks_test.cpp \
+    mesher_sweep_test.cpp \
+    mesher_axisymmetric_test.cpp \
+    mesher_tetgen_test.cpp \
+    mesh_type_info_test.cpp \
+    parallel_test.cpp \
+    project_run_test.cpp
 
 DISTFILES += \
     max_element_size_test.scad \